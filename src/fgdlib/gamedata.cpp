@@ -2,12 +2,14 @@
 //
 //=============================================================================
 
+#ifdef _WIN32
 #include <windows.h>
-#include <tier0/dbg.h>
 #include <io.h>
-#include <WorldSize.h>
-#include "fgdlib/GameData.h"
-#include "fgdlib/HelperInfo.h"
+#endif
+#include <tier0/dbg.h>
+#include <worldsize.h>
+#include "fgdlib/gamedata.h"
+#include "fgdlib/helperinfo.h"
 #include "KeyValues.h"
 #include "filesystem_tools.h"
 #include "tier1/strtools.h"
@@ -280,8 +282,13 @@ BOOL GameData::Load(const char *pszFilename)
 {
 	TokenReader tr;
 
+#ifdef _WIN32
 	if(GetFileAttributes(pszFilename) == 0xffffffff)
 		return FALSE;
+#else
+	if ( access( pszFilename, F_OK ) != 0 )
+		return FALSE;
+#endif
 
 	if(!tr.Open(pszFilename))
 		return FALSE;
@@ -547,7 +554,7 @@ GDclass *GameData::BeginInstanceRemap( const char *pszClassName, const char *psz
 		m_InstanceClass = NULL;
 	}
 
-	if ( strcmpi( pszClassName, "info_overlay_accessor" ) == 0 )
+	if ( V_stricmp( pszClassName, "info_overlay_accessor" ) == 0 )
 	{	// yucky hack for a made up entity in the bsp process
 		pszClassName = "info_overlay";
 	}
@@ -699,7 +706,7 @@ bool GameData::RemapKeyValue( const char *pszKey, const char *pszInValue, char *
 			break;
 	}
 
-	return ( strcmpi( pszInValue, pszOutValue ) != 0 );
+	return ( V_stricmp( pszInValue, pszOutValue ) != 0 );
 }
 
 
@@ -729,7 +736,7 @@ bool GameData::RemapNameField( const char *pszInValue, char *pszOutValue, TNameF
 		}
 	}
 
-	return ( strcmpi( pszInValue, pszOutValue ) != 0 );
+	return ( V_stricmp( pszInValue, pszOutValue ) != 0 );
 }
 
 
@@ -4,7 +4,7 @@
 //
 //=============================================================================
 
-#include "fgdlib/WCKeyValues.h"
+#include "fgdlib/wckeyvalues.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include <tier0/memdbgon.h>
@@ -139,8 +139,8 @@ WCKeyValuesT<Base>::~WCKeyValuesT(void)
 template<class Base>
 const char *WCKeyValuesT<Base>::GetValue(const char *pszKey, int *piIndex) const
 {
-	int i = FindByKeyName( pszKey );
-	if ( i == GetInvalidIndex() )
+	int i = this->FindByKeyName( pszKey );
+	if ( i == this->GetInvalidIndex() )
 	{
 		return NULL;
 	}
@@ -149,7 +149,7 @@ const char *WCKeyValuesT<Base>::GetValue(const char *pszKey, int *piIndex) const
 		if(piIndex)
 			piIndex[0] = i;
 			
-		return m_KeyValues[i].szValue;
+		return this->m_KeyValues[i].szValue;
 	}
 }
 
@@ -169,7 +169,7 @@ template<class Base>
 void WCKeyValuesT<Base>::SetValue(const char *pszKey, int iValue)
 {
 	char szValue[100];
-	itoa(iValue, szValue, 10);
+	V_snprintf(szValue, sizeof(szValue), "%d", iValue);
 
 	SetValue(pszKey, szValue);
 }
@@ -233,8 +233,8 @@ void WCKeyValuesT<Base>::SetValue(const char *pszKey, const char *pszValue)
 	StripEdgeWhiteSpace(szTmpKey);
 	StripEdgeWhiteSpace(szTmpValue);
 
-	int i = FindByKeyName( szTmpKey );
-	if ( i == GetInvalidIndex() )
+	int i = this->FindByKeyName( szTmpKey );
+	if ( i == this->GetInvalidIndex() )
 	{
 		if ( pszValue )
 		{
@@ -244,21 +244,21 @@ void WCKeyValuesT<Base>::SetValue(const char *pszKey, const char *pszValue)
 			MDkeyvalue newkv;
 			Q_strncpy( newkv.szKey, szTmpKey, sizeof( newkv.szKey ) );
 			Q_strncpy( newkv.szValue, szTmpValue, sizeof( newkv.szValue ) );
-			InsertKeyValue( newkv );
+			this->InsertKeyValue( newkv );
 		}
 	}
 	else
 	{
 		if (pszValue != NULL)
 		{
-			V_strncpy(m_KeyValues[i].szValue, szTmpValue, sizeof(m_KeyValues[i].szValue));
+			V_strncpy(this->m_KeyValues[i].szValue, szTmpValue, sizeof(this->m_KeyValues[i].szValue));
 		}
 		//
 		// If we are setting to a NULL value, delete the key.
 		//
 		else
 		{
-			RemoveKeyAt( i );
+			this->RemoveKeyAt( i );
 		}
 	}
 }
@@ -270,7 +270,7 @@ void WCKeyValuesT<Base>::SetValue(const char *pszKey, const char *pszValue)
 template<class Base>
 void WCKeyValuesT<Base>::RemoveAll(void)
 {
-	m_KeyValues.RemoveAll();
+	this->m_KeyValues.RemoveAll();
 }
 
 
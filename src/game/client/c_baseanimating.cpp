@@ -653,6 +653,9 @@ static unsigned long	g_iModelBoneCounter = 0;
 CUtlVector<C_BaseAnimating *> g_PreviousBoneSetups;
 static unsigned long	g_iPreviousBoneCounter = (unsigned)-1;
 
+static bool g_bInThreadedBoneSetup;
+static bool g_bDoThreadedBoneSetup;
+
 class C_BaseAnimatingGameSystem : public CAutoGameSystem
 {
 	void LevelShutdownPostEntity()
@@ -695,6 +698,7 @@ C_BaseAnimating::C_BaseAnimating() :
 
 	m_iMostRecentModelBoneCounter = 0xFFFFFFFF;
 	m_iMostRecentBoneSetupRequest = g_iPreviousBoneCounter - 1;
+	m_bBoneSetupWaveDone = false;
 	m_flLastBoneSetupTime = -FLT_MAX;
 
 	m_vecPreRagdollMins = vec3_origin;
@@ -2293,6 +2297,27 @@ bool C_BaseAnimating::IsViewModel() const
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Anything that returns false here, and everything attached to it, is
+//			left out of ThreadedBoneSetup and set up on demand on the main thread
+//-----------------------------------------------------------------------------
+bool C_BaseAnimating::IsBoneSetupThreadSafe( void )
+{
+	// View models are set up from the current view, which isn't known yet
+	if ( IsViewModel() )
+		return false;
+
+	// ApplyBoneMatrixTransform draws from the shared random stream for these
+	if ( m_nRenderFX == kRenderFxDistort || m_nRenderFX == kRenderFxHologram )
+		return false;
+
+	// The replay ragdoll cache that BuildTransformations reads during playback isn't locked
+	if ( m_pRagdoll && ( engine->IsPlayingDemo() || engine->IsPlayingTimeDemo() ) )
+		return false;
+
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -2445,8 +2470,12 @@ void C_BaseAnimating::CalculateIKLocks( float currentTime )
 	// In TF, we might be attaching a player's view to a walking model that's using IK. If we are, it can
 	// get in here during the view setup code, and it's not normally supposed to be able to access the spatial
 	// partition that early in the rendering loop. So we allow access right here for that special case.
+	// The suppressed lists are global, so threaded bone setup does this once around all of its work instead.
 	SpatialPartitionListMask_t curSuppressed = ::partition->GetSuppressedLists();
-	::partition->SuppressLists( PARTITION_ALL_CLIENT_EDICTS, false );
+	if ( !g_bInThreadedBoneSetup )
+	{
+		::partition->SuppressLists( PARTITION_ALL_CLIENT_EDICTS, false );
+	}
 	CBaseEntity::PushEnableAbsRecomputations( false );
 
 	Ray_t ray;
@@ -2666,7 +2695,10 @@ void C_BaseAnimating::CalculateIKLocks( float currentTime )
 #endif
 
 	CBaseEntity::PopEnableAbsRecomputations();
-	::partition->SuppressLists( curSuppressed, true );
+	if ( !g_bInThreadedBoneSetup )
+	{
+		::partition->SuppressLists( curSuppressed, true );
+	}
 }
 
 bool C_BaseAnimating::GetPoseParameterRange( int index_, float &minValue, float &maxValue )
@@ -2738,9 +2770,8 @@ CMouthInfo *C_BaseAnimating::GetMouth( void )
 ConVar cl_warn_thread_contested_bone_setup("cl_warn_thread_contested_bone_setup", "0" );
 #endif
 
-// Marked this developmentonly because it currently crashes, and users are enabling it and complaining because of
-// course.  Once this actually works it should just be FCVAR_INTERNAL_USE.
-ConVar cl_threaded_bone_setup("cl_threaded_bone_setup", "0", FCVAR_DEVELOPMENTONLY | FCVAR_INTERNAL_USE,
+// Entities whose bone setup isn't safe off the main thread opt out with IsBoneSetupThreadSafe.
+ConVar cl_threaded_bone_setup("cl_threaded_bone_setup", "1", FCVAR_INTERNAL_USE,
                               "Enable parallel processing of C_BaseAnimating::SetupBones()" );
 
 //-----------------------------------------------------------------------------
@@ -2749,8 +2780,7 @@ ConVar cl_threaded_bone_setup("cl_threaded_bone_setup", "0", FCVAR_DEVELOPMENTON
 
 static void SetupBonesOnBaseAnimating( C_BaseAnimating *&pBaseAnimating )
 {
-	if ( !pBaseAnimating->GetMoveParent() )
-		pBaseAnimating->SetupBones( NULL, -1, -1, gpGlobals->curtime );
+	pBaseAnimating->SetupBones( NULL, -1, -1, gpGlobals->curtime );
 }
 
 static void PreThreadedBoneSetup()
@@ -2763,8 +2793,45 @@ static void PostThreadedBoneSetup()
 	mdlcache->EndLock();
 }
 
-static bool g_bInThreadedBoneSetup;
-static bool g_bDoThreadedBoneSetup;
+//-----------------------------------------------------------------------------
+// Threaded bone setup runs in waves. Wave 0 is everything without an animating
+// move parent (players, NPCs, props), wave 1 is what is attached to those (weapons,
+// bone merged wearables) and so on. Every parent is finished before any of its
+// children start, so a child's bone merge or attachment lookup only reads bones
+// that nobody is writing. Anything nested deeper than the last wave, or attached to
+// something that isn't IsBoneSetupThreadSafe, is left to set itself up on demand on
+// the main thread.
+//-----------------------------------------------------------------------------
+#define MAX_BONE_SETUP_WAVES	4
+
+static CUtlVector<C_BaseAnimating *> g_BoneSetupWaves[MAX_BONE_SETUP_WAVES];
+
+static C_BaseAnimating *GetBoneSetupParent( C_BaseAnimating *pAnimating )
+{
+	for ( C_BaseEntity *pParent = pAnimating->GetMoveParent(); pParent; pParent = pParent->GetMoveParent() )
+	{
+		C_BaseAnimating *pParentAnimating = pParent->GetBaseAnimating();
+		if ( pParentAnimating && !pParentAnimating->IsDormant() )
+			return pParentAnimating;
+	}
+
+	return NULL;
+}
+
+// Returns how many waves down pAnimating goes, or -1 if it or one of its parents has to
+// be set up on the main thread. A worker asking an unsafe parent for its bones would set
+// that parent up right there.
+static int GetBoneSetupWave( C_BaseAnimating *pAnimating )
+{
+	int nDepth = -1;
+	for ( C_BaseAnimating *pEntity = pAnimating; pEntity; pEntity = GetBoneSetupParent( pEntity ) )
+	{
+		if ( ++nDepth >= MAX_BONE_SETUP_WAVES || !pEntity->IsBoneSetupThreadSafe() )
+			return -1;
+	}
+
+	return nDepth;
+}
 
 void C_BaseAnimating::InitBoneSetupThreadPool()
 {
@@ -2776,17 +2843,74 @@ void C_BaseAnimating::ShutdownBoneSetupThreadPool()
 
 void C_BaseAnimating::ThreadedBoneSetup()
 {
-	g_bDoThreadedBoneSetup = cl_threaded_bone_setup.GetBool();
+	// Jiggle bone debugging draws through debugoverlay, which isn't thread safe
+	static ConVarRef cl_jiggle_bone_debug( "cl_jiggle_bone_debug" );
+	static ConVarRef cl_jiggle_bone_debug_yaw_constraints( "cl_jiggle_bone_debug_yaw_constraints" );
+	static ConVarRef cl_jiggle_bone_debug_pitch_constraints( "cl_jiggle_bone_debug_pitch_constraints" );
+
+	g_bDoThreadedBoneSetup = cl_threaded_bone_setup.GetBool() &&
+							 !cl_jiggle_bone_debug.GetBool() &&
+							 !cl_jiggle_bone_debug_yaw_constraints.GetBool() &&
+							 !cl_jiggle_bone_debug_pitch_constraints.GetBool();
 	if ( g_bDoThreadedBoneSetup )
 	{
+		// Parents have to be in the graph for their children to wait on them, even if
+		// nobody asked for their bones directly last frame. The list grows as we go.
+		for ( int i = 0; i < g_PreviousBoneSetups.Count(); i++ )
+		{
+			C_BaseAnimating *pParent = GetBoneSetupParent( g_PreviousBoneSetups[i] );
+			if ( pParent && pParent->m_iMostRecentBoneSetupRequest != g_iPreviousBoneCounter )
+			{
+				pParent->m_iMostRecentBoneSetupRequest = g_iPreviousBoneCounter;
+				g_PreviousBoneSetups.AddToTail( pParent );
+			}
+		}
+
 		int nCount = g_PreviousBoneSetups.Count();
 		if ( nCount > 1 )
 		{
+			for ( int i = 0; i < nCount; i++ )
+			{
+				C_BaseAnimating *pAnimating = g_PreviousBoneSetups[i];
+
+				int nWave = GetBoneSetupWave( pAnimating );
+				if ( nWave >= 0 )
+				{
+					g_BoneSetupWaves[nWave].AddToTail( pAnimating );
+				}
+			}
+
+			// IK traces need the client lists in the partition, see CalculateIKLocks
+			SpatialPartitionListMask_t curSuppressed = ::partition->GetSuppressedLists();
+			::partition->SuppressLists( PARTITION_ALL_CLIENT_EDICTS, false );
+
 			g_bInThreadedBoneSetup = true;
 
-			ParallelProcess( "C_BaseAnimating::ThreadedBoneSetup", g_PreviousBoneSetups.Base(), nCount, &SetupBonesOnBaseAnimating, &PreThreadedBoneSetup, &PostThreadedBoneSetup );
+			for ( int i = 0; i < MAX_BONE_SETUP_WAVES; i++ )
+			{
+				if ( g_BoneSetupWaves[i].Count() )
+				{
+					ParallelProcess( "C_BaseAnimating::ThreadedBoneSetup", g_BoneSetupWaves[i].Base(), g_BoneSetupWaves[i].Count(), &SetupBonesOnBaseAnimating, &PreThreadedBoneSetup, &PostThreadedBoneSetup );
+
+					for ( int j = 0; j < g_BoneSetupWaves[i].Count(); j++ )
+					{
+						g_BoneSetupWaves[i][j]->m_bBoneSetupWaveDone = true;
+					}
+				}
+			}
 
 			g_bInThreadedBoneSetup = false;
+
+			for ( int i = 0; i < MAX_BONE_SETUP_WAVES; i++ )
+			{
+				for ( int j = 0; j < g_BoneSetupWaves[i].Count(); j++ )
+				{
+					g_BoneSetupWaves[i][j]->m_bBoneSetupWaveDone = false;
+				}
+				g_BoneSetupWaves[i].RemoveAll();
+			}
+
+			::partition->SuppressLists( curSuppressed, true );
 		}
 	}
 	g_iPreviousBoneCounter++;
@@ -2844,7 +2968,14 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 
 	if ( g_bInThreadedBoneSetup )
 	{
-		if ( !m_BoneSetupLock.TryLock() )
+		// Entities finished in an earlier wave are only asked for their bones by their
+		// children, which always lock child then parent, so waiting can't deadlock. Bone
+		// merged siblings all ask for the same parent at once and mustn't fail on each other.
+		if ( m_bBoneSetupWaveDone )
+		{
+			m_BoneSetupLock.Lock();
+		}
+		else if ( !m_BoneSetupLock.TryLock() )
 		{
 			return false;
 		}
@@ -2894,7 +3025,7 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 	}
 
 	int nBoneCount = m_CachedBoneData.Count();
-	if ( g_bDoThreadedBoneSetup && !g_bInThreadedBoneSetup && ( nBoneCount >= 16 ) && !GetMoveParent() && m_iMostRecentBoneSetupRequest != g_iPreviousBoneCounter )
+	if ( g_bDoThreadedBoneSetup && !g_bInThreadedBoneSetup && ( nBoneCount >= 16 ) && m_iMostRecentBoneSetupRequest != g_iPreviousBoneCounter )
 	{
 		m_iMostRecentBoneSetupRequest = g_iPreviousBoneCounter;
 		Assert( g_PreviousBoneSetups.Find( this ) == -1 );
@@ -2934,7 +3065,10 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 		}
 		else
 		{
-			TrackBoneSetupEnt( this );
+			if ( !g_bInThreadedBoneSetup )
+			{
+				TrackBoneSetupEnt( this );
+			}
 			
 			// This is necessary because it's possible that CalculateIKLocks will trigger our move children
 			// to call GetAbsOrigin(), and they'll use our OLD bone transforms to get their attachments
@@ -2981,8 +3115,12 @@ bool C_BaseAnimating::SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, i
 				m_pIk->Init( hdr, GetRenderAngles(), GetRenderOrigin(), currentTime, gpGlobals->framecount, bonesMaskNeedRecalc );
 			}
 
-			// Let pose debugger know that we are blending
-			g_pPoseDebugger->StartBlending( this, hdr );
+			// Let pose debugger know that we are blending. It isn't thread safe and
+			// only follows one model at a time anyway.
+			if ( !g_bInThreadedBoneSetup )
+			{
+				g_pPoseDebugger->StartBlending( this, hdr );
+			}
 
 			StandardBlendingRules( hdr, pos, q, currentTime, bonesMaskNeedRecalc );
 
@@ -4603,6 +4741,24 @@ const QAngle& C_BaseAnimating::GetRenderAngles( void )
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Loads the studio header and resolves the abs transform here, so that
+//			GetRenderBoundsWorldspace only reads them from the worker
+//-----------------------------------------------------------------------------
+bool C_BaseAnimating::PrepareThreadedRenderBounds( void )
+{
+	// Ragdoll bounds come from physics, and followers get theirs from their parent
+	if ( m_pRagdoll || IsFollowingEntity() )
+		return false;
+
+	if ( !GetModelPtr() )
+		return false;
+
+	GetRenderOrigin();
+	GetRenderAngles();
+	return true;
+}
+
 void C_BaseAnimating::RagdollMoved( void ) 
 {
 	SetAbsOrigin( m_pRagdoll->GetRagdollOrigin() );
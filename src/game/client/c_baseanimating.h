@@ -259,6 +259,7 @@ public:
 	virtual void					GetRenderBounds( Vector& theMins, Vector& theMaxs );
 	virtual const Vector&			GetRenderOrigin( void );
 	virtual const QAngle&			GetRenderAngles( void );
+	virtual bool					PrepareThreadedRenderBounds( void );
 
 	virtual bool					GetSoundSpatialization( SpatializationInfo_t& info );
 
@@ -450,6 +451,10 @@ public:
 	virtual bool					IsViewModel() const;
 	virtual void					UpdateOnRemove( void );
 
+	// Can ThreadedBoneSetup set this entity up on a worker thread? Return false if the
+	// bone setup overrides read view state or write to other entities.
+	virtual bool					IsBoneSetupThreadSafe( void );
+
 protected:
 	// View models scale their attachment positions to account for FOV. To get the unmodified
 	// attachment position (like if you're rendering something else during the view model's DrawModel call),
@@ -517,6 +522,7 @@ protected:
 	// bone transformation matrix
 	unsigned long					m_iMostRecentModelBoneCounter;
 	unsigned long					m_iMostRecentBoneSetupRequest;
+	bool							m_bBoneSetupWaveDone;		// Set up in an earlier wave of ThreadedBoneSetup
 	int								m_iPrevBoneMask;
 	int								m_iAccumulatedBoneMask;
 
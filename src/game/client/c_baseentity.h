@@ -308,6 +308,10 @@ public:
 	virtual IPVSNotify*				GetPVSNotifyInterface();
 	virtual void					GetRenderBoundsWorldspace( Vector& absMins, Vector& absMaxs );
 
+	// Called on the main thread by the leaf system. Returning true means GetRenderBoundsWorldspace
+	// can be called from a worker until the entity next changes.
+	virtual bool					PrepareThreadedRenderBounds( void ) { return false; }
+
 	virtual void					GetShadowRenderBounds( Vector &mins, Vector &maxs, ShadowType_t shadowType );
 
 	// Determine the color modulation amount
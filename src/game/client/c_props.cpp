@@ -101,6 +101,15 @@ void C_DynamicProp::GetRenderBounds( Vector& theMins, Vector& theMaxs )
 	BaseClass::GetRenderBounds( theMins, theMaxs );
 }
 
+bool C_DynamicProp::PrepareThreadedRenderBounds( void )
+{
+	// Hitbox render bounds set up our bones
+	if ( m_bUseHitboxesForRenderBox )
+		return false;
+
+	return BaseClass::PrepareThreadedRenderBounds();
+}
+
 unsigned int C_DynamicProp::ComputeClientSideAnimationFlags()
 {
 	if ( GetSequence() != -1 )
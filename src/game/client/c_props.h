@@ -29,6 +29,7 @@ public:
 	~C_DynamicProp( void );
 
 	void GetRenderBounds( Vector& theMins, Vector& theMaxs );
+	virtual bool PrepareThreadedRenderBounds( void );
 	unsigned int ComputeClientSideAnimationFlags();
 	bool TestBoneFollowers( const Ray_t &ray, unsigned int fContentsMask, trace_t& tr );
 	bool TestCollision( const Ray_t &ray, unsigned int fContentsMask, trace_t& tr );
@@ -32,7 +32,8 @@ class VMatrix;  // forward decl
 static ConVar cl_drawleaf("cl_drawleaf", "-1", FCVAR_CHEAT );
 static ConVar r_PortalTestEnts( "r_PortalTestEnts", "1", FCVAR_CHEAT, "Clip entities against portal frustums." );
 static ConVar r_portalsopenall( "r_portalsopenall", "0", FCVAR_CHEAT, "Open all portals" );
-static ConVar cl_threaded_client_leaf_system("cl_threaded_client_leaf_system", "0"  );
+static ConVar cl_threaded_client_leaf_system("cl_threaded_client_leaf_system", "1"  );
+static ConVar cl_threaded_client_leaf_system_min_dirty( "cl_threaded_client_leaf_system_min_dirty", "32", 0, "Fewest dirty renderables in a frame before their leaves are found on the thread pool." );
 
 
 DEFINE_FIXEDSIZE_ALLOCATOR( CClientRenderablesList, 1, CUtlMemoryPool::GROW_SLOW );
@@ -56,6 +57,55 @@ static void CallComputeFXBlend( IClientRenderable *&pRenderable )
 	pRenderable->ComputeFxBlend();
 }
 
+void CalcRenderableWorldSpaceAABB_Fast( IClientRenderable *pRenderable, Vector &absMin, Vector &absMax );
+
+//-----------------------------------------------------------------------------
+// Leaves found for one dirty renderable on the thread pool. Each job only writes
+// its own entry, and PreRender links them into the leaves afterwards.
+//-----------------------------------------------------------------------------
+#define MAX_PENDING_INSERT_LEAVES	64
+
+struct PendingLeafInsert_t
+{
+	ClientRenderHandle_t	m_Handle;
+	IClientRenderable		*m_pRenderable;
+	bool					m_bCalcBounds;	// Bounds are found on the worker, otherwise they're already filled in
+	Vector					m_vecAbsMins;
+	Vector					m_vecAbsMaxs;
+	int						m_nLeafCount;	// -1 if it touches too many leaves to record
+	unsigned short			m_Leaves[MAX_PENDING_INSERT_LEAVES];
+};
+
+class CPendingLeafInsertEnumerator : public ISpatialLeafEnumerator
+{
+public:
+	bool EnumerateLeaf( int leaf, intp context )
+	{
+		PendingLeafInsert_t *pInsert = (PendingLeafInsert_t *)context;
+		if ( pInsert->m_nLeafCount >= MAX_PENDING_INSERT_LEAVES )
+		{
+			pInsert->m_nLeafCount = -1;
+			return false;
+		}
+
+		pInsert->m_Leaves[pInsert->m_nLeafCount++] = leaf;
+		return true;
+	}
+};
+
+static void EnumeratePendingLeafInsert( PendingLeafInsert_t &insert )
+{
+	if ( insert.m_bCalcBounds )
+	{
+		CalcRenderableWorldSpaceAABB_Fast( insert.m_pRenderable, insert.m_vecAbsMins, insert.m_vecAbsMaxs );
+		Assert( insert.m_vecAbsMins.IsValid() && insert.m_vecAbsMaxs.IsValid() );
+	}
+
+	CPendingLeafInsertEnumerator enumerator;
+	insert.m_nLeafCount = 0;
+	engine->GetBSPTreeQuery()->EnumerateLeavesInBox( insert.m_vecAbsMins, insert.m_vecAbsMaxs, &enumerator, (intp)&insert );
+}
+
 //-----------------------------------------------------------------------------
 // The client leaf system
 //-----------------------------------------------------------------------------
@@ -160,7 +210,8 @@ private:
 	short GetRenderableArea( ClientRenderHandle_t handle );
 
 	// remove renderables from leaves
-	void InsertIntoTree( ClientRenderHandle_t &handle );
+	void InsertIntoTree( ClientRenderHandle_t handle );
+	void InsertIntoTreeThreaded( int nDirty );
 	void RemoveFromTree( ClientRenderHandle_t handle );
 
 	// Returns if it's a view model render group
@@ -219,16 +270,6 @@ private:
 		return s_ClientLeafSystem.m_Shadows[shadow].m_FirstRenderable;
 	}
 
-	void FrameLock()
-	{
-		mdlcache->BeginLock();
-	}
-
-	void FrameUnlock()
-	{
-		mdlcache->EndLock();
-	}
-
 private:
 	enum
 	{
@@ -280,18 +321,6 @@ private:
 		unsigned short	m_Flags;
 	};
 
-	struct EnumResult_t
-	{
-		int leaf;
-		EnumResult_t *pNext;
-	};
-
-	struct EnumResultList_t
-	{
-		EnumResult_t *pHead;
-		ClientRenderHandle_t handle;
-	};
-
 	// Stores data associated with each leaf.
 	CUtlVector< ClientLeaf_t >	m_Leaf;
 
@@ -313,6 +342,9 @@ private:
 	// Dirty list of renderables
 	CUtlVector< ClientRenderHandle_t >	m_DirtyRenderables;
 
+	// Scratch space for finding the leaves of dirty renderables in parallel
+	CUtlVector< PendingLeafInsert_t >	m_PendingInserts;
+
 	// List of renderables in view model render groups
 	CUtlVector< ClientRenderHandle_t >	m_ViewModels;
 
@@ -322,8 +354,6 @@ private:
 
 	// A little enumerator to help us when adding shadows to renderables
 	int	m_ShadowEnum;
-
-	CTSList<EnumResultList_t> m_DeferredInserts;
 };
 
 
@@ -334,8 +364,6 @@ CClientLeafSystem CClientLeafSystem::s_ClientLeafSystem;
 IClientLeafSystem *g_pClientLeafSystem = &CClientLeafSystem::s_ClientLeafSystem;
 EXPOSE_SINGLE_INTERFACE_GLOBALVAR( CClientLeafSystem, IClientLeafSystem, CLIENTLEAFSYSTEM_INTERFACE_VERSION, CClientLeafSystem::s_ClientLeafSystem );
 
-void CalcRenderableWorldSpaceAABB_Fast( IClientRenderable *pRenderable, Vector &absMin, Vector &absMax );
-
 //-----------------------------------------------------------------------------
 // Helper functions.
 //-----------------------------------------------------------------------------
@@ -519,6 +547,7 @@ void CClientLeafSystem::LevelShutdownPostEntity()
 	m_ShadowsInLeaf.Purge();
 	m_ShadowsOnRenderable.Purge();
 	m_DirtyRenderables.Purge();
+	m_PendingInserts.Purge();
 }
 
 
@@ -550,7 +579,7 @@ void CClientLeafSystem::PreRender()
 			RemoveFromTree( handle );
 		}
 
-		bool bThreaded = false;//( nDirty > 5 && cl_threaded_client_leaf_system.GetBool() && g_pThreadPool->NumThreads() );
+		bool bThreaded = ( nDirty >= cl_threaded_client_leaf_system_min_dirty.GetInt() && cl_threaded_client_leaf_system.GetBool() && g_pThreadPool->NumThreads() );
 
 		if ( !bThreaded )
 		{
@@ -561,26 +590,7 @@ void CClientLeafSystem::PreRender()
 		}
 		else
 		{
-			// InsertIntoTree can result in new renderables being added, so copy:
-			ClientRenderHandle_t *pDirtyRenderables = (ClientRenderHandle_t *)alloca( sizeof(ClientRenderHandle_t) * nDirty );
-			memcpy( pDirtyRenderables, m_DirtyRenderables.Base(), sizeof(ClientRenderHandle_t) * nDirty );
-			ParallelProcess( "CClientLeafSystem::PreRender", pDirtyRenderables, nDirty, this, &CClientLeafSystem::InsertIntoTree, &CClientLeafSystem::FrameLock, &CClientLeafSystem::FrameUnlock );
-		}
-
-		if ( m_DeferredInserts.Count() )
-		{
-			EnumResultList_t enumResultList;
-			while ( m_DeferredInserts.PopItem( &enumResultList ) )
-			{
-				m_ShadowEnum++;
-				while ( enumResultList.pHead )
-				{
-					EnumResult_t *p = enumResultList.pHead;
-					enumResultList.pHead = p->pNext;
-					AddRenderableToLeaf( p->leaf, enumResultList.handle );
-					delete p;
-				}
-			}
+			InsertIntoTreeThreaded( nDirty );
 		}
 
 		for ( i = nDirty; --i >= 0; )
@@ -1202,31 +1212,17 @@ void CClientLeafSystem::AddRenderableToLeaves( ClientRenderHandle_t handle, int
 //-----------------------------------------------------------------------------
 bool CClientLeafSystem::EnumerateLeaf( int leaf, intp context )
 {
-	EnumResultList_t *pList = (EnumResultList_t *)context;
-	if ( ThreadInMainThread() )
-	{
-		AddRenderableToLeaf( leaf, pList->handle );
-	}
-	else
-	{
-		EnumResult_t *p = new EnumResult_t;
-		p->leaf = leaf;
-		p->pNext = pList->pHead;
-		pList->pHead = p;
-	}
+	AddRenderableToLeaf( leaf, (ClientRenderHandle_t)context );
 	return true;
 }
 
-void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle )
+void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t handle )
 {
-	if ( ThreadInMainThread() )
-	{
-		// When we insert into the tree, increase the shadow enumerator
-		// to make sure each shadow is added exactly once to each renderable
-		m_ShadowEnum++;
-	}
+	Assert( ThreadInMainThread() );
 
-	EnumResultList_t list = { NULL, handle };
+	// When we insert into the tree, increase the shadow enumerator
+	// to make sure each shadow is added exactly once to each renderable
+	m_ShadowEnum++;
 
 	// NOTE: The render bounds here are relative to the renderable's coordinate system
 	IClientRenderable* pRenderable = m_Renderables[handle].m_pRenderable;
@@ -1236,11 +1232,50 @@ void CClientLeafSystem::InsertIntoTree( ClientRenderHandle_t &handle )
 	Assert( absMins.IsValid() && absMaxs.IsValid() );
 
 	ISpatialQuery* pQuery = engine->GetBSPTreeQuery();
-	pQuery->EnumerateLeavesInBox( absMins, absMaxs, this, (intp)&list );
+	pQuery->EnumerateLeavesInBox( absMins, absMaxs, this, (intp)handle );
+}
+
+//-----------------------------------------------------------------------------
+// Inserts the first nDirty dirty renderables, finding their bounds and walking the
+// BSP on the thread pool. Entities that can't guarantee their bounds code only reads
+// their own state get their bounds here on the main thread instead, and linking into
+// the leaves always happens here.
+//-----------------------------------------------------------------------------
+void CClientLeafSystem::InsertIntoTreeThreaded( int nDirty )
+{
+	m_PendingInserts.SetCount( nDirty );
+	for ( int i = 0; i < nDirty; ++i )
+	{
+		PendingLeafInsert_t &insert = m_PendingInserts[i];
+		insert.m_Handle = m_DirtyRenderables[i];
+		insert.m_pRenderable = m_Renderables[insert.m_Handle].m_pRenderable;
+
+		C_BaseEntity *pEnt = insert.m_pRenderable->GetIClientUnknown()->GetBaseEntity();
+		insert.m_bCalcBounds = pEnt && pEnt->PrepareThreadedRenderBounds();
+		if ( !insert.m_bCalcBounds )
+		{
+			CalcRenderableWorldSpaceAABB_Fast( insert.m_pRenderable, insert.m_vecAbsMins, insert.m_vecAbsMaxs );
+			Assert( insert.m_vecAbsMins.IsValid() && insert.m_vecAbsMaxs.IsValid() );
+		}
+	}
+
+	ParallelProcess( "CClientLeafSystem::PreRender", m_PendingInserts.Base(), nDirty, &EnumeratePendingLeafInsert, &::FrameLock, &::FrameUnlock );
 
-	if ( list.pHead )
+	// Same order as the serial path, so the leaf lists come out the same
+	for ( int i = nDirty; --i >= 0; )
 	{
-		m_DeferredInserts.PushItem( list );
+		const PendingLeafInsert_t &insert = m_PendingInserts[i];
+		if ( insert.m_nLeafCount < 0 )
+		{
+			InsertIntoTree( insert.m_Handle );
+			continue;
+		}
+
+		m_ShadowEnum++;
+		for ( int j = 0; j < insert.m_nLeafCount; ++j )
+		{
+			AddRenderableToLeaf( insert.m_Leaves[j], insert.m_Handle );
+		}
 	}
 }
 
@@ -388,6 +388,7 @@ public:
 	virtual void	SetupWeights( const matrix3x4_t *pBoneToWorld, int nFlexWeightCount, float *pFlexWeights, float *pFlexDelayedWeights );
 
 	void GetRenderBounds( Vector& theMins, Vector& theMaxs );
+	virtual bool PrepareThreadedRenderBounds( void ) { return false; }	// GetRenderBounds can recompute our abs transform
 	virtual void AddEntity( void );
 	virtual void AccumulateLayers( IBoneSetup &boneSetup, Vector pos[], Quaternion q[], float currentTime );
 	virtual void BuildTransformations( CStudioHdr *pStudioHdr, Vector *pos, Quaternion q[], const matrix3x4_t &cameraTransform, int boneMask, CBoneBitList &boneComputed );
@@ -8716,6 +8716,18 @@ void C_TFPlayer::BuildTransformations( CStudioHdr *hdr, Vector *pos, Quaternion
 	BuildFirstPersonMeathookTransformations( hdr, pos, q, cameraTransform, boneMask, boneComputed, "bip_head" );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: The meathook transform in BuildTransformations reads the main view,
+//			which is only set up on the main thread while rendering
+//-----------------------------------------------------------------------------
+bool C_TFPlayer::IsBoneSetupThreadSafe( void )
+{
+	if ( IsLocalPlayer() )
+		return false;
+
+	return BaseClass::IsBoneSetupThreadSafe();
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: 
@@ -103,6 +103,7 @@ public:
 
 	virtual void ApplyBoneMatrixTransform( matrix3x4_t& transform );
 	virtual void BuildTransformations( CStudioHdr *hdr, Vector *pos, Quaternion q[], const matrix3x4_t& cameraTransform, int boneMask, CBoneBitList &boneComputed );
+	virtual bool IsBoneSetupThreadSafe( void ) OVERRIDE;
 
 	virtual bool CreateMove( float flInputSampleTime, CUserCmd *pCmd ) OVERRIDE;
 	void CreateVehicleMove( float flInputSampleTime, CUserCmd *pCmd );
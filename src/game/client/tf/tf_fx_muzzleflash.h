@@ -45,6 +45,7 @@ public:
 	// Recording
 	virtual void GetToolRecordingState( KeyValues *msg );
 	virtual bool SetupBones( matrix3x4_t *pBoneToWorldOut, int nMaxBones, int boneMask, float currentTime );
+	virtual bool IsBoneSetupThreadSafe( void ) { return false; }	// SetupBones swaps the parent weapon's model
 
 	void	SetIs3rdPersonFlash( bool bEnable );
 
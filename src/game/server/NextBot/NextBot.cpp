@@ -19,6 +19,7 @@
 #include "vprof.h"
 #include "datacache/imdlcache.h"
 #include "EntityFlame.h"
+#include "ilagcompensationmanager.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -262,6 +263,18 @@ void NextBotCombatCharacter::Spawn( void )
 	SetNextThink( gpGlobals->curtime );
 
 	m_lastAttacker = NULL;
+
+	// hitscan against us is lag compensated like it is against players
+	lagcompensation->AddAdditionalEntity( this );
+}
+
+
+//----------------------------------------------------------------------------------------------------------
+void NextBotCombatCharacter::UpdateOnRemove( void )
+{
+	lagcompensation->RemoveAdditionalEntity( this );
+
+	BaseClass::UpdateOnRemove();
 }
 
 
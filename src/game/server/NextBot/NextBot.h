@@ -36,6 +36,7 @@ public:
 	virtual ~NextBotCombatCharacter() { }
 
 	virtual void Spawn( void );
+	virtual void UpdateOnRemove( void );
 
 	virtual Vector EyePosition( void );
 
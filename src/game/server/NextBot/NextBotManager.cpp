@@ -6,6 +6,9 @@
 
 #include "NextBotManager.h"
 #include "NextBotInterface.h"
+#include "NextBotVisionInterface.h"
+#include "datacache/imdlcache.h"
+#include "vstdlib/jobthread.h"
 
 #ifdef TERROR
 #include "ZombieBot/Infected/Infected.h"
@@ -25,6 +28,7 @@ ConVar nb_update_frequency( "nb_update_frequency", ".1", FCVAR_CHEAT );
 ConVar nb_update_framelimit( "nb_update_framelimit", ( IsDebug() ) ? "30" : "15", FCVAR_CHEAT );
 ConVar nb_update_maxslide( "nb_update_maxslide", "2", FCVAR_CHEAT );
 ConVar nb_update_debug( "nb_update_debug", "0", FCVAR_CHEAT );
+ConVar nb_vision_threaded( "nb_vision_threaded", "1", FCVAR_CHEAT, "Resolve line-of-sight for bots scheduled to update on the thread pool" );
 
 //---------------------------------------------------------------------------------------------
 //---------------------------------------------------------------------------------------------
@@ -391,6 +395,8 @@ void NextBotManager::Update( void )
 			nScheduled = m_botList.Count();
 		}
 
+		GatherPerception();
+
 		if ( nb_update_debug.GetBool() )
 		{
 			int nIntentionalSliders = 0;
@@ -412,6 +418,59 @@ void NextBotManager::Update( void )
 	}
 }
 
+//---------------------------------------------------------------------------------------------
+static void PreGatherPerception()
+{
+	mdlcache->BeginLock();
+}
+
+static void PostGatherPerception()
+{
+	mdlcache->EndLock();
+}
+
+static void GatherPerceptionJob( IVision *&vision )
+{
+	vision->GatherPerception();
+}
+
+
+//---------------------------------------------------------------------------------------------
+/**
+ * Run the line-of-sight traces for each bot about to update. Setting up the queries touches
+ * entities, so it stays on the main thread. The raw traces are independent per bot, so they
+ * are spread across the thread pool, and the bots use the results when they update later this tick.
+ */
+void NextBotManager::GatherPerception( void )
+{
+	VPROF_BUDGET( "NextBotManager::GatherPerception", "NextBot" );
+
+	CUtlVector< IVision * > visionVector;
+
+	for( int i = m_botList.Head(); i != m_botList.InvalidIndex(); i = m_botList.Next( i ) )
+	{
+		INextBot *bot = m_botList[i];
+
+		if ( m_iUpdateTickrate > 0 && !bot->IsFlaggedForUpdate() )
+			continue;
+
+		if ( IsDead( bot ) )
+			continue;
+
+		IVision *vision = bot->GetVisionInterface();
+		if ( vision && vision->PreparePerception() )
+		{
+			visionVector.AddToTail( vision );
+		}
+	}
+
+	if ( visionVector.Count() )
+	{
+		ParallelProcess( "NextBotManager::GatherPerception", visionVector.Base(), visionVector.Count(), &GatherPerceptionJob, &PreGatherPerception, &PostGatherPerception, ( nb_vision_threaded.GetBool() ) ? INT_MAX : 0 );
+	}
+}
+
+
 //---------------------------------------------------------------------------------------------
 bool NextBotManager::ShouldUpdate( INextBot *bot )
 {
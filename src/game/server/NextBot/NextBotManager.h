@@ -147,6 +147,8 @@ protected:
 
 	CUtlLinkedList< INextBot * > m_botList;				// list of all active NextBots
 
+	void GatherPerception( void );					// resolve line-of-sight for the bots about to update, in parallel
+
 	int m_iUpdateTickrate;
 	double m_CurUpdateStartTime;
 	double m_SumFrameTime;
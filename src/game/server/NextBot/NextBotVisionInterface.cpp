@@ -46,6 +46,11 @@ void IVision::Reset( void )
 	m_lastVisionUpdateTimestamp = 0.0f;
 	m_primaryThreat = NULL;
 
+	m_lineOfSightQueryVector.RemoveAll();
+	m_lineOfSightQueryTick = -1;
+	m_isUsingLineOfSightQueries = false;
+	m_lastPotentiallyVisible.RemoveAll();
+
 	m_FOV = GetDefaultFieldOfView();
 	m_cosHalfFOV = cos( 0.5f * m_FOV * M_PI / 180.0f );
 	
@@ -373,6 +378,9 @@ void IVision::UpdateKnownEntities( void )
 	CollectPotentiallyVisibleEntities( &potentiallyVisible );
 
 	// collect set of visible and recognized entities at this moment
+	// line-of-sight traces already resolved by GatherPerception() this tick are reused
+	m_isUsingLineOfSightQueries = ( m_lineOfSightQueryTick == gpGlobals->tickcount );
+
 	CollectVisible visibleNow( this );
 	FOR_EACH_VEC( potentiallyVisible, pit )
 	{
@@ -381,6 +389,17 @@ void IVision::UpdateKnownEntities( void )
 		if ( visibleNow( potentiallyVisible[ pit ] ) == false )
 			break;
 	}
+
+	m_isUsingLineOfSightQueries = false;
+	m_lineOfSightQueryTick = -1;
+	m_lineOfSightQueryVector.RemoveAll();
+
+	// the next PreparePerception() traces against this set
+	m_lastPotentiallyVisible.SetCount( potentiallyVisible.Count() );
+	FOR_EACH_VEC( potentiallyVisible, pit )
+	{
+		m_lastPotentiallyVisible[ pit ] = potentiallyVisible[ pit ];
+	}
 	
 	// update known set with new data
 	{	VPROF_BUDGET( "IVision::UpdateKnownEntities( update status )", "NextBot" );
@@ -564,11 +583,191 @@ void IVision::Update( void )
 }
 
 
+//------------------------------------------------------------------------------------------
+/**
+ * Set up line-of-sight queries for the entities our last look collected. Runs on the main thread.
+ * Only the entities IsAbleToSee() would actually trace against get a query.
+ * Returns false if there is nothing to trace.
+ */
+bool IVision::PreparePerception( void )
+{
+	m_lineOfSightQueryTick = -1;
+	m_lineOfSightQueryVector.RemoveAll();
+
+	if ( nb_blind.GetBool() )
+	{
+		return false;
+	}
+
+	CBaseCombatCharacter *me = GetBot()->GetEntity();
+	if ( !me )
+	{
+		return false;
+	}
+
+	const Vector &eye = GetBot()->GetBodyInterface()->GetEyePosition();
+
+	FOR_EACH_VEC( m_lastPotentiallyVisible, it )
+	{
+		CBaseEntity *subject = m_lastPotentiallyVisible[ it ];
+
+		if ( !subject ||
+			 IsIgnored( subject ) ||
+			 !subject->IsAlive() ||
+			 subject == me ||
+			 !IsPotentiallyInSight( subject, USE_FOV ) )
+		{
+			continue;
+		}
+
+		LineOfSightQuery &query = m_lineOfSightQueryVector[ m_lineOfSightQueryVector.AddToTail() ];
+		query.m_subject = subject;
+		query.m_eye = eye;
+		query.m_spot[0] = subject->WorldSpaceCenter();
+		query.m_spot[1] = subject->EyePosition();
+		query.m_spot[2] = subject->GetAbsOrigin();
+		query.m_result = LOS_UNKNOWN;
+	}
+
+	if ( m_lineOfSightQueryVector.Count() == 0 )
+	{
+		return false;
+	}
+
+	m_lineOfSightQueryTick = gpGlobals->tickcount;
+	return true;
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Skips only the viewer and the subject, by pointer. Everything the vision filter
+ * can hit is hit by this one too, so a clear trace here is clear there as well.
+ */
+class CLineOfSightQueryFilter : public CTraceFilter
+{
+public:
+	CLineOfSightQueryFilter( const IHandleEntity *me, const IHandleEntity *subject )
+	{
+		m_me = me;
+		m_subject = subject;
+	}
+
+	virtual bool ShouldHitEntity( IHandleEntity *pHandleEntity, int contentsMask )
+	{
+		return ( pHandleEntity != m_me && pHandleEntity != m_subject );
+	}
+
+	const IHandleEntity *m_me;
+	const IHandleEntity *m_subject;
+};
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Resolve the queries set up by PreparePerception(). May be run on a worker thread, so it
+ * calls no entity or trace filter code. A spot blocked by world geometry is blocked for
+ * IsLineOfSightClearToEntity() too, and a spot clear of everything is clear for it. Anything
+ * else is left LOS_UNKNOWN, and the main thread traces it with the real filter as before.
+ */
+void IVision::GatherPerception( void )
+{
+	VPROF_BUDGET( "IVision::GatherPerception", "NextBotExpensive" );
+
+	const IHandleEntity *me = GetBot()->GetEntity();
+	const unsigned int mask = MASK_BLOCKLOS_AND_NPCS|CONTENTS_IGNORE_NODRAW_OPAQUE;
+
+	CTraceFilterWorldOnly worldFilter;
+	Ray_t ray;
+	trace_t result;
+
+	FOR_EACH_VEC( m_lineOfSightQueryVector, it )
+	{
+		LineOfSightQuery &query = m_lineOfSightQueryVector[ it ];
+		CLineOfSightQueryFilter filter( me, query.m_subject.Get() );
+
+		query.m_result = LOS_BLOCKED;
+
+		for( int s=0; s<ARRAYSIZE( query.m_spot ); ++s )
+		{
+			ray.Init( query.m_eye, query.m_spot[s] );
+
+			enginetrace->TraceRay( ray, mask, &worldFilter, &result );
+			if ( result.DidHit() )
+			{
+				// the world hides this spot, try the next one
+				continue;
+			}
+
+			enginetrace->TraceRay( ray, mask, &filter, &result );
+			query.m_result = result.DidHit() ? LOS_UNKNOWN : LOS_CLEAR;
+			break;
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Return the result GatherPerception() found for the subject, if UpdateKnownEntities() is
+ * running this tick and neither the subject nor our eye has moved since it was traced.
+ */
+IVision::LineOfSightResult IVision::GetLineOfSightQueryResult( const CBaseEntity *subject ) const
+{
+	if ( !m_isUsingLineOfSightQueries )
+	{
+		return LOS_UNKNOWN;
+	}
+
+	FOR_EACH_VEC( m_lineOfSightQueryVector, it )
+	{
+		const LineOfSightQuery &query = m_lineOfSightQueryVector[ it ];
+
+		if ( query.m_subject.Get() != subject )
+			continue;
+
+		if ( query.m_eye != GetBot()->GetBodyInterface()->GetEyePosition() ||
+			 query.m_spot[0] != subject->WorldSpaceCenter() ||
+			 query.m_spot[1] != subject->EyePosition() ||
+			 query.m_spot[2] != subject->GetAbsOrigin() )
+		{
+			return LOS_UNKNOWN;
+		}
+
+		return query.m_result;
+	}
+
+	return LOS_UNKNOWN;
+}
+
+
 //------------------------------------------------------------------------------------------
 bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV, Vector *visibleSpot ) const
 {
 	VPROF_BUDGET( "IVision::IsAbleToSee", "NextBotExpensive" );
 
+	if ( !IsPotentiallyInSight( subject, checkFOV ) )
+	{
+		return false;
+	}
+
+	// do actual line-of-sight trace
+	if ( !IsLineOfSightClearToEntity( subject ) )
+	{
+		return false;
+	}
+
+	return IsVisibleEntityNoticed( subject );
+}
+
+
+//------------------------------------------------------------------------------------------
+/**
+ * Return true if the subject passes the range, fog, field of view, and nav PVS tests
+ * that come before the line-of-sight trace in IsAbleToSee()
+ */
+bool IVision::IsPotentiallyInSight( CBaseEntity *subject, FieldOfViewCheckType checkFOV ) const
+{
 	if ( GetBot()->IsRangeGreaterThan( subject, GetMaxVisionRange() ) )
 	{
 		return false;
@@ -601,13 +800,7 @@ bool IVision::IsAbleToSee( CBaseEntity *subject, FieldOfViewCheckType checkFOV,
 		}
 	}
 
-	// do actual line-of-sight trace
-	if ( !IsLineOfSightClearToEntity( subject ) )
-	{
-		return false;
-	}
-
-	return IsVisibleEntityNoticed( subject );
+	return true;
 }
 
 
@@ -749,6 +942,15 @@ bool IVision::IsLineOfSightClearToEntity( const CBaseEntity *subject, Vector *vi
 	// TODO: Use plain-old traces until querycache/etc gets integrated
 	VPROF_BUDGET( "IVision::IsLineOfSightClearToEntity", "NextBot" );
 
+	if ( !visibleSpot )
+	{
+		LineOfSightResult precomputed = GetLineOfSightQueryResult( subject );
+		if ( precomputed != LOS_UNKNOWN )
+		{
+			return ( precomputed == LOS_CLEAR );
+		}
+	}
+
 	trace_t result;
 	NextBotTraceFilterIgnoreActors filter( subject, COLLISION_GROUP_NONE );
 
@@ -72,6 +72,18 @@ public:
 	 */
 	virtual void CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible );
 
+	/**
+	 * Line-of-sight traces for many bots can be run in parallel ahead of their Update().
+	 * PreparePerception() runs on the main thread. It culls the entities found by the last look
+	 * exactly as IsAbleToSee() would, and records the trace endpoints for the rest. It returns
+	 * false if there is nothing to trace. GatherPerception() may then run on a worker thread.
+	 * It only runs engine traces, and calls no entity or trace filter code.
+	 * The next UpdateKnownEntities() this tick uses those results where they are conclusive.
+	 * Everything else, including CollectPotentiallyVisibleEntities(), still runs in Update() as before.
+	 */
+	virtual bool PreparePerception( void );
+	void GatherPerception( void );
+
 	virtual float GetMaxVisionRange( void ) const;				// return maximum distance vision can reach
 	virtual float GetMinRecognizeTime( void ) const;			// return VISUAL reaction time
 
@@ -119,6 +131,24 @@ private:
 	bool IsAwareOf( const CKnownEntity &known ) const;	// return true if our reaction time has passed for this entity
 	mutable CHandle< CBaseEntity > m_primaryThreat;
 
+	bool IsPotentiallyInSight( CBaseEntity *subject, FieldOfViewCheckType checkFOV ) const;	// the range, fog, FOV, and nav PVS tests IsAbleToSee() does before tracing
+
+	enum LineOfSightResult { LOS_UNKNOWN, LOS_CLEAR, LOS_BLOCKED };
+
+	struct LineOfSightQuery
+	{
+		CHandle< CBaseEntity > m_subject;
+		Vector m_eye;
+		Vector m_spot[3];					// the points IsLineOfSightClearToEntity() tries, in order
+		LineOfSightResult m_result;
+	};
+	CUtlVector< LineOfSightQuery > m_lineOfSightQueryVector;		// set up by PreparePerception(), resolved by GatherPerception()
+	int m_lineOfSightQueryTick;										// tick the queries are valid for, or -1
+	bool m_isUsingLineOfSightQueries;								// true while UpdateKnownEntities() may consult them
+	LineOfSightResult GetLineOfSightQueryResult( const CBaseEntity *subject ) const;
+
+	CUtlVector< CHandle< CBaseEntity > > m_lastPotentiallyVisible;	// the set collected by the last UpdateKnownEntities()
+
 	float m_lastVisionUpdateTimestamp;
 	IntervalTimer m_notVisibleTimer[ MAX_TEAMS ];		// for tracking interval since last saw a member of the given team
 };
@@ -190,7 +190,8 @@ public:
 		// Compute shortest path to subject
 		//
 		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
+		CNavSearchContext &context = TheNavSearchContext();
+		bool pathResult = NavAreaBuildPath( context, startArea, subjectArea, &subjectPos, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
 
 		// Failed?
 		if ( closestArea == NULL )
@@ -203,7 +204,7 @@ public:
 		// get count
 		int count = 0;
 		CNavArea *area;
-		for( area = closestArea; area; area = area->GetParent() )
+		for( area = closestArea; area; area = context.GetParent( area ) )
 		{
 			++count;
 
@@ -224,11 +225,11 @@ public:
 
 		// assemble path
 		m_segmentCount = count;
-		for( area = closestArea; count && area; area = area->GetParent() )
+		for( area = closestArea; count && area; area = context.GetParent( area ) )
 		{
 			--count;
 			m_path[ count ].area = area;
-			m_path[ count ].how = area->GetParentHow();
+			m_path[ count ].how = context.GetParentHow( area );
 			m_path[ count ].type = ON_GROUND;
 		}
 
@@ -318,7 +319,8 @@ public:
 		// Compute shortest path to goal
 		//
 		CNavArea *closestArea = NULL;
-		bool pathResult = NavAreaBuildPath( startArea, goalArea, &goal, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
+		CNavSearchContext &context = TheNavSearchContext();
+		bool pathResult = NavAreaBuildPath( context, startArea, goalArea, &goal, costFunc, &closestArea, maxPathLength, bot->GetEntity()->GetTeamNumber() );
 
 		// Failed?
 		if ( closestArea == NULL )
@@ -331,7 +333,7 @@ public:
 		// get count
 		int count = 0;
 		CNavArea *area;
-		for( area = closestArea; area; area = area->GetParent() )
+		for( area = closestArea; area; area = context.GetParent( area ) )
 		{
 			++count;
 
@@ -352,11 +354,11 @@ public:
 
 		// assemble path
 		m_segmentCount = count;
-		for( area = closestArea; count && area; area = area->GetParent() )
+		for( area = closestArea; count && area; area = context.GetParent( area ) )
 		{
 			--count;
 			m_path[ count ].area = area;
-			m_path[ count ].how = area->GetParentHow();
+			m_path[ count ].how = context.GetParentHow( area );
 			m_path[ count ].type = ON_GROUND;
 		}
 
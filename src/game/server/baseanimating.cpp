@@ -2749,46 +2749,65 @@ void CBaseAnimating::UnlockStudioHdr()
 //-----------------------------------------------------------------------------
 CBoneCache *CBaseAnimating::GetBoneCache( void )
 {
-	CStudioHdr *pStudioHdr = GetModelPtr( );
-	Assert(pStudioHdr);
-
 	CBoneCache *pcache = Studio_GetBoneCache( m_boneCacheHandle );
+	int boneMask = GetBoneCacheMask();
+
+	if ( pcache && pcache->IsValid( gpGlobals->curtime ) && (pcache->m_boneMask & boneMask) == boneMask && pcache->m_timeValid <= gpGlobals->curtime)
+	{
+		// Msg("%s:%s:%s (%x:%x:%8.4f) cache\n", GetClassname(), GetDebugName(), STRING(GetModelName()), boneMask, pcache->m_boneMask, pcache->m_timeValid );
+		// in memory and still valid, use it!
+		return pcache;
+	}
+
+	matrix3x4_t bonetoworld[MAXSTUDIOBONES];
+	SetupBones( bonetoworld, boneMask );
+
+	return SetCachedBones( bonetoworld );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: the bones GetBoneCache sets up
+//-----------------------------------------------------------------------------
+int CBaseAnimating::GetBoneCacheMask( void ) const
+{
 	int boneMask = BONE_USED_BY_HITBOX | BONE_USED_BY_ATTACHMENT;
 
 	// TF queries these bones to position weapons when players are killed
 #if defined( TF_DLL )
 	boneMask |= BONE_USED_BY_BONE_MERGE;
 #endif
-	if ( pcache )
+	return boneMask;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: store bones set up with GetBoneCacheMask() as the current bone cache
+//-----------------------------------------------------------------------------
+CBoneCache *CBaseAnimating::SetCachedBones( const matrix3x4_t *pBoneToWorld )
+{
+	CStudioHdr *pStudioHdr = GetModelPtr( );
+	Assert(pStudioHdr);
+
+	CBoneCache *pcache = Studio_GetBoneCache( m_boneCacheHandle );
+	int boneMask = GetBoneCacheMask();
+
+	// in memory, but missing some of the bone masks
+	if ( pcache && (pcache->m_boneMask & boneMask) != boneMask )
 	{
-		if ( pcache->IsValid( gpGlobals->curtime ) && (pcache->m_boneMask & boneMask) == boneMask && pcache->m_timeValid <= gpGlobals->curtime)
-		{
-			// Msg("%s:%s:%s (%x:%x:%8.4f) cache\n", GetClassname(), GetDebugName(), STRING(GetModelName()), boneMask, pcache->m_boneMask, pcache->m_timeValid );
-			// in memory and still valid, use it!
-			return pcache;
-		}
-		// in memory, but missing some of the bone masks
-		if ( (pcache->m_boneMask & boneMask) != boneMask )
-		{
-			Studio_DestroyBoneCache( m_boneCacheHandle );
-			m_boneCacheHandle = 0;
-			pcache = NULL;
-		}
+		Studio_DestroyBoneCache( m_boneCacheHandle );
+		m_boneCacheHandle = 0;
+		pcache = NULL;
 	}
 
-	matrix3x4_t bonetoworld[MAXSTUDIOBONES];
-	SetupBones( bonetoworld, boneMask );
-
 	if ( pcache )
 	{
 		// still in memory but out of date, refresh the bones.
-		pcache->UpdateBones( bonetoworld, pStudioHdr->numbones(), gpGlobals->curtime );
+		pcache->UpdateBones( pBoneToWorld, pStudioHdr->numbones(), gpGlobals->curtime );
 	}
 	else
 	{
 		bonecacheparams_t params;
 		params.pStudioHdr = pStudioHdr;
-		params.pBoneToWorld = bonetoworld;
+		params.pBoneToWorld = const_cast<matrix3x4_t *>( pBoneToWorld );
 		params.curtime = gpGlobals->curtime;
 		params.boneMask = boneMask;
 
@@ -2799,6 +2818,15 @@ CBoneCache *CBaseAnimating::GetBoneCache( void )
 	return pcache;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: IK traces the world and bone merge reads the parent's bones, so
+//			neither can be reused for another entity state
+//-----------------------------------------------------------------------------
+bool CBaseAnimating::CanShareBoneSetup( void )
+{
+	return !m_pIk && m_flEstIkOffset == 0.0f && !GetMoveParent() && !MyNPCPointer();
+}
+
 
 void CBaseAnimating::InvalidateBoneCache( void )
 {
@@ -280,6 +280,12 @@ public:
 	class CBoneCache *GetBoneCache( void );
 	void InvalidateBoneCache();
 	void InvalidateBoneCacheIfOlderThan( float deltaTime );
+
+	// Bones the bone cache holds, and a way to fill it with bones set up elsewhere
+	int GetBoneCacheMask( void ) const;
+	class CBoneCache *SetCachedBones( const matrix3x4_t *pBoneToWorld );
+	// True if SetupBones only depends on the animation state, origin and angles
+	bool CanShareBoneSetup( void );
 	virtual int DrawDebugTextOverlays( void );
 	
 	// See note in code re: bandwidth usage!!!
@@ -725,14 +725,15 @@ void CMultiInputVar::inputitem_t::operator delete( void *pMem )
 //
 // Purpose: holds and executes a global prioritized queue of entity actions
 //-----------------------------------------------------------------------------
-DEFINE_FIXEDSIZE_ALLOCATOR( EventQueuePrioritizedEvent_t, 128, CUtlMemoryPool::GROW_SLOW );
+DEFINE_FIXEDSIZE_ALLOCATOR( EventQueuePrioritizedEvent_t, 512, CUtlMemoryPool::GROW_FAST );
 
 CEventQueue g_EventQueue;
 
-CEventQueue::CEventQueue()
+CEventQueue::CEventQueue() : m_CallerEvents( DefLessFunc( unsigned long ) )
 {
-	m_Events.m_flFireTime = -FLT_MAX;
-	m_Events.m_pNext = NULL;
+	m_iNextSequence = 0;
+	m_iListCount = 0;
+	m_pServicingEvent = NULL;
 
 	Init();
 }
@@ -841,26 +842,49 @@ ISaveRestoreBlockHandler *GetEventQueueSaveRestoreBlockHandler()
 void CEventQueue::Init( void )
 {
 	Clear();
+
+	m_iPeakCount = 0;
+	m_iInsertCount = 0;
+	m_iServiceCount = 0;
+	m_flServiceTime = 0.0;
+	m_flMaxServiceTime = 0.0;
+	m_flStatsStartTime = Plat_FloatTime();
 }
 
 void CEventQueue::Clear( void )
 {
 	// delete all the events in the queue
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
-	
-	while ( pe != NULL )
+	for ( int i = 0; i < m_Heap.Count(); i++ )
 	{
-		EventQueuePrioritizedEvent_t *next = pe->m_pNext;
-		delete pe;
-		pe = next;
+		delete m_Heap[i];
 	}
 
-	m_Events.m_pNext = NULL;
+	m_Heap.RemoveAll();
+	m_CallerEvents.RemoveAll();
+	m_pServicingEvent = NULL;
+}
+
+static int EventFireOrderCompare( EventQueuePrioritizedEvent_t * const *a, EventQueuePrioritizedEvent_t * const *b )
+{
+	if ( (*a)->m_flFireTime != (*b)->m_flFireTime )
+		return ( (*a)->m_flFireTime < (*b)->m_flFireTime ) ? -1 : 1;
+
+	return (int)( (*a)->m_iSequence - (*b)->m_iSequence );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: returns the queued events in the order they will fire
+//-----------------------------------------------------------------------------
+void CEventQueue::GetEventsInOrder( CUtlVector< EventQueuePrioritizedEvent_t * > *events ) const
+{
+	events->CopyArray( m_Heap.Base(), m_Heap.Count() );
+	events->Sort( EventFireOrderCompare );
 }
 
 void CEventQueue::Dump( void )
 {
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
+	CUtlVector< EventQueuePrioritizedEvent_t * > events;
+	GetEventsInOrder( &events );
 
 	Msg("Dumping event queue. Current time is: %.2f\n",
 #ifdef TF_DLL
@@ -870,9 +894,9 @@ void CEventQueue::Dump( void )
 #endif
 		);
 
-	while ( pe != NULL )
+	FOR_EACH_VEC( events, i )
 	{
-		EventQueuePrioritizedEvent_t *next = pe->m_pNext;
+		EventQueuePrioritizedEvent_t *pe = events[i];
 
 		Msg("   (%.2f) Target: '%s', Input: '%s', Parameter '%s'. Activator: '%s', Caller '%s'.  \n", 
 			pe->m_flFireTime, 
@@ -881,13 +905,34 @@ void CEventQueue::Dump( void )
 			pe->m_VariantValue.String(),
 			pe->m_pActivator ? pe->m_pActivator->GetDebugName() : "None", 
 			pe->m_pCaller ? pe->m_pCaller->GetDebugName() : "None"  );
-
-		pe = next;
 	}
 
 	Msg("Finished dump.\n");
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: reports queue depth, insert rate and service time since the last report
+//-----------------------------------------------------------------------------
+void CEventQueue::DumpStats( void )
+{
+	double flNow = Plat_FloatTime();
+	double flElapsed = flNow - m_flStatsStartTime;
+
+	Msg( "Event queue: %d pending, peak %d, %d callers with pending events\n", m_Heap.Count(), m_iPeakCount, m_CallerEvents.Count() );
+	Msg( "   %d inserts in %.1f seconds (%.1f/sec)\n", m_iInsertCount, flElapsed, ( flElapsed > 0.0 ) ? m_iInsertCount / flElapsed : 0.0 );
+	Msg( "   service time %.3f ms average, %.3f ms max over %d frames\n", 
+		( m_iServiceCount > 0 ) ? 1000.0 * m_flServiceTime / m_iServiceCount : 0.0, 
+		1000.0 * m_flMaxServiceTime, 
+		m_iServiceCount );
+
+	m_iPeakCount = m_Heap.Count();
+	m_iInsertCount = 0;
+	m_iServiceCount = 0;
+	m_flServiceTime = 0.0;
+	m_flMaxServiceTime = 0.0;
+	m_flStatsStartTime = flNow;
+}
+
 
 //-----------------------------------------------------------------------------
 // Purpose: adds the action into the correct spot in the priority queue, targeting entity via string name
@@ -944,40 +989,141 @@ void CEventQueue::AddEvent( CBaseEntity *target, const char *action, float fireD
 
 
 //-----------------------------------------------------------------------------
-// Purpose: private function, adds an event into the list
+// Purpose: events fire in order of fire time; events with the same fire time
+//			fire in the order they were added
+//-----------------------------------------------------------------------------
+inline bool CEventQueue::FiresBefore( const EventQueuePrioritizedEvent_t *a, const EventQueuePrioritizedEvent_t *b )
+{
+	if ( a->m_flFireTime != b->m_flFireTime )
+		return a->m_flFireTime < b->m_flFireTime;
+
+	return (int)( a->m_iSequence - b->m_iSequence ) < 0;
+}
+
+void CEventQueue::HeapSiftUp( int index )
+{
+	EventQueuePrioritizedEvent_t *pe = m_Heap[ index ];
+
+	while ( index > 0 )
+	{
+		int parent = ( index - 1 ) / 2;
+		if ( !FiresBefore( pe, m_Heap[ parent ] ) )
+			break;
+
+		m_Heap[ index ] = m_Heap[ parent ];
+		m_Heap[ index ]->m_iHeapIndex = index;
+		index = parent;
+	}
+
+	m_Heap[ index ] = pe;
+	pe->m_iHeapIndex = index;
+}
+
+void CEventQueue::HeapSiftDown( int index )
+{
+	EventQueuePrioritizedEvent_t *pe = m_Heap[ index ];
+	int count = m_Heap.Count();
+
+	while ( true )
+	{
+		int child = 2 * index + 1;
+		if ( child >= count )
+			break;
+
+		if ( child + 1 < count && FiresBefore( m_Heap[ child + 1 ], m_Heap[ child ] ) )
+		{
+			++child;
+		}
+
+		if ( !FiresBefore( m_Heap[ child ], pe ) )
+			break;
+
+		m_Heap[ index ] = m_Heap[ child ];
+		m_Heap[ index ]->m_iHeapIndex = index;
+		index = child;
+	}
+
+	m_Heap[ index ] = pe;
+	pe->m_iHeapIndex = index;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: private function, adds an event into the queue
 // Input  : *newEvent - the (already built) event to add
 //-----------------------------------------------------------------------------
 void CEventQueue::AddEvent( EventQueuePrioritizedEvent_t *newEvent )
 {
-	// loop through the actions looking for a place to insert
-	EventQueuePrioritizedEvent_t *pe;
-	for ( pe = &m_Events; pe->m_pNext != NULL; pe = pe->m_pNext )
+	newEvent->m_iSequence = m_iNextSequence++;
+
+	// insert into the heap
+	newEvent->m_iHeapIndex = m_Heap.AddToTail( newEvent );
+	HeapSiftUp( newEvent->m_iHeapIndex );
+
+	// and at the head of the caller's list
+	newEvent->m_pPrevForCaller = NULL;
+	newEvent->m_pNextForCaller = NULL;
+
+	unsigned long caller = newEvent->m_pCaller.ToInt();
+	if ( caller != INVALID_EHANDLE_INDEX )
 	{
-		if ( pe->m_pNext->m_flFireTime > newEvent->m_flFireTime )
+		unsigned short i = m_CallerEvents.Find( caller );
+		if ( i == m_CallerEvents.InvalidIndex() )
 		{
-			break;
+			m_CallerEvents.Insert( caller, newEvent );
+		}
+		else
+		{
+			newEvent->m_pNextForCaller = m_CallerEvents[i];
+			m_CallerEvents[i]->m_pPrevForCaller = newEvent;
+			m_CallerEvents[i] = newEvent;
 		}
 	}
 
-	Assert( pe );
-
-	// insert
-	newEvent->m_pNext = pe->m_pNext;
-	newEvent->m_pPrev = pe;
-	pe->m_pNext = newEvent;
-	if ( newEvent->m_pNext )
+	++m_iInsertCount;
+	if ( m_Heap.Count() > m_iPeakCount )
 	{
-		newEvent->m_pNext->m_pPrev = newEvent;
+		m_iPeakCount = m_Heap.Count();
 	}
 }
 
 void CEventQueue::RemoveEvent( EventQueuePrioritizedEvent_t *pe )
 {
-	Assert( pe->m_pPrev );
-	pe->m_pPrev->m_pNext = pe->m_pNext;
-	if ( pe->m_pNext )
+	// take it out of the heap, filling the hole with the last event
+	int index = pe->m_iHeapIndex;
+	Assert( m_Heap[ index ] == pe );
+
+	m_Heap.FastRemove( index );
+	if ( index < m_Heap.Count() )
+	{
+		EventQueuePrioritizedEvent_t *moved = m_Heap[ index ];
+		moved->m_iHeapIndex = index;
+		HeapSiftUp( index );
+		HeapSiftDown( moved->m_iHeapIndex );
+	}
+
+	// unlink from the caller's list
+	if ( pe->m_pPrevForCaller )
+	{
+		pe->m_pPrevForCaller->m_pNextForCaller = pe->m_pNextForCaller;
+	}
+	else if ( pe->m_pCaller.ToInt() != INVALID_EHANDLE_INDEX )
 	{
-		pe->m_pNext->m_pPrev = pe->m_pPrev;
+		unsigned short i = m_CallerEvents.Find( pe->m_pCaller.ToInt() );
+		Assert( i != m_CallerEvents.InvalidIndex() && m_CallerEvents[i] == pe );
+
+		if ( pe->m_pNextForCaller )
+		{
+			m_CallerEvents[i] = pe->m_pNextForCaller;
+		}
+		else
+		{
+			m_CallerEvents.RemoveAt( i );
+		}
+	}
+
+	if ( pe->m_pNextForCaller )
+	{
+		pe->m_pNextForCaller->m_pPrevForCaller = pe->m_pPrevForCaller;
 	}
 }
 
@@ -992,16 +1138,20 @@ void CEventQueue::ServiceEvents( void )
 		return;
 	}
 
-	EventQueuePrioritizedEvent_t *pe = m_Events.m_pNext;
+	double flStartTime = Plat_FloatTime();
 
 #ifdef TF_DLL
-	while ( pe != NULL && pe->m_flFireTime <= engine->GetServerTime() )
+	while ( m_Heap.Count() && m_Heap[0]->m_flFireTime <= engine->GetServerTime() )
 #else
-	while ( pe != NULL && pe->m_flFireTime <= gpGlobals->curtime )
+	while ( m_Heap.Count() && m_Heap[0]->m_flFireTime <= gpGlobals->curtime )
 #endif
 	{
 		MDLCACHE_CRITICAL_SECTION();
 
+		// the event stays queued while it fires, but can't be cancelled
+		EventQueuePrioritizedEvent_t *pe = m_Heap[0];
+		m_pServicingEvent = pe;
+
 		bool targetFound = false;
 
 		// find the targets
@@ -1065,9 +1215,13 @@ void CEventQueue::ServiceEvents( void )
 			ADD_DEBUG_HISTORY( HISTORY_ENTITY_IO, szBuffer );
 		}
 
-		// remove the event from the list (remembering that the queue may have been added to)
-		RemoveEvent( pe );
-		delete pe;
+		// remove the event from the queue (remembering that the queue may have been added to, or cleared)
+		if ( m_pServicingEvent == pe )
+		{
+			m_pServicingEvent = NULL;
+			RemoveEvent( pe );
+			delete pe;
+		}
 
 		//
 		// If we are in debug mode, exit the loop if we have fired the correct number of events.
@@ -1079,10 +1233,12 @@ void CEventQueue::ServiceEvents( void )
 				break;
 			}
 		}
-
-		// restart the list (to catch any new items have probably been added to the queue)
-		pe = m_Events.m_pNext;	
 	}
+
+	double flServiceTime = Plat_FloatTime() - flStartTime;
+	m_flServiceTime += flServiceTime;
+	m_flMaxServiceTime = MAX( m_flMaxServiceTime, flServiceTime );
+	++m_iServiceCount;
 }
 
 //-----------------------------------------------------------------------------
@@ -1097,6 +1253,18 @@ void CC_DumpEventQueue()
 }
 static ConCommand dumpeventqueue( "dumpeventqueue", CC_DumpEventQueue, "Dump the contents of the Entity I/O event queue to the console." );
 
+//-----------------------------------------------------------------------------
+// Purpose: Reports Entity I/O event queue statistics to the console.
+//-----------------------------------------------------------------------------
+void CC_EventQueueStats()
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	g_EventQueue.DumpStats();
+}
+static ConCommand eventqueue_stats( "eventqueue_stats", CC_EventQueueStats, "Report the Entity I/O event queue depth, insert rate and service time since the last report." );
+
 //-----------------------------------------------------------------------------
 // Purpose: Removes all pending events from the I/O queue that were added by the
 //			given caller.
@@ -1109,26 +1277,19 @@ void CEventQueue::CancelEvents( CBaseEntity *pCaller )
 	if (!pCaller)
 		return;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	unsigned short i = m_CallerEvents.Find( pCaller->GetRefEHandle().ToInt() );
+	if ( i == m_CallerEvents.InvalidIndex() )
+		return;
+
+	EventQueuePrioritizedEvent_t *pCur = m_CallerEvents[i];
 
 	while (pCur != NULL)
 	{
-		bool bDelete = false;
-		if (pCur->m_pCaller == pCaller)
-		{
-			// Pointers match; make sure everything else matches.
-			if (!stricmp(STRING(pCur->m_pCaller->GetEntityName()), STRING(pCaller->GetEntityName())) &&
-				!stricmp(pCur->m_pCaller->GetClassname(), pCaller->GetClassname()))
-			{
-				// Found a matching event; delete it from the queue.
-				bDelete = true;
-			}
-		}
-
 		EventQueuePrioritizedEvent_t *pCurSave = pCur;
-		pCur = pCur->m_pNext;
+		pCur = pCur->m_pNextForCaller;
 
-		if (bDelete)
+		// Found a matching event; delete it from the queue.
+		if ( pCurSave != m_pServicingEvent )
 		{
 			RemoveEvent( pCurSave );
 			delete pCurSave;
@@ -1147,28 +1308,25 @@ void CEventQueue::CancelEventOn( CBaseEntity *pTarget, const char *sInputName )
 	if (!pTarget)
 		return;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
+	CUtlVector< EventQueuePrioritizedEvent_t * > matches;
 
-	while (pCur != NULL)
+	for ( int i = 0; i < m_Heap.Count(); i++ )
 	{
-		bool bDelete = false;
-		if (pCur->m_pEntTarget == pTarget)
+		EventQueuePrioritizedEvent_t *pCur = m_Heap[i];
+		if (pCur->m_pEntTarget == pTarget && pCur != m_pServicingEvent)
 		{
 			if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
 			{
 				// Found a matching event; delete it from the queue.
-				bDelete = true;
+				matches.AddToTail( pCur );
 			}
 		}
+	}
 
-		EventQueuePrioritizedEvent_t *pCurSave = pCur;
-		pCur = pCur->m_pNext;
-
-		if (bDelete)
-		{
-			RemoveEvent( pCurSave );
-			delete pCurSave;
-		}
+	for ( int i = 0; i < matches.Count(); i++ )
+	{
+		RemoveEvent( matches[i] );
+		delete matches[i];
 	}
 }
 
@@ -1182,10 +1340,9 @@ bool CEventQueue::HasEventPending( CBaseEntity *pTarget, const char *sInputName
 	if (!pTarget)
 		return false;
 
-	EventQueuePrioritizedEvent_t *pCur = m_Events.m_pNext;
-
-	while (pCur != NULL)
+	for ( int i = 0; i < m_Heap.Count(); i++ )
 	{
+		EventQueuePrioritizedEvent_t *pCur = m_Heap[i];
 		if (pCur->m_pEntTarget == pTarget)
 		{
 			if ( !sInputName )
@@ -1194,8 +1351,6 @@ bool CEventQueue::HasEventPending( CBaseEntity *pTarget, const char *sInputName
 			if ( !Q_strncmp( STRING(pCur->m_iTargetInput), sInputName, strlen(sInputName) ) )
 				return true;
 		}
-
-		pCur = pCur->m_pNext;
 	}
 
 	return false;
@@ -1213,7 +1368,7 @@ void ServiceEventQueue( void )
 // save data description for the event queue
 BEGIN_SIMPLE_DATADESC( CEventQueue )
 	// These are saved explicitly in CEventQueue::Save below
-	// DEFINE_FIELD( m_Events, EventQueuePrioritizedEvent_t ),
+	// DEFINE_FIELD( m_Heap, EventQueuePrioritizedEvent_t ),
 
 	DEFINE_FIELD( m_iListCount, FIELD_INTEGER ),	// this value is only used during save/restore
 END_DATADESC()
@@ -1230,29 +1385,28 @@ BEGIN_SIMPLE_DATADESC( EventQueuePrioritizedEvent_t )
 	DEFINE_FIELD( m_iOutputID, FIELD_INTEGER ),
 	DEFINE_CUSTOM_FIELD( m_VariantValue, variantFuncs ),
 
-//	DEFINE_FIELD( m_pNext, FIELD_??? ),
-//	DEFINE_FIELD( m_pPrev, FIELD_??? ),
+	// m_iSequence and m_iHeapIndex are rebuilt as events are restored, in the order they were saved
+//	DEFINE_FIELD( m_pNextForCaller, FIELD_??? ),
+//	DEFINE_FIELD( m_pPrevForCaller, FIELD_??? ),
 END_DATADESC()
 
 
 int CEventQueue::Save( ISave &save )
 {
-	// count the number of items in the queue
-	EventQueuePrioritizedEvent_t *pe;
+	// save events in firing order, so restoring them keeps the order of events with the same fire time
+	CUtlVector< EventQueuePrioritizedEvent_t * > events;
+	GetEventsInOrder( &events );
 
-	m_iListCount = 0;
-	for ( pe = m_Events.m_pNext; pe != NULL; pe = pe->m_pNext )
-	{
-		m_iListCount++;
-	}
+	m_iListCount = events.Count();
 
 	// save that value out to disk, so we know how many to restore
 	if ( !save.WriteFields( "EventQueue", this, NULL, m_DataMap.dataDesc, m_DataMap.dataNumFields ) )
 		return 0;
 	
 	// cycle through all the events, saving them all
-	for ( pe = m_Events.m_pNext; pe != NULL; pe = pe->m_pNext )
+	FOR_EACH_VEC( events, i )
 	{
+		EventQueuePrioritizedEvent_t *pe = events[i];
 		if ( !save.WriteFields( "PEvent", pe, NULL, pe->m_DataMap.dataDesc, pe->m_DataMap.dataNumFields ) )
 			return 0;
 	}
@@ -17,6 +17,7 @@
 #include "ai_initutils.h"
 #include "globalstate.h"
 #include "datacache/imdlcache.h"
+#include "tier1/generichash.h"
 
 #ifdef HL2_DLL
 #include "npc_playercompanion.h"
@@ -290,10 +291,22 @@ CBaseEntityClassList::~CBaseEntityClassList()
 {
 }
 
+static ConVar ent_index_verify( "ent_index_verify", "0", FCVAR_CHEAT, "Check indexed entity name/classname lookups against a full scan of the entity list." );
+
 CGlobalEntityList::CGlobalEntityList()
 {
 	m_iHighestEnt = m_iNumEnts = m_iNumEdicts = 0;
 	m_bClearingEntities = false;
+
+	for ( int i = 0; i < NUM_ENT_ENTRIES; i++ )
+	{
+		m_NameLinks[i].m_nKey = 0;
+		m_NameLinks[i].m_bFiled = false;
+		m_NameLinks[i].m_iNext = m_NameLinks[i].m_iPrev = -1;
+		m_ClassnameLinks[i] = m_NameLinks[i];
+		m_nAddOrder[i] = 0;
+	}
+	m_nNextAddOrder = 0;
 }
 
 
@@ -480,6 +493,26 @@ bool CGlobalEntityList::IsEntityPtr( void *pTest )
 //			szName - Classname to search for.
 //-----------------------------------------------------------------------------
 CBaseEntity *CGlobalEntityList::FindEntityByClassname( CBaseEntity *pStartEntity, const char *szName, IEntityFindFilter *pFilter )
+{
+	// Wildcards and empty names can match more than one key, scan for those
+	if ( !szName || !szName[0] || V_strchr( szName, '*' ) )
+		return FindEntityByClassnameScan( pStartEntity, szName, pFilter );
+
+	CBaseEntity *pEntity = IndexFind( m_ClassnameIndex, m_ClassnameLinks, true, szName, pStartEntity, pFilter );
+	if ( ent_index_verify.GetBool() )
+	{
+		CBaseEntity *pScan = FindEntityByClassnameScan( pStartEntity, szName, pFilter );
+		if ( pScan != pEntity )
+		{
+			Warning( "ent_index_verify: classname \"%s\" index found %d, scan found %d\n", szName,
+				pEntity ? pEntity->entindex() : -1, pScan ? pScan->entindex() : -1 );
+			return pScan;
+		}
+	}
+	return pEntity;
+}
+
+CBaseEntity *CGlobalEntityList::FindEntityByClassnameScan( CBaseEntity *pStartEntity, const char *szName, IEntityFindFilter *pFilter )
 {
 	const CEntInfo *pInfo = pStartEntity ? GetEntInfoPtr( pStartEntity->GetRefEHandle() )->m_pNext : FirstEntInfo();
 
@@ -595,7 +628,26 @@ CBaseEntity *CGlobalEntityList::FindEntityByName( CBaseEntity *pStartEntity, con
 
 		return NULL;
 	}
-	
+
+	if ( V_strchr( szName, '*' ) )
+		return FindEntityByNameScan( pStartEntity, szName, pFilter );
+
+	CBaseEntity *pEntity = IndexFind( m_NameIndex, m_NameLinks, false, szName, pStartEntity, pFilter );
+	if ( ent_index_verify.GetBool() )
+	{
+		CBaseEntity *pScan = FindEntityByNameScan( pStartEntity, szName, pFilter );
+		if ( pScan != pEntity )
+		{
+			Warning( "ent_index_verify: name \"%s\" index found %d, scan found %d\n", szName,
+				pEntity ? pEntity->entindex() : -1, pScan ? pScan->entindex() : -1 );
+			return pScan;
+		}
+	}
+	return pEntity;
+}
+
+CBaseEntity *CGlobalEntityList::FindEntityByNameScan( CBaseEntity *pStartEntity, const char *szName, IEntityFindFilter *pFilter )
+{
 	const CEntInfo *pInfo = pStartEntity ? GetEntInfoPtr( pStartEntity->GetRefEHandle() )->m_pNext : FirstEntInfo();
 
 	for ( ;pInfo; pInfo = pInfo->m_pNext )
@@ -1128,6 +1180,12 @@ void CGlobalEntityList::OnAddEntity( IHandleEntity *pEnt, CBaseHandle handle )
 	
 	// NOTE: Must be a CBaseEntity on server
 	Assert( pBaseEnt );
+
+	// File under name and classname; the add order keeps buckets in active list order
+	m_nAddOrder[i] = m_nNextAddOrder++;
+	IndexInsert( m_NameIndex, m_NameLinks, i, pBaseEnt->GetEntityName() );
+	IndexInsert( m_ClassnameIndex, m_ClassnameLinks, i, pBaseEnt->m_iClassname );
+
 	//DevMsg(2,"Created %s\n", pBaseEnt->GetClassname() );
 	for ( i = m_entityListeners.Count()-1; i >= 0; i-- )
 	{
@@ -1159,6 +1217,244 @@ void CGlobalEntityList::OnRemoveEntity( IHandleEntity *pEnt, CBaseHandle handle
 		m_iNumEdicts--;
 
 	m_iNumEnts--;
+
+	IndexRemove( m_NameIndex, m_NameLinks, handle.GetEntryIndex() );
+	IndexRemove( m_ClassnameIndex, m_ClassnameLinks, handle.GetEntryIndex() );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Files an entity handle entry in a name index under iszSource.
+//			Keys are caseless hashes so that case-insensitive matches share
+//			a bucket no matter which pooled copy of the string they use.
+//-----------------------------------------------------------------------------
+void CGlobalEntityList::IndexInsert( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry, string_t iszSource )
+{
+	EntityIndexLink_t &link = pLinks[iEntry];
+	link.m_nKey = 0;
+	link.m_bFiled = false;
+	link.m_iNext = link.m_iPrev = -1;
+
+	if ( iszSource == NULL_STRING || !STRING( iszSource )[0] )
+		return;
+
+	link.m_nKey = HashStringCaseless( STRING( iszSource ) );
+	link.m_bFiled = true;
+
+	// Insert returns the existing bucket if the key is already present
+	EntityIndexBucket_t empty = { -1, -1 };
+	UtlHashHandle_t h = table.Insert( link.m_nKey, empty );
+	EntityIndexBucket_t &bucket = table[h];
+
+	// Entities nearly always arrive at the tail, only renames need to walk back
+	int iPrev = bucket.m_iTail;
+	while ( iPrev != -1 && (int)( m_nAddOrder[iPrev] - m_nAddOrder[iEntry] ) > 0 )
+	{
+		iPrev = pLinks[iPrev].m_iPrev;
+	}
+
+	int iNext = ( iPrev != -1 ) ? pLinks[iPrev].m_iNext : bucket.m_iHead;
+	link.m_iPrev = iPrev;
+	link.m_iNext = iNext;
+
+	if ( iPrev != -1 )
+		pLinks[iPrev].m_iNext = iEntry;
+	else
+		bucket.m_iHead = iEntry;
+
+	if ( iNext != -1 )
+		pLinks[iNext].m_iPrev = iEntry;
+	else
+		bucket.m_iTail = iEntry;
+}
+
+void CGlobalEntityList::IndexRemove( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry )
+{
+	EntityIndexLink_t &link = pLinks[iEntry];
+	if ( link.m_bFiled )
+	{
+		UtlHashHandle_t h = table.Find( link.m_nKey );
+		Assert( h != table.InvalidHandle() );
+		if ( h != table.InvalidHandle() )
+		{
+			EntityIndexBucket_t &bucket = table[h];
+
+			if ( link.m_iPrev != -1 )
+				pLinks[link.m_iPrev].m_iNext = link.m_iNext;
+			else
+				bucket.m_iHead = link.m_iNext;
+
+			if ( link.m_iNext != -1 )
+				pLinks[link.m_iNext].m_iPrev = link.m_iPrev;
+			else
+				bucket.m_iTail = link.m_iPrev;
+
+			if ( bucket.m_iHead == -1 )
+			{
+				table.RemoveByHandle( h );
+			}
+		}
+	}
+
+	link.m_nKey = 0;
+	link.m_bFiled = false;
+	link.m_iNext = link.m_iPrev = -1;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Moves an entry to a new bucket if its string hashes differently now.
+//-----------------------------------------------------------------------------
+void CGlobalEntityList::IndexRefile( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry, string_t iszSource )
+{
+	const EntityIndexLink_t &link = pLinks[iEntry];
+	bool bFile = ( iszSource != NULL_STRING && STRING( iszSource )[0] );
+	if ( bFile == link.m_bFiled && ( !bFile || HashStringCaseless( STRING( iszSource ) ) == link.m_nKey ) )
+		return;
+
+	IndexRemove( table, pLinks, iEntry );
+	IndexInsert( table, pLinks, iEntry, iszSource );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the first entity whose name (or classname) matches szName
+//			that comes after pStartEntity in the active list and passes pFilter.
+//-----------------------------------------------------------------------------
+CBaseEntity *CGlobalEntityList::IndexFind( const EntityIndexTable_t &table, const EntityIndexLink_t *pLinks, bool bClassname, const char *szName, CBaseEntity *pStartEntity, IEntityFindFilter *pFilter )
+{
+	unsigned int nKey = HashStringCaseless( szName );
+	UtlHashHandle_t h = table.Find( nKey );
+	if ( h == table.InvalidHandle() )
+		return NULL;
+
+	int iEntry = table[h].m_iHead;
+	if ( pStartEntity )
+	{
+		int iStart = pStartEntity->GetRefEHandle().GetEntryIndex();
+		if ( pLinks[iStart].m_bFiled && pLinks[iStart].m_nKey == nKey )
+		{
+			iEntry = pLinks[iStart].m_iNext;
+		}
+		else
+		{
+			while ( iEntry != -1 && (int)( m_nAddOrder[iEntry] - m_nAddOrder[iStart] ) <= 0 )
+			{
+				iEntry = pLinks[iEntry].m_iNext;
+			}
+		}
+	}
+
+	for ( ; iEntry != -1; iEntry = pLinks[iEntry].m_iNext )
+	{
+		CBaseEntity *pEntity = (CBaseEntity *)GetEntInfoPtrByIndex( iEntry )->m_pEntity;
+		Assert( pEntity );
+
+		// The bucket may also hold other strings with the same hash
+		if ( bClassname ? !pEntity->ClassMatches( szName ) : !pEntity->NameMatches( szName ) )
+			continue;
+
+		if ( pFilter && !pFilter->ShouldFindEntity( pEntity ) )
+			continue;
+
+		return pEntity;
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Refiles an entity after its name or classname was assigned.
+//-----------------------------------------------------------------------------
+void CGlobalEntityList::UpdateEntityIndex( CBaseEntity *pEnt )
+{
+	// Not in the list yet (or anymore), OnAddEntity will file it
+	const CBaseHandle &handle = pEnt->GetRefEHandle();
+	if ( !handle.IsValid() || LookupEntity( handle ) != pEnt )
+		return;
+
+	int iEntry = handle.GetEntryIndex();
+	IndexRefile( m_NameIndex, m_NameLinks, iEntry, pEnt->GetEntityName() );
+	IndexRefile( m_ClassnameIndex, m_ClassnameLinks, iEntry, pEnt->m_iClassname );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Exercises the name index the way point_template does: an entity
+//			spawned with MarkNeedsNamePurge takes its name out of the string
+//			pool on removal while another entity still has that name, then the
+//			freed string memory gets reused by a new name.
+//-----------------------------------------------------------------------------
+static CBaseEntity *CreateIndexTestEntity( const char *pszName )
+{
+	CBaseEntity *pEntity = CreateEntityByName( "info_target" );
+	if ( pEntity )
+	{
+		pEntity->SetName( AllocPooledString( pszName ) );
+		DispatchSpawn( pEntity );
+	}
+	return pEntity;
+}
+
+static bool CheckIndexTestLookup( const char *pszName, CBaseEntity *pExpected )
+{
+	CBaseEntity *pFound = gEntList.FindEntityByName( NULL, pszName );
+	if ( pFound != pExpected )
+	{
+		Warning( "ent_index_test: \"%s\" found %d, expected %d\n", pszName,
+			pFound ? pFound->entindex() : -1, pExpected ? pExpected->entindex() : -1 );
+		return false;
+	}
+
+	// Nothing after the expected entity either
+	if ( pFound && gEntList.FindEntityByName( pFound, pszName ) )
+	{
+		Warning( "ent_index_test: \"%s\" matched more than one entity\n", pszName );
+		return false;
+	}
+	return true;
+}
+
+CON_COMMAND_F( ent_index_test, "Checks indexed name lookups across template names leaving and re-entering the string pool.", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	CBaseEntity *pTemplate = CreateIndexTestEntity( "ent_index_test_a" );
+	CBaseEntity *pSurvivor = CreateIndexTestEntity( "Ent_Index_Test_A" );
+	if ( !pTemplate || !pSurvivor )
+	{
+		Warning( "ent_index_test: couldn't create test entities\n" );
+		UTIL_RemoveImmediate( pTemplate );
+		UTIL_RemoveImmediate( pSurvivor );
+		return;
+	}
+
+	// Both share the caseless name, in creation order
+	bool bPassed = ( gEntList.FindEntityByName( NULL, "ent_index_test_a" ) == pTemplate ) &&
+		( gEntList.FindEntityByName( pTemplate, "ENT_INDEX_TEST_A" ) == pSurvivor );
+	if ( !bPassed )
+	{
+		Warning( "ent_index_test: mixed case names didn't share a bucket\n" );
+	}
+
+	// Removing the template copy pulls the name out of the pool
+	pTemplate->MarkNeedsNamePurge();
+	UTIL_RemoveImmediate( pTemplate );
+	bPassed = CheckIndexTestLookup( "ent_index_test_a", pSurvivor ) && bPassed;
+
+	// Re-pool the survivor's name, free the old copy and hand out new strings
+	pSurvivor->SetName( AllocPooledString( "ent_index_test_a" ) );
+	PurgeDeferredPooledStrings();
+	CBaseEntity *pNew = CreateIndexTestEntity( "ent_index_test_b" );
+	bPassed = CheckIndexTestLookup( "ent_index_test_a", pSurvivor ) && bPassed;
+	bPassed = CheckIndexTestLookup( "ent_index_test_b", pNew ) && bPassed;
+
+	// Renames move between buckets
+	pSurvivor->SetName( AllocPooledString( "ent_index_test_c" ) );
+	bPassed = CheckIndexTestLookup( "ent_index_test_a", NULL ) && bPassed;
+	bPassed = CheckIndexTestLookup( "ent_index_test_c", pSurvivor ) && bPassed;
+
+	UTIL_RemoveImmediate( pSurvivor );
+	UTIL_RemoveImmediate( pNew );
+
+	Msg( "ent_index_test: %s\n", bPassed ? "passed" : "FAILED" );
 }
 
 void CGlobalEntityList::NotifyCreateEntity( CBaseEntity *pEnt )
@@ -14,6 +14,7 @@
 #endif
 
 #include "baseentity.h"
+#include "utlhashtable.h"
 
 class IEntityListener;
 
@@ -81,6 +82,44 @@ private:
 	bool m_bClearingEntities;
 	CUtlVector<IEntityListener *>	m_entityListeners;
 
+	// Exact name and classname lookups go through these indices. Each key
+	// (a caseless hash of the string, not the pooled pointer, since template
+	// names get removed from the pool while others may still use them) maps
+	// to an intrusive list threaded through the link arrays by handle entry,
+	// kept in the same order as the active list so pStartEntity iteration
+	// matches a linear scan. Hash collisions share a bucket and are told
+	// apart by comparing the entity's own name when searching.
+	struct EntityIndexLink_t
+	{
+		unsigned int m_nKey;		// HashStringCaseless of the name when filed
+		bool m_bFiled;
+		int m_iNext;
+		int m_iPrev;
+	};
+
+	struct EntityIndexBucket_t
+	{
+		int m_iHead;
+		int m_iTail;
+	};
+
+	typedef CUtlHashtable< unsigned int, EntityIndexBucket_t > EntityIndexTable_t;
+
+	EntityIndexTable_t	m_NameIndex;
+	EntityIndexTable_t	m_ClassnameIndex;
+	EntityIndexLink_t	m_NameLinks[NUM_ENT_ENTRIES];
+	EntityIndexLink_t	m_ClassnameLinks[NUM_ENT_ENTRIES];
+	unsigned int		m_nAddOrder[NUM_ENT_ENTRIES];
+	unsigned int		m_nNextAddOrder;
+
+	void IndexInsert( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry, string_t iszSource );
+	void IndexRemove( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry );
+	CBaseEntity *IndexFind( const EntityIndexTable_t &table, const EntityIndexLink_t *pLinks, bool bClassname, const char *szName, CBaseEntity *pStartEntity, IEntityFindFilter *pFilter );
+	void IndexRefile( EntityIndexTable_t &table, EntityIndexLink_t *pLinks, int iEntry, string_t iszSource );
+
+	CBaseEntity *FindEntityByClassnameScan( CBaseEntity *pStartEntity, const char *szName, IEntityFindFilter *pFilter );
+	CBaseEntity *FindEntityByNameScan( CBaseEntity *pStartEntity, const char *szName, IEntityFindFilter *pFilter );
+
 public:
 	IServerNetworkable* GetServerNetworkable( CBaseHandle hEnt ) const;
 	CBaseNetworkable* GetBaseNetworkable( CBaseHandle hEnt ) const;
@@ -112,6 +151,10 @@ public:
 	void NotifyCreateEntity( CBaseEntity *pEnt );
 	void NotifySpawn( CBaseEntity *pEnt );
 	void NotifyRemoveEntity( CBaseHandle hEnt );
+
+	// Refiles an entity in the name/classname indices after m_iName or m_iClassname changed
+	void UpdateEntityIndex( CBaseEntity *pEnt );
+
 	// iteration functions
 
 	// returns the next entity after pCurrentEnt;  if pCurrentEnt is NULL, return the first entity
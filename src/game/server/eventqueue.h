@@ -15,6 +15,7 @@
 #endif
 
 #include "mempool.h"
+#include "utlmap.h"
 
 struct EventQueuePrioritizedEvent_t
 {
@@ -28,8 +29,12 @@ struct EventQueuePrioritizedEvent_t
 
 	variant_t m_VariantValue;	// variable-type parameter
 
-	EventQueuePrioritizedEvent_t *m_pNext;
-	EventQueuePrioritizedEvent_t *m_pPrev;
+	unsigned int m_iSequence;	// insertion order, breaks ties between events with the same fire time
+	int m_iHeapIndex;			// position in the queue's heap
+
+	// other pending events from the same caller
+	EventQueuePrioritizedEvent_t *m_pNextForCaller;
+	EventQueuePrioritizedEvent_t *m_pPrevForCaller;
 
 	DECLARE_SIMPLE_DATADESC();
 
@@ -65,15 +70,36 @@ public:
 	void Clear( void ); // resets the list
 
 	void Dump( void );
+	void DumpStats( void );
 
 private:
 
 	void AddEvent( EventQueuePrioritizedEvent_t *event );
 	void RemoveEvent( EventQueuePrioritizedEvent_t *pe );
 
+	// the queue is a binary heap ordered on fire time, then insertion sequence
+	static bool FiresBefore( const EventQueuePrioritizedEvent_t *a, const EventQueuePrioritizedEvent_t *b );
+	void HeapSiftUp( int index );
+	void HeapSiftDown( int index );
+	void GetEventsInOrder( CUtlVector< EventQueuePrioritizedEvent_t * > *events ) const;
+
 	DECLARE_SIMPLE_DATADESC();
-	EventQueuePrioritizedEvent_t m_Events;
+	CUtlVector< EventQueuePrioritizedEvent_t * > m_Heap;
+	unsigned int m_iNextSequence;
 	int m_iListCount;
+
+	// pending events of each caller, keyed by the caller's EHANDLE
+	CUtlMap< unsigned long, EventQueuePrioritizedEvent_t * > m_CallerEvents;
+
+	EventQueuePrioritizedEvent_t *m_pServicingEvent;	// the event being fired, which is freed once it returns
+
+	// for eventqueue_stats
+	int m_iPeakCount;
+	int m_iInsertCount;
+	int m_iServiceCount;
+	double m_flServiceTime;
+	double m_flMaxServiceTime;
+	double m_flStatsStartTime;
 };
 
 extern CEventQueue g_EventQueue;
@@ -248,6 +248,7 @@ static ClientPutInServerOverrideFn g_pClientPutInServerOverride = NULL;
 static void UpdateChapterRestrictions( const char *mapname );
 
 static void UpdateRichPresence ( void );
+static void InvalidateTransmitPVSCache( void );
 
 
 #if !defined( _XBOX ) // Don't doubly define this symbol.
@@ -962,6 +963,8 @@ bool CServerGameDLL::LevelInit( const char *pMapName, char const *pMapEntities,
 
 	g_flServerCurTime = gpGlobals->curtime;
 
+	InvalidateTransmitPVSCache();
+
 #ifdef USES_ECON_ITEMS
 	GameItemSchema_t *pItemSchema = ItemSystem()->GetItemSchema();
 	if ( pItemSchema )
@@ -1200,6 +1203,8 @@ void CServerGameDLL::GameFrame( bool simulating )
 {
 	VPROF( "CServerGameDLL::GameFrame" );
 
+	g_pServerBenchmark->StartFrame();
+
 	// Don't run frames until fully restored
 	if ( g_InRestore )
 		return;
@@ -1241,7 +1246,10 @@ void CServerGameDLL::GameFrame( bool simulating )
 #endif
 
 #ifdef NEXT_BOT
-	TheNextBots().Update();
+	{
+		SV_BENCHMARK_SCOPE( SV_BENCHMARK_NEXTBOT_UPDATE );
+		TheNextBots().Update();
+	}
 #endif
 
 	gamestatsuploader->UpdateConnection();
@@ -1250,13 +1258,19 @@ void CServerGameDLL::GameFrame( bool simulating )
 	UpdateQueryCache();
 	g_pServerBenchmark->UpdateBenchmark();
 
-	Physics_RunThinkFunctions( simulating );
+	{
+		SV_BENCHMARK_SCOPE( SV_BENCHMARK_ENTITY_THINK );
+		Physics_RunThinkFunctions( simulating );
+	}
 	
 	IGameSystem::FrameUpdatePostEntityThinkAllSystems();
 
 	// UNDONE: Make these systems IGameSystems and move these calls into FrameUpdatePostEntityThink()
 	// service event queue, firing off any actions whos time has come
-	ServiceEventQueue();
+	{
+		SV_BENCHMARK_SCOPE( SV_BENCHMARK_EVENT_QUEUE );
+		ServiceEventQueue();
+	}
 
 	// free all ents marked in think functions
 	gEntList.CleanupDeleteList();
@@ -1397,6 +1411,7 @@ void CServerGameDLL::LevelShutdown( void )
 	gEntList.Clear();
 
 	InvalidateQueryCache();
+	InvalidateTransmitPVSCache();
 
 	IGameSystem::LevelShutdownPostEntityAllSystems();
 
@@ -2481,12 +2496,164 @@ inline void CServerNetworkProperty::CheckTransmit( CCheckTransmitInfo *pInfo )
 	}
 } */
 
+//-----------------------------------------------------------------------------
+// CheckTransmit runs once per client per snapshot over the same edict list. The PVS
+// data of every entity that needs a PVS test is gathered into flat arrays on the first
+// call of the tick and shared by the rest of the clients. Each client resolves whether
+// an area is connected to it once per area instead of once per entity.
+//-----------------------------------------------------------------------------
+static ConVar sv_checktransmit_cache( "sv_checktransmit_cache", "1", 0, "Share entity PVS data between the clients' transmit checks each tick." );
+
+struct TransmitPVSEntry_t
+{
+	short	m_nAreaNum;
+	short	m_nAreaNum2;
+	short	m_nClusterCount;	// -1 if too many clusters, test m_nHeadNode instead
+	short	m_nHeadNode;
+	int		m_iFirstCluster;
+};
+
+class CTransmitPVSCache
+{
+public:
+	CTransmitPVSCache() : m_nTick( -1 ) {}
+
+	void Update( edict_t *pBaseEdict, const unsigned short *pEdictIndices, int nEdicts );
+
+	// The tickcount restarts with each level, so a cache from the old level could look current
+	void Invalidate()
+	{
+		m_nTick = -1;
+		m_EdictIndices.Purge();
+		m_EntryForIndex.Purge();
+		m_Entries.Purge();
+		m_Clusters.Purge();
+	}
+
+	// Entry for pEdictIndices[i], or NULL if it didn't need a PVS test when the cache was built
+	const TransmitPVSEntry_t *GetEntry( int i ) const
+	{
+		int iEntry = m_EntryForIndex[i];
+		return ( iEntry >= 0 ) ? &m_Entries[iEntry] : NULL;
+	}
+
+	// Same test as CServerNetworkProperty::IsInPVS. pAreaState is MAX_MAP_AREAS
+	// bytes, zeroed at the start of each client's check.
+	bool IsInPVS( const TransmitPVSEntry_t &entry, const CCheckTransmitInfo *pInfo, unsigned char *pAreaState ) const;
+
+private:
+	int m_nTick;
+	CUtlVector<unsigned short>		m_EdictIndices;
+	CUtlVector<int>					m_EntryForIndex;
+	CUtlVector<TransmitPVSEntry_t>	m_Entries;
+	CUtlVector<unsigned short>		m_Clusters;
+};
+
+static CTransmitPVSCache s_TransmitPVSCache;
+
+static void InvalidateTransmitPVSCache( void )
+{
+	s_TransmitPVSCache.Invalidate();
+}
+
+void CTransmitPVSCache::Update( edict_t *pBaseEdict, const unsigned short *pEdictIndices, int nEdicts )
+{
+	if ( m_nTick == gpGlobals->tickcount && m_EdictIndices.Count() == nEdicts &&
+		 !V_memcmp( m_EdictIndices.Base(), pEdictIndices, nEdicts * sizeof( unsigned short ) ) )
+		return;
+
+	m_nTick = gpGlobals->tickcount;
+	m_EdictIndices.CopyArray( pEdictIndices, nEdicts );
+	m_EntryForIndex.SetCount( nEdicts );
+	m_Entries.RemoveAll();
+	m_Clusters.RemoveAll();
+
+	for ( int i = 0; i < nEdicts; i++ )
+	{
+		edict_t *pEdict = &pBaseEdict[ pEdictIndices[i] ];
+		m_EntryForIndex[i] = -1;
+
+		if ( !( pEdict->m_fStateFlags & ( FL_EDICT_PVSCHECK | FL_EDICT_FULLCHECK ) ) ||
+			 ( pEdict->m_fStateFlags & ( FL_EDICT_DONTSEND | FL_EDICT_ALWAYS ) ) )
+			continue;
+
+		CServerNetworkProperty *netProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		if ( !netProp )
+			continue;
+
+		netProp->RecomputePVSInformation();
+		const PVSInfo_t *pPVSInfo = netProp->GetPVSInfo();
+
+		m_EntryForIndex[i] = m_Entries.AddToTail();
+		TransmitPVSEntry_t &entry = m_Entries.Tail();
+		entry.m_nAreaNum = pPVSInfo->m_nAreaNum;
+		entry.m_nAreaNum2 = pPVSInfo->m_nAreaNum2;
+		entry.m_nClusterCount = pPVSInfo->m_nClusterCount;
+		entry.m_nHeadNode = pPVSInfo->m_nHeadNode;
+		entry.m_iFirstCluster = m_Clusters.Count();
+		if ( pPVSInfo->m_nClusterCount > 0 )
+		{
+			m_Clusters.AddMultipleToTail( pPVSInfo->m_nClusterCount, pPVSInfo->m_pClusters );
+		}
+	}
+}
+
+static bool IsAreaConnectedToClient( int nArea, const CCheckTransmitInfo *pInfo, unsigned char *pAreaState )
+{
+	enum { AREA_UNKNOWN = 0, AREA_CONNECTED, AREA_NOT_CONNECTED };
+
+	if ( nArea >= 0 && nArea < MAX_MAP_AREAS && pAreaState[nArea] != AREA_UNKNOWN )
+		return pAreaState[nArea] == AREA_CONNECTED;
+
+	bool bConnected = false;
+	for ( int i = 0; i < pInfo->m_AreasNetworked; i++ )
+	{
+		int clientArea = pInfo->m_Areas[i];
+		if ( clientArea == nArea || engine->CheckAreasConnected( clientArea, nArea ) )
+		{
+			bConnected = true;
+			break;
+		}
+	}
+
+	if ( nArea >= 0 && nArea < MAX_MAP_AREAS )
+	{
+		pAreaState[nArea] = bConnected ? AREA_CONNECTED : AREA_NOT_CONNECTED;
+	}
+	return bConnected;
+}
+
+bool CTransmitPVSCache::IsInPVS( const TransmitPVSEntry_t &entry, const CCheckTransmitInfo *pInfo, unsigned char *pAreaState ) const
+{
+	// doors can legally straddle two areas, so we may need to check another one
+	if ( !IsAreaConnectedToClient( entry.m_nAreaNum, pInfo, pAreaState ) &&
+		 ( !entry.m_nAreaNum2 || !IsAreaConnectedToClient( entry.m_nAreaNum2, pInfo, pAreaState ) ) )
+		return false;
+
+	const unsigned char *pPVS = pInfo->m_PVS;
+	if ( entry.m_nClusterCount < 0 )   // too many clusters, use headnode
+		return ( engine->CheckHeadnodeVisible( entry.m_nHeadNode, pPVS, pInfo->m_nPVSSize ) != 0 );
+
+	const unsigned short *pClusters = m_Clusters.Base() + entry.m_iFirstCluster;
+	for ( int i = entry.m_nClusterCount; --i >= 0; )
+	{
+		int nCluster = pClusters[i];
+		if ( ((int)(pPVS[nCluster >> 3])) & BitVec_BitInByte( nCluster ) )
+			return true;
+	}
+
+	return false;
+}
+
+
 void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned short *pEdictIndices, int nEdicts )
 {
 	// NOTE: for speed's sake, this assumes that all networkables are CBaseEntities and that the edict list
 	// is consecutive in memory. If either of these things change, then this routine needs to change, but
 	// ideally we won't be calling any virtual from this routine. This speedy routine was added as an
 	// optimization which would be nice to keep.
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_CHECK_TRANSMIT );
+
 	edict_t *pBaseEdict = engine->PEntityOfEntIndex( 0 );
 
 	// get recipient player's skybox:
@@ -2509,6 +2676,14 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 		    bIsReplay == ( pInfo->m_pTransmitAlways != NULL) );
 #endif
 
+	const bool bUseCache = sv_checktransmit_cache.GetBool();
+	unsigned char areaState[MAX_MAP_AREAS];
+	if ( bUseCache )
+	{
+		s_TransmitPVSCache.Update( pBaseEdict, pEdictIndices, nEdicts );
+		V_memset( areaState, 0, sizeof( areaState ) );
+	}
+
 	for ( int i=0; i < nEdicts; i++ )
 	{
 		int iEdict = pEdictIndices[i];
@@ -2577,12 +2752,16 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 			continue;
 
 		CServerNetworkProperty *netProp = static_cast<CServerNetworkProperty*>( pEdict->GetNetworkable() );
+		const TransmitPVSEntry_t *pPVSEntry = bUseCache ? s_TransmitPVSCache.GetEntry( i ) : NULL;
+
+		// Sidenote: call of AreaNum() ensures that PVS data is up to date for this entity
+		const int nAreaNum = pPVSEntry ? pPVSEntry->m_nAreaNum : netProp->AreaNum();
 
 #ifndef _X360
 		if ( bIsHLTV || bIsReplay )
 		{
 			// for the HLTV/Replay we don't cull against PVS
-			if ( netProp->AreaNum() == skyBoxArea )
+			if ( nAreaNum == skyBoxArea )
 			{
 				pEnt->SetTransmit( pInfo, true );
 			}
@@ -2595,15 +2774,14 @@ void CServerGameEnts::CheckTransmit( CCheckTransmitInfo *pInfo, const unsigned s
 #endif
 
 		// Always send entities in the player's 3d skybox.
-		// Sidenote: call of AreaNum() ensures that PVS data is up to date for this entity
-		bool bSameAreaAsSky = netProp->AreaNum() == skyBoxArea;
+		bool bSameAreaAsSky = nAreaNum == skyBoxArea;
 		if ( bSameAreaAsSky )
 		{
 			pEnt->SetTransmit( pInfo, true );
 			continue;
 		}
 
-		bool bInPVS = netProp->IsInPVS( pInfo );
+		bool bInPVS = pPVSEntry ? s_TransmitPVSCache.IsInPVS( *pPVSEntry, pInfo, areaState ) : netProp->IsInPVS( pInfo );
 		if ( bInPVS || sv_force_transmit_ents.GetBool() )
 		{
 			// only send if entity is in PVS
@@ -12,6 +12,7 @@
 #endif
 
 class CBasePlayer;
+class CBaseAnimatingOverlay;
 class CUserCmd;
 
 //-----------------------------------------------------------------------------
@@ -24,6 +25,10 @@ public:
 	virtual void	StartLagCompensation( CBasePlayer *player, CUserCmd *cmd ) = 0;
 	virtual void	FinishLagCompensation( CBasePlayer *player ) = 0;
 	virtual bool	IsCurrentlyDoingLagCompensation() const = 0;
+
+	// Non-player entities (NextBots, buildings) that should be lag compensated
+	virtual void	AddAdditionalEntity( CBaseAnimatingOverlay *pEntity ) = 0;
+	virtual void	RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity ) = 0;
 };
 
 extern ILagCompensationManager *lagcompensation;
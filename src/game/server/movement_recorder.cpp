@@ -0,0 +1,1353 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Player movement record/replay. While recording, enginetrace is swapped for a
+//			proxy around every ProcessMovement call that logs each collision query and
+//			its result. A replay restores the recorded player state and move data onto a
+//			live player, runs the same movement code, and answers its collision queries
+//			either from the log or from the world brushes saved with the recording, so
+//			neither the engine's collision code nor the other entities are involved.
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "movement_recorder.h"
+#include "player.h"
+#include "igamemovement.h"
+#include "imovehelper.h"
+#include "movehelper_server.h"
+#include "world.h"
+#include "filesystem.h"
+#include "coordsize.h"
+#include "collisionutils.h"
+#include "tier0/fasttimer.h"
+#ifdef TF_DLL
+#include "tf_player.h"
+#endif
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+extern IGameMovement *g_pGameMovement;
+
+ConVar sv_movement_record_maxmoves( "sv_movement_record_maxmoves", "50000", 0, "Movement recordings are written out automatically once they hold this many usercmds." );
+
+CMovementRecorder g_MovementRecorder;
+
+#define MOVEMENT_RECORDING_ID		(('C'<<24)+('R'<<16)+('V'<<8)+'M')
+#define MOVEMENT_RECORDING_VERSION	2
+
+// Replays stop printing individual mismatches after this many
+#define MOVEMENT_REPLAY_MAX_REPORTS	10
+
+
+//-----------------------------------------------------------------------------
+// File layout. Everything is written raw, so the sizes in the header have to
+// match the build that replays it.
+//-----------------------------------------------------------------------------
+struct MovementRecordingHeader_t
+{
+	int		m_nID;
+	int		m_nVersion;
+	int		m_nMoveDataSize;
+	int		m_nMoveSize;
+	int		m_nQuerySize;
+	float	m_flTickInterval;
+	char	m_szMapName[64];
+	int		m_nBrushes;
+	int		m_nBrushPlanes;
+	int		m_nMoves;
+	int		m_nQueries;
+};
+
+struct MovementBrush_t
+{
+	int		m_nContents;
+	int		m_iFirstPlane;
+	int		m_nPlanes;
+	Vector	m_vecMins;		// from the brush's axial planes, which vbsp always adds
+	Vector	m_vecMaxs;
+};
+
+// Everything on the player that the movement code reads or writes outside of CMoveData
+struct MovementPlayerState_t
+{
+	int		m_fFlags;
+	int		m_nMoveType;
+	int		m_nMoveCollide;
+	int		m_nWaterLevel;
+	int		m_nWaterType;
+	int		m_iGroundEntity;	// -1 if in the air
+	int		m_nTickBase;
+	Vector	m_vecBaseVelocity;
+	Vector	m_vecViewOffset;
+	float	m_flGravity;
+	float	m_flFriction;
+	float	m_flMaxSpeed;
+	float	m_flDucktime;
+	float	m_flDuckJumpTime;
+	float	m_flJumpTime;
+	float	m_flFallVelocity;
+	float	m_flStepSize;
+	QAngle	m_vecPunchAngle;
+	QAngle	m_vecPunchAngleVel;
+	float	m_flWaterJumpTime;
+	Vector	m_vecWaterJumpVel;
+	float	m_flSwimSoundTime;
+	Vector	m_vecLadderNormal;
+	float	m_flStepSoundTime;
+	float	m_surfaceFriction;
+	int		m_surfaceProps;
+	int		m_StuckLast;
+	int		m_nNumCrouches;
+	char	m_chTextureType;
+	char	m_chPreviousTextureType;
+	bool	m_bHasSurfaceData;
+	bool	m_bDucked;
+	bool	m_bDucking;
+	bool	m_bInDuckJump;
+	bool	m_bAllowAutoMovement;
+	bool	m_bSlowMovement;
+	int		m_nButtons;
+
+#ifdef TF_DLL
+	// CTFPlayerShared. Conditions are the raw bits, crit boost lives in the
+	// condition list and isn't captured, movement doesn't look at it.
+	int		m_nPlayerCond[5];
+	int		m_iAirDash;
+	int		m_nAirDucked;
+	int		m_iStunFlags;
+	int		m_iMovementStunAmount;
+	int		m_iActiveStunFlags;		// the active stun_struct_t, if m_bHasActiveStun
+	float	m_flActiveStunAmount;
+	float	m_flActiveStunExpireTime;
+	float	m_flStunLerpTarget;
+	float	m_flLastMovementStunChange;
+	float	m_flChargeMeter;
+	float	m_flHypeMeter;
+	bool	m_bJumping;
+	bool	m_bStunNeedsFadeOut;
+	bool	m_bHasActiveStun;
+
+	// CTFPlayer
+	bool	m_bTakenBlastDamageSinceLastMovement;
+	int		m_iKartState;
+	float	m_flTauntYaw;
+	float	m_flCurrentTauntMoveSpeed;
+	float	m_flVehicleReverseTime;
+	float	m_flWaterExitTime;
+#endif
+};
+
+#ifdef TF_DLL
+//-----------------------------------------------------------------------------
+// The parts of a TF player a replay can change that don't go in a recording.
+// Taken before a replay and put back afterwards.
+//-----------------------------------------------------------------------------
+struct TFReplayPlayerSnapshot_t
+{
+	CUtlVector<condition_source_t>		m_ConditionData;
+	CUtlVector<condition_provider_t>	m_ConditionProviders;
+	CUtlVector<stun_struct_t>			m_PlayerStuns;
+	int									m_iStunIndex;
+};
+#endif
+
+struct MovementRecord_t
+{
+	int		m_nTick;
+	float	m_flCurTime;
+	float	m_flFrameTime;
+	int		m_iPlayer;
+	int		m_iFirstQuery;
+	int		m_nQueries;
+	CMoveData				m_MoveIn;
+	CMoveData				m_MoveOut;
+	MovementPlayerState_t	m_StateIn;
+	MovementPlayerState_t	m_StateOut;
+};
+
+enum
+{
+	MOVEMENT_QUERY_TRACE = 0,
+	MOVEMENT_QUERY_CONTENTS,
+};
+
+struct MovementQuery_t
+{
+	int				m_nType;
+	unsigned int	m_fMask;
+	Vector			m_vecStart;		// the point for contents queries
+	Vector			m_vecDelta;
+	Vector			m_vecStartOffset;
+	Vector			m_vecExtents;
+	bool			m_bIsRay;
+	bool			m_bIsSwept;
+
+	// result
+	bool			m_bAllSolid;
+	bool			m_bStartSolid;
+	int				m_nContents;
+	Vector			m_vecStartPos;
+	Vector			m_vecEndPos;
+	Vector			m_vecPlaneNormal;
+	float			m_flPlaneDist;
+	byte			m_nPlaneType;
+	byte			m_nPlaneSignBits;
+	unsigned short	m_nDispFlags;
+	float			m_flFraction;
+	float			m_flFractionLeftSolid;
+	short			m_nSurfaceProps;
+	unsigned short	m_nSurfaceFlags;
+	int				m_nHitGroup;
+	short			m_nPhysicsBone;
+	int				m_nHitbox;
+	int				m_iEntity;		// -1 if nothing was hit
+};
+
+
+//-----------------------------------------------------------------------------
+// A recording in memory
+//-----------------------------------------------------------------------------
+class CMovementRecording
+{
+public:
+	void Clear()
+	{
+		m_Brushes.Purge();
+		m_BrushPlanes.Purge();
+		m_Moves.Purge();
+		m_Queries.Purge();
+	}
+
+	void CaptureWorldBrushes();
+	bool Write( const char *pFileName );
+	bool Read( const char *pFileName );
+
+	char							m_szMapName[64];
+	CUtlVector<MovementBrush_t>		m_Brushes;
+	CUtlVector<Vector4D>			m_BrushPlanes;
+	CUtlVector<MovementRecord_t>	m_Moves;
+	CUtlVector<MovementQuery_t>		m_Queries;
+};
+
+void CMovementRecording::CaptureWorldBrushes()
+{
+	CUtlVector<int> brushes;
+	CUtlVector<Vector4D> planes;
+	Vector vecWorldMax( MAX_COORD_FLOAT, MAX_COORD_FLOAT, MAX_COORD_FLOAT );
+	enginetrace->GetBrushesInAABB( -vecWorldMax, vecWorldMax, &brushes, MASK_PLAYERSOLID | MASK_WATER | CONTENTS_LADDER );
+
+	for ( int i = 0; i < brushes.Count(); i++ )
+	{
+		int nContents;
+		planes.RemoveAll();
+		if ( !enginetrace->GetBrushInfo( brushes[i], &planes, &nContents ) || !planes.Count() )
+			continue;
+
+		MovementBrush_t &brush = m_Brushes[ m_Brushes.AddToTail() ];
+		brush.m_nContents = nContents;
+		brush.m_iFirstPlane = m_BrushPlanes.Count();
+		brush.m_nPlanes = planes.Count();
+		brush.m_vecMins.Init( -MAX_COORD_FLOAT, -MAX_COORD_FLOAT, -MAX_COORD_FLOAT );
+		brush.m_vecMaxs.Init( MAX_COORD_FLOAT, MAX_COORD_FLOAT, MAX_COORD_FLOAT );
+
+		for ( int j = 0; j < planes.Count(); j++ )
+		{
+			const Vector4D &plane = planes[j];
+			for ( int nAxis = 0; nAxis < 3; nAxis++ )
+			{
+				if ( plane[nAxis] == 1.0f )
+				{
+					brush.m_vecMaxs[nAxis] = plane.w;
+				}
+				else if ( plane[nAxis] == -1.0f )
+				{
+					brush.m_vecMins[nAxis] = -plane.w;
+				}
+			}
+		}
+
+		m_BrushPlanes.AddMultipleToTail( planes.Count(), planes.Base() );
+	}
+}
+
+bool CMovementRecording::Write( const char *pFileName )
+{
+	MovementRecordingHeader_t header;
+	V_memset( &header, 0, sizeof( header ) );
+	header.m_nID = MOVEMENT_RECORDING_ID;
+	header.m_nVersion = MOVEMENT_RECORDING_VERSION;
+	header.m_nMoveDataSize = sizeof( CMoveData );
+	header.m_nMoveSize = sizeof( MovementRecord_t );
+	header.m_nQuerySize = sizeof( MovementQuery_t );
+	header.m_flTickInterval = TICK_INTERVAL;
+	V_strncpy( header.m_szMapName, m_szMapName, sizeof( header.m_szMapName ) );
+	header.m_nBrushes = m_Brushes.Count();
+	header.m_nBrushPlanes = m_BrushPlanes.Count();
+	header.m_nMoves = m_Moves.Count();
+	header.m_nQueries = m_Queries.Count();
+
+	CUtlBuffer buf;
+	buf.Put( &header, sizeof( header ) );
+	buf.Put( m_Brushes.Base(), m_Brushes.Count() * sizeof( MovementBrush_t ) );
+	buf.Put( m_BrushPlanes.Base(), m_BrushPlanes.Count() * sizeof( Vector4D ) );
+	buf.Put( m_Moves.Base(), m_Moves.Count() * sizeof( MovementRecord_t ) );
+	buf.Put( m_Queries.Base(), m_Queries.Count() * sizeof( MovementQuery_t ) );
+
+	return filesystem->WriteFile( pFileName, "MOD", buf );
+}
+
+bool CMovementRecording::Read( const char *pFileName )
+{
+	Clear();
+
+	CUtlBuffer buf;
+	if ( !filesystem->ReadFile( pFileName, "MOD", buf ) )
+	{
+		Warning( "Couldn't read movement recording %s\n", pFileName );
+		return false;
+	}
+
+	MovementRecordingHeader_t header;
+	buf.Get( &header, sizeof( header ) );
+	if ( !buf.IsValid() || header.m_nID != MOVEMENT_RECORDING_ID || header.m_nVersion != MOVEMENT_RECORDING_VERSION )
+	{
+		Warning( "%s is not a movement recording\n", pFileName );
+		return false;
+	}
+
+	if ( header.m_nMoveDataSize != sizeof( CMoveData ) || header.m_nMoveSize != sizeof( MovementRecord_t ) ||
+		 header.m_nQuerySize != sizeof( MovementQuery_t ) )
+	{
+		Warning( "%s was recorded by a different build\n", pFileName );
+		return false;
+	}
+
+	if ( header.m_flTickInterval != TICK_INTERVAL )
+	{
+		Warning( "%s was recorded with a tick interval of %f, replaying at %f\n", pFileName, header.m_flTickInterval, TICK_INTERVAL );
+	}
+
+	if ( header.m_nBrushes < 0 || header.m_nBrushPlanes < 0 || header.m_nMoves < 0 || header.m_nQueries < 0 )
+	{
+		Warning( "%s is corrupt\n", pFileName );
+		return false;
+	}
+
+	// Don't allocate for counts the file can't possibly hold
+	int64 nDataSize = (int64)header.m_nBrushes * sizeof( MovementBrush_t ) + (int64)header.m_nBrushPlanes * sizeof( Vector4D ) +
+		(int64)header.m_nMoves * sizeof( MovementRecord_t ) + (int64)header.m_nQueries * sizeof( MovementQuery_t );
+	if ( nDataSize > buf.GetBytesRemaining() )
+	{
+		Warning( "%s is truncated\n", pFileName );
+		return false;
+	}
+
+	V_strncpy( m_szMapName, header.m_szMapName, sizeof( m_szMapName ) );
+	m_szMapName[ sizeof( m_szMapName ) - 1 ] = 0;
+	m_Brushes.SetCount( header.m_nBrushes );
+	m_BrushPlanes.SetCount( header.m_nBrushPlanes );
+	m_Moves.SetCount( header.m_nMoves );
+	m_Queries.SetCount( header.m_nQueries );
+
+	buf.Get( m_Brushes.Base(), m_Brushes.Count() * sizeof( MovementBrush_t ) );
+	buf.Get( m_BrushPlanes.Base(), m_BrushPlanes.Count() * sizeof( Vector4D ) );
+	buf.Get( m_Moves.Base(), m_Moves.Count() * sizeof( MovementRecord_t ) );
+	buf.Get( m_Queries.Base(), m_Queries.Count() * sizeof( MovementQuery_t ) );
+	if ( !buf.IsValid() )
+	{
+		Warning( "%s is truncated\n", pFileName );
+		Clear();
+		return false;
+	}
+
+	// Replays index straight into these, so every range has to be inside its array
+	for ( int i = 0; i < m_Brushes.Count(); i++ )
+	{
+		const MovementBrush_t &brush = m_Brushes[i];
+		if ( brush.m_iFirstPlane < 0 || brush.m_nPlanes < 0 || brush.m_nPlanes > m_BrushPlanes.Count() - brush.m_iFirstPlane )
+		{
+			Warning( "%s is corrupt, brush %d has planes outside the recording\n", pFileName, i );
+			Clear();
+			return false;
+		}
+	}
+
+	for ( int i = 0; i < m_Moves.Count(); i++ )
+	{
+		const MovementRecord_t &record = m_Moves[i];
+		if ( record.m_iFirstQuery < 0 || record.m_nQueries < 0 || record.m_nQueries > m_Queries.Count() - record.m_iFirstQuery )
+		{
+			Warning( "%s is corrupt, move %d has queries outside the recording\n", pFileName, i );
+			Clear();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static CMovementRecording s_Recording;
+
+
+//-----------------------------------------------------------------------------
+// Offline collision against the world brushes saved in a recording. Brush
+// entities, displacements and props aren't in there, and surface properties
+// come back as the default.
+//-----------------------------------------------------------------------------
+class CMovementBrushCollision
+{
+public:
+	void Init( const CMovementRecording *pRecording ) { m_pRecording = pRecording; }
+
+	int GetPointContents( const Vector &vecPoint ) const;
+	void TraceRay( const Ray_t &ray, unsigned int fMask, trace_t *pTrace ) const;
+
+private:
+	void ClipRayToBrush( const Ray_t &ray, const MovementBrush_t &brush, trace_t *pTrace ) const;
+
+	const CMovementRecording *m_pRecording;
+};
+
+int CMovementBrushCollision::GetPointContents( const Vector &vecPoint ) const
+{
+	int nContents = CONTENTS_EMPTY;
+	for ( int i = 0; i < m_pRecording->m_Brushes.Count(); i++ )
+	{
+		const MovementBrush_t &brush = m_pRecording->m_Brushes[i];
+		if ( !IsPointInBox( vecPoint, brush.m_vecMins, brush.m_vecMaxs ) )
+			continue;
+
+		const Vector4D *pPlanes = &m_pRecording->m_BrushPlanes[ brush.m_iFirstPlane ];
+		int j;
+		for ( j = 0; j < brush.m_nPlanes; j++ )
+		{
+			if ( DotProduct( vecPoint, pPlanes[j].AsVector3D() ) > pPlanes[j].w )
+				break;
+		}
+
+		if ( j == brush.m_nPlanes )
+		{
+			nContents |= brush.m_nContents;
+		}
+	}
+
+	return nContents;
+}
+
+static int PlaneTypeForNormal( const Vector &vecNormal )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		if ( fabs( vecNormal[i] ) == 1.0f )
+			return PLANE_X + i;
+	}
+
+	Vector vecAbs( fabs( vecNormal.x ), fabs( vecNormal.y ), fabs( vecNormal.z ) );
+	if ( vecAbs.x >= vecAbs.y && vecAbs.x >= vecAbs.z )
+		return PLANE_ANYX;
+	return ( vecAbs.y >= vecAbs.z ) ? PLANE_ANYY : PLANE_ANYZ;
+}
+
+void CMovementBrushCollision::ClipRayToBrush( const Ray_t &ray, const MovementBrush_t &brush, trace_t *pTrace ) const
+{
+	const Vector4D *pPlanes = &m_pRecording->m_BrushPlanes[ brush.m_iFirstPlane ];
+	const Vector4D *pClipPlane = NULL;
+	float flEnterFrac = -1.0f;
+	float flLeaveFrac = 1.0f;
+	bool bGetOut = false;
+	bool bStartOut = false;
+
+	Vector vecEnd;
+	VectorAdd( ray.m_Start, ray.m_Delta, vecEnd );
+
+	for ( int i = 0; i < brush.m_nPlanes; i++ )
+	{
+		const Vector &vecNormal = pPlanes[i].AsVector3D();
+
+		// push the plane out by the box's extents along the normal
+		float flDist = pPlanes[i].w;
+		if ( !ray.m_IsRay )
+		{
+			flDist += fabs( vecNormal.x * ray.m_Extents.x ) + fabs( vecNormal.y * ray.m_Extents.y ) + fabs( vecNormal.z * ray.m_Extents.z );
+		}
+
+		float d1 = DotProduct( ray.m_Start, vecNormal ) - flDist;
+		float d2 = DotProduct( vecEnd, vecNormal ) - flDist;
+
+		if ( d2 > 0 )
+			bGetOut = true;
+		if ( d1 > 0 )
+			bStartOut = true;
+
+		// completely in front of this plane
+		if ( d1 > 0 && ( d2 >= DIST_EPSILON || d2 >= d1 ) )
+			return;
+
+		// completely behind it
+		if ( d1 <= 0 && d2 <= 0 )
+			continue;
+
+		if ( d1 > d2 )
+		{
+			float f = MAX( 0.0f, ( d1 - DIST_EPSILON ) / ( d1 - d2 ) );
+			if ( f > flEnterFrac )
+			{
+				flEnterFrac = f;
+				pClipPlane = &pPlanes[i];
+			}
+		}
+		else
+		{
+			float f = MIN( 1.0f, ( d1 + DIST_EPSILON ) / ( d1 - d2 ) );
+			if ( f < flLeaveFrac )
+			{
+				flLeaveFrac = f;
+			}
+		}
+	}
+
+	if ( !bStartOut )
+	{
+		pTrace->startsolid = true;
+		pTrace->contents = brush.m_nContents;
+		if ( !bGetOut )
+		{
+			pTrace->allsolid = true;
+			pTrace->fraction = 0.0f;
+			pTrace->fractionleftsolid = 1.0f;
+		}
+		else if ( flLeaveFrac > pTrace->fractionleftsolid )
+		{
+			pTrace->fractionleftsolid = flLeaveFrac;
+		}
+		return;
+	}
+
+	if ( pClipPlane && flEnterFrac < flLeaveFrac && flEnterFrac < pTrace->fraction )
+	{
+		pTrace->fraction = flEnterFrac;
+		pTrace->plane.normal = pClipPlane->AsVector3D();
+		pTrace->plane.dist = pClipPlane->w;
+		pTrace->plane.type = (byte)PlaneTypeForNormal( pTrace->plane.normal );
+		pTrace->plane.signbits = (byte)SignbitsForPlane( &pTrace->plane );
+		pTrace->contents = brush.m_nContents;
+	}
+}
+
+void CMovementBrushCollision::TraceRay( const Ray_t &ray, unsigned int fMask, trace_t *pTrace ) const
+{
+	V_memset( pTrace, 0, sizeof( *pTrace ) );
+	pTrace->fraction = 1.0f;
+	pTrace->fractionleftsolid = 0.0f;
+	pTrace->surface.name = "**empty**";
+
+	Vector vecEnd;
+	VectorAdd( ray.m_Start, ray.m_Delta, vecEnd );
+	Vector vecSweepMins, vecSweepMaxs;
+	VectorMin( ray.m_Start, vecEnd, vecSweepMins );
+	VectorMax( ray.m_Start, vecEnd, vecSweepMaxs );
+	vecSweepMins -= ray.m_Extents + Vector( 1, 1, 1 );
+	vecSweepMaxs += ray.m_Extents + Vector( 1, 1, 1 );
+
+	for ( int i = 0; i < m_pRecording->m_Brushes.Count() && !pTrace->allsolid; i++ )
+	{
+		const MovementBrush_t &brush = m_pRecording->m_Brushes[i];
+		if ( !( brush.m_nContents & fMask ) )
+			continue;
+		if ( !IsBoxIntersectingBox( vecSweepMins, vecSweepMaxs, brush.m_vecMins, brush.m_vecMaxs ) )
+			continue;
+
+		ClipRayToBrush( ray, brush, pTrace );
+	}
+
+	VectorAdd( ray.m_Start, ray.m_StartOffset, pTrace->startpos );
+	if ( pTrace->fraction == 1.0f )
+	{
+		VectorAdd( pTrace->startpos, ray.m_Delta, pTrace->endpos );
+	}
+	else
+	{
+		VectorMA( pTrace->startpos, pTrace->fraction, ray.m_Delta, pTrace->endpos );
+	}
+
+	if ( pTrace->fraction < 1.0f || pTrace->startsolid )
+	{
+		pTrace->m_pEnt = GetWorldEntity();
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Stands in for enginetrace during a recorded or replayed move
+//-----------------------------------------------------------------------------
+class CMovementTraceProxy : public IEngineTrace
+{
+public:
+	enum Mode_t
+	{
+		MODE_RECORD,
+		MODE_REPLAY_TRACES,		// answer from the log, falling back to brushes once the move diverges
+		MODE_REPLAY_BRUSHES,	// answer everything from the brushes
+	};
+
+	void Install( Mode_t mode )
+	{
+		Assert( !m_pEngineTrace );
+		m_Mode = mode;
+		m_pEngineTrace = enginetrace;
+		enginetrace = this;
+	}
+
+	void Uninstall()
+	{
+		Assert( enginetrace == this );
+		enginetrace = m_pEngineTrace;
+		m_pEngineTrace = NULL;
+	}
+
+	// replay
+	void SetQueries( const MovementQuery_t *pQueries, int nQueries )
+	{
+		m_pQueries = pQueries;
+		m_nQueries = nQueries;
+		m_iNextQuery = 0;
+		m_bDiverged = false;
+	}
+	bool Diverged() const { return m_Mode == MODE_REPLAY_TRACES && ( m_bDiverged || m_iNextQuery != m_nQueries ); }
+
+	CMovementBrushCollision m_BrushCollision;
+
+	virtual int GetPointContents( const Vector &vecAbsPosition, IHandleEntity** ppEntity = NULL );
+	virtual void TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace );
+
+	virtual int GetPointContents_Collideable( ICollideable *pCollide, const Vector &vecAbsPosition )
+	{
+		return m_pEngineTrace->GetPointContents_Collideable( pCollide, vecAbsPosition );
+	}
+	virtual void ClipRayToEntity( const Ray_t &ray, unsigned int fMask, IHandleEntity *pEnt, trace_t *pTrace )
+	{
+		m_pEngineTrace->ClipRayToEntity( ray, fMask, pEnt, pTrace );
+	}
+	virtual void ClipRayToCollideable( const Ray_t &ray, unsigned int fMask, ICollideable *pCollide, trace_t *pTrace )
+	{
+		m_pEngineTrace->ClipRayToCollideable( ray, fMask, pCollide, pTrace );
+	}
+	virtual void SetupLeafAndEntityListRay( const Ray_t &ray, CTraceListData &traceData )
+	{
+		m_pEngineTrace->SetupLeafAndEntityListRay( ray, traceData );
+	}
+	virtual void SetupLeafAndEntityListBox( const Vector &vecBoxMin, const Vector &vecBoxMax, CTraceListData &traceData )
+	{
+		m_pEngineTrace->SetupLeafAndEntityListBox( vecBoxMin, vecBoxMax, traceData );
+	}
+	virtual void TraceRayAgainstLeafAndEntityList( const Ray_t &ray, CTraceListData &traceData, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
+	{
+		m_pEngineTrace->TraceRayAgainstLeafAndEntityList( ray, traceData, fMask, pTraceFilter, pTrace );
+	}
+	virtual void SweepCollideable( ICollideable *pCollide, const Vector &vecAbsStart, const Vector &vecAbsEnd,
+		const QAngle &vecAngles, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
+	{
+		m_pEngineTrace->SweepCollideable( pCollide, vecAbsStart, vecAbsEnd, vecAngles, fMask, pTraceFilter, pTrace );
+	}
+	virtual void EnumerateEntities( const Ray_t &ray, bool triggers, IEntityEnumerator *pEnumerator )
+	{
+		m_pEngineTrace->EnumerateEntities( ray, triggers, pEnumerator );
+	}
+	virtual void EnumerateEntities( const Vector &vecAbsMins, const Vector &vecAbsMaxs, IEntityEnumerator *pEnumerator )
+	{
+		m_pEngineTrace->EnumerateEntities( vecAbsMins, vecAbsMaxs, pEnumerator );
+	}
+	virtual ICollideable *GetCollideable( IHandleEntity *pEntity )
+	{
+		return m_pEngineTrace->GetCollideable( pEntity );
+	}
+	virtual int GetStatByIndex( int index, bool bClear )
+	{
+		return m_pEngineTrace->GetStatByIndex( index, bClear );
+	}
+	virtual void GetBrushesInAABB( const Vector &vMins, const Vector &vMaxs, CUtlVector<int> *pOutput, int iContentsMask = 0xFFFFFFFF )
+	{
+		m_pEngineTrace->GetBrushesInAABB( vMins, vMaxs, pOutput, iContentsMask );
+	}
+	virtual CPhysCollide* GetCollidableFromDisplacementsInAABB( const Vector& vMins, const Vector& vMaxs )
+	{
+		return m_pEngineTrace->GetCollidableFromDisplacementsInAABB( vMins, vMaxs );
+	}
+	virtual bool GetBrushInfo( int iBrush, CUtlVector<Vector4D> *pPlanesOut, int *pContentsOut )
+	{
+		return m_pEngineTrace->GetBrushInfo( iBrush, pPlanesOut, pContentsOut );
+	}
+	virtual bool PointOutsideWorld( const Vector &ptTest )
+	{
+		return m_pEngineTrace->PointOutsideWorld( ptTest );
+	}
+	virtual int GetLeafContainingPoint( const Vector &ptTest )
+	{
+		return m_pEngineTrace->GetLeafContainingPoint( ptTest );
+	}
+
+private:
+	const MovementQuery_t *NextQuery( int nType );
+
+	Mode_t			m_Mode;
+	IEngineTrace	*m_pEngineTrace;
+
+	const MovementQuery_t	*m_pQueries;
+	int						m_nQueries;
+	int						m_iNextQuery;
+	bool					m_bDiverged;
+};
+
+static CMovementTraceProxy s_TraceProxy;
+
+static bool IsSameVector( const Vector &a, const Vector &b )
+{
+	return !V_memcmp( &a, &b, sizeof( Vector ) );
+}
+
+static CBaseEntity *EntityForRecordedIndex( int iEntity )
+{
+	if ( iEntity < 0 )
+		return NULL;
+
+	// whatever was hit may be gone; the world keeps ground checks working
+	CBaseEntity *pEntity = CBaseEntity::Instance( iEntity );
+	return pEntity ? pEntity : GetWorldEntity();
+}
+
+const MovementQuery_t *CMovementTraceProxy::NextQuery( int nType )
+{
+	if ( m_Mode != MODE_REPLAY_TRACES || m_bDiverged )
+		return NULL;
+
+	if ( m_iNextQuery >= m_nQueries || m_pQueries[m_iNextQuery].m_nType != nType )
+	{
+		m_bDiverged = true;
+		return NULL;
+	}
+
+	return &m_pQueries[m_iNextQuery++];
+}
+
+int CMovementTraceProxy::GetPointContents( const Vector &vecAbsPosition, IHandleEntity** ppEntity )
+{
+	if ( m_Mode == MODE_RECORD )
+	{
+		int nContents = m_pEngineTrace->GetPointContents( vecAbsPosition, ppEntity );
+
+		MovementQuery_t &query = s_Recording.m_Queries[ s_Recording.m_Queries.AddToTail() ];
+		V_memset( &query, 0, sizeof( query ) );
+		query.m_nType = MOVEMENT_QUERY_CONTENTS;
+		query.m_vecStart = vecAbsPosition;
+		query.m_nContents = nContents;
+		query.m_iEntity = -1;
+		return nContents;
+	}
+
+	if ( ppEntity )
+	{
+		*ppEntity = NULL;
+	}
+
+	const MovementQuery_t *pQuery = NextQuery( MOVEMENT_QUERY_CONTENTS );
+	if ( pQuery && IsSameVector( pQuery->m_vecStart, vecAbsPosition ) )
+		return pQuery->m_nContents;
+
+	if ( pQuery )
+	{
+		m_bDiverged = true;
+	}
+	return m_BrushCollision.GetPointContents( vecAbsPosition );
+}
+
+void CMovementTraceProxy::TraceRay( const Ray_t &ray, unsigned int fMask, ITraceFilter *pTraceFilter, trace_t *pTrace )
+{
+	if ( m_Mode == MODE_RECORD )
+	{
+		m_pEngineTrace->TraceRay( ray, fMask, pTraceFilter, pTrace );
+
+		MovementQuery_t &query = s_Recording.m_Queries[ s_Recording.m_Queries.AddToTail() ];
+		V_memset( &query, 0, sizeof( query ) );
+		query.m_nType = MOVEMENT_QUERY_TRACE;
+		query.m_fMask = fMask;
+		query.m_vecStart = ray.m_Start;
+		query.m_vecDelta = ray.m_Delta;
+		query.m_vecStartOffset = ray.m_StartOffset;
+		query.m_vecExtents = ray.m_Extents;
+		query.m_bIsRay = ray.m_IsRay;
+		query.m_bIsSwept = ray.m_IsSwept;
+		query.m_bAllSolid = pTrace->allsolid;
+		query.m_bStartSolid = pTrace->startsolid;
+		query.m_nContents = pTrace->contents;
+		query.m_vecStartPos = pTrace->startpos;
+		query.m_vecEndPos = pTrace->endpos;
+		query.m_vecPlaneNormal = pTrace->plane.normal;
+		query.m_flPlaneDist = pTrace->plane.dist;
+		query.m_nPlaneType = pTrace->plane.type;
+		query.m_nPlaneSignBits = pTrace->plane.signbits;
+		query.m_nDispFlags = pTrace->dispFlags;
+		query.m_flFraction = pTrace->fraction;
+		query.m_flFractionLeftSolid = pTrace->fractionleftsolid;
+		query.m_nSurfaceProps = pTrace->surface.surfaceProps;
+		query.m_nSurfaceFlags = pTrace->surface.flags;
+		query.m_nHitGroup = pTrace->hitgroup;
+		query.m_nPhysicsBone = pTrace->physicsbone;
+		query.m_nHitbox = pTrace->hitbox;
+		query.m_iEntity = pTrace->m_pEnt ? pTrace->m_pEnt->entindex() : -1;
+		return;
+	}
+
+	const MovementQuery_t *pQuery = NextQuery( MOVEMENT_QUERY_TRACE );
+	if ( pQuery && ( pQuery->m_fMask != fMask || pQuery->m_bIsRay != ray.m_IsRay ||
+		 !IsSameVector( pQuery->m_vecStart, ray.m_Start ) || !IsSameVector( pQuery->m_vecDelta, ray.m_Delta ) ||
+		 !IsSameVector( pQuery->m_vecExtents, ray.m_Extents ) ) )
+	{
+		m_bDiverged = true;
+		pQuery = NULL;
+	}
+
+	if ( !pQuery )
+	{
+		m_BrushCollision.TraceRay( ray, fMask, pTrace );
+		return;
+	}
+
+	pTrace->startpos = pQuery->m_vecStartPos;
+	pTrace->endpos = pQuery->m_vecEndPos;
+	pTrace->plane.normal = pQuery->m_vecPlaneNormal;
+	pTrace->plane.dist = pQuery->m_flPlaneDist;
+	pTrace->plane.type = pQuery->m_nPlaneType;
+	pTrace->plane.signbits = pQuery->m_nPlaneSignBits;
+	pTrace->plane.pad[0] = pTrace->plane.pad[1] = 0;
+	pTrace->fraction = pQuery->m_flFraction;
+	pTrace->contents = pQuery->m_nContents;
+	pTrace->dispFlags = pQuery->m_nDispFlags;
+	pTrace->allsolid = pQuery->m_bAllSolid;
+	pTrace->startsolid = pQuery->m_bStartSolid;
+	pTrace->fractionleftsolid = pQuery->m_flFractionLeftSolid;
+	pTrace->surface.name = "**replay**";
+	pTrace->surface.surfaceProps = pQuery->m_nSurfaceProps;
+	pTrace->surface.flags = pQuery->m_nSurfaceFlags;
+	pTrace->hitgroup = pQuery->m_nHitGroup;
+	pTrace->physicsbone = pQuery->m_nPhysicsBone;
+	pTrace->hitbox = pQuery->m_nHitbox;
+	pTrace->m_pEnt = EntityForRecordedIndex( pQuery->m_iEntity );
+}
+
+
+//-----------------------------------------------------------------------------
+// Keeps replayed moves from playing sounds, hurting the player or touching
+// triggers
+//-----------------------------------------------------------------------------
+class CReplayMoveHelper : public IMoveHelper
+{
+public:
+	void Install()
+	{
+		m_pMoveHelper = MoveHelper();
+		SetSingleton( this );
+	}
+
+	void Uninstall()
+	{
+		SetSingleton( m_pMoveHelper );
+	}
+
+	virtual	char const *GetName( EntityHandle_t handle ) const	{ return m_pMoveHelper->GetName( handle ); }
+	virtual void ResetTouchList( void )								{}
+	virtual bool AddToTouched( const CGameTrace& tr, const Vector& impactvelocity ) { return true; }
+	virtual void ProcessImpacts( void )								{}
+	virtual void Con_NPrintf( int idx, char const* fmt, ... )		{}
+	virtual void StartSound( const Vector& origin, int channel, char const* sample, float volume, soundlevel_t soundlevel, int fFlags, int pitch ) {}
+	virtual void StartSound( const Vector& origin, const char *soundname ) {}
+	virtual void PlaybackEventFull( int flags, int clientindex, unsigned short eventindex, float delay, Vector& origin, Vector& angles, float fparam1, float fparam2, int iparam1, int iparam2, int bparam1, int bparam2 ) {}
+	virtual bool PlayerFallingDamage( void )						{ return true; }
+	virtual void PlayerSetAnimation( PLAYER_ANIM playerAnim )		{}
+	virtual IPhysicsSurfaceProps *GetSurfaceProps( void )			{ return m_pMoveHelper->GetSurfaceProps(); }
+	virtual bool IsWorldEntity( const CBaseHandle &handle )			{ return m_pMoveHelper->IsWorldEntity( handle ); }
+	virtual void SetHost( CBasePlayer *host )						{}
+
+private:
+	IMoveHelper *m_pMoveHelper;
+};
+
+static CReplayMoveHelper s_ReplayMoveHelper;
+
+
+//-----------------------------------------------------------------------------
+// Player state
+//-----------------------------------------------------------------------------
+void CMovementRecorder::SavePlayerState( CBasePlayer *pPlayer, MovementPlayerState_t &state )
+{
+	// zeroed so padding compares equal too
+	V_memset( &state, 0, sizeof( state ) );
+
+	CBaseEntity *pGround = pPlayer->GetGroundEntity();
+
+	state.m_fFlags = pPlayer->GetFlags();
+	state.m_nMoveType = pPlayer->GetMoveType();
+	state.m_nMoveCollide = pPlayer->GetMoveCollide();
+	state.m_nWaterLevel = pPlayer->GetWaterLevel();
+	state.m_nWaterType = pPlayer->GetWaterType();
+	state.m_iGroundEntity = pGround ? pGround->entindex() : -1;
+	state.m_nTickBase = pPlayer->m_nTickBase;
+	state.m_vecBaseVelocity = pPlayer->GetBaseVelocity();
+	state.m_vecViewOffset = pPlayer->GetViewOffset();
+	state.m_flGravity = pPlayer->GetGravity();
+	state.m_flFriction = pPlayer->GetFriction();
+	state.m_flMaxSpeed = pPlayer->MaxSpeed();
+	state.m_flDucktime = pPlayer->m_Local.m_flDucktime;
+	state.m_flDuckJumpTime = pPlayer->m_Local.m_flDuckJumpTime;
+	state.m_flJumpTime = pPlayer->m_Local.m_flJumpTime;
+	state.m_flFallVelocity = pPlayer->m_Local.m_flFallVelocity;
+	state.m_flStepSize = pPlayer->m_Local.m_flStepSize;
+	state.m_vecPunchAngle = pPlayer->m_Local.m_vecPunchAngle;
+	state.m_vecPunchAngleVel = pPlayer->m_Local.m_vecPunchAngleVel;
+	state.m_flWaterJumpTime = pPlayer->m_flWaterJumpTime;
+	state.m_vecWaterJumpVel = pPlayer->m_vecWaterJumpVel;
+	state.m_flSwimSoundTime = pPlayer->m_flSwimSoundTime;
+	state.m_vecLadderNormal = pPlayer->m_vecLadderNormal;
+	state.m_flStepSoundTime = pPlayer->m_flStepSoundTime;
+	state.m_surfaceFriction = pPlayer->m_surfaceFriction;
+	state.m_surfaceProps = pPlayer->m_surfaceProps;
+	state.m_StuckLast = pPlayer->m_StuckLast;
+	state.m_nNumCrouches = pPlayer->m_nNumCrouches;
+	state.m_chTextureType = pPlayer->m_chTextureType;
+	state.m_chPreviousTextureType = pPlayer->m_chPreviousTextureType;
+	state.m_bHasSurfaceData = pPlayer->m_pSurfaceData != NULL;
+	state.m_bDucked = pPlayer->m_Local.m_bDucked;
+	state.m_bDucking = pPlayer->m_Local.m_bDucking;
+	state.m_bInDuckJump = pPlayer->m_Local.m_bInDuckJump;
+	state.m_bAllowAutoMovement = pPlayer->m_Local.m_bAllowAutoMovement;
+	state.m_bSlowMovement = pPlayer->m_Local.m_bSlowMovement;
+	state.m_nButtons = pPlayer->m_nButtons;
+
+#ifdef TF_DLL
+	CTFPlayer *pTFPlayer = ToTFPlayer( pPlayer );
+	if ( pTFPlayer )
+	{
+		const CTFPlayerShared &shared = pTFPlayer->m_Shared;
+		state.m_nPlayerCond[0] = shared.m_nPlayerCond;
+		state.m_nPlayerCond[1] = shared.m_nPlayerCondEx;
+		state.m_nPlayerCond[2] = shared.m_nPlayerCondEx2;
+		state.m_nPlayerCond[3] = shared.m_nPlayerCondEx3;
+		state.m_nPlayerCond[4] = shared.m_nPlayerCondEx4;
+		state.m_iAirDash = shared.m_iAirDash;
+		state.m_nAirDucked = shared.m_nAirDucked;
+		state.m_iStunFlags = shared.m_iStunFlags;
+		state.m_iMovementStunAmount = shared.m_iMovementStunAmount;
+		state.m_flStunLerpTarget = shared.m_flStunLerpTarget;
+		state.m_flLastMovementStunChange = shared.m_flLastMovementStunChange;
+		state.m_flChargeMeter = shared.m_flChargeMeter;
+		state.m_flHypeMeter = shared.m_flHypeMeter;
+		state.m_bJumping = shared.m_bJumping;
+		state.m_bStunNeedsFadeOut = shared.m_bStunNeedsFadeOut;
+
+		const stun_struct_t *pStun = shared.GetActiveStunInfo();
+		if ( pStun )
+		{
+			state.m_bHasActiveStun = true;
+			state.m_iActiveStunFlags = pStun->iStunFlags;
+			state.m_flActiveStunAmount = pStun->flStunAmount;
+			state.m_flActiveStunExpireTime = pStun->flExpireTime;
+		}
+
+		state.m_bTakenBlastDamageSinceLastMovement = pTFPlayer->m_bTakenBlastDamageSinceLastMovement;
+		state.m_iKartState = pTFPlayer->m_iKartState;
+		state.m_flTauntYaw = pTFPlayer->m_flTauntYaw;
+		state.m_flCurrentTauntMoveSpeed = pTFPlayer->m_flCurrentTauntMoveSpeed;
+		state.m_flVehicleReverseTime = pTFPlayer->m_flVehicleReverseTime;
+		state.m_flWaterExitTime = pTFPlayer->m_flWaterExitTime;
+	}
+#endif
+}
+
+void CMovementRecorder::RestorePlayerState( CBasePlayer *pPlayer, const MovementPlayerState_t &state )
+{
+	pPlayer->ClearFlags();
+	pPlayer->AddFlag( state.m_fFlags );
+	pPlayer->SetMoveType( (MoveType_t)state.m_nMoveType, (MoveCollide_t)state.m_nMoveCollide );
+	pPlayer->SetWaterLevel( state.m_nWaterLevel );
+	pPlayer->SetWaterType( state.m_nWaterType );
+	pPlayer->SetGroundEntity( EntityForRecordedIndex( state.m_iGroundEntity ) );
+	pPlayer->m_nTickBase = state.m_nTickBase;
+	pPlayer->SetBaseVelocity( state.m_vecBaseVelocity );
+	pPlayer->SetViewOffset( state.m_vecViewOffset );
+	pPlayer->SetGravity( state.m_flGravity );
+	pPlayer->SetFriction( state.m_flFriction );
+	pPlayer->SetMaxSpeed( state.m_flMaxSpeed );
+	pPlayer->m_Local.m_flDucktime = state.m_flDucktime;
+	pPlayer->m_Local.m_flDuckJumpTime = state.m_flDuckJumpTime;
+	pPlayer->m_Local.m_flJumpTime = state.m_flJumpTime;
+	pPlayer->m_Local.m_flFallVelocity = state.m_flFallVelocity;
+	pPlayer->m_Local.m_flStepSize = state.m_flStepSize;
+	pPlayer->m_Local.m_vecPunchAngle = state.m_vecPunchAngle;
+	pPlayer->m_Local.m_vecPunchAngleVel = state.m_vecPunchAngleVel;
+	pPlayer->m_flWaterJumpTime = state.m_flWaterJumpTime;
+	pPlayer->m_vecWaterJumpVel = state.m_vecWaterJumpVel;
+	pPlayer->m_flSwimSoundTime = state.m_flSwimSoundTime;
+	pPlayer->m_vecLadderNormal = state.m_vecLadderNormal;
+	pPlayer->m_flStepSoundTime = state.m_flStepSoundTime;
+	pPlayer->m_surfaceFriction = state.m_surfaceFriction;
+	pPlayer->m_surfaceProps = state.m_surfaceProps;
+	pPlayer->m_pSurfaceData = state.m_bHasSurfaceData ? physprops->GetSurfaceData( state.m_surfaceProps ) : NULL;
+	pPlayer->m_StuckLast = state.m_StuckLast;
+	pPlayer->m_nNumCrouches = state.m_nNumCrouches;
+	pPlayer->m_chTextureType = state.m_chTextureType;
+	pPlayer->m_chPreviousTextureType = state.m_chPreviousTextureType;
+	pPlayer->m_Local.m_bDucked = state.m_bDucked;
+	pPlayer->m_Local.m_bDucking = state.m_bDucking;
+	pPlayer->m_Local.m_bInDuckJump = state.m_bInDuckJump;
+	pPlayer->m_Local.m_bAllowAutoMovement = state.m_bAllowAutoMovement;
+	pPlayer->m_Local.m_bSlowMovement = state.m_bSlowMovement;
+	pPlayer->m_nButtons = state.m_nButtons;
+
+#ifdef TF_DLL
+	// Written raw, the condition callbacks would reach outside the player
+	CTFPlayer *pTFPlayer = ToTFPlayer( pPlayer );
+	if ( pTFPlayer )
+	{
+		CTFPlayerShared &shared = pTFPlayer->m_Shared;
+		shared.m_nPlayerCond = state.m_nPlayerCond[0];
+		shared.m_nPlayerCondEx = state.m_nPlayerCond[1];
+		shared.m_nPlayerCondEx2 = state.m_nPlayerCond[2];
+		shared.m_nPlayerCondEx3 = state.m_nPlayerCond[3];
+		shared.m_nPlayerCondEx4 = state.m_nPlayerCond[4];
+		shared.m_iAirDash = state.m_iAirDash;
+		shared.m_nAirDucked = state.m_nAirDucked;
+		shared.m_iStunFlags = state.m_iStunFlags;
+		shared.m_iMovementStunAmount = state.m_iMovementStunAmount;
+		shared.m_flStunLerpTarget = state.m_flStunLerpTarget;
+		shared.m_flLastMovementStunChange = state.m_flLastMovementStunChange;
+		shared.m_flChargeMeter = state.m_flChargeMeter;
+		shared.m_flHypeMeter = state.m_flHypeMeter;
+		shared.m_bJumping = state.m_bJumping;
+		shared.m_bStunNeedsFadeOut = state.m_bStunNeedsFadeOut;
+
+		shared.m_PlayerStuns.RemoveAll();
+		shared.m_iStunIndex = -1;
+		if ( state.m_bHasActiveStun )
+		{
+			stun_struct_t stun;
+			V_memset( &stun, 0, sizeof( stun ) );
+			stun.iStunFlags = state.m_iActiveStunFlags;
+			stun.flStunAmount = state.m_flActiveStunAmount;
+			stun.flExpireTime = state.m_flActiveStunExpireTime;
+			shared.m_iStunIndex = shared.m_PlayerStuns.AddToTail( stun );
+		}
+
+		pTFPlayer->m_bTakenBlastDamageSinceLastMovement = state.m_bTakenBlastDamageSinceLastMovement;
+		pTFPlayer->m_iKartState = state.m_iKartState;
+		pTFPlayer->m_flTauntYaw = state.m_flTauntYaw;
+		pTFPlayer->m_flCurrentTauntMoveSpeed = state.m_flCurrentTauntMoveSpeed;
+		pTFPlayer->m_flVehicleReverseTime = state.m_flVehicleReverseTime;
+		pTFPlayer->m_flWaterExitTime = state.m_flWaterExitTime;
+	}
+#endif
+}
+
+// Returns the name of the first output that differs, or NULL if the move matched bit for bit
+static const char *CompareMoveOutput( const CMoveData &a, const CMoveData &b )
+{
+#define COMPARE_MOVE_FIELD( field ) \
+	if ( V_memcmp( &a.field, &b.field, sizeof( a.field ) ) ) \
+		return #field;
+
+	COMPARE_MOVE_FIELD( GetAbsOrigin() );
+	COMPARE_MOVE_FIELD( m_vecVelocity );
+	COMPARE_MOVE_FIELD( m_vecAngles );
+	COMPARE_MOVE_FIELD( m_vecViewAngles );
+	COMPARE_MOVE_FIELD( m_nButtons );
+	COMPARE_MOVE_FIELD( m_nOldButtons );
+	COMPARE_MOVE_FIELD( m_flForwardMove );
+	COMPARE_MOVE_FIELD( m_flSideMove );
+	COMPARE_MOVE_FIELD( m_flUpMove );
+	COMPARE_MOVE_FIELD( m_flMaxSpeed );
+	COMPARE_MOVE_FIELD( m_outStepHeight );
+	COMPARE_MOVE_FIELD( m_outWishVel );
+	COMPARE_MOVE_FIELD( m_outJumpVel );
+
+#undef COMPARE_MOVE_FIELD
+
+	if ( a.m_bGameCodeMovedPlayer != b.m_bGameCodeMovedPlayer )
+		return "m_bGameCodeMovedPlayer";
+
+	return NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+// CMovementRecorder
+//-----------------------------------------------------------------------------
+CMovementRecorder::CMovementRecorder()
+{
+	m_bRecording = false;
+	m_bInMove = false;
+	m_bReplaying = false;
+	m_nUserID = 0;
+}
+
+static char s_szRecordingFileName[MAX_PATH];
+
+void CMovementRecorder::StartRecording( const char *pFileName, int nUserID )
+{
+	if ( m_bRecording )
+	{
+		StopRecording();
+	}
+
+	V_strncpy( s_szRecordingFileName, pFileName, sizeof( s_szRecordingFileName ) );
+	V_DefaultExtension( s_szRecordingFileName, ".mvr", sizeof( s_szRecordingFileName ) );
+
+	s_Recording.Clear();
+	V_strncpy( s_Recording.m_szMapName, STRING( gpGlobals->mapname ), sizeof( s_Recording.m_szMapName ) );
+	s_Recording.CaptureWorldBrushes();
+
+	m_nUserID = nUserID;
+	m_bRecording = true;
+
+	Msg( "Recording movement to %s (%d world brushes)\n", s_szRecordingFileName, s_Recording.m_Brushes.Count() );
+}
+
+void CMovementRecorder::StopRecording()
+{
+	if ( !m_bRecording )
+		return;
+
+	Assert( !m_bInMove );
+	m_bRecording = false;
+
+	if ( s_Recording.Write( s_szRecordingFileName ) )
+	{
+		Msg( "Wrote %d moves and %d collision queries to %s\n", s_Recording.m_Moves.Count(), s_Recording.m_Queries.Count(), s_szRecordingFileName );
+	}
+	else
+	{
+		Warning( "Couldn't write movement recording %s\n", s_szRecordingFileName );
+	}
+
+	s_Recording.Clear();
+}
+
+void CMovementRecorder::BeginMove( CBasePlayer *pPlayer, const CMoveData *pMove )
+{
+	if ( m_nUserID && pPlayer->GetUserID() != m_nUserID )
+		return;
+
+	MovementRecord_t &move = s_Recording.m_Moves[ s_Recording.m_Moves.AddToTail() ];
+	move.m_nTick = gpGlobals->tickcount;
+	move.m_flCurTime = gpGlobals->curtime;
+	move.m_flFrameTime = gpGlobals->frametime;
+	move.m_iPlayer = pPlayer->entindex();
+	move.m_iFirstQuery = s_Recording.m_Queries.Count();
+	move.m_MoveIn = *pMove;
+	SavePlayerState( pPlayer, move.m_StateIn );
+
+	s_TraceProxy.Install( CMovementTraceProxy::MODE_RECORD );
+	m_bInMove = true;
+}
+
+void CMovementRecorder::EndMove( CBasePlayer *pPlayer, const CMoveData *pMove )
+{
+	if ( !m_bInMove )
+		return;
+
+	s_TraceProxy.Uninstall();
+	m_bInMove = false;
+
+	MovementRecord_t &move = s_Recording.m_Moves.Tail();
+	move.m_nQueries = s_Recording.m_Queries.Count() - move.m_iFirstQuery;
+	move.m_MoveOut = *pMove;
+	SavePlayerState( pPlayer, move.m_StateOut );
+
+	if ( s_Recording.m_Moves.Count() >= sv_movement_record_maxmoves.GetInt() )
+	{
+		StopRecording();
+	}
+}
+
+void CMovementRecorder::Replay( CBasePlayer *pPlayer, const char *pFileName, bool bBrushCollision, int nIterations )
+{
+	if ( m_bRecording )
+	{
+		Warning( "Can't replay movement while recording\n" );
+		return;
+	}
+
+	char szFileName[MAX_PATH];
+	V_strncpy( szFileName, pFileName, sizeof( szFileName ) );
+	V_DefaultExtension( szFileName, ".mvr", sizeof( szFileName ) );
+
+	CMovementRecording *pRecording = new CMovementRecording;
+	if ( !pRecording->Read( szFileName ) )
+	{
+		delete pRecording;
+		return;
+	}
+
+	if ( V_stricmp( pRecording->m_szMapName, STRING( gpGlobals->mapname ) ) )
+	{
+		Warning( "%s was recorded on %s; entities it touched won't match\n", szFileName, pRecording->m_szMapName );
+	}
+
+	// everything the replay touches gets put back afterwards
+	MovementPlayerState_t savedState;
+	SavePlayerState( pPlayer, savedState );
+	Vector vecSavedOrigin = pPlayer->GetAbsOrigin();
+	Vector vecSavedVelocity = pPlayer->GetAbsVelocity();
+	float flSavedCurTime = gpGlobals->curtime;
+	float flSavedFrameTime = gpGlobals->frametime;
+	int nSavedTickCount = gpGlobals->tickcount;
+
+#ifdef TF_DLL
+	TFReplayPlayerSnapshot_t snapshot;
+	CTFPlayer *pTFPlayer = ToTFPlayer( pPlayer );
+	if ( pTFPlayer )
+	{
+		snapshot.m_ConditionData = pTFPlayer->m_Shared.m_ConditionData;
+		snapshot.m_ConditionProviders = pTFPlayer->m_Shared.m_ConditionProviders;
+		snapshot.m_PlayerStuns = pTFPlayer->m_Shared.m_PlayerStuns;
+		snapshot.m_iStunIndex = pTFPlayer->m_Shared.m_iStunIndex;
+	}
+#endif
+
+	m_bReplaying = true;
+	s_TraceProxy.m_BrushCollision.Init( pRecording );
+	s_TraceProxy.Install( bBrushCollision ? CMovementTraceProxy::MODE_REPLAY_BRUSHES : CMovementTraceProxy::MODE_REPLAY_TRACES );
+	s_ReplayMoveHelper.Install();
+
+	int nMismatches = 0;
+	int nDiverged = 0;
+	CCycleCount totalTime;
+	CMoveData move;
+	MovementPlayerState_t stateOut;
+
+	for ( int iIteration = 0; iIteration < nIterations; iIteration++ )
+	{
+		for ( int i = 0; i < pRecording->m_Moves.Count(); i++ )
+		{
+			const MovementRecord_t &record = pRecording->m_Moves[i];
+
+			gpGlobals->curtime = record.m_flCurTime;
+			gpGlobals->frametime = record.m_flFrameTime;
+			gpGlobals->tickcount = record.m_nTick;
+
+			RestorePlayerState( pPlayer, record.m_StateIn );
+			move = record.m_MoveIn;
+			move.m_nPlayerHandle = pPlayer;
+			s_TraceProxy.SetQueries( pRecording->m_Queries.Base() + record.m_iFirstQuery, record.m_nQueries );
+
+			CFastTimer timer;
+			timer.Start();
+			g_pGameMovement->ProcessMovement( pPlayer, &move );
+			timer.End();
+			totalTime += timer.GetDuration();
+
+			if ( iIteration )
+				continue;
+
+			if ( s_TraceProxy.Diverged() )
+			{
+				nDiverged++;
+			}
+
+			SavePlayerState( pPlayer, stateOut );
+			const char *pMismatch = CompareMoveOutput( move, record.m_MoveOut );
+			if ( !pMismatch && V_memcmp( &stateOut, &record.m_StateOut, sizeof( stateOut ) ) )
+			{
+				pMismatch = "player state";
+			}
+
+			if ( pMismatch && nMismatches++ < MOVEMENT_REPLAY_MAX_REPORTS )
+			{
+				Msg( "move %d (tick %d, player %d): %s differs\n", i, record.m_nTick, record.m_iPlayer, pMismatch );
+			}
+		}
+	}
+
+	s_ReplayMoveHelper.Uninstall();
+	s_TraceProxy.Uninstall();
+	m_bReplaying = false;
+
+	gpGlobals->curtime = flSavedCurTime;
+	gpGlobals->frametime = flSavedFrameTime;
+	gpGlobals->tickcount = nSavedTickCount;
+	RestorePlayerState( pPlayer, savedState );
+	pPlayer->SetAbsOrigin( vecSavedOrigin );
+	pPlayer->SetAbsVelocity( vecSavedVelocity );
+
+#ifdef TF_DLL
+	if ( pTFPlayer )
+	{
+		pTFPlayer->m_Shared.m_ConditionData = snapshot.m_ConditionData;
+		pTFPlayer->m_Shared.m_ConditionProviders = snapshot.m_ConditionProviders;
+		pTFPlayer->m_Shared.m_PlayerStuns = snapshot.m_PlayerStuns;
+		pTFPlayer->m_Shared.m_iStunIndex = snapshot.m_iStunIndex;
+		pTFPlayer->TeamFortress_SetSpeed();
+	}
+#endif
+
+	int nMoves = pRecording->m_Moves.Count();
+	Msg( "Replayed %d moves x %d using %s: %.2f usec per move\n", nMoves, nIterations,
+		bBrushCollision ? "brush collision" : "recorded traces",
+		nMoves ? totalTime.GetMicrosecondsF() / ( nMoves * nIterations ) : 0.0 );
+	Msg( "%d moves differ from the recording, %d made different collision queries\n", nMismatches, nDiverged );
+
+	delete pRecording;
+}
+
+
+//-----------------------------------------------------------------------------
+// Commands
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( sv_movement_record, "Record player movement: sv_movement_record <file> [userid]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: sv_movement_record <file> [userid]\n" );
+		return;
+	}
+
+	g_MovementRecorder.StartRecording( args[1], ( args.ArgC() > 2 ) ? atoi( args[2] ) : 0 );
+}
+
+CON_COMMAND( sv_movement_record_stop, "Stop recording player movement and write it out" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	g_MovementRecorder.StopRecording();
+}
+
+CON_COMMAND_F( sv_movement_replay, "Replay a movement recording through the movement code on the calling (or first) player: sv_movement_replay <file> [traces|brushes] [iterations]", FCVAR_CHEAT )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: sv_movement_replay <file> [traces|brushes] [iterations]\n" );
+		return;
+	}
+
+	CBasePlayer *pPlayer = UTIL_GetCommandClient();
+	for ( int i = 1; !pPlayer && i <= gpGlobals->maxClients; i++ )
+	{
+		pPlayer = UTIL_PlayerByIndex( i );
+	}
+
+	if ( !pPlayer )
+	{
+		Msg( "sv_movement_replay needs a player to run the moves on\n" );
+		return;
+	}
+
+	bool bBrushCollision = ( args.ArgC() > 2 ) && !V_stricmp( args[2], "brushes" );
+	int nIterations = ( args.ArgC() > 3 ) ? MAX( 1, atoi( args[3] ) ) : 1;
+	g_MovementRecorder.Replay( pPlayer, args[1], bBrushCollision, nIterations );
+}
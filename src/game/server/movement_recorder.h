@@ -0,0 +1,61 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Records the inputs, outputs and collision queries of player movement so
+//			that usercmds can be replayed through the movement code outside of a live
+//			game, for profiling and for catching changes that would affect prediction.
+//
+//			sv_movement_record <file> [userid]	- start recording every usercmd
+//			sv_movement_record_stop				- write the recording out
+//			sv_movement_replay <file> [traces|brushes] [iterations]
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef MOVEMENT_RECORDER_H
+#define MOVEMENT_RECORDER_H
+
+#ifdef _WIN32
+#pragma once
+#endif
+
+class CBasePlayer;
+class CMoveData;
+struct MovementPlayerState_t;
+
+
+//-----------------------------------------------------------------------------
+// Hooks around the ProcessMovement call in CPlayerMove::RunCommand
+//-----------------------------------------------------------------------------
+class CMovementRecorder
+{
+public:
+	CMovementRecorder();
+
+	bool IsRecording() const { return m_bRecording; }
+
+	// Movement code checks this to skip sounds, speech, events and anything else
+	// that would reach outside the player while a replay reruns old moves on it
+	bool IsReplaying() const { return m_bReplaying; }
+
+	void BeginMove( CBasePlayer *pPlayer, const CMoveData *pMove );
+	void EndMove( CBasePlayer *pPlayer, const CMoveData *pMove );
+
+	void StartRecording( const char *pFileName, int nUserID );
+	void StopRecording();
+
+	void Replay( CBasePlayer *pPlayer, const char *pFileName, bool bBrushCollision, int nIterations );
+
+private:
+	static void SavePlayerState( CBasePlayer *pPlayer, MovementPlayerState_t &state );
+	static void RestorePlayerState( CBasePlayer *pPlayer, const MovementPlayerState_t &state );
+
+	bool	m_bRecording;
+	bool	m_bInMove;
+	bool	m_bReplaying;
+	int		m_nUserID;		// 0 records every player
+};
+
+extern CMovementRecorder g_MovementRecorder;
+
+
+#endif // MOVEMENT_RECORDER_H
@@ -3552,6 +3552,250 @@ void CNavArea::ClearSearchLists( void )
 	m_openListTail = NULL;
 }
 
+
+//--------------------------------------------------------------------------------------------------------------
+//--------------------------------------------------------------------------------------------------------------
+static CTHREADLOCALPTR( CNavSearchContext ) s_activeNavSearchContext;
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext &TheNavSearchContext( void )
+{
+	Assert( ThreadInMainThread() );
+
+	static CNavSearchContext mainThreadContext;
+	return mainThreadContext;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::CNavSearchContext( void )
+{
+	m_openQueueHead = 0;
+	m_searchMarker = 1;
+	m_openSequence = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Clears the open and closed sets for a new search
+ */
+void CNavSearchContext::Reset( void )
+{
+	++m_searchMarker;
+	if ( m_searchMarker == 0 )
+	{
+		// marker wrapped - scrub stale markers so old data can't alias the new search
+		FOR_EACH_VEC( m_scratch, it )
+		{
+			m_scratch[ it ].m_touchMarker = 0;
+			m_scratch[ it ].m_marker = 0;
+			m_scratch[ it ].m_openMarker = 0;
+		}
+		m_searchMarker = 1;
+	}
+
+	m_touched.RemoveAll();
+	m_openHeap.RemoveAll();
+	m_openQueue.RemoveAll();
+	m_openQueueHead = 0;
+	m_openSequence = 0;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavSearchContext::HeapSiftUp( int index )
+{
+	OpenEntry entry = m_openHeap[ index ];
+
+	while( index > 0 )
+	{
+		int parent = ( index - 1 ) / 2;
+		if ( !( entry < m_openHeap[ parent ] ) )
+			break;
+
+		m_openHeap[ index ] = m_openHeap[ parent ];
+		m_scratch[ m_openHeap[ index ].m_area->GetID() ].m_heapIndex = index;
+		index = parent;
+	}
+
+	m_openHeap[ index ] = entry;
+	m_scratch[ entry.m_area->GetID() ].m_heapIndex = index;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavSearchContext::HeapSiftDown( int index )
+{
+	OpenEntry entry = m_openHeap[ index ];
+	int count = m_openHeap.Count();
+
+	while( true )
+	{
+		int child = 2 * index + 1;
+		if ( child >= count )
+			break;
+
+		if ( child + 1 < count && m_openHeap[ child + 1 ] < m_openHeap[ child ] )
+			++child;
+
+		if ( !( m_openHeap[ child ] < entry ) )
+			break;
+
+		m_openHeap[ index ] = m_openHeap[ child ];
+		m_scratch[ m_openHeap[ index ].m_area->GetID() ].m_heapIndex = index;
+		index = child;
+	}
+
+	m_openHeap[ index ] = entry;
+	m_scratch[ entry.m_area->GetID() ].m_heapIndex = index;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Add to open set in increasing total cost order. Areas of equal cost are served in insertion order.
+ */
+void CNavSearchContext::AddToOpenList( CNavArea *area )
+{
+	AreaScratch &scratch = Touch( area );
+	if ( scratch.m_openMarker == m_searchMarker )
+	{
+		// already on list
+		return;
+	}
+
+	scratch.m_openMarker = m_searchMarker;
+
+	OpenEntry entry;
+	entry.m_totalCost = scratch.m_totalCost;
+	entry.m_sequence = m_openSequence++;
+	entry.m_area = area;
+
+	int index = m_openHeap.AddToTail( entry );
+	HeapSiftUp( index );
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Add to the breadth-first queue. Queued areas are served in FIFO order once the cost-ordered set is empty.
+ */
+void CNavSearchContext::AddToOpenListTail( CNavArea *area )
+{
+	AreaScratch &scratch = Touch( area );
+	if ( scratch.m_openMarker == m_searchMarker )
+	{
+		// already on list
+		return;
+	}
+
+	scratch.m_openMarker = m_searchMarker;
+	scratch.m_heapIndex = -1;
+
+	m_openQueue.AddToTail( area );
+}
+
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * A smaller total cost has been found, move this area to its new place in the heap
+ */
+void CNavSearchContext::UpdateOnOpenList( CNavArea *area )
+{
+	AreaScratch &scratch = Touch( area );
+	Assert( scratch.m_openMarker == m_searchMarker );
+
+	if ( scratch.m_heapIndex < 0 )
+	{
+		// breadth-first entries are not ordered by cost
+		return;
+	}
+
+	OpenEntry &entry = m_openHeap[ scratch.m_heapIndex ];
+	Assert( scratch.m_totalCost <= entry.m_totalCost );
+
+	// the sorted list placed a re-costed area after any existing areas of equal cost
+	entry.m_totalCost = scratch.m_totalCost;
+	entry.m_sequence = m_openSequence++;
+
+	// A lower cost moves it up, but if the cost didn't change the new sequence number makes it
+	// order after its equal cost children, so it may have to move down instead
+	HeapSiftUp( scratch.m_heapIndex );
+	HeapSiftDown( scratch.m_heapIndex );
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavArea *CNavSearchContext::PopOpenList( void )
+{
+	CNavArea *area;
+
+	if ( m_openHeap.Count() )
+	{
+		area = m_openHeap[0].m_area;
+
+		int last = m_openHeap.Count() - 1;
+		if ( last > 0 )
+		{
+			m_openHeap[0] = m_openHeap[ last ];
+			m_openHeap.RemoveMultipleFromTail( 1 );
+			HeapSiftDown( 0 );
+		}
+		else
+		{
+			m_openHeap.RemoveAll();
+		}
+	}
+	else if ( m_openQueueHead < m_openQueue.Count() )
+	{
+		area = m_openQueue[ m_openQueueHead++ ];
+
+		if ( m_openQueueHead == m_openQueue.Count() )
+		{
+			// drained - reuse the storage from the front
+			m_openQueue.RemoveAll();
+			m_openQueueHead = 0;
+		}
+	}
+	else
+	{
+		return NULL;
+	}
+
+	AreaScratch &scratch = m_scratch[ area->GetID() ];
+	scratch.m_openMarker = 0;
+	scratch.m_heapIndex = -1;
+
+	return area;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+void CNavSearchContext::PublishToAreas( void ) const
+{
+	FOR_EACH_VEC( m_touched, it )
+	{
+		CNavArea *area = m_touched[ it ];
+		const AreaScratch &scratch = m_scratch[ area->GetID() ];
+
+		area->SetParent( scratch.m_parent, scratch.m_parentHow );
+		area->SetTotalCost( scratch.m_totalCost );
+		area->SetCostSoFar( scratch.m_costSoFar );
+		area->SetPathLengthSoFar( scratch.m_pathLengthSoFar );
+	}
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext *CNavSearchContext::GetActive( void )
+{
+	return s_activeNavSearchContext;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::CActiveScope::CActiveScope( CNavSearchContext *context )
+{
+	m_prior = s_activeNavSearchContext;
+	s_activeNavSearchContext = context;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+CNavSearchContext::CActiveScope::~CActiveScope()
+{
+	s_activeNavSearchContext = m_prior;
+}
+
 //--------------------------------------------------------------------------------------------------------------
 void CNavArea::SetCorner( NavCornerType corner, const Vector& newPosition )
 {
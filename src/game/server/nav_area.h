@@ -450,7 +450,7 @@ public:
 	float GetTotalCost( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_totalCost ); return m_totalCost; }
 
 	void SetCostSoFar( float value )	{ DebuggerBreakOnNaN_StagingOnly( value ); Assert( value >= 0.0 && !IS_NAN(value) ); m_costSoFar = value; }
-	float GetCostSoFar( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_costSoFar ); return m_costSoFar; }
+	float GetCostSoFar( void ) const;							// if a CNavSearchContext search is running on this thread, returns its value
 
 	void SetPathLengthSoFar( float value )	{ DebuggerBreakOnNaN_StagingOnly( value ); Assert( value >= 0.0 && !IS_NAN(value) ); m_pathLengthSoFar = value; }
 	float GetPathLengthSoFar( void ) const	{ DebuggerBreakOnNaN_StagingOnly( m_pathLengthSoFar ); return m_pathLengthSoFar; }
@@ -763,6 +763,108 @@ typedef CUtlVector< CNavArea * > NavAreaVector;
 extern NavAreaVector TheNavAreas;
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * Per-query state for nav mesh searches.
+ * Holds the open set as a binary heap (plus a FIFO for breadth-first flood fills) and per-area
+ * scratch cost/parent data indexed by area ID, so searches using different contexts can run
+ * at the same time. Scratch data is invalidated lazily by bumping a search marker in Reset().
+ */
+class CNavSearchContext
+{
+public:
+	CNavSearchContext( void );
+
+	void Reset( void );											// begin a new search, clearing the open and closed sets
+
+	void Mark( const CNavArea *area )							{ Touch( area ).m_marker = m_searchMarker; }
+	bool IsMarked( const CNavArea *area ) const;
+
+	bool IsOpen( const CNavArea *area ) const;					// true if on the open set
+	void AddToOpenList( CNavArea *area );						// add to the open set, ordered by total cost
+	void AddToOpenListTail( CNavArea *area );					// add to the breadth-first queue, which is served after the cost-ordered set
+	void UpdateOnOpenList( CNavArea *area );					// total cost has decreased, restore open set order
+	bool IsOpenListEmpty( void ) const							{ return m_openHeap.Count() == 0 && m_openQueueHead >= m_openQueue.Count(); }
+	CNavArea *PopOpenList( void );								// remove and return the cheapest element of the open set
+
+	bool IsClosed( const CNavArea *area ) const					{ return IsMarked( area ) && !IsOpen( area ); }
+	void AddToClosedList( CNavArea *area )						{ Mark( area ); }
+	void RemoveFromClosedList( CNavArea *area )					{ }	// since "closed" is defined as visited (marked) and not on open list, do nothing
+
+	void SetParent( CNavArea *area, CNavArea *parent, NavTraverseType how = NUM_TRAVERSE_TYPES );
+	CNavArea *GetParent( const CNavArea *area ) const;
+	NavTraverseType GetParentHow( const CNavArea *area ) const;
+
+	void SetTotalCost( CNavArea *area, float value )			{ Assert( value >= 0.0 && !IS_NAN(value) ); Touch( area ).m_totalCost = value; }
+	float GetTotalCost( const CNavArea *area ) const;
+
+	void SetCostSoFar( CNavArea *area, float value )			{ Assert( value >= 0.0 && !IS_NAN(value) ); Touch( area ).m_costSoFar = value; }
+	float GetCostSoFar( const CNavArea *area ) const;
+
+	void SetPathLengthSoFar( CNavArea *area, float value )		{ Assert( value >= 0.0 && !IS_NAN(value) ); Touch( area ).m_pathLengthSoFar = value; }
+	float GetPathLengthSoFar( const CNavArea *area ) const;
+
+	void PublishToAreas( void ) const;							// copy parent and cost data into the areas touched by this search, for code using the CNavArea accessors
+
+	static CNavSearchContext *GetActive( void );				// the context whose search is running on this thread, or NULL
+
+	/**
+	 * Make 'context' the active context on this thread for the lifetime of this object,
+	 * so cost functors calling CNavArea::GetCostSoFar() read this search's data.
+	 */
+	class CActiveScope
+	{
+	public:
+		CActiveScope( CNavSearchContext *context );
+		~CActiveScope();
+
+	private:
+		CNavSearchContext *m_prior;
+	};
+
+private:
+	struct AreaScratch
+	{
+		unsigned int m_touchMarker;								// if this equals the search marker, the data below belongs to the current search
+		unsigned int m_marker;									// if this equals the search marker, the area has been visited
+		unsigned int m_openMarker;								// if this equals the search marker, the area is on the open set
+		int m_heapIndex;										// index into m_openHeap, or -1 if queued breadth-first
+		float m_totalCost;
+		float m_costSoFar;
+		float m_pathLengthSoFar;
+		CNavArea *m_parent;
+		NavTraverseType m_parentHow;
+	};
+
+	struct OpenEntry
+	{
+		float m_totalCost;
+		unsigned int m_sequence;								// insertion order, to keep equal-cost ordering identical to the sorted list
+		CNavArea *m_area;
+
+		bool operator<( const OpenEntry &other ) const			{ return ( m_totalCost < other.m_totalCost ) || ( m_totalCost == other.m_totalCost && m_sequence < other.m_sequence ); }
+	};
+
+	AreaScratch &Touch( const CNavArea *area );
+	const AreaScratch *Find( const CNavArea *area ) const;
+
+	void HeapSiftUp( int index );
+	void HeapSiftDown( int index );
+
+	CUtlVector< AreaScratch > m_scratch;
+	CUtlVector< CNavArea * > m_touched;							// areas with scratch data for the current search
+
+	CUtlVector< OpenEntry > m_openHeap;
+	CUtlVector< CNavArea * > m_openQueue;
+	int m_openQueueHead;
+
+	unsigned int m_searchMarker;
+	unsigned int m_openSequence;
+};
+
+extern CNavSearchContext &TheNavSearchContext( void );			// shared context for searches run on the main thread
+
+
 //--------------------------------------------------------------------------------------------------------------
 //--------------------------------------------------------------------------------------------------------------
 //
@@ -857,6 +959,114 @@ inline CNavArea *CNavArea::PopOpenList( void )
 	return NULL;
 }
 
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavArea::GetCostSoFar( void ) const
+{
+	const CNavSearchContext *context = CNavSearchContext::GetActive();
+	if ( context )
+	{
+		return context->GetCostSoFar( this );
+	}
+
+	DebuggerBreakOnNaN_StagingOnly( m_costSoFar );
+	return m_costSoFar;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline CNavSearchContext::AreaScratch &CNavSearchContext::Touch( const CNavArea *area )
+{
+	unsigned int id = area->GetID();
+	if ( id >= (unsigned int)m_scratch.Count() )
+	{
+		int oldCount = m_scratch.Count();
+		m_scratch.AddMultipleToTail( id + 1 - oldCount );
+		V_memset( m_scratch.Base() + oldCount, 0, ( m_scratch.Count() - oldCount ) * sizeof( AreaScratch ) );
+	}
+
+	AreaScratch &scratch = m_scratch[ id ];
+	if ( scratch.m_touchMarker != m_searchMarker )
+	{
+		// first time this search has seen this area - discard data from prior searches
+		scratch.m_touchMarker = m_searchMarker;
+		scratch.m_heapIndex = -1;
+		scratch.m_totalCost = 0.0f;
+		scratch.m_costSoFar = 0.0f;
+		scratch.m_pathLengthSoFar = 0.0f;
+		scratch.m_parent = NULL;
+		scratch.m_parentHow = NUM_TRAVERSE_TYPES;
+		m_touched.AddToTail( const_cast< CNavArea * >( area ) );
+	}
+
+	return scratch;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline const CNavSearchContext::AreaScratch *CNavSearchContext::Find( const CNavArea *area ) const
+{
+	unsigned int id = area->GetID();
+	if ( id >= (unsigned int)m_scratch.Count() || m_scratch[ id ].m_touchMarker != m_searchMarker )
+		return NULL;
+
+	return &m_scratch[ id ];
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline bool CNavSearchContext::IsMarked( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch && scratch->m_marker == m_searchMarker;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline bool CNavSearchContext::IsOpen( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch && scratch->m_openMarker == m_searchMarker;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline void CNavSearchContext::SetParent( CNavArea *area, CNavArea *parent, NavTraverseType how )
+{
+	AreaScratch &scratch = Touch( area );
+	scratch.m_parent = parent;
+	scratch.m_parentHow = how;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline CNavArea *CNavSearchContext::GetParent( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch ? scratch->m_parent : NULL;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline NavTraverseType CNavSearchContext::GetParentHow( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch ? scratch->m_parentHow : NUM_TRAVERSE_TYPES;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavSearchContext::GetTotalCost( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch ? scratch->m_totalCost : 0.0f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavSearchContext::GetCostSoFar( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch ? scratch->m_costSoFar : 0.0f;
+}
+
+//--------------------------------------------------------------------------------------------------------------
+inline float CNavSearchContext::GetPathLengthSoFar( const CNavArea *area ) const
+{
+	const AreaScratch *scratch = Find( area );
+	return scratch ? scratch->m_pathLengthSoFar : 0.0f;
+}
+
 //--------------------------------------------------------------------------------------------------------------
 inline bool CNavArea::IsClosed( void ) const
 {
@@ -64,6 +64,7 @@ bool FindGroundForNode( Vector *pos, Vector *normal );
 //--------------------------------------------------------------------------------------------------------------
 CNavMesh::CNavMesh( void )
 {
+	m_changeCount = 0;
 	m_spawnName = NULL;
 	m_gridCellSize = 300.0f;
 	m_editMode = NORMAL;
@@ -162,6 +163,8 @@ CNavArea *CNavMesh::GetMarkedArea( void ) const
  */
 void CNavMesh::DestroyNavigationMesh( bool incremental )
 {
+	++m_changeCount;
+
 	m_blockedAreas.RemoveAll();
 	m_avoidanceObstacleAreas.RemoveAll();
 	m_transientAreas.RemoveAll();
@@ -515,6 +518,7 @@ void CNavMesh::AddNavArea( CNavArea *area )
 	}
 
 	++m_areaCount;
+	++m_changeCount;
 }
 
 //--------------------------------------------------------------------------------------------------------------
@@ -523,6 +527,8 @@ void CNavMesh::AddNavArea( CNavArea *area )
  */
 void CNavMesh::RemoveNavArea( CNavArea *area )
 {
+	++m_changeCount;
+
 	// add to grid
 	int loX = WorldToGridX( area->GetCorner( NORTH_WEST ).x );
 	int loY = WorldToGridY( area->GetCorner( NORTH_WEST ).y );
@@ -322,6 +322,7 @@ public:
 	const CUtlVector< INavAvoidanceObstacle * > &GetObstructions( void ) const { return m_avoidanceObstacles; }
 
 	unsigned int GetNavAreaCount( void ) const	{ return m_areaCount; }	// return total number of nav areas
+	unsigned int GetChangeCount( void ) const	{ return m_changeCount; }	// bumped whenever areas are added, removed or destroyed
 
 	// See GetNavAreaFlags_t for flags
 	CNavArea *GetNavArea( const Vector &pos, float beneathLimt = 120.0f ) const;	// given a position, return the nav area that IsOverlapping and is *immediately* beneath it
@@ -1097,6 +1098,7 @@ private:
 	float m_minX;
 	float m_minY;
 	unsigned int m_areaCount;									// total number of nav areas
+	unsigned int m_changeCount;									// incremented whenever areas are added, removed or destroyed
 
 	bool m_isLoaded;											// true if a Navigation Mesh has been loaded
 	bool m_isOutOfDate;											// true if the Navigation Mesh is older than the actual BSP
@@ -15,6 +15,7 @@
 #include "tier0/vprof.h"
 #include "mathlib/ssemath.h"
 #include "nav_area.h"
+#include "serverbenchmark_base.h"
 
 
 
@@ -95,23 +96,28 @@ public:
  * If 'goalPos' is NULL, will use the center of 'goalArea' as the goal position.
  * If 'maxPathLength' is nonzero, path building will stop when this length is reached.
  * Returns true if a path exists.
+ * All search state lives in 'context', so searches with different contexts may run concurrently.
+ * The path is defined by context.GetParent() links, valid until the context's next search.
  */
 #define IGNORE_NAV_BLOCKERS true
 template< typename CostFunctor >
-bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false )
+bool NavAreaBuildPath( CNavSearchContext &context, CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false )
 {
 	VPROF_BUDGET( "NavAreaBuildPath", "NextBotSpiky" );
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_PATHFINDING );
 
 	if ( closestArea )
 	{
 		*closestArea = startArea;
 	}
 
+	// start search
+	context.Reset();
 
 	if (startArea == NULL)
 		return false;
 
-	startArea->SetParent( NULL );
+	context.SetParent( startArea, NULL );
 
 	if (goalArea != NULL && goalArea->IsBlocked( teamID, ignoreNavBlockers ))
 		goalArea = NULL;
@@ -128,29 +134,29 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 	// determine actual goal position
 	Vector actualGoalPos = (goalPos) ? *goalPos : goalArea->GetCenter();
 
-	// start search
-	CNavArea::ClearSearchLists();
+	// cost functors read CNavArea::GetCostSoFar(), which must see this search's data
+	CNavSearchContext::CActiveScope activeScope( &context );
 
 	// compute estimate of path length
 	/// @todo Cost might work as "manhattan distance"
-	startArea->SetTotalCost( (startArea->GetCenter() - actualGoalPos).Length() );
+	context.SetTotalCost( startArea, (startArea->GetCenter() - actualGoalPos).Length() );
 
 	float initCost = costFunc( startArea, NULL, NULL, NULL, -1.0f );	
 	if (initCost < 0.0f)
 		return false;
-	startArea->SetCostSoFar( initCost );
-	startArea->SetPathLengthSoFar( 0.0 );
+	context.SetCostSoFar( startArea, initCost );
+	context.SetPathLengthSoFar( startArea, 0.0 );
 
-	startArea->AddToOpenList();
+	context.AddToOpenList( startArea );
 
 	// keep track of the area we visit that is closest to the goal
-	float closestAreaDist = startArea->GetTotalCost();
+	float closestAreaDist = context.GetTotalCost( startArea );
 
 	// do A* search
-	while( !CNavArea::IsOpenListEmpty() )
+	while( !context.IsOpenListEmpty() )
 	{
 		// get next area to check
-		CNavArea *area = CNavArea::PopOpenList();
+		CNavArea *area = context.PopOpenList();
 
 
 		// don't consider blocked areas
@@ -323,7 +329,7 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 
 			// don't backtrack
 			Assert( newArea );
-			if ( newArea == area->GetParent() )
+			if ( newArea == context.GetParent( area ) )
 				continue;
 			if ( newArea == area ) // self neighbor?
 				continue;
@@ -346,13 +352,13 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 
 			// Safety check against a bogus functor.  The cost of the path
 			// A...B, C should always be at least as big as the path A...B.
-			Assert( newCostSoFar >= area->GetCostSoFar() );
+			Assert( newCostSoFar >= context.GetCostSoFar( area ) );
 
 			// And now that we've asserted, let's be a bit more defensive.
 			// Make sure that any jump to a new area incurs some pathfinsing
 			// cost, to avoid us spinning our wheels over insignificant cost
 			// benefit, floating point precision bug, or busted cost functor.
-			float minNewCostSoFar = area->GetCostSoFar() * 1.00001f + 0.00001f;
+			float minNewCostSoFar = context.GetCostSoFar( area ) * 1.00001f + 0.00001f;
 			newCostSoFar = Max( newCostSoFar, minNewCostSoFar );
 				
 			// stop if path length limit reached
@@ -360,14 +366,14 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 			{
 				// keep track of path length so far
 				float deltaLength = ( newArea->GetCenter() - area->GetCenter() ).Length();
-				float newLengthSoFar = area->GetPathLengthSoFar() + deltaLength;
+				float newLengthSoFar = context.GetPathLengthSoFar( area ) + deltaLength;
 				if ( newLengthSoFar > maxPathLength )
 					continue;
 				
-				newArea->SetPathLengthSoFar( newLengthSoFar );
+				context.SetPathLengthSoFar( newArea, newLengthSoFar );
 			}
 
-			if ( ( newArea->IsOpen() || newArea->IsClosed() ) && newArea->GetCostSoFar() <= newCostSoFar )
+			if ( ( context.IsOpen( newArea ) || context.IsClosed( newArea ) ) && context.GetCostSoFar( newArea ) <= newCostSoFar )
 			{
 				// this is a worse path - skip it
 				continue;
@@ -385,42 +391,61 @@ bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *go
 					closestAreaDist = newCostRemaining;
 				}
 				
-				newArea->SetCostSoFar( newCostSoFar );
-				newArea->SetTotalCost( newCostSoFar + newCostRemaining );
+				context.SetCostSoFar( newArea, newCostSoFar );
+				context.SetTotalCost( newArea, newCostSoFar + newCostRemaining );
 
-				if ( newArea->IsClosed() )
+				if ( context.IsClosed( newArea ) )
 				{
-					newArea->RemoveFromClosedList();
+					context.RemoveFromClosedList( newArea );
 				}
 
-				if ( newArea->IsOpen() )
+				if ( context.IsOpen( newArea ) )
 				{
-					// area already on open list, update the list order to keep costs sorted
-					newArea->UpdateOnOpenList();
+					// area already on open list, update the heap order to keep costs sorted
+					context.UpdateOnOpenList( newArea );
 				}
 				else
 				{
-					newArea->AddToOpenList();
+					context.AddToOpenList( newArea );
 				}
 
-				newArea->SetParent( area, how );
+				context.SetParent( newArea, area, how );
 			}
 		}
 
 		// we have searched this area
-		area->AddToClosedList();
+		context.AddToClosedList( area );
 	}
 
 	return false;
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * As above, using the shared main thread search context.
+ * On return the resulting parent and cost data is also copied into the areas, for callers that follow
+ * CNavArea::GetParent() links.
+ */
+template< typename CostFunctor >
+bool NavAreaBuildPath( CNavArea *startArea, CNavArea *goalArea, const Vector *goalPos, CostFunctor &costFunc, CNavArea **closestArea = NULL, float maxPathLength = 0.0f, int teamID = TEAM_ANY, bool ignoreNavBlockers = false )
+{
+	CNavSearchContext &context = TheNavSearchContext();
+
+	bool result = NavAreaBuildPath( context, startArea, goalArea, goalPos, costFunc, closestArea, maxPathLength, teamID, ignoreNavBlockers );
+
+	context.PublishToAreas();
+
+	return result;
+}
+
+
 //--------------------------------------------------------------------------------------------------------------
 /**
  * Compute distance between two areas. Return -1 if can't reach 'endArea' from 'startArea'.
  */
 template< typename CostFunctor >
-float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea, CostFunctor &costFunc, float maxPathLength = 0.0f )
+float NavAreaTravelDistance( CNavSearchContext &context, CNavArea *startArea, CNavArea *endArea, CostFunctor &costFunc, float maxPathLength = 0.0f )
 {
 	if (startArea == NULL)
 		return -1.0f;
@@ -432,20 +457,31 @@ float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea, CostFunctor
 		return 0.0f;
 
 	// compute path between areas using given cost heuristic
-	if (NavAreaBuildPath( startArea, endArea, NULL, costFunc, NULL, maxPathLength ) == false)
+	if (NavAreaBuildPath( context, startArea, endArea, NULL, costFunc, NULL, maxPathLength ) == false)
 		return -1.0f;
 
 	// compute distance along path
 	float distance = 0.0f;
-	for( CNavArea *area = endArea; area->GetParent(); area = area->GetParent() )
+	for( CNavArea *area = endArea; context.GetParent( area ); area = context.GetParent( area ) )
 	{
-		distance += (area->GetCenter() - area->GetParent()->GetCenter()).Length();
+		distance += (area->GetCenter() - context.GetParent( area )->GetCenter()).Length();
 	}
 
 	return distance;
 }
 
 
+//--------------------------------------------------------------------------------------------------------------
+/**
+ * As above, using the shared main thread search context.
+ */
+template< typename CostFunctor >
+float NavAreaTravelDistance( CNavArea *startArea, CNavArea *endArea, CostFunctor &costFunc, float maxPathLength = 0.0f )
+{
+	return NavAreaTravelDistance( TheNavSearchContext(), startArea, endArea, costFunc, maxPathLength );
+}
+
+
 
 //--------------------------------------------------------------------------------------------------------------
 /**
@@ -1159,6 +1159,7 @@ private:
 
 	friend class CPlayerMove;
 	friend class CPlayerClass;
+	friend class CMovementRecorder;
 
 	// Player name
 	char					m_szNetname[MAX_PLAYER_NAME_LENGTH];
@@ -12,6 +12,7 @@
 #include "client.h"
 #include "player_command.h"
 #include "movehelper_server.h"
+#include "movement_recorder.h"
 #include "iservervehicle.h"
 #include "tier0/vprof.h"
 
@@ -425,7 +426,16 @@ void CPlayerMove::RunCommand ( CBasePlayer *player, CUserCmd *ucmd, IMoveHelper
 	{
 		VPROF( "g_pGameMovement->ProcessMovement()" );
 		Assert( g_pGameMovement );
-		g_pGameMovement->ProcessMovement( player, g_pMoveData );
+		if ( g_MovementRecorder.IsRecording() )
+		{
+			g_MovementRecorder.BeginMove( player, g_pMoveData );
+			g_pGameMovement->ProcessMovement( player, g_pMoveData );
+			g_MovementRecorder.EndMove( player, g_pMoveData );
+		}
+		else
+		{
+			g_pGameMovement->ProcessMovement( player, g_pMoveData );
+		}
 	}
 	else
 	{
@@ -10,9 +10,14 @@
 #include "igamesystem.h"
 #include "ilagcompensationmanager.h"
 #include "inetchannelinfo.h"
-#include "utllinkedlist.h"
 #include "BaseAnimatingOverlay.h"
 #include "tier0/vprof.h"
+#include "gamevars_shared.h"
+
+#include "serverbenchmark_base.h"
+#include "bone_setup.h"
+#include "checksum_crc.h"
+#include "vstdlib/jobthread.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
@@ -37,11 +42,43 @@ ConVar sv_showlagcompensation( "sv_showlagcompensation", "0", FCVAR_CHEAT, "Show
 
 ConVar sv_unlag_fixstuck( "sv_unlag_fixstuck", "0", FCVAR_DEVELOPMENTONLY, "Disallow backtracking a player for lag compensation if it will cause them to become stuck" );
 
+ConVar sv_unlag_cull( "sv_unlag_cull", "1", FCVAR_DEVELOPMENTONLY, "Don't backtrack entities whose rewound bounds are outside the shooter's fire cone" );
+
+ConVar sv_unlag_bonecache( "sv_unlag_bonecache", "1", FCVAR_DEVELOPMENTONLY, "Set up the bones of rewound entities right after backtracking them, and share them with every shooter that rewinds them to the same state this tick" );
+ConVar sv_unlag_bonecache_threaded( "sv_unlag_bonecache_threaded", "1", FCVAR_DEVELOPMENTONLY, "Set up the bones of rewound entities on the thread pool" );
+
+// Entities this close to the shooter are always rewound, since melee, flames and healing don't follow the aim ray
+#define LAG_COMPENSATION_CULL_NEAR_DIST		512.0f
+// Tangent of the half-angle of the fire cone (~15 degrees), wider than any bullet spread
+#define LAG_COMPENSATION_CULL_CONE_TAN		0.27f
+// Hitboxes can extend past the collision bounds
+#define LAG_COMPENSATION_CULL_MARGIN		32.0f
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
 #define MAX_LAYER_RECORDS (CBaseAnimatingOverlay::MAX_OVERLAYS)
 
+// History is a fixed size ring per entity, which must cover sv_maxunlag at the server tickrate
+#define MAX_LAG_RECORDS			128
+#define LAG_RECORD_MASK			( MAX_LAG_RECORDS - 1 )
+
+// Animation is stored as reverse deltas - only the layers and pose parameters that changed
+// since the previous record. When these fill up, the oldest records are dropped.
+#define MAX_LAYER_DELTAS		( MAX_LAG_RECORDS * 4 )
+#define LAYER_DELTA_MASK		( MAX_LAYER_DELTAS - 1 )
+#define MAX_POSE_DELTAS			( MAX_LAG_RECORDS * 8 )
+#define POSE_DELTA_MASK			( MAX_POSE_DELTAS - 1 )
+
+// The rings are indexed with masks, and must hold a full sv_maxunlag window at the default tickrate
+COMPILE_TIME_ASSERT( ( MAX_LAG_RECORDS & LAG_RECORD_MASK ) == 0 );
+COMPILE_TIME_ASSERT( ( MAX_LAYER_DELTAS & LAYER_DELTA_MASK ) == 0 );
+COMPILE_TIME_ASSERT( ( MAX_POSE_DELTAS & POSE_DELTA_MASK ) == 0 );
+COMPILE_TIME_ASSERT( MAX_LAG_RECORDS > (int)( 1.0 / DEFAULT_TICK_INTERVAL ) + 1 );
+// A single record's deltas must always fit, or making room for it would never finish
+COMPILE_TIME_ASSERT( MAX_LAYER_DELTAS >= MAX_LAYER_RECORDS );
+COMPILE_TIME_ASSERT( MAX_POSE_DELTAS >= MAXSTUDIOPOSEPARAM );
+
 struct LayerRecord
 {
 	int m_sequence;
@@ -64,6 +101,38 @@ struct LayerRecord
 		m_weight = src.m_weight;
 		m_order = src.m_order;
 	}
+
+	bool operator==( const LayerRecord &other ) const
+	{
+		return m_sequence == other.m_sequence && m_cycle == other.m_cycle && m_weight == other.m_weight && m_order == other.m_order;
+	}
+
+	bool operator!=( const LayerRecord &other ) const
+	{
+		return !( *this == other );
+	}
+};
+
+// The full set of overlay layers and pose parameters of an entity
+struct LagAnimation
+{
+	void Save( CBaseAnimatingOverlay *pEntity );
+	void Apply( CBaseAnimatingOverlay *pEntity ) const;
+
+	LayerRecord				m_layerRecords[MAX_LAYER_RECORDS];
+	float					m_flPoseParameters[MAXSTUDIOPOSEPARAM];
+};
+
+struct LayerDelta
+{
+	int						m_index;
+	LayerRecord				m_layer;
+};
+
+struct PoseDelta
+{
+	int						m_index;
+	float					m_flValue;
 };
 
 struct LagRecord
@@ -79,52 +148,418 @@ public:
 		m_flSimulationTime = -1;
 		m_masterSequence = 0;
 		m_masterCycle = 0;
+		m_nSerial = 0;
+		m_nLastBreak = 0;
+		m_nFirstLayerDelta = 0;
+		m_nLayerDeltas = 0;
+		m_nFirstPoseDelta = 0;
+		m_nPoseDeltas = 0;
+	}
+
+	// Did player die this frame
+	int						m_fFlags;
+
+	// Player position, orientation and bbox
+	Vector					m_vecOrigin;
+	QAngle					m_vecAngles;
+	Vector					m_vecMinsPreScaled;
+	Vector					m_vecMaxsPreScaled;
+
+	float					m_flSimulationTime;	
+	
+	// Player animation details, so we can get the legs in the right spot.
+	int						m_masterSequence;
+	float					m_masterCycle;
+
+	// Serial number of this record, and of the newest record at or before it that
+	// we can't backtrack past (dead, or teleported from the record before it)
+	unsigned int			m_nSerial;
+	unsigned int			m_nLastBreak;
+
+	// Layers and pose parameters that differ from the previous record, holding the previous record's values
+	unsigned int			m_nFirstLayerDelta;
+	int						m_nLayerDeltas;
+	unsigned int			m_nFirstPoseDelta;
+	int						m_nPoseDeltas;
+};
+
+// Entity state before we moved it back, and where we moved it back to
+struct LagRestoreRecord
+{
+	int						m_fFlags;
+
+	Vector					m_vecOrigin;
+	QAngle					m_vecAngles;
+	Vector					m_vecMinsPreScaled;
+	Vector					m_vecMaxsPreScaled;
+
+	float					m_flSimulationTime;
+
+	int						m_masterSequence;
+	float					m_masterCycle;
+	LagAnimation			m_animation;
+};
+
+// Everything SetupBones reads from a rewound entity. Two shooters that rewind an
+// entity to the same state this tick get the same bones.
+struct LagBoneState
+{
+	void Save( CBaseAnimatingOverlay *pEntity );
+
+	bool operator==( const LagBoneState &other ) const
+	{
+		return !V_memcmp( this, &other, sizeof( *this ) );
+	}
+
+	int						m_nModelIndex;
+	float					m_flModelScale;
+	Vector					m_vecOrigin;
+	QAngle					m_vecAngles;
+	int						m_masterSequence;
+	float					m_masterCycle;
+	int						m_fActiveLayers;
+	LagAnimation			m_animation;
+};
+
+// Bones set up for one entity state this tick
+struct LagBoneCacheEntry
+{
+	EHANDLE					m_hEntity;
+	CRC32_t					m_nHash;
+	LagBoneState			m_state;
+	int						m_iFirstBone;
+};
+
+struct LagBoneSetupJob
+{
+	CBaseAnimatingOverlay	*m_pEntity;
+	int						m_iEntry;
+	matrix3x4_t				*m_pBones;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void LagAnimation::Save( CBaseAnimatingOverlay *pEntity )
+{
+	int layerCount = pEntity->GetNumAnimOverlays();
+	for( int layerIndex = 0; layerIndex < MAX_LAYER_RECORDS; ++layerIndex )
+	{
+		CAnimationLayer *currentLayer = ( layerIndex < layerCount ) ? pEntity->GetAnimOverlay(layerIndex) : NULL;
+		if( currentLayer )
+		{
+			m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
+			m_layerRecords[layerIndex].m_order = currentLayer->m_nOrder;
+			m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
+			m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
+		}
+		else
+		{
+			m_layerRecords[layerIndex] = LayerRecord();
+		}
+	}
+
+	for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+	{
+		m_flPoseParameters[i] = pEntity->GetPoseParameter(i);
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void LagAnimation::Apply( CBaseAnimatingOverlay *pEntity ) const
+{
+	int layerCount = pEntity->GetNumAnimOverlays();
+	for( int layerIndex = 0; layerIndex < layerCount && layerIndex < MAX_LAYER_RECORDS; ++layerIndex )
+	{
+		CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
+		if( currentLayer )
+		{
+			currentLayer->m_flCycle = m_layerRecords[layerIndex].m_cycle;
+			currentLayer->m_nOrder = m_layerRecords[layerIndex].m_order;
+			currentLayer->m_nSequence = m_layerRecords[layerIndex].m_sequence;
+			currentLayer->m_flWeight = m_layerRecords[layerIndex].m_weight;
+		}
+	}
+
+	for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+	{
+		pEntity->SetPoseParameter( i, m_flPoseParameters[i] );
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void LagBoneState::Save( CBaseAnimatingOverlay *pEntity )
+{
+	// zeroed so padding compares and hashes the same
+	V_memset( (void *)this, 0, sizeof( *this ) );
+
+	m_nModelIndex = pEntity->GetModelIndex();
+	m_flModelScale = pEntity->GetModelScale();
+	m_vecOrigin = pEntity->GetAbsOrigin();
+	m_vecAngles = pEntity->GetAbsAngles();
+	m_masterSequence = pEntity->GetSequence();
+	m_masterCycle = pEntity->GetCycle();
+	m_animation.Save( pEntity );
+
+	int layerCount = MIN( pEntity->GetNumAnimOverlays(), MAX_LAYER_RECORDS );
+	for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
+	{
+		CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
+		if ( currentLayer && currentLayer->IsActive() )
+		{
+			m_fActiveLayers |= ( 1 << layerIndex );
+		}
+	}
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: History of one lag compensated entity, oldest record first
+//-----------------------------------------------------------------------------
+class CLagTrack
+{
+public:
+	CLagTrack()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		m_nOldest = 0;
+		m_nCount = 0;
+		m_nNextSerial = 0;
+		m_nLayerDeltaHead = 0;
+		m_nPoseDeltaHead = 0;
+		m_restore.m_fFlags = 0;
+	}
+
+	int Count() const { return m_nCount; }
+
+	const LagRecord &Get( int i ) const
+	{
+		Assert( i >= 0 && i < m_nCount );
+		return m_records[ ( m_nOldest + i ) & LAG_RECORD_MASK ];
+	}
+
+	const LagRecord &Newest() const { return Get( m_nCount - 1 ); }
+
+	void RemoveOldest()
+	{
+		Assert( m_nCount > 0 );
+		m_nOldest = ( m_nOldest + 1 ) & LAG_RECORD_MASK;
+		--m_nCount;
+	}
+
+	void Record( CBaseAnimatingOverlay *pEntity, float flSimulationTime, float flTeleportDistanceSqr );
+	int FindRecord( float flTargetTime ) const;
+	bool CanBacktrackTo( int i ) const;
+	void GetAnimation( int i, LagAnimation *pAnimation, LagAnimation *pNewerAnimation ) const;
+
+	EHANDLE					m_hEntity;			// the entity this history belongs to
+
+	LagRestoreRecord		m_restore;			// entity data before we moved it back
+	LagRestoreRecord		m_change;			// entity data where we moved it back
+
+private:
+	LagRecord				m_records[ MAX_LAG_RECORDS ];
+	int						m_nOldest;
+	int						m_nCount;
+	unsigned int			m_nNextSerial;
+
+	LagAnimation			m_newestAnimation;	// full animation state of the newest record
+
+	LayerDelta				m_layerDeltas[ MAX_LAYER_DELTAS ];
+	unsigned int			m_nLayerDeltaHead;
+	PoseDelta				m_poseDeltas[ MAX_POSE_DELTAS ];
+	unsigned int			m_nPoseDeltaHead;
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Add the entity's current state as the newest record
+//-----------------------------------------------------------------------------
+void CLagTrack::Record( CBaseAnimatingOverlay *pEntity, float flSimulationTime, float flTeleportDistanceSqr )
+{
+	LagAnimation animation;
+	animation.Save( pEntity );
+
+	int layerDeltas = 0;
+	int poseDeltas = 0;
+	if ( m_nCount > 0 )
+	{
+		for( int layerIndex = 0; layerIndex < MAX_LAYER_RECORDS; ++layerIndex )
+		{
+			if ( animation.m_layerRecords[layerIndex] != m_newestAnimation.m_layerRecords[layerIndex] )
+				++layerDeltas;
+		}
 
 		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
 		{
-			m_flPoseParameters[i] = 0;
+			if ( animation.m_flPoseParameters[i] != m_newestAnimation.m_flPoseParameters[i] )
+				++poseDeltas;
 		}
 	}
 
-	LagRecord( const LagRecord& src )
+	// make room for the new record and its deltas
+	while ( m_nCount > 0 )
+	{
+		const LagRecord &oldest = Get( 0 );
+		if ( m_nCount < MAX_LAG_RECORDS &&
+			 m_nLayerDeltaHead - oldest.m_nFirstLayerDelta + layerDeltas <= MAX_LAYER_DELTAS &&
+			 m_nPoseDeltaHead - oldest.m_nFirstPoseDelta + poseDeltas <= MAX_POSE_DELTAS )
+			break;
+
+		static bool s_bWarnedShortHistory = false;
+		if ( !s_bWarnedShortHistory && flSimulationTime - oldest.m_flSimulationTime < sv_maxunlag.GetFloat() )
+		{
+			DevWarning( "Lag compensation history for %s is shorter than sv_maxunlag (%.2fs of %.2fs), the history rings are too small for this tickrate\n",
+				pEntity->GetClassname(), flSimulationTime - oldest.m_flSimulationTime, sv_maxunlag.GetFloat() );
+			s_bWarnedShortHistory = true;
+		}
+
+		RemoveOldest();
+	}
+
+	const LagRecord *prev = ( m_nCount > 0 ) ? &Newest() : NULL;
+	LagRecord &record = m_records[ ( m_nOldest + m_nCount ) & LAG_RECORD_MASK ];
+
+	record.m_fFlags = 0;
+	if ( pEntity->IsAlive() )
+	{
+		record.m_fFlags |= LC_ALIVE;
+	}
+
+	record.m_flSimulationTime	= flSimulationTime;
+	record.m_vecAngles			= pEntity->GetLocalAngles();
+	record.m_vecOrigin			= pEntity->GetLocalOrigin();
+	record.m_vecMinsPreScaled	= pEntity->CollisionProp()->OBBMinsPreScaled();
+	record.m_vecMaxsPreScaled	= pEntity->CollisionProp()->OBBMaxsPreScaled();
+	record.m_masterSequence		= pEntity->GetSequence();
+	record.m_masterCycle		= pEntity->GetCycle();
+
+	record.m_nSerial = m_nNextSerial++;
+	if ( !prev || !( record.m_fFlags & LC_ALIVE ) || ( record.m_vecOrigin - prev->m_vecOrigin ).Length2DSqr() > flTeleportDistanceSqr )
+	{
+		record.m_nLastBreak = record.m_nSerial;
+	}
+	else
+	{
+		record.m_nLastBreak = prev->m_nLastBreak;
+	}
+
+	record.m_nFirstLayerDelta = m_nLayerDeltaHead;
+	record.m_nFirstPoseDelta = m_nPoseDeltaHead;
+
+	if ( prev )
 	{
-		m_fFlags = src.m_fFlags;
-		m_vecOrigin = src.m_vecOrigin;
-		m_vecAngles = src.m_vecAngles;
-		m_vecMinsPreScaled = src.m_vecMinsPreScaled;
-		m_vecMaxsPreScaled = src.m_vecMaxsPreScaled;
-		m_flSimulationTime = src.m_flSimulationTime;
 		for( int layerIndex = 0; layerIndex < MAX_LAYER_RECORDS; ++layerIndex )
 		{
-			m_layerRecords[layerIndex] = src.m_layerRecords[layerIndex];
+			if ( animation.m_layerRecords[layerIndex] != m_newestAnimation.m_layerRecords[layerIndex] )
+			{
+				LayerDelta &delta = m_layerDeltas[ m_nLayerDeltaHead++ & LAYER_DELTA_MASK ];
+				delta.m_index = layerIndex;
+				delta.m_layer = m_newestAnimation.m_layerRecords[layerIndex];
+			}
 		}
-		m_masterSequence = src.m_masterSequence;
-		m_masterCycle = src.m_masterCycle;
 
 		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
 		{
-			m_flPoseParameters[i] = src.m_flPoseParameters[i];
+			if ( animation.m_flPoseParameters[i] != m_newestAnimation.m_flPoseParameters[i] )
+			{
+				PoseDelta &delta = m_poseDeltas[ m_nPoseDeltaHead++ & POSE_DELTA_MASK ];
+				delta.m_index = i;
+				delta.m_flValue = m_newestAnimation.m_flPoseParameters[i];
+			}
 		}
 	}
 
-	// Did player die this frame
-	int						m_fFlags;
+	record.m_nLayerDeltas = m_nLayerDeltaHead - record.m_nFirstLayerDelta;
+	record.m_nPoseDeltas = m_nPoseDeltaHead - record.m_nFirstPoseDelta;
 
-	// Player position, orientation and bbox
-	Vector					m_vecOrigin;
-	QAngle					m_vecAngles;
-	Vector					m_vecMinsPreScaled;
-	Vector					m_vecMaxsPreScaled;
+	m_newestAnimation = animation;
+	++m_nCount;
+}
 
-	float					m_flSimulationTime;	
-	
-	// Player animation details, so we can get the legs in the right spot.
-	LayerRecord				m_layerRecords[MAX_LAYER_RECORDS];
-	int						m_masterSequence;
-	float					m_masterCycle;
 
-	float					m_flPoseParameters[MAXSTUDIOPOSEPARAM];
-};
+//-----------------------------------------------------------------------------
+// Purpose: Return the newest record at or before the given time, or the oldest
+//			record if they are all newer
+//-----------------------------------------------------------------------------
+int CLagTrack::FindRecord( float flTargetTime ) const
+{
+	Assert( m_nCount > 0 );
+
+	int lo = 0;
+	int hi = m_nCount - 1;
+	while ( lo < hi )
+	{
+		int mid = ( lo + hi + 1 ) / 2;
+		if ( Get( mid ).m_flSimulationTime <= flTargetTime )
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+
+	return lo;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Return true if the entity was alive and didn't teleport between
+//			the given record and the newest one
+//-----------------------------------------------------------------------------
+bool CLagTrack::CanBacktrackTo( int i ) const
+{
+	const LagRecord &record = Get( i );
+
+	if ( !( record.m_fFlags & LC_ALIVE ) )
+		return false;
+
+	return (int)( record.m_nSerial - Newest().m_nLastBreak ) >= 0;
+}
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuild the animation state of a record, and of the record after it
+//			if there is one, by undoing deltas from the newest record back
+//-----------------------------------------------------------------------------
+void CLagTrack::GetAnimation( int i, LagAnimation *pAnimation, LagAnimation *pNewerAnimation ) const
+{
+	*pAnimation = m_newestAnimation;
+
+	for( int j = m_nCount - 1; j > i; --j )
+	{
+		if ( j == i + 1 && pNewerAnimation )
+		{
+			*pNewerAnimation = *pAnimation;
+		}
+
+		const LagRecord &record = Get( j );
+		for( int d = 0; d < record.m_nLayerDeltas; ++d )
+		{
+			const LayerDelta &delta = m_layerDeltas[ ( record.m_nFirstLayerDelta + d ) & LAYER_DELTA_MASK ];
+			pAnimation->m_layerRecords[ delta.m_index ] = delta.m_layer;
+		}
+
+		for( int d = 0; d < record.m_nPoseDeltas; ++d )
+		{
+			const PoseDelta &delta = m_poseDeltas[ ( record.m_nFirstPoseDelta + d ) & POSE_DELTA_MASK ];
+			pAnimation->m_flPoseParameters[ delta.m_index ] = delta.m_flValue;
+		}
+	}
+}
 
 
 //
@@ -185,17 +620,37 @@ public:
 	CLagCompensationManager( char const *name ) : CAutoGameSystemPerFrame( name ), m_flTeleportDistanceSqr( 64 *64 )
 	{
 		m_isCurrentlyDoingCompensation = false;
+		m_nBoneCacheTick = -1;
+		Q_memset( m_pPlayerTrack, 0, sizeof( m_pPlayerTrack ) );
 	}
 
 	// IServerSystem stuff
 	virtual void Shutdown()
 	{
 		ClearHistory();
+		m_AdditionalTracks.PurgeAndDeleteElements();
+	}
+
+	virtual void LevelInitPostEntity()
+	{
+		// -tickrate can raise the number of records sv_maxunlag needs past what the rings hold
+		float flMaxUnlag = sv_maxunlag.GetFloat();
+		sv_maxunlag.GetMax( flMaxUnlag );
+		int nRecordsNeeded = (int)ceil( flMaxUnlag / TICK_INTERVAL ) + 1;
+		if ( nRecordsNeeded > MAX_LAG_RECORDS )
+		{
+			Warning( "Lag compensation holds %d records, but sv_maxunlag %.2f needs %d at this tickrate, so history will be cut short\n",
+				MAX_LAG_RECORDS, flMaxUnlag, nRecordsNeeded );
+		}
 	}
 
 	virtual void LevelShutdownPostEntity()
 	{
 		ClearHistory();
+		m_AdditionalTracks.PurgeAndDeleteElements();
+		m_BoneCacheEntries.Purge();
+		m_BoneCacheMatrices.Purge();
+		m_nBoneCacheTick = -1;
 	}
 
 	// called after entities think
@@ -209,27 +664,50 @@ public:
 
 	bool			IsCurrentlyDoingLagCompensation() const OVERRIDE { return m_isCurrentlyDoingCompensation; }
 
+	void			AddAdditionalEntity( CBaseAnimatingOverlay *pEntity ) OVERRIDE;
+	void			RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity ) OVERRIDE;
+
 private:
+	void			RecordEntity( CLagTrack *track, CBaseAnimatingOverlay *pEntity, float flSimulationTime, float flDeadtime );
 	void			BacktrackPlayer( CBasePlayer *player, float flTargetTime );
+	void			BacktrackEntity( CLagTrack *track, CBaseAnimatingOverlay *pEntity, float flTargetTime );
+	bool			IsInFireCone( const Vector &vecCenter, float flRadius ) const;
+	void			SetupRewoundBones();
+	int				FindBoneCacheEntry( CBaseAnimatingOverlay *pEntity, const LagBoneState &state, CRC32_t nHash ) const;
 
 	void ClearHistory()
 	{
 		for ( int i=0; i<MAX_PLAYERS; i++ )
-			m_PlayerTrack[i].Purge();
+		{
+			delete m_pPlayerTrack[i];
+			m_pPlayerTrack[i] = NULL;
+		}
+
+		for ( int i=0; i<m_AdditionalTracks.Count(); i++ )
+			m_AdditionalTracks[i]->Clear();
 	}
 
-	// keep a list of lag records for each player
-	CUtlFixedLinkedList< LagRecord >	m_PlayerTrack[ MAX_PLAYERS ];
+	// keep a history of lag records for each player, allocated when the player is first seen
+	CLagTrack				*m_pPlayerTrack[ MAX_PLAYERS ];
+
+	// and for each registered non-player entity (NextBots, buildings)
+	CUtlVector< CLagTrack * >	m_AdditionalTracks;
 
 	// Scratchpad for determining what needs to be restored
 	CBitVec<MAX_PLAYERS>	m_RestorePlayer;
-	bool					m_bNeedToRestore;
-	
-	LagRecord				m_RestoreData[ MAX_PLAYERS ];	// player data before we moved him back
-	LagRecord				m_ChangeData[ MAX_PLAYERS ];	// player data where we moved him back
+	CUtlVector< CLagTrack * >	m_RestoreTracks;	// entities we moved back
 
 	CBasePlayer				*m_pCurrentPlayer;	// The player we are doing lag compensation for
 
+	// Bones of rewound entities, shared by every shooter this tick
+	int								m_nBoneCacheTick;
+	CUtlVector< LagBoneCacheEntry >	m_BoneCacheEntries;
+	CUtlVector< matrix3x4_t >		m_BoneCacheMatrices;
+	CUtlVector< LagBoneSetupJob >	m_BoneSetupJobs;
+
+	Vector					m_vecShooterEyePosition;
+	Vector					m_vecShooterForward;
+
 	float					m_flTeleportDistanceSqr;
 
 	bool					m_isCurrentlyDoingCompensation;	// Sentinel to prevent calling StartLagCompensation a second time before a Finish.
@@ -244,6 +722,8 @@ ILagCompensationManager *lagcompensation = &g_LagCompensationManager;
 //-----------------------------------------------------------------------------
 void CLagCompensationManager::FrameUpdatePostEntityThink()
 {
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_LAG_COMPENSATION );
+
 	if ( (gpGlobals->maxClients <= 1) || !sv_unlag.GetBool() )
 	{
 		ClearHistory();
@@ -255,95 +735,138 @@ void CLagCompensationManager::FrameUpdatePostEntityThink()
 	VPROF_BUDGET( "FrameUpdatePostEntityThink", "CLagCompensationManager" );
 
 	// remove all records before that time:
-	int flDeadtime = gpGlobals->curtime - sv_maxunlag.GetFloat();
+	float flDeadtime = gpGlobals->curtime - sv_maxunlag.GetFloat();
 
 	// Iterate all active players
 	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
 	{
 		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
 
-		CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[i-1];
+		CLagTrack *track = m_pPlayerTrack[i-1];
 
 		if ( !pPlayer )
 		{
-			if ( track->Count() > 0 )
+			if ( track )
 			{
-				track->RemoveAll();
+				track->Clear();
 			}
 
 			continue;
 		}
 
-		Assert( track->Count() < 1000 ); // insanity check
-
-		// remove tail records that are too old
-		intp tailIndex = track->Tail();
-		while ( track->IsValidIndex( tailIndex ) )
+		if ( !track )
 		{
-			LagRecord &tail = track->Element( tailIndex );
-
-			// if tail is within limits, stop
-			if ( tail.m_flSimulationTime >= flDeadtime )
-				break;
-			
-			// remove tail, get new tail
-			track->Remove( tailIndex );
-			tailIndex = track->Tail();
+			track = m_pPlayerTrack[i-1] = new CLagTrack;
 		}
 
-		// check if head has same simulation time
-		if ( track->Count() > 0 )
+		if ( track->m_hEntity != pPlayer )
 		{
-			LagRecord &head = track->Element( track->Head() );
-
-			// check if player changed simulation time since last time updated
-			if ( head.m_flSimulationTime >= pPlayer->GetSimulationTime() )
-				continue; // don't add new entry for same or older time
+			// a new player in this slot
+			track->Clear();
+			track->m_hEntity = pPlayer;
 		}
 
-		// add new record to player track
-		LagRecord &record = track->Element( track->AddToHead() );
+		RecordEntity( track, pPlayer, pPlayer->GetSimulationTime(), flDeadtime );
+	}
+
+	// Iterate all registered non-player entities
+	for ( int i = m_AdditionalTracks.Count() - 1; i >= 0; i-- )
+	{
+		CLagTrack *track = m_AdditionalTracks[i];
+		CBaseAnimatingOverlay *pEntity = track->m_hEntity;
 
-		record.m_fFlags = 0;
-		if ( pPlayer->IsAlive() )
+		if ( !pEntity )
 		{
-			record.m_fFlags |= LC_ALIVE;
+			delete track;
+			m_AdditionalTracks.FastRemove( i );
+			continue;
 		}
 
-		record.m_flSimulationTime	= pPlayer->GetSimulationTime();
-		record.m_vecAngles			= pPlayer->GetLocalAngles();
-		record.m_vecOrigin			= pPlayer->GetLocalOrigin();
-		record.m_vecMinsPreScaled	= pPlayer->CollisionProp()->OBBMinsPreScaled();
-		record.m_vecMaxsPreScaled	= pPlayer->CollisionProp()->OBBMaxsPreScaled();
+		// simulation time only changes when these move, but their animation is still advanced every think
+		RecordEntity( track, pEntity, MAX( pEntity->GetSimulationTime(), pEntity->GetAnimTime() ), flDeadtime );
+	}
 
-		int layerCount = pPlayer->GetNumAnimOverlays();
-		for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
-		{
-			CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
-			if( currentLayer )
-			{
-				record.m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
-				record.m_layerRecords[layerIndex].m_order = currentLayer->m_nOrder;
-				record.m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
-				record.m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
-			}
-		}
-		record.m_masterSequence = pPlayer->GetSequence();
-		record.m_masterCycle = pPlayer->GetCycle();
+	//Clear the current player.
+	m_pCurrentPlayer = NULL;
+}
 
-		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+//-----------------------------------------------------------------------------
+// Purpose: Expire old records and add the entity's current state
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::RecordEntity( CLagTrack *track, CBaseAnimatingOverlay *pEntity, float flSimulationTime, float flDeadtime )
+{
+	// remove records that are too old
+	while ( track->Count() > 0 && track->Get( 0 ).m_flSimulationTime < flDeadtime )
+	{
+		track->RemoveOldest();
+	}
+
+	// check if entity changed simulation time since last time updated
+	if ( track->Count() > 0 && track->Newest().m_flSimulationTime >= flSimulationTime )
+		return; // don't add new entry for same or older time
+
+	track->Record( pEntity, flSimulationTime, m_flTeleportDistanceSqr );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Register a non-player entity that hitscan against should be lag compensated
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::AddAdditionalEntity( CBaseAnimatingOverlay *pEntity )
+{
+	for ( int i=0; i<m_AdditionalTracks.Count(); i++ )
+	{
+		if ( m_AdditionalTracks[i]->m_hEntity == pEntity )
+			return;
+	}
+
+	CLagTrack *track = new CLagTrack;
+	track->m_hEntity = pEntity;
+	m_AdditionalTracks.AddToTail( track );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::RemoveAdditionalEntity( CBaseAnimatingOverlay *pEntity )
+{
+	for ( int i=0; i<m_AdditionalTracks.Count(); i++ )
+	{
+		CLagTrack *track = m_AdditionalTracks[i];
+		if ( track->m_hEntity == pEntity )
 		{
-			record.m_flPoseParameters[i] = pPlayer->GetPoseParameter(i);
+			m_RestoreTracks.FindAndRemove( track );
+			delete track;
+			m_AdditionalTracks.FastRemove( i );
+			return;
 		}
 	}
+}
 
-	//Clear the current player.
-	m_pCurrentPlayer = NULL;
+//-----------------------------------------------------------------------------
+// Purpose: Return true if a sphere could be hit by a shot along the shooter's aim
+//-----------------------------------------------------------------------------
+bool CLagCompensationManager::IsInFireCone( const Vector &vecCenter, float flRadius ) const
+{
+	Vector vecToCenter = vecCenter - m_vecShooterEyePosition;
+
+	float flDistSqr = vecToCenter.LengthSqr();
+	float flNear = LAG_COMPENSATION_CULL_NEAR_DIST + flRadius;
+	if ( flDistSqr < flNear * flNear )
+		return true;
+
+	float flAlong = DotProduct( vecToCenter, m_vecShooterForward );
+	if ( flAlong < -flRadius )
+		return false;	// behind us
+
+	float flConeRadius = MAX( flAlong, 0.0f ) * LAG_COMPENSATION_CULL_CONE_TAN + flRadius;
+	return ( flDistSqr - flAlong * flAlong ) <= flConeRadius * flConeRadius;
 }
 
 // Called during player movement to set up/restore after lag compensation
 void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCmd *cmd )
 {
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_LAG_COMPENSATION );
+
 	Assert( !m_isCurrentlyDoingCompensation );
 
 	//DONT LAG COMP AGAIN THIS FRAME IF THERES ALREADY ONE IN PROGRESS
@@ -357,7 +880,7 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 
 	// Assume no players need to be restored
 	m_RestorePlayer.ClearAll();
-	m_bNeedToRestore = false;
+	m_RestoreTracks.RemoveAll();
 
 	m_pCurrentPlayer = player;
 	
@@ -371,8 +894,6 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 
 	// NOTE: Put this here so that it won't show up in single player mode.
 	VPROF_BUDGET( "StartLagCompensation", VPROF_BUDGETGROUP_OTHER_NETWORKING );
-	Q_memset( m_RestoreData, 0, sizeof( m_RestoreData ) );
-	Q_memset( m_ChangeData, 0, sizeof( m_ChangeData ) );
 
 	m_isCurrentlyDoingCompensation = true;
 
@@ -410,6 +931,10 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 		// DevMsg("StartLagCompensation: delta too big (%.3f)\n", deltaTime );
 		targettick = gpGlobals->tickcount - TIME_TO_TICKS( correct );
 	}
+
+	// where the shot comes from, for culling targets it can't reach
+	m_vecShooterEyePosition = player->EyePosition();
+	AngleVectors( cmd->viewangles, &m_vecShooterForward );
 	
 	// Iterate all active players
 	const CBitVec<MAX_EDICTS> *pEntityTransmitBits = engine->GetEntityTransmitBitsForClient( player->entindex() - 1 );
@@ -435,76 +960,171 @@ void CLagCompensationManager::StartLagCompensation( CBasePlayer *player, CUserCm
 		// Move other player back in time
 		BacktrackPlayer( pPlayer, TICKS_TO_TIME( targettick ) );
 	}
+
+	// Iterate all registered non-player entities
+	for ( int i = 0; i < m_AdditionalTracks.Count(); i++ )
+	{
+		CLagTrack *track = m_AdditionalTracks[i];
+		CBaseAnimatingOverlay *pEntity = track->m_hEntity;
+
+		if ( !pEntity )
+		{
+			continue;
+		}
+
+		// Team members shouldn't be adjusted unless friendly fire is on.
+		if ( !friendlyfire.GetInt() && pEntity->GetTeamNumber() == player->GetTeamNumber() )
+			continue;
+
+		// If this entity hasn't been transmitted to us and acked, then don't bother lag compensating it.
+		if ( pEntityTransmitBits && !pEntityTransmitBits->Get( pEntity->entindex() ) )
+			continue;
+
+		BacktrackEntity( track, pEntity, TICKS_TO_TIME( targettick ) );
+	}
+
+	if ( sv_unlag_bonecache.GetBool() && sv_lagflushbonecache.GetBool() )
+	{
+		SetupRewoundBones();
+	}
 }
 
-void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTargetTime )
+static void SetupRewoundBonesJob( LagBoneSetupJob &job )
 {
-	Vector org;
-	Vector minsPreScaled;
-	Vector maxsPreScaled;
-	QAngle ang;
+	job.m_pEntity->SetupBones( job.m_pBones, job.m_pEntity->GetBoneCacheMask() );
+}
 
-	VPROF_BUDGET( "BacktrackPlayer", "CLagCompensationManager" );
-	int pl_index = pPlayer->entindex() - 1;
+//-----------------------------------------------------------------------------
+// Purpose: Find bones already set up this tick for an entity in this state
+//-----------------------------------------------------------------------------
+int CLagCompensationManager::FindBoneCacheEntry( CBaseAnimatingOverlay *pEntity, const LagBoneState &state, CRC32_t nHash ) const
+{
+	for ( int i = 0; i < m_BoneCacheEntries.Count(); i++ )
+	{
+		const LagBoneCacheEntry &entry = m_BoneCacheEntries[i];
+		if ( entry.m_nHash == nHash && entry.m_hEntity == pEntity && entry.m_state == state )
+			return i;
+	}
 
-	// get track history of this player
-	CUtlFixedLinkedList< LagRecord > *track = &m_PlayerTrack[ pl_index ];
+	return -1;
+}
 
-	// check if we have at leat one entry
-	if ( track->Count() <= 0 )
-		return;
+//-----------------------------------------------------------------------------
+// Purpose: Fill the bone caches of the entities we just moved back. Shooters
+//			that rewind an entity to a state another shooter already used this
+//			tick reuse its bones, the rest are set up together on the thread pool.
+//-----------------------------------------------------------------------------
+void CLagCompensationManager::SetupRewoundBones()
+{
+	VPROF_BUDGET( "SetupRewoundBones", "CLagCompensationManager" );
 
-	intp curr = track->Head();
+	if ( m_nBoneCacheTick != gpGlobals->tickcount )
+	{
+		m_nBoneCacheTick = gpGlobals->tickcount;
+		m_BoneCacheEntries.RemoveAll();
+		m_BoneCacheMatrices.RemoveAll();
+	}
 
-	LagRecord *prevRecord = NULL;
-	LagRecord *record = NULL;
+	m_BoneSetupJobs.RemoveAll();
 
-	Vector prevOrg = pPlayer->GetLocalOrigin();
-	
-	// Walk context looking for any invalidating event
-	while( track->IsValidIndex(curr) )
+	for ( int i = 0; i < m_RestoreTracks.Count(); i++ )
 	{
-		// remember last record
-		prevRecord = record;
+		CBaseAnimatingOverlay *pEntity = m_RestoreTracks[i]->m_hEntity;
+		if ( !pEntity || !pEntity->CanShareBoneSetup() )
+			continue;
 
-		// get next record
-		record = &track->Element( curr );
+		// also makes sure the model is loaded before any job runs
+		CStudioHdr *pStudioHdr = pEntity->GetModelPtr();
+		if ( !pStudioHdr || !pStudioHdr->numbones() )
+			continue;
 
-		if ( !(record->m_fFlags & LC_ALIVE) )
-		{
-			// player most be alive, lost track
-			return;
-		}
+		// computes the abs origin and angles on this thread, which the jobs rely on
+		LagBoneState state;
+		state.Save( pEntity );
+		CRC32_t nHash = CRC32_ProcessSingleBuffer( &state, sizeof( state ) );
 
-		Vector delta = record->m_vecOrigin - prevOrg;
-		if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
+		int iEntry = FindBoneCacheEntry( pEntity, state, nHash );
+		if ( iEntry >= 0 )
 		{
-			// lost track, too much difference
-			return; 
+			pEntity->SetCachedBones( &m_BoneCacheMatrices[ m_BoneCacheEntries[iEntry].m_iFirstBone ] );
+			continue;
 		}
 
-		// did we find a context smaller than target time ?
-		if ( record->m_flSimulationTime <= flTargetTime )
-			break; // hurra, stop
+		iEntry = m_BoneCacheEntries.AddToTail();
+		LagBoneCacheEntry &entry = m_BoneCacheEntries[iEntry];
+		entry.m_hEntity = pEntity;
+		entry.m_nHash = nHash;
+		entry.m_state = state;
+		entry.m_iFirstBone = m_BoneCacheMatrices.AddMultipleToTail( pStudioHdr->numbones() );
+
+		LagBoneSetupJob &job = m_BoneSetupJobs[ m_BoneSetupJobs.AddToTail() ];
+		job.m_pEntity = pEntity;
+		job.m_iEntry = iEntry;
+	}
 
-		prevOrg = record->m_vecOrigin;
+	if ( !m_BoneSetupJobs.Count() )
+		return;
 
-		// go one step back
-		curr = track->Next( curr );
+	// the matrices don't move once everything is allocated
+	for ( int i = 0; i < m_BoneSetupJobs.Count(); i++ )
+	{
+		LagBoneSetupJob &job = m_BoneSetupJobs[i];
+		job.m_pBones = &m_BoneCacheMatrices[ m_BoneCacheEntries[job.m_iEntry].m_iFirstBone ];
 	}
 
-	Assert( record );
+	ParallelProcess( "CLagCompensationManager::SetupRewoundBones", m_BoneSetupJobs.Base(), m_BoneSetupJobs.Count(), &SetupRewoundBonesJob, NULL, NULL,
+		sv_unlag_bonecache_threaded.GetBool() ? INT_MAX : 0 );
 
-	if ( !record )
+	for ( int i = 0; i < m_BoneSetupJobs.Count(); i++ )
 	{
-		if ( sv_unlag_debug.GetBool() )
-		{
-			DevMsg( "No valid positions in history for BacktrackPlayer client ( %s )\n", pPlayer->GetPlayerName() );
-		}
+		LagBoneSetupJob &job = m_BoneSetupJobs[i];
+		job.m_pEntity->SetCachedBones( job.m_pBones );
+	}
+}
+
+void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTargetTime )
+{
+	CLagTrack *track = m_pPlayerTrack[ pPlayer->entindex() - 1 ];
+
+	// check if we have a history of this player
+	if ( !track || track->m_hEntity != pPlayer )
+		return;
+
+	BacktrackEntity( track, pPlayer, flTargetTime );
+}
+
+void CLagCompensationManager::BacktrackEntity( CLagTrack *track, CBaseAnimatingOverlay *pEntity, float flTargetTime )
+{
+	Vector org;
+	Vector minsPreScaled;
+	Vector maxsPreScaled;
+	QAngle ang;
+
+	VPROF_BUDGET( "BacktrackEntity", "CLagCompensationManager" );
 
-		return; // that should never happen
+	// check if we have at leat one entry
+	if ( track->Count() <= 0 )
+		return;
+
+	Vector delta = track->Newest().m_vecOrigin - pEntity->GetLocalOrigin();
+	if ( delta.Length2DSqr() > m_flTeleportDistanceSqr )
+	{
+		// lost track, moved too far since the last record
+		return;
 	}
 
+	// find the record at the target time
+	int recordIndex = track->FindRecord( flTargetTime );
+
+	if ( !track->CanBacktrackTo( recordIndex ) )
+	{
+		// must be alive and not teleported since then, lost track
+		return;
+	}
+
+	const LagRecord *record = &track->Get( recordIndex );
+	const LagRecord *prevRecord = ( recordIndex + 1 < track->Count() ) ? &track->Get( recordIndex + 1 ) : NULL;
+
 	float frac = 0.0f;
 	if ( prevRecord && 
 		 (record->m_flSimulationTime < flTargetTime) &&
@@ -537,9 +1157,23 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		maxsPreScaled	= record->m_vecMaxsPreScaled;
 	}
 
+	// Don't bother moving it if the shot can't reach where it was
+	if ( sv_unlag_cull.GetBool() && !pEntity->GetMoveParent() )
+	{
+		Vector vecCenter = org + pEntity->CollisionProp()->OBBCenter();
+		float flRadius = pEntity->CollisionProp()->BoundingRadius() + LAG_COMPENSATION_CULL_MARGIN;
+
+		if ( !IsInFireCone( vecCenter, flRadius ) )
+			return;
+	}
+
+	int pl_index = pEntity->IsPlayer() ? pEntity->entindex() - 1 : -1;
+
 	// See if this is still a valid position for us to teleport to
-	if ( sv_unlag_fixstuck.GetBool() )
+	if ( pl_index >= 0 && sv_unlag_fixstuck.GetBool() )
 	{
+		CBasePlayer *pPlayer = static_cast< CBasePlayer * >( pEntity );
+
 		// Try to move to the wanted position from our current position.
 		trace_t tr;
 		UTIL_TraceEntity( pPlayer, org, org, MASK_PLAYERSOLID, &tr );
@@ -559,7 +1193,6 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 				{
 					// prevent recursion - save a copy of m_RestorePlayer,
 					// pretend that this player is off-limits
-					int pl_index = pPlayer->entindex() - 1;
 
 					// Temp turn this flag on
 					m_RestorePlayer.Set( pl_index );
@@ -596,34 +1229,34 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		}
 	}
 	
-	// See if this represents a change for the player
+	// See if this represents a change for the entity
 	int flags = 0;
-	LagRecord *restore = &m_RestoreData[ pl_index ];
-	LagRecord *change  = &m_ChangeData[ pl_index ];
+	LagRestoreRecord *restore = &track->m_restore;
+	LagRestoreRecord *change  = &track->m_change;
 
-	QAngle angdiff = pPlayer->GetLocalAngles() - ang;
-	Vector orgdiff = pPlayer->GetLocalOrigin() - org;
+	QAngle angdiff = pEntity->GetLocalAngles() - ang;
+	Vector orgdiff = pEntity->GetLocalOrigin() - org;
 
 	// Always remember the pristine simulation time in case we need to restore it.
-	restore->m_flSimulationTime = pPlayer->GetSimulationTime();
+	restore->m_flSimulationTime = pEntity->GetSimulationTime();
 
 	if ( angdiff.LengthSqr() > LAG_COMPENSATION_EPS_SQR )
 	{
 		flags |= LC_ANGLES_CHANGED;
-		restore->m_vecAngles = pPlayer->GetLocalAngles();
-		pPlayer->SetLocalAngles( ang );
+		restore->m_vecAngles = pEntity->GetLocalAngles();
+		pEntity->SetLocalAngles( ang );
 		change->m_vecAngles = ang;
 	}
 
 	// Use absolute equality here
-	if ( minsPreScaled != pPlayer->CollisionProp()->OBBMinsPreScaled() || maxsPreScaled != pPlayer->CollisionProp()->OBBMaxsPreScaled() )
+	if ( minsPreScaled != pEntity->CollisionProp()->OBBMinsPreScaled() || maxsPreScaled != pEntity->CollisionProp()->OBBMaxsPreScaled() )
 	{
 		flags |= LC_SIZE_CHANGED;
 
-		restore->m_vecMinsPreScaled = pPlayer->CollisionProp()->OBBMinsPreScaled();
-		restore->m_vecMaxsPreScaled = pPlayer->CollisionProp()->OBBMaxsPreScaled();
+		restore->m_vecMinsPreScaled = pEntity->CollisionProp()->OBBMinsPreScaled();
+		restore->m_vecMaxsPreScaled = pEntity->CollisionProp()->OBBMaxsPreScaled();
 		
-		pPlayer->SetSize( minsPreScaled, maxsPreScaled );
+		pEntity->SetSize( minsPreScaled, maxsPreScaled );
 		
 		change->m_vecMinsPreScaled = minsPreScaled;
 		change->m_vecMaxsPreScaled = maxsPreScaled;
@@ -633,8 +1266,8 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	if ( orgdiff.LengthSqr() > LAG_COMPENSATION_EPS_SQR )
 	{
 		flags |= LC_ORIGIN_CHANGED;
-		restore->m_vecOrigin = pPlayer->GetLocalOrigin();
-		pPlayer->SetLocalOrigin( org );
+		restore->m_vecOrigin = pEntity->GetLocalOrigin();
+		pEntity->SetLocalOrigin( org );
 		change->m_vecOrigin = org;
 	}
 
@@ -642,8 +1275,14 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	// standing still, but you breathe even on the server.
 	// This is quicker than actually comparing all bazillion floats.
 	flags |= LC_ANIMATION_CHANGED;
-	restore->m_masterSequence = pPlayer->GetSequence();
-	restore->m_masterCycle = pPlayer->GetCycle();
+	restore->m_masterSequence = pEntity->GetSequence();
+	restore->m_masterCycle = pEntity->GetCycle();
+	restore->m_animation.Save( pEntity );
+
+	// rebuild the animation of the records we're using from the stored deltas
+	LagAnimation recordAnimation;
+	LagAnimation prevRecordAnimation;
+	track->GetAnimation( recordIndex, &recordAnimation, prevRecord ? &prevRecordAnimation : NULL );
 
 	bool interpolationAllowed = false;
 	if( prevRecord && (record->m_masterSequence == prevRecord->m_masterSequence) )
@@ -658,57 +1297,47 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 	if( frac > 0.0f && interpolationAllowed )
 	{
 		interpolatedMasters = true;
-		pPlayer->SetSequence( Lerp( frac, record->m_masterSequence, prevRecord->m_masterSequence ) );
-		pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
+		pEntity->SetSequence( Lerp( frac, record->m_masterSequence, prevRecord->m_masterSequence ) );
+		pEntity->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
 
 		if( record->m_masterCycle > prevRecord->m_masterCycle )
 		{
 			// the older record is higher in frame than the newer, it must have wrapped around from 1 back to 0
 			// add one to the newer so it is lerping from .9 to 1.1 instead of .9 to .1, for example.
 			float newCycle = Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle + 1 );
-			pPlayer->SetCycle(newCycle < 1 ? newCycle : newCycle - 1 );// and make sure .9 to 1.2 does not end up 1.05
+			pEntity->SetCycle(newCycle < 1 ? newCycle : newCycle - 1 );// and make sure .9 to 1.2 does not end up 1.05
 		}
 		else
 		{
-			pPlayer->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
-		}
-
-		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
-		{
-			//don't lerp pose params, just pick the closest
-			pPlayer->SetPoseParameter( i, record->m_flPoseParameters[i] );
-			//pAnimating->SetPoseParameter( i, Lerp( frac, record->m_flPoseParameters[i], prevRecord->m_flPoseParameters[i] ) );
+			pEntity->SetCycle( Lerp( frac, record->m_masterCycle, prevRecord->m_masterCycle ) );
 		}
 	}
 	if( !interpolatedMasters )
 	{
-		pPlayer->SetSequence(record->m_masterSequence);
-		pPlayer->SetCycle(record->m_masterCycle);
+		pEntity->SetSequence(record->m_masterSequence);
+		pEntity->SetCycle(record->m_masterCycle);
+	}
 
-		for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
-		{
-			pPlayer->SetPoseParameter( i, record->m_flPoseParameters[i] );
-		}
+	//don't lerp pose params, just pick the closest
+	for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
+	{
+		pEntity->SetPoseParameter( i, recordAnimation.m_flPoseParameters[i] );
 	}
 
 	////////////////////////
 	// Now do all the layers
-	int layerCount = pPlayer->GetNumAnimOverlays();
+	int layerCount = MIN( pEntity->GetNumAnimOverlays(), MAX_LAYER_RECORDS );
 	for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
 	{
-		CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
+		CAnimationLayer *currentLayer = pEntity->GetAnimOverlay(layerIndex);
 		if( currentLayer )
 		{
-			restore->m_layerRecords[layerIndex].m_cycle = currentLayer->m_flCycle;
-			restore->m_layerRecords[layerIndex].m_order = currentLayer->m_nOrder;
-			restore->m_layerRecords[layerIndex].m_sequence = currentLayer->m_nSequence;
-			restore->m_layerRecords[layerIndex].m_weight = currentLayer->m_flWeight;
+			const LayerRecord &recordsLayerRecord = recordAnimation.m_layerRecords[layerIndex];
 
 			bool interpolated = false;
 			if( (frac > 0.0f)  &&  interpolationAllowed )
 			{
-				LayerRecord &recordsLayerRecord = record->m_layerRecords[layerIndex];
-				LayerRecord &prevRecordsLayerRecord = prevRecord->m_layerRecords[layerIndex];
+				const LayerRecord &prevRecordsLayerRecord = prevRecordAnimation.m_layerRecords[layerIndex];
 				if( (recordsLayerRecord.m_order == prevRecordsLayerRecord.m_order)
 					&& (recordsLayerRecord.m_sequence == prevRecordsLayerRecord.m_sequence)
 					)
@@ -734,10 +1363,10 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 			if( !interpolated )
 			{
 				//Either no interp, or interp failed.  Just use record.
-				currentLayer->m_flCycle = record->m_layerRecords[layerIndex].m_cycle;
-				currentLayer->m_nOrder = record->m_layerRecords[layerIndex].m_order;
-				currentLayer->m_nSequence = record->m_layerRecords[layerIndex].m_sequence;
-				currentLayer->m_flWeight = record->m_layerRecords[layerIndex].m_weight;
+				currentLayer->m_flCycle = recordsLayerRecord.m_cycle;
+				currentLayer->m_nOrder = recordsLayerRecord.m_order;
+				currentLayer->m_nSequence = recordsLayerRecord.m_sequence;
+				currentLayer->m_flWeight = recordsLayerRecord.m_weight;
 			}
 		}
 	}
@@ -746,21 +1375,28 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 		return; // we didn't change anything
 
 	if ( sv_lagflushbonecache.GetBool() )
-		pPlayer->InvalidateBoneCache();
+		pEntity->InvalidateBoneCache();
 
 	/*char text[256]; Q_snprintf( text, sizeof(text), "time %.2f", flTargetTime );
-	pPlayer->DrawServerHitboxes( 10 );
+	pEntity->DrawServerHitboxes( 10 );
 	NDebugOverlay::Text( org, text, false, 10 );
-	NDebugOverlay::EntityBounds( pPlayer, 255, 0, 0, 32, 10 ); */
+	NDebugOverlay::EntityBounds( pEntity, 255, 0, 0, 32, 10 ); */
+
+	if ( pl_index >= 0 )
+	{
+		m_RestorePlayer.Set( pl_index ); //remember that we changed this player
+	}
 
-	m_RestorePlayer.Set( pl_index ); //remember that we changed this player
-	m_bNeedToRestore = true;  // we changed at least one player
+	if ( !restore->m_fFlags )
+	{
+		m_RestoreTracks.AddToTail( track ); // we changed at least one entity
+	}
 	restore->m_fFlags = flags; // we need to restore these flags
 	change->m_fFlags = flags; // we have changed these flags
 
 	if( sv_showlagcompensation.GetInt() == 1 )
 	{
-		pPlayer->DrawServerHitboxes(4, true);
+		pEntity->DrawServerHitboxes(4, true);
 	}
 }
 
@@ -768,108 +1404,97 @@ void CLagCompensationManager::BacktrackPlayer( CBasePlayer *pPlayer, float flTar
 void CLagCompensationManager::FinishLagCompensation( CBasePlayer *player )
 {
 	VPROF_BUDGET_FLAGS( "FinishLagCompensation", VPROF_BUDGETGROUP_OTHER_NETWORKING, BUDGETFLAG_CLIENT|BUDGETFLAG_SERVER );
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_LAG_COMPENSATION );
 
 	m_pCurrentPlayer = NULL;
 
-	if ( !m_bNeedToRestore )
+	if ( !m_RestoreTracks.Count() )
 	{
 		m_isCurrentlyDoingCompensation = false;
-		return; // no player was changed at all
+		return; // no entity was changed at all
 	}
 
-	// Iterate all active players
-	for ( int i = 1; i <= gpGlobals->maxClients; i++ )
+	// Iterate all entities we moved
+	for ( int i = 0; i < m_RestoreTracks.Count(); i++ )
 	{
-		int pl_index = i - 1;
-		
-		if ( !m_RestorePlayer.Get( pl_index ) )
-		{
-			// player wasn't changed by lag compensation
-			continue;
-		}
+		CLagTrack *track = m_RestoreTracks[i];
 
-		CBasePlayer *pPlayer = UTIL_PlayerByIndex( i );
-		if ( !pPlayer )
+		LagRestoreRecord *restore = &track->m_restore;
+		LagRestoreRecord *change  = &track->m_change;
+
+		int restoreFlags = restore->m_fFlags;
+		restore->m_fFlags = 0;
+
+		CBaseAnimatingOverlay *pEntity = track->m_hEntity;
+		if ( !pEntity )
 		{
 			continue;
 		}
 
-		LagRecord *restore = &m_RestoreData[ pl_index ];
-		LagRecord *change  = &m_ChangeData[ pl_index ];
-
 		bool restoreSimulationTime = false;
 
-		if ( restore->m_fFlags & LC_SIZE_CHANGED )
+		if ( restoreFlags & LC_SIZE_CHANGED )
 		{
 			restoreSimulationTime = true;
 	
 			// see if simulation made any changes, if no, then do the restore, otherwise,
 			//  leave new values in
-			if ( pPlayer->CollisionProp()->OBBMinsPreScaled() == change->m_vecMinsPreScaled &&
-				pPlayer->CollisionProp()->OBBMaxsPreScaled() == change->m_vecMaxsPreScaled )
+			if ( pEntity->CollisionProp()->OBBMinsPreScaled() == change->m_vecMinsPreScaled &&
+				pEntity->CollisionProp()->OBBMaxsPreScaled() == change->m_vecMaxsPreScaled )
 			{
 				// Restore it
-				pPlayer->SetSize( restore->m_vecMinsPreScaled, restore->m_vecMaxsPreScaled );
+				pEntity->SetSize( restore->m_vecMinsPreScaled, restore->m_vecMaxsPreScaled );
 			}
 		}
 
-		if ( restore->m_fFlags & LC_ANGLES_CHANGED )
+		if ( restoreFlags & LC_ANGLES_CHANGED )
 		{		   
 			restoreSimulationTime = true;
 
-			if ( pPlayer->GetLocalAngles() == change->m_vecAngles )
+			if ( pEntity->GetLocalAngles() == change->m_vecAngles )
 			{
-				pPlayer->SetLocalAngles( restore->m_vecAngles );
+				pEntity->SetLocalAngles( restore->m_vecAngles );
 			}
 		}
 
-		if ( restore->m_fFlags & LC_ORIGIN_CHANGED )
+		if ( restoreFlags & LC_ORIGIN_CHANGED )
 		{
 			restoreSimulationTime = true;
 
 			// Okay, let's see if we can do something reasonable with the change
-			Vector delta = pPlayer->GetLocalOrigin() - change->m_vecOrigin;
+			Vector delta = pEntity->GetLocalOrigin() - change->m_vecOrigin;
 			
-			// If it moved really far, just leave the player in the new spot!!!
+			// If it moved really far, just leave the entity in the new spot!!!
 			if ( delta.Length2DSqr() < m_flTeleportDistanceSqr )
 			{
-				RestorePlayerTo( pPlayer, restore->m_vecOrigin + delta );
+				if ( pEntity->IsPlayer() )
+				{
+					RestorePlayerTo( static_cast< CBasePlayer * >( pEntity ), restore->m_vecOrigin + delta );
+				}
+				else
+				{
+					pEntity->SetLocalOrigin( restore->m_vecOrigin + delta );
+				}
 			}
 		}
 
-		if( restore->m_fFlags & LC_ANIMATION_CHANGED )
+		if( restoreFlags & LC_ANIMATION_CHANGED )
 		{
 			restoreSimulationTime = true;
 
-			pPlayer->SetSequence(restore->m_masterSequence);
-			pPlayer->SetCycle(restore->m_masterCycle);
+			pEntity->SetSequence(restore->m_masterSequence);
+			pEntity->SetCycle(restore->m_masterCycle);
 
-			int layerCount = pPlayer->GetNumAnimOverlays();
-			for( int layerIndex = 0; layerIndex < layerCount; ++layerIndex )
-			{
-				CAnimationLayer *currentLayer = pPlayer->GetAnimOverlay(layerIndex);
-				if( currentLayer )
-				{
-					currentLayer->m_flCycle = restore->m_layerRecords[layerIndex].m_cycle;
-					currentLayer->m_nOrder = restore->m_layerRecords[layerIndex].m_order;
-					currentLayer->m_nSequence = restore->m_layerRecords[layerIndex].m_sequence;
-					currentLayer->m_flWeight = restore->m_layerRecords[layerIndex].m_weight;
-				}
-			}
-
-			for( int i=0; i<MAXSTUDIOPOSEPARAM; i++ )
-			{
-				pPlayer->SetPoseParameter( i, restore->m_flPoseParameters[i] );
-			}
+			restore->m_animation.Apply( pEntity );
 		}
 
 		if ( restoreSimulationTime )
 		{
-			pPlayer->SetSimulationTime( restore->m_flSimulationTime );
+			pEntity->SetSimulationTime( restore->m_flSimulationTime );
 		}
 	}
 
+	m_RestoreTracks.RemoveAll();
+
 	m_isCurrentlyDoingCompensation = false;
 }
-
-
@@ -20,15 +20,65 @@
 
 static ConVar sv_benchmark_numticks( "sv_benchmark_numticks", "3300", 0, "If > 0, then it only runs the benchmark for this # of ticks." );
 static ConVar sv_benchmark_autovprofrecord( "sv_benchmark_autovprofrecord", "0", 0, "If running a benchmark and this is set, it will record a vprof file over the duration of the benchmark with filename benchmark.vprof." );
+static ConVar sv_benchmark_bots( "sv_benchmark_bots", "22", 0, "Number of bots the benchmark creates.", true, 0, true, MAX_PLAYERS );
+static ConVar sv_benchmark_seed( "sv_benchmark_seed", "1111", 0, "Random seed for the benchmark. Runs with the same seed, map and settings do the same thing on the same ticks." );
+static ConVar sv_benchmark_report( "sv_benchmark_report", "sv_benchmark.json", 0, "File the benchmark writes its JSON report to. Empty to skip the report." );
+static ConVar sv_benchmark_quit( "sv_benchmark_quit", "0", 0, "Quit once the benchmark finishes, after writing sv_benchmark_results.txt and the report." );
 
 static float s_flBenchmarkStartWaitSeconds = 3;	// Wait this many seconds after level load before starting the benchmark.
 
-static int s_nBenchmarkBotsToCreate = 22;		// Create this many bots.
 static int s_nBenchmarkBotCreateInterval = 50;	// Create a bot every N ticks.
 
 static int s_nBenchmarkPhysicsObjects = 100;	// Create this many physics objects.
 
 
+static bool s_bBenchmarkPending = false;		// sv_benchmark_run was used to load the level
+
+
+// ---------------------------------------------------------------------------------------------- //
+// Subsystem timers.
+// ---------------------------------------------------------------------------------------------- //
+bool g_bServerBenchmarkTimersActive = false;
+
+static bool s_bBenchmarkTimerOpen[SV_BENCHMARK_TIMER_COUNT];
+static uint64 s_nBenchmarkTimerCycles[SV_BENCHMARK_TIMER_COUNT];
+
+static const char *s_pszBenchmarkTimerNames[SV_BENCHMARK_TIMER_COUNT] =
+{
+	"entity_think",
+	"nextbot_update",
+	"pathfinding",
+	"lag_compensation",
+	"game_movement",
+	"event_queue",
+	"attribute_hooks",
+	"check_transmit",
+};
+
+bool ServerBenchmark_EnterTimer( ServerBenchmarkTimer_t timer )
+{
+	// Nested and recursive calls are already covered by the outermost one
+	if ( s_bBenchmarkTimerOpen[timer] || !ThreadInMainThread() )
+		return false;
+
+	s_bBenchmarkTimerOpen[timer] = true;
+	return true;
+}
+
+void ServerBenchmark_ExitTimer( ServerBenchmarkTimer_t timer, const CCycleCount &duration )
+{
+	s_bBenchmarkTimerOpen[timer] = false;
+	s_nBenchmarkTimerCycles[timer] += duration.GetLongCycles();
+}
+
+static double Benchmark_CyclesToMS( uint64 nCycles )
+{
+	CCycleCount count;
+	count.Init( nCycles );
+	return count.GetMillisecondsF();
+}
+
+
 static double Benchmark_ValidTime()
 {
 	bool bOld = Plat_IsInBenchmarkMode();
@@ -51,14 +101,23 @@ public:
 		m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
 		
 		// The benchmark should always have the same seed and do exactly the same thing on the same ticks.
-		m_RandomStream.SetSeed( 1111 ); 
+		m_RandomStream.SetSeed( sv_benchmark_seed.GetInt() );
+
+		m_bFrameStarted = false;
 	}
 
 	virtual bool StartBenchmark()
 	{
-		bool bBenchmark = (CommandLine()->FindParm( "-sv_benchmark" ) != 0);
+		bool bBenchmark = (CommandLine()->FindParm( "-sv_benchmark" ) != 0) || s_bBenchmarkPending;
+		s_bBenchmarkPending = false;
 
-		return InternalStartBenchmark( bBenchmark, s_flBenchmarkStartWaitSeconds );
+		int nBenchmarkMode = 0;
+		if ( bBenchmark )
+		{
+			nBenchmarkMode = sv_benchmark_quit.GetBool() ? 2 : 1;
+		}
+
+		return InternalStartBenchmark( nBenchmarkMode, s_flBenchmarkStartWaitSeconds );
 	}
 
 	// nBenchmarkMode: 0 = no benchmark
@@ -87,6 +146,7 @@ public:
 
 		m_nBotsCreated = 0;
 		m_nStartWaitCounter = -1;
+		m_RandomStream.SetSeed( sv_benchmark_seed.GetInt() );
 
 		// Setup the benchmark environment.
 		engine->SetDedicatedServerBenchmarkMode( true );	// Run 1 tick per frame and ignore all timing stuff.
@@ -124,8 +184,16 @@ public:
 
 				StartVProfRecord();
 
-				RandomSeed( 0 );
-				m_RandomStream.SetSeed( 0 );
+				RandomSeed( sv_benchmark_seed.GetInt() );
+				m_RandomStream.SetSeed( sv_benchmark_seed.GetInt() );
+
+				// Subsystem timing starts with the next full frame
+				m_bFrameStarted = false;
+				m_FrameMS.RemoveAll();
+				for ( int i = 0; i < SV_BENCHMARK_TIMER_COUNT; i++ )
+				{
+					m_TimerMS[i].RemoveAll();
+				}
 			}
 		}
 
@@ -137,6 +205,7 @@ public:
 		{
 			EndVProfRecord();
 			OutputResults();
+			WriteReport();
 			EndBenchmark();
 			return;
 		}
@@ -147,6 +216,34 @@ public:
 		CServerBenchmarkHook::s_pBenchmarkHook->UpdateBenchmark();
 	}
 
+	// Closes out the previous tick: its wall time, and how much of it each subsystem took
+	virtual void StartFrame()
+	{
+		if ( m_BenchmarkState != BENCHMARKSTATE_RUNNING )
+			return;
+
+		CCycleCount now;
+		now.Sample();
+
+		if ( m_bFrameStarted )
+		{
+			m_FrameMS.AddToTail( Benchmark_CyclesToMS( now.GetLongCycles() - m_FrameStart.GetLongCycles() ) );
+			for ( int i = 0; i < SV_BENCHMARK_TIMER_COUNT; i++ )
+			{
+				m_TimerMS[i].AddToTail( Benchmark_CyclesToMS( s_nBenchmarkTimerCycles[i] ) );
+			}
+		}
+
+		for ( int i = 0; i < SV_BENCHMARK_TIMER_COUNT; i++ )
+		{
+			s_nBenchmarkTimerCycles[i] = 0;
+		}
+
+		m_FrameStart = now;
+		m_bFrameStarted = true;
+		g_bServerBenchmarkTimersActive = true;
+	}
+
 	void StartVProfRecord()
 	{
 		if ( sv_benchmark_autovprofrecord.GetInt() )
@@ -185,6 +282,7 @@ public:
 		}
 		
 		m_BenchmarkState = BENCHMARKSTATE_NOT_RUNNING;
+		g_bServerBenchmarkTimersActive = false;
 		engine->SetDedicatedServerBenchmarkMode( false );
 	}
 
@@ -313,7 +411,7 @@ public:
 
 	void UpdatePlayerCreation()
 	{
-		if ( m_nBotsCreated >= s_nBenchmarkBotsToCreate )
+		if ( m_nBotsCreated >= sv_benchmark_bots.GetInt() )
 			return;
 
 		// Spawn the player.
@@ -338,6 +436,81 @@ public:
 		Warning( "--------------------------------------------------------------\n" );
 	}
 
+	static float Percentile( const CUtlVector<float> &sorted, float flFraction )
+	{
+		if ( sorted.Count() == 0 )
+			return 0.0f;
+
+		int i = (int)ceil( flFraction * sorted.Count() ) - 1;
+		return sorted[ clamp( i, 0, sorted.Count() - 1 ) ];
+	}
+
+	static int __cdecl SortFloats( const float *pLeft, const float *pRight )
+	{
+		return ( *pLeft < *pRight ) ? -1 : ( ( *pLeft > *pRight ) ? 1 : 0 );
+	}
+
+	// Writes "name": { total, mean, percentiles, max } for one list of per-tick times
+	void WriteTickTimes( FileHandle_t fh, const char *pszName, const CUtlVector<float> &ticks, bool bLast )
+	{
+		CUtlVector<float> sorted;
+		sorted.CopyArray( ticks.Base(), ticks.Count() );
+		sorted.Sort( &SortFloats );
+
+		double flTotal = 0;
+		for ( int i = 0; i < sorted.Count(); i++ )
+		{
+			flTotal += sorted[i];
+		}
+
+		filesystem->FPrintf( fh, "\t\t\"%s\": { \"total_ms\": %.3f, \"mean_ms\": %.4f, \"p50_ms\": %.4f, \"p90_ms\": %.4f, \"p99_ms\": %.4f, \"p999_ms\": %.4f, \"max_ms\": %.4f }%s\n",
+			pszName, flTotal, sorted.Count() ? flTotal / sorted.Count() : 0.0,
+			Percentile( sorted, 0.5f ), Percentile( sorted, 0.9f ), Percentile( sorted, 0.99f ), Percentile( sorted, 0.999f ),
+			sorted.Count() ? sorted.Tail() : 0.0f, bLast ? "" : "," );
+	}
+
+	// Machine readable results, for build gates and comparing hardware
+	void WriteReport()
+	{
+		const char *pszReport = sv_benchmark_report.GetString();
+		if ( !pszReport[0] )
+			return;
+
+		FileHandle_t fh = filesystem->Open( pszReport, "wt", "DEFAULT_WRITE_PATH" );
+		if ( !fh )
+		{
+			Warning( "Server benchmark: couldn't write %s\n", pszReport );
+			return;
+		}
+
+		float flRunTime = Benchmark_ValidTime() - m_fl_ValidTime_BenchmarkStartTime;
+
+		filesystem->FPrintf( fh, "{\n" );
+		filesystem->FPrintf( fh, "\t\"map\": \"%s\",\n", STRING( gpGlobals->mapname ) );
+		filesystem->FPrintf( fh, "\t\"game_mode\": \"%s\",\n", CServerBenchmarkHook::s_pBenchmarkHook->GetGameModeName() );
+		filesystem->FPrintf( fh, "\t\"bots\": %d,\n", sv_benchmark_bots.GetInt() );
+		filesystem->FPrintf( fh, "\t\"seed\": %d,\n", sv_benchmark_seed.GetInt() );
+		filesystem->FPrintf( fh, "\t\"ticks\": %d,\n", sv_benchmark_numticks.GetInt() );
+		filesystem->FPrintf( fh, "\t\"tick_interval_ms\": %.4f,\n", gpGlobals->interval_per_tick * 1000.0f );
+		filesystem->FPrintf( fh, "\t\"total_seconds\": %.3f,\n", flRunTime );
+		filesystem->FPrintf( fh, "\t\"ticks_per_second\": %.2f,\n", sv_benchmark_numticks.GetInt() / flRunTime );
+		filesystem->FPrintf( fh, "\t\"crc\": %d,\n", CalculateBenchmarkCRC() );
+		filesystem->FPrintf( fh, "\t\"frames_timed\": %d,\n", m_FrameMS.Count() );
+		filesystem->FPrintf( fh, "\t\"frame\": {\n" );
+		WriteTickTimes( fh, "tick", m_FrameMS, true );
+		filesystem->FPrintf( fh, "\t},\n" );
+		filesystem->FPrintf( fh, "\t\"subsystems\": {\n" );
+		for ( int i = 0; i < SV_BENCHMARK_TIMER_COUNT; i++ )
+		{
+			WriteTickTimes( fh, s_pszBenchmarkTimerNames[i], m_TimerMS[i], i == SV_BENCHMARK_TIMER_COUNT - 1 );
+		}
+		filesystem->FPrintf( fh, "\t}\n" );
+		filesystem->FPrintf( fh, "}\n" );
+
+		filesystem->Close( fh );
+		Msg( "Server benchmark: wrote %s\n", pszReport );
+	}
+
 	int CalculateBenchmarkCRC()
 	{
 		int crc = 0;
@@ -395,6 +568,12 @@ private:
 	int m_nBenchmarkMode;
 
 	CUniformRandomStream m_RandomStream;
+
+	// Per-tick wall time and subsystem times, in milliseconds
+	bool m_bFrameStarted;
+	CCycleCount m_FrameStart;
+	CUtlVector<float> m_FrameMS;
+	CUtlVector<float> m_TimerMS[SV_BENCHMARK_TIMER_COUNT];
 };
 
 static CServerBenchmark g_ServerBenchmark;
@@ -408,6 +587,27 @@ CON_COMMAND( sv_benchmark_force_start, "Force start the benchmark. This is only
 	g_ServerBenchmark.InternalStartBenchmark( 1, 1 );
 }
 
+CON_COMMAND( sv_benchmark_run, "Load a map and run the server benchmark on it, using the sv_benchmark_* settings. Usage: sv_benchmark_run <map>" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( args.ArgC() < 2 )
+	{
+		Msg( "Usage: sv_benchmark_run <map>\n" );
+		return;
+	}
+
+	if ( !engine->IsMapValid( args[1] ) )
+	{
+		Warning( "sv_benchmark_run: no such map '%s'\n", args[1] );
+		return;
+	}
+
+	s_bBenchmarkPending = true;
+	engine->ServerCommand( UTIL_VarArgs( "map %s\n", args[1] ) );
+}
+
 
 // ---------------------------------------------------------------------------------------------- //
 // CServerBenchmarkHook implementation.
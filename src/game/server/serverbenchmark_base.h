@@ -10,12 +10,15 @@
 #pragma once
 #endif
 
+#include "tier0/fasttimer.h"
+
 
 // The base server code calls into this.
 class IServerBenchmark
 {
 public:
 	virtual bool StartBenchmark() = 0;
+	virtual void StartFrame() = 0;		// called first thing each server frame, to time whole ticks
 	virtual void UpdateBenchmark() = 0;
 	virtual void EndBenchmark() = 0;
 	
@@ -31,6 +34,62 @@ public:
 extern IServerBenchmark *g_pServerBenchmark;
 
 
+//
+// Subsystems broken out in the benchmark report. Times are inclusive (pathfinding is also
+// counted under whatever asked for the path), and only the main thread is timed.
+//
+enum ServerBenchmarkTimer_t
+{
+	SV_BENCHMARK_ENTITY_THINK = 0,
+	SV_BENCHMARK_NEXTBOT_UPDATE,
+	SV_BENCHMARK_PATHFINDING,
+	SV_BENCHMARK_LAG_COMPENSATION,
+	SV_BENCHMARK_GAME_MOVEMENT,
+	SV_BENCHMARK_EVENT_QUEUE,
+	SV_BENCHMARK_ATTRIBUTE_HOOKS,
+	SV_BENCHMARK_CHECK_TRANSMIT,
+
+	SV_BENCHMARK_TIMER_COUNT
+};
+
+extern bool g_bServerBenchmarkTimersActive;
+
+bool ServerBenchmark_EnterTimer( ServerBenchmarkTimer_t timer );
+void ServerBenchmark_ExitTimer( ServerBenchmarkTimer_t timer, const CCycleCount &duration );
+
+// Times the enclosing scope into one of the buckets above while a benchmark is running.
+// Costs a single branch otherwise.
+class CServerBenchmarkScope
+{
+public:
+	CServerBenchmarkScope( ServerBenchmarkTimer_t timer )
+	{
+		m_bTiming = g_bServerBenchmarkTimersActive && ServerBenchmark_EnterTimer( timer );
+		if ( m_bTiming )
+		{
+			m_Timer = timer;
+			m_FastTimer.Start();
+		}
+	}
+
+	~CServerBenchmarkScope()
+	{
+		if ( m_bTiming )
+		{
+			m_FastTimer.End();
+			ServerBenchmark_ExitTimer( m_Timer, m_FastTimer.GetDuration() );
+		}
+	}
+
+private:
+	bool m_bTiming;
+	ServerBenchmarkTimer_t m_Timer;
+	CFastTimer m_FastTimer;
+};
+
+#define SV_BENCHMARK_SCOPE( timer )		CServerBenchmarkScope svBenchmarkScope( timer )
+
+
 //
 // Each game can derive from this to hook into the server benchmark.
 //
@@ -56,6 +115,9 @@ public:
 	// If you want to manage the bots yourself, you can return NULL here.
 	virtual CBasePlayer* CreateBot() = 0;
 
+	// Game mode description for the report, e.g. "mvm".
+	virtual const char *GetGameModeName() { return ""; }
+
 private:
 	friend class CServerBenchmark;
 	static CServerBenchmarkHook *s_pBenchmarkHook; // There can be only one!!
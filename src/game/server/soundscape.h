@@ -44,11 +44,11 @@ public:
 	void InputToggleEnabled( inputdata_t &inputdata );
 
 	string_t GetSoundscapeName() const {return m_soundscapeName;}
+	bool IsEnabled( void ) const;
 
 
 private:
 
-	bool IsEnabled( void ) const;
 	void Disable( void );
 	void Enable( void );
 
@@ -12,12 +12,20 @@
 #include "filesystem.h"
 #include "game.h"
 #include "util_shared.h"
+#include "nav_mesh.h"
 
 // memdbgon must be the last include file in a .cpp file!!!
 #include "tier0/memdbgon.h"
 
 #define SOUNDSCAPE_MANIFEST_FILE				"scripts/soundscapes_manifest.txt"
 
+// Nav areas are sampled on a grid of this spacing when baking, up to a limit per axis
+#define SOUNDSCAPE_BAKE_SAMPLE_SPACING			128.0f
+#define SOUNDSCAPE_BAKE_MAX_SAMPLES				8
+
+ConVar soundscape_bake( "soundscape_bake", "1", 0, "Look up each player's soundscape from a table baked over the nav mesh, only tracing where the table can't decide." );
+ConVar soundscape_bake_budget( "soundscape_bake_budget", "1", 0, "Milliseconds per frame spent baking the soundscape table.", true, 0.1f, false, 0 );
+
 CON_COMMAND(soundscape_flush, "Flushes the server & client side soundscapes")
 {
 	CBasePlayer *pPlayer = ToBasePlayer( UTIL_GetCommandClient() );
@@ -129,6 +137,7 @@ void CSoundscapeSystem::PrintDebugInfo()
 bool CSoundscapeSystem::Init()
 {
 	m_soundscapeCount = 0;
+	m_bakeNextArea = -1;
 
 	char maptmp[256];
 	const char *mapname = GetCleanMapName( STRING( gpGlobals->mapname ), maptmp );
@@ -185,6 +194,10 @@ void CSoundscapeSystem::Shutdown()
 	FlushSoundscapes();
 	m_soundscapeEntities.RemoveAll();
 	m_activeIndex = 0;
+	m_bakedSoundscapeForArea.Purge();
+	m_bakedNavChangeCount = 0;
+	m_bakeNextArea = -1;
+	m_bBakePending = false;
 
 	if ( IsX360() )
 	{
@@ -264,6 +277,236 @@ void CSoundscapeSystem::LevelInitPostEntity()
 		m_soundscapesInCluster[cluster].soundscapeCount++;
 		m_soundscapeIndexList[outIndex] = soundscapeIndexList[i];
 	}
+
+	// The nav mesh isn't loaded until the server activates, so bake on the first frame
+	m_bakedSoundscapeForArea.Purge();
+	m_bBakePending = true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The soundscape the player would end up with at this position with no
+//			history: the nearest soundscape that is in range and visible, whether or
+//			not it's enabled. Matches the traces CEnvSoundscape::UpdateForPlayer does.
+//-----------------------------------------------------------------------------
+int CSoundscapeSystem::FindNearestVisibleSoundscape( const Vector &position )
+{
+	int clusterIndex = engine->GetClusterForOrigin( position );
+	if ( clusterIndex < 0 || clusterIndex >= m_soundscapesInCluster.Count() )
+		return SOUNDSCAPE_BAKE_NONE;
+
+	int best = SOUNDSCAPE_BAKE_NONE;
+	float bestDistance = FLT_MAX;
+	for ( int j = 0; j < m_soundscapesInCluster[clusterIndex].soundscapeCount; j++ )
+	{
+		int ssIndex = m_soundscapeIndexList[m_soundscapesInCluster[clusterIndex].firstSoundscape + j];
+		CEnvSoundscape *pSoundscape = m_soundscapeEntities[ssIndex];
+
+		Vector target = pSoundscape->EarPosition();
+		float range = (position - target).Length();
+		if ( range >= bestDistance )
+			continue;
+		if ( !( pSoundscape->m_flRadius > range || pSoundscape->m_flRadius == -1 ) )
+			continue;
+
+		trace_t tr;
+		UTIL_TraceLine( target, position, MASK_SOLID_BRUSHONLY|MASK_WATER, NULL, COLLISION_GROUP_NONE, &tr );
+		if ( tr.fraction == 1 && !tr.startsolid )
+		{
+			best = ssIndex;
+			bestDistance = range;
+		}
+	}
+
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Start a new table. Every area reads as ambiguous until ContinueBake
+//			gets to it.
+//-----------------------------------------------------------------------------
+void CSoundscapeSystem::BeginBake( void )
+{
+	m_bakedSoundscapeForArea.Purge();
+	m_bakeNextArea = -1;
+
+	if ( !m_soundscapeEntities.Count() )
+		return;
+
+	// Moving soundscapes can't be baked
+	for ( int i = 0; i < m_soundscapeEntities.Count(); i++ )
+	{
+		if ( m_soundscapeEntities[i]->GetMoveParent() )
+			return;
+	}
+
+	unsigned int maxID = 0;
+	FOR_EACH_VEC( TheNavAreas, it )
+	{
+		maxID = MAX( maxID, TheNavAreas[it]->GetID() );
+	}
+
+	m_bakedSoundscapeForArea.SetCount( maxID + 1 );
+	for ( int i = 0; i < m_bakedSoundscapeForArea.Count(); i++ )
+	{
+		m_bakedSoundscapeForArea[i] = SOUNDSCAPE_BAKE_AMBIGUOUS;
+	}
+
+	m_bakedNavChangeCount = TheNavMesh->GetChangeCount();
+	m_bakeNextArea = 0;
+	m_bakeAmbiguousCount = 0;
+	m_bakeTime = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sample nav areas at ear height and record the soundscape that wins
+//			there, if every sample agrees on it. Stops when this frame's budget
+//			is spent.
+//-----------------------------------------------------------------------------
+void CSoundscapeSystem::ContinueBake( void )
+{
+	double startTime = Plat_FloatTime();
+	double endTime = startTime + soundscape_bake_budget.GetFloat() * 0.001;
+
+	while ( m_bakeNextArea < TheNavAreas.Count() )
+	{
+		const CNavArea *area = TheNavAreas[m_bakeNextArea++];
+		float earHeight = ( area->GetAttributes() & NAV_MESH_CROUCH ) ? VEC_DUCK_VIEW.z : VEC_VIEW.z;
+		Vector nwCorner = area->GetCorner( NORTH_WEST );
+
+		int samplesX = clamp( (int)ceil( area->GetSizeX() / SOUNDSCAPE_BAKE_SAMPLE_SPACING ), 1, SOUNDSCAPE_BAKE_MAX_SAMPLES );
+		int samplesY = clamp( (int)ceil( area->GetSizeY() / SOUNDSCAPE_BAKE_SAMPLE_SPACING ), 1, SOUNDSCAPE_BAKE_MAX_SAMPLES );
+
+		int winner = SOUNDSCAPE_BAKE_NONE;
+		for ( int y = 0; y < samplesY && winner != SOUNDSCAPE_BAKE_AMBIGUOUS; y++ )
+		{
+			for ( int x = 0; x < samplesX; x++ )
+			{
+				Vector position;
+				position.x = nwCorner.x + area->GetSizeX() * ( x + 0.5f ) / samplesX;
+				position.y = nwCorner.y + area->GetSizeY() * ( y + 0.5f ) / samplesY;
+				position.z = area->GetZ( position.x, position.y ) + earHeight;
+
+				int sample = FindNearestVisibleSoundscape( position );
+				if ( x == 0 && y == 0 )
+				{
+					winner = sample;
+				}
+				else if ( sample != winner )
+				{
+					winner = SOUNDSCAPE_BAKE_AMBIGUOUS;
+					break;
+				}
+			}
+		}
+
+		m_bakedSoundscapeForArea[area->GetID()] = winner;
+		if ( winner == SOUNDSCAPE_BAKE_AMBIGUOUS )
+		{
+			m_bakeAmbiguousCount++;
+		}
+
+		if ( Plat_FloatTime() >= endTime )
+			break;
+	}
+
+	m_bakeTime += Plat_FloatTime() - startTime;
+
+	if ( m_bakeNextArea >= TheNavAreas.Count() )
+	{
+		m_bakeNextArea = -1;
+		DevMsg( "Baked soundscapes for %d nav areas (%d traced at runtime) in %.2f seconds\n",
+			TheNavAreas.Count(), m_bakeAmbiguousCount, m_bakeTime );
+	}
+}
+
+CEnvSoundscape *CSoundscapeSystem::GetCurrentSoundscape( CBasePlayer *pPlayer )
+{
+	audioparams_t &audio = pPlayer->GetAudioParams();
+	if ( audio.entIndex > 0 && audio.entIndex <= m_soundscapeEntities.Count() )
+		return m_soundscapeEntities[audio.entIndex - 1];
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Set the player's soundscape from the baked table. Returns false if the
+//			player isn't over a nav area the table has an answer for, or a soundscape
+//			that could reach them has been disabled since.
+//-----------------------------------------------------------------------------
+bool CSoundscapeSystem::UpdatePlayerFromBake( CBasePlayer *pPlayer, bool bAnyDisabled )
+{
+	if ( !m_bakedSoundscapeForArea.Count() )
+		return false;
+
+	Vector position = pPlayer->EarPosition();
+	CNavArea *area = TheNavMesh->GetNavArea( position );
+	if ( !area || area->GetID() >= (unsigned int)m_bakedSoundscapeForArea.Count() )
+		return false;
+
+	int winner = m_bakedSoundscapeForArea[area->GetID()];
+	if ( winner == SOUNDSCAPE_BAKE_AMBIGUOUS )
+		return false;
+
+	if ( bAnyDisabled )
+	{
+		// The table was baked with every soundscape enabled
+		int clusterIndex = engine->GetClusterForOrigin( position );
+		if ( clusterIndex >= 0 && clusterIndex < m_soundscapesInCluster.Count() )
+		{
+			for ( int j = 0; j < m_soundscapesInCluster[clusterIndex].soundscapeCount; j++ )
+			{
+				int ssIndex = m_soundscapeIndexList[m_soundscapesInCluster[clusterIndex].firstSoundscape + j];
+				if ( !m_soundscapeEntities[ssIndex]->IsEnabled() )
+					return false;
+			}
+		}
+	}
+
+	if ( winner == SOUNDSCAPE_BAKE_NONE )
+		return true;
+
+	// Only write when the soundscape changes, the same as the traced update
+	CEnvSoundscape *pSoundscape = m_soundscapeEntities[winner];
+	if ( pSoundscape != GetCurrentSoundscape( pPlayer ) )
+	{
+		pSoundscape->WriteAudioParamsTo( pPlayer->GetAudioParams() );
+	}
+
+	return true;
+}
+
+void CSoundscapeSystem::UpdatePlayerFromTraces( CBasePlayer *pPlayer, int &traceCount )
+{
+	// if we got this far, we're looking at an entity that is contending
+	// for current player sound. the closest entity to player wins.
+	CEnvSoundscape *pCurrent = GetCurrentSoundscape( pPlayer );
+
+	ss_update_t update;
+	update.pPlayer = pPlayer;
+	update.pCurrentSoundscape = pCurrent;
+	update.playerPosition = pPlayer->EarPosition();
+	update.bInRange = false;
+	update.currentDistance = 0;
+	update.traceCount = 0;
+	if ( pCurrent )
+	{
+		pCurrent->UpdateForPlayer(update);
+	}
+
+	int clusterIndex = engine->GetClusterForOrigin( update.playerPosition );
+
+	if ( clusterIndex >= 0 && clusterIndex < m_soundscapesInCluster.Count() )
+	{
+		// find all soundscapes that could possibly attach to this player and update them
+		for ( int j = 0; j < m_soundscapesInCluster[clusterIndex].soundscapeCount; j++ )
+		{
+			int ssIndex = m_soundscapeIndexList[m_soundscapesInCluster[clusterIndex].firstSoundscape + j];
+			if ( m_soundscapeEntities[ssIndex] == update.pCurrentSoundscape )
+				continue;
+			m_soundscapeEntities[ssIndex]->UpdateForPlayer( update );
+		}
+	}
+	traceCount += update.traceCount;
 }
 
 int	CSoundscapeSystem::GetSoundscapeIndex( const char *pName )
@@ -284,6 +527,10 @@ void CSoundscapeSystem::AddSoundscapeEntity( CEnvSoundscape *pSoundscape )
 	{
 		int index = m_soundscapeEntities.AddToTail( pSoundscape );
 		pSoundscape->m_soundscapeEntityId = index + 1;
+
+		// A new soundscape after the bake could win anywhere, fall back to tracing
+		m_bakedSoundscapeForArea.Purge();
+		m_bakeNextArea = -1;
 	}
 }
 
@@ -291,6 +538,10 @@ void CSoundscapeSystem::RemoveSoundscapeEntity( CEnvSoundscape *pSoundscape )
 {
 	m_soundscapeEntities.FindAndRemove( pSoundscape );
 	pSoundscape->m_soundscapeEntityId = -1;
+
+	// The baked table holds entity indices, which just shifted
+	m_bakedSoundscapeForArea.Purge();
+	m_bakeNextArea = -1;
 }
 
 void CSoundscapeSystem::FrameUpdatePostEntityThink()
@@ -298,6 +549,28 @@ void CSoundscapeSystem::FrameUpdatePostEntityThink()
 	int total = m_soundscapeEntities.Count();
 	if ( total > 0 )
 	{
+		if ( m_bBakePending && TheNavMesh->IsLoaded() && !TheNavMesh->IsGenerating() )
+		{
+			m_bBakePending = false;
+			if ( soundscape_bake.GetBool() )
+			{
+				BeginBake();
+			}
+		}
+
+		// throw the table away and start over if the nav mesh was edited or reloaded
+		if ( m_bakedSoundscapeForArea.Count() && m_bakedNavChangeCount != TheNavMesh->GetChangeCount() )
+		{
+			m_bakedSoundscapeForArea.Purge();
+			m_bakeNextArea = -1;
+			m_bBakePending = true;
+		}
+
+		if ( m_bakeNextArea >= 0 && m_bakedSoundscapeForArea.Count() )
+		{
+			ContinueBake();
+		}
+
 		int traceCount = 0;
 		int playerCount = 0;
 		// budget tuned for TF.  Do a max of 20 traces.  That's going to happen anyway because a bunch of the maps
@@ -308,61 +581,51 @@ void CSoundscapeSystem::FrameUpdatePostEntityThink()
 		// maxPlayers has to be at least 1
 		maxPlayers = MAX( 1, maxPlayers );
 		int maxTraces = 20;
+		bool bUseBake = soundscape_bake.GetBool() && !soundscape_debug.GetBool();
 		if ( soundscape_debug.GetBool() )
 		{
 			maxTraces = 9999;
 			maxPlayers = MAX_PLAYERS;
 		}
 
+		// Players standing in baked nav areas cost no traces, so update all of them every tick
+		bool bNeedsTrace[MAX_PLAYERS];
+		if ( bUseBake )
+		{
+			bool bAnyDisabled = false;
+			for ( int i = 0; i < total && !bAnyDisabled; i++ )
+			{
+				bAnyDisabled = !m_soundscapeEntities[i]->IsEnabled();
+			}
+
+			for ( int i = 0; i < gpGlobals->maxClients; i++ )
+			{
+				CBasePlayer *pPlayer = UTIL_PlayerByIndex( i + 1 );
+				bNeedsTrace[i] = !pPlayer || !pPlayer->IsNetClient() || !UpdatePlayerFromBake( pPlayer, bAnyDisabled );
+			}
+		}
+		else
+		{
+			for ( int i = 0; i < gpGlobals->maxClients; i++ )
+			{
+				bNeedsTrace[i] = true;
+			}
+		}
+
 		// load balance across server ticks a bit by limiting the numbers of players (get cluster for origin)
 		// and traces processed in a single tick.  In single player this will update the player every tick
 		// because it always does at least one player's full load of work
 		for ( int i = 0; i < gpGlobals->maxClients && traceCount <= maxTraces && playerCount <= maxPlayers; i++ )
 		{
 			m_activeIndex = (m_activeIndex+1) % gpGlobals->maxClients;
+			if ( !bNeedsTrace[m_activeIndex] )
+				continue;
+
 			CBasePlayer *pPlayer = UTIL_PlayerByIndex( m_activeIndex + 1 );
 			if ( pPlayer && pPlayer->IsNetClient() )
 			{
-				// check to see if this is the sound entity that is 
-				// currently affecting this player
-				audioparams_t &audio = pPlayer->GetAudioParams();
-
-				// if we got this far, we're looking at an entity that is contending
-				// for current player sound. the closest entity to player wins.
-				CEnvSoundscape *pCurrent = NULL;
-				if ( audio.entIndex > 0 && audio.entIndex <= m_soundscapeEntities.Count() )
-				{
-					int ssIndex = audio.entIndex - 1;
-							  
-					pCurrent = m_soundscapeEntities[ssIndex];
-				}
-				ss_update_t update;
-				update.pPlayer = pPlayer;
-				update.pCurrentSoundscape = pCurrent;
-				update.playerPosition = pPlayer->EarPosition();
-				update.bInRange = false;
-				update.currentDistance = 0;
-				update.traceCount = 0;
-				if ( pCurrent )
-				{
-					pCurrent->UpdateForPlayer(update);
-				}
-
-				int clusterIndex = engine->GetClusterForOrigin( update.playerPosition );
-			
-				if ( clusterIndex >= 0 && clusterIndex < m_soundscapesInCluster.Count() )
-				{
-					// find all soundscapes that could possibly attach to this player and update them
-					for ( int j = 0; j < m_soundscapesInCluster[clusterIndex].soundscapeCount; j++ )
-					{
-						int ssIndex = m_soundscapeIndexList[m_soundscapesInCluster[clusterIndex].firstSoundscape + j];
-						if ( m_soundscapeEntities[ssIndex] == update.pCurrentSoundscape )
-							continue;
-						m_soundscapeEntities[ssIndex]->UpdateForPlayer( update );
-					}
-				}
+				UpdatePlayerFromTraces( pPlayer, traceCount );
 				playerCount++;
-				traceCount += update.traceCount;
 			}
 		}
 	}
@@ -21,6 +21,10 @@ struct clusterSoundscapeList_t
 	unsigned short	firstSoundscape;
 };
 
+// Values in the baked nav area table other than a soundscape entity index
+#define SOUNDSCAPE_BAKE_NONE		-1		// nothing reaches this area, the player keeps their soundscape
+#define SOUNDSCAPE_BAKE_AMBIGUOUS	-2		// the winner changes across the area, trace at runtime
+
 
 
 class CSoundscapeSystem : public CAutoGameSystemPerFrame
@@ -50,12 +54,29 @@ public:
 	void PrecacheSounds( int soundscapeIndex );
 
 private:
+	void BeginBake( void );
+	void ContinueBake( void );
+	int FindNearestVisibleSoundscape( const Vector &position );
+	bool UpdatePlayerFromBake( CBasePlayer *pPlayer, bool bAnyDisabled );
+	void UpdatePlayerFromTraces( CBasePlayer *pPlayer, int &traceCount );
+	CEnvSoundscape *GetCurrentSoundscape( CBasePlayer *pPlayer );
+
 	CStringRegistry							m_soundscapes;
 	int										m_soundscapeCount;
 	CUtlVector< CEnvSoundscape * >			m_soundscapeEntities;
 	CUtlVector<clusterSoundscapeList_t>		m_soundscapesInCluster;
 	CUtlVector<unsigned short>				m_soundscapeIndexList;
 	int										m_activeIndex;
+
+	// Winning soundscape for each nav area, indexed by area ID. Built a few areas a frame
+	// once the nav mesh is loaded, and thrown away if the soundscape entities or the nav
+	// mesh change. Areas that aren't baked yet read as ambiguous and get traced.
+	CUtlVector<short>						m_bakedSoundscapeForArea;
+	unsigned int							m_bakedNavChangeCount;	// TheNavMesh->GetChangeCount() the table was baked against
+	int										m_bakeNextArea;			// next entry in TheNavAreas to bake, -1 when not baking
+	int										m_bakeAmbiguousCount;
+	double									m_bakeTime;
+	bool									m_bBakePending;
 	CUtlVector< CUtlVector< CUtlString > >	m_soundscapeSounds;
 };
 
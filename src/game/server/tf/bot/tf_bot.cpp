@@ -4367,18 +4367,7 @@ void CTFBot::UpdateDelayedThreatNotices( void )
 //---------------------------------------------------------------------------------------------
 void CTFBot::GiveRandomItem( loadout_positions_t loadoutPosition )
 {
-	CUtlVector< const CEconItemDefinition * > itemVector;
-
-	const CEconItemSchema::ItemDefinitionMap_t& mapItemDefs = ItemSystem()->GetItemSchema()->GetItemDefinitionMap();
-	FOR_EACH_MAP_FAST( mapItemDefs, i )
-	{
-		const CTFItemDefinition *pItemDef = dynamic_cast< const CTFItemDefinition * >( mapItemDefs[i] );
-
-		if ( pItemDef && pItemDef->GetLoadoutSlot( GetPlayerClass()->GetClassIndex() ) == loadoutPosition )
-		{
-			itemVector.AddToTail( pItemDef );
-		}
-	}
+	const CUtlVector< item_definition_index_t > &itemVector = ItemSystem()->GetItemSchema()->GetItemDefinitionIndexesByClassSlot( GetPlayerClass()->GetClassIndex(), loadoutPosition );
 
 	if ( itemVector.Count() > 0 )
 	{
@@ -4390,7 +4379,7 @@ void CTFBot::GiveRandomItem( loadout_positions_t loadoutPosition )
 		UTIL_Remove( myMelee );
 */
 
-		const char *itemName = itemVector[ which ]->GetDefinitionName();
+		const char *itemName = ItemSystem()->GetItemSchema()->GetItemDefinition( itemVector[ which ] )->GetDefinitionName();
 		BotGenerateAndWearItem( this, itemName );
 	}
 }
@@ -4796,6 +4785,27 @@ const CTFBot::EventChangeAttributes_t* CTFBot::GetEventChangeAttributes( const c
 }
 
 
+//---------------------------------------------------------------------------------------------
+// Look up the item definitions once, so giving the items to a bot doesn't search the schema
+void CTFBot::EventChangeAttributes_t::ResolveItemDefinitions()
+{
+	const GameItemSchema_t *pSchema = ItemSystem()->GetItemSchema();
+
+	m_itemDefs.RemoveAll();
+	FOR_EACH_VEC( m_items, i )
+	{
+		const CEconItemDefinition *pItemDef = pSchema->GetItemDefinitionByName( m_items[i] );
+		m_itemDefs.AddToTail( pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX );
+	}
+
+	FOR_EACH_VEC( m_itemsAttributes, i )
+	{
+		const CEconItemDefinition *pItemDef = pSchema->GetItemDefinitionByName( m_itemsAttributes[i].m_itemName );
+		m_itemsAttributes[i].m_itemDef = pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX;
+	}
+}
+
+
 void CTFBot::OnEventChangeAttributes( const CTFBot::EventChangeAttributes_t* pEvent )
 {
 	if ( pEvent )
@@ -4841,16 +4851,26 @@ void CTFBot::OnEventChangeAttributes( const CTFBot::EventChangeAttributes_t* pEv
 		SetHealth( nHealth );
 
 		// give items to bot before apply attribute changes
+		bool bItemsResolved = ( pEvent->m_itemDefs.Count() == pEvent->m_items.Count() );
 		FOR_EACH_VEC( pEvent->m_items, i )
 		{
-			AddItem( pEvent->m_items[i] );
+			AddItem( pEvent->m_items[i], bItemsResolved ? pEvent->m_itemDefs[i] : INVALID_ITEM_DEF_INDEX );
 		}
 
 		// add attributes to equipped items
 		FOR_EACH_VEC( pEvent->m_itemsAttributes, i )
 		{
 			const CTFBot::EventChangeAttributes_t::item_attributes_t& itemAttributes = pEvent->m_itemsAttributes[i];
-			CSchemaItemDefHandle itemDef( itemAttributes.m_itemName );
+			const CEconItemDefinition *itemDef = NULL;
+			if ( itemAttributes.m_itemDef != INVALID_ITEM_DEF_INDEX )
+			{
+				itemDef = ItemSystem()->GetItemSchema()->GetItemDefinition( itemAttributes.m_itemDef );
+			}
+			else
+			{
+				itemDef = ItemSystem()->GetItemSchema()->GetItemDefinitionByName( itemAttributes.m_itemName );
+			}
+
 			if ( !itemDef )
 			{
 				Warning( "Unable to find item %s to update attribute.\n", itemAttributes.m_itemName.Get() ); 
@@ -4894,13 +4914,23 @@ void CTFBot::OnEventChangeAttributes( const CTFBot::EventChangeAttributes_t* pEv
 }
 
 
-void CTFBot::AddItem( const char* pszItemName )
+void CTFBot::AddItem( const char* pszItemName, item_definition_index_t iItemDef /*= INVALID_ITEM_DEF_INDEX*/ )
 {
 	CItemSelectionCriteria criteria;
 	criteria.SetQuality( AE_USE_SCRIPT_VALUE );
-	criteria.BAddCondition( "name", k_EOperator_String_EQ, pszItemName, true );
 
-	CBaseEntity *pItem = ItemGeneration()->GenerateRandomItem( &criteria, WorldSpaceCenter(), vec3_angle );
+	CBaseEntity *pItem = NULL;
+	if ( iItemDef != INVALID_ITEM_DEF_INDEX )
+	{
+		// already looked up, usually by the spawner when the popfile was parsed
+		pItem = ItemGeneration()->GenerateItemFromDefIndex( iItemDef, &criteria, WorldSpaceCenter(), vec3_angle );
+	}
+	else
+	{
+		criteria.BAddCondition( "name", k_EOperator_String_EQ, pszItemName, true );
+		pItem = ItemGeneration()->GenerateRandomItem( &criteria, WorldSpaceCenter(), vec3_angle );
+	}
+
 	if ( pItem )
 	{
 		CEconItemView *pScriptItem = static_cast< CBaseCombatWeapon * >( pItem )->GetAttributeContainer()->GetItem();
@@ -431,6 +431,7 @@ public:
 			{
 				m_items.CopyAndAddToTail( copy.m_items[i] );
 			}
+			m_itemDefs = copy.m_itemDefs;
 
 			m_itemsAttributes = copy.m_itemsAttributes;
 			m_characterAttributes = copy.m_characterAttributes;
@@ -453,6 +454,7 @@ public:
 			m_maxVisionRange = -1.f;
 
 			m_items.RemoveAll();
+			m_itemDefs.RemoveAll();
 			
 			m_itemsAttributes.RemoveAll();
 			m_characterAttributes.RemoveAll();
@@ -470,9 +472,16 @@ public:
 
 		CUtlStringList m_items;
 
+		// Look up the definitions of m_items and m_itemsAttributes ahead of time
+		void ResolveItemDefinitions();
+		CCopyableUtlVector< item_definition_index_t > m_itemDefs;	// parallel to m_items once resolved
+
 		struct item_attributes_t
 		{
+			item_attributes_t() : m_itemDef( INVALID_ITEM_DEF_INDEX ) { }
+
 			CUtlString m_itemName;
+			item_definition_index_t m_itemDef;
 			CCopyableUtlVector< static_attrib_t > m_attributes;
 		};
 		CUtlVector< item_attributes_t > m_itemsAttributes;
@@ -484,7 +493,7 @@ public:
 	const EventChangeAttributes_t* GetEventChangeAttributes( const char* pszEventName ) const;
 	void OnEventChangeAttributes( const CTFBot::EventChangeAttributes_t* pEvent );
 
-	void AddItem( const char* pszItemName );
+	void AddItem( const char* pszItemName, item_definition_index_t iItemDef = INVALID_ITEM_DEF_INDEX );
 
 	int GetUberHealthThreshold();
 	float GetUberDeployDelayDuration();
@@ -60,6 +60,19 @@ void CTFBotVision::Update( void )
 }
 
 
+//------------------------------------------------------------------------------------------
+// Don't gather perception for robots whose throttled vision won't update this tick
+bool CTFBotVision::PreparePerception( void )
+{
+	if ( TFGameRules()->IsMannVsMachineMode() && !m_scanTimer.IsElapsed() )
+	{
+		return false;
+	}
+
+	return IVision::PreparePerception();
+}
+
+
 //------------------------------------------------------------------------------------------
 void CTFBotVision::CollectPotentiallyVisibleEntities( CUtlVector< CBaseEntity * > *potentiallyVisible )
 {
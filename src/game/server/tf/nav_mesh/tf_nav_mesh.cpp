@@ -908,7 +908,7 @@ void CTFNavMesh::CollectControlPointAreas( void )
 
 //-------------------------------------------------------------------------
 // For MvM mode. Mark all nav areas where the bomb can drop and the invaders can reach it.
-void CTFNavMesh::ComputeLegalBombDropAreas( void )
+void CTFNavMesh::ComputeLegalBombDropAreas( CNavSearchContext &context )
 {
 	if ( !TFGameRules()->IsMannVsMachineMode() )
 	{
@@ -935,18 +935,18 @@ void CTFNavMesh::ComputeLegalBombDropAreas( void )
 		return;
 	}
 
-	CNavArea::ClearSearchLists();
+	context.Reset();
 
-	startArea->AddToOpenList();
-	startArea->Mark();
-	startArea->SetParent( NULL );
+	context.AddToOpenList( startArea );
+	context.Mark( startArea );
+	context.SetParent( startArea, NULL );
 
 	CUtlVectorFixedGrowable< const NavConnect *, 64 > adjAreaVector;
 
-	while( !CNavArea::IsOpenListEmpty() )
+	while( !context.IsOpenListEmpty() )
 	{
 		// get next area to check
-		CTFNavArea *area = static_cast< CTFNavArea * >( CNavArea::PopOpenList() );
+		CTFNavArea *area = static_cast< CTFNavArea * >( context.PopOpenList() );
 
 		// explore adjacent floor areas
 		adjAreaVector.RemoveAll();
@@ -966,7 +966,7 @@ void CTFNavMesh::ComputeLegalBombDropAreas( void )
 			const NavConnect *connect = adjAreaVector[ vit ];
 			CTFNavArea *adjArea = static_cast< CTFNavArea * >( connect->area );
 
-			if ( adjArea->IsMarked() )
+			if ( context.IsMarked( adjArea ) )
 			{
 				continue;
 			}
@@ -983,14 +983,14 @@ void CTFNavMesh::ComputeLegalBombDropAreas( void )
 				adjArea->SetAttributeTF( TF_NAV_BOMB_CAN_DROP_HERE );
 			}
 
-			adjArea->Mark();
-			adjArea->SetParent( area );
+			context.Mark( adjArea );
+			context.SetParent( adjArea, area );
 
-			if ( !adjArea->IsOpen() )
+			if ( !context.IsOpen( adjArea ) )
 			{
 				// Since we're doing a breadth-first search, this area will end up at the end of the list.
 				// Adding it to the tail explicitly saves us a bunch of list traversals.
-				adjArea->AddToOpenListTail();
+				context.AddToOpenListTail( adjArea );
 			}
 		}
 	}
@@ -999,7 +999,7 @@ void CTFNavMesh::ComputeLegalBombDropAreas( void )
 
 //-------------------------------------------------------------------------
 // For MvM mode. Mark all nav areas where the bomb can drop and the invaders can reach it.
-void CTFNavMesh::ComputeBombTargetDistance()
+void CTFNavMesh::ComputeBombTargetDistance( CNavSearchContext &context )
 {
 	if ( !TFGameRules()->IsMannVsMachineMode() )
 	{
@@ -1036,19 +1036,19 @@ void CTFNavMesh::ComputeBombTargetDistance()
 		area->m_distanceToBombTarget = -1.0f;
 	}
 
-	CNavArea::ClearSearchLists();
+	context.Reset();
 
-	zoneArea->AddToOpenList();
-	zoneArea->Mark();
-	zoneArea->SetParent( NULL );
+	context.AddToOpenList( zoneArea );
+	context.Mark( zoneArea );
+	context.SetParent( zoneArea, NULL );
 	zoneArea->m_distanceToBombTarget = 0.0f;
 
 	CUtlVectorFixedGrowable< const NavConnect *, 64 > adjAreaVector;
 
-	while( !CNavArea::IsOpenListEmpty() )
+	while( !context.IsOpenListEmpty() )
 	{
 		// get next area to check
-		CTFNavArea *area = static_cast< CTFNavArea * >( CNavArea::PopOpenList() );
+		CTFNavArea *area = static_cast< CTFNavArea * >( context.PopOpenList() );
 
 		// explore adjacent floor areas
 		adjAreaVector.RemoveAll();
@@ -1089,14 +1089,14 @@ void CTFNavMesh::ComputeBombTargetDistance()
 			if ( adjacentTravelDistance < 0.0f || adjacentTravelDistance > newTravelDistance + flTol )
 			{
 				adjArea->m_distanceToBombTarget = newTravelDistance;
-				adjArea->Mark();
-				adjArea->SetParent( area );
+				context.Mark( adjArea );
+				context.SetParent( adjArea, area );
 
-				if ( !adjArea->IsOpen() )
+				if ( !context.IsOpen( adjArea ) )
 				{
 					// Since we're doing a breadth-first search, this area will end up at the end of the list.
 					// Adding it to the tail explicitly saves us a bunch of list traversals.
-					adjArea->AddToOpenListTail();
+					context.AddToOpenListTail( adjArea );
 				}
 			}
 			else
@@ -1107,12 +1107,12 @@ void CTFNavMesh::ComputeBombTargetDistance()
 				{
 					// check if the reverse direction is cheaper (for the case of jumping off edges)
 					area->m_distanceToBombTarget = newTravelDistanceFromAdjacent;
-					area->Mark();
-					area->SetParent( adjArea );
-					if ( !area->IsOpen() )
+					context.Mark( area );
+					context.SetParent( area, adjArea );
+					if ( !context.IsOpen( area ) )
 					{
 						// found a cheaper path, try to traverse backward
-						area->AddToOpenListTail();
+						context.AddToOpenListTail( area );
 					}
 				}
 			}
@@ -1128,10 +1128,12 @@ void CTFNavMesh::RecomputeInternalData( void )
 	RemoveAllMeshDecoration();
 	DecorateMesh();
 	ComputeBlockedAreas();			// relies on DecorateMesh() being complete
-	ComputeIncursionDistances();
+
+	CNavSearchContext &context = TheNavSearchContext();
+	ComputeIncursionDistances( context );
 	ComputeInvasionAreas();
-	ComputeLegalBombDropAreas();
-	ComputeBombTargetDistance();	// for MvM
+	ComputeLegalBombDropAreas( context );
+	ComputeBombTargetDistance( context );	// for MvM
 
 	if ( m_recomputeReason == RESET || m_recomputeReason == SETUP_FINISHED )
 	{
@@ -1430,7 +1432,7 @@ void CTFNavMesh::LoadCustomData( CUtlBuffer &fileBuffer, unsigned int subVersion
 /**
  * Recompute travel distance from each team's spawn room for each nav area
  */
-void CTFNavMesh::ComputeIncursionDistances( void )
+void CTFNavMesh::ComputeIncursionDistances( CNavSearchContext &context )
 {
 	VPROF_BUDGET( "CTFNavMesh::ComputeIncursionDistances", "NextBot" );
 
@@ -1480,7 +1482,7 @@ void CTFNavMesh::ComputeIncursionDistances( void )
 				CTFNavArea *spawnArea = static_cast< CTFNavArea * >( TheTFNavMesh()->GetNearestNavArea( spawnSpot ) );
 				if ( spawnArea )
 				{
-					ComputeIncursionDistances( spawnArea, spawnSpot->GetTeamNumber() );
+					ComputeIncursionDistances( context, spawnArea, spawnSpot->GetTeamNumber() );
 
 					if ( spawnSpot->GetTeamNumber() == TF_TEAM_RED )
 					{
@@ -1542,27 +1544,27 @@ void CTFNavMesh::ComputeIncursionDistances( void )
  * Flood-fill outwards, marking flow distance as we go.
  * When we reach an area, stop if it already has a lesser travel distance
  */
-void CTFNavMesh::ComputeIncursionDistances( CTFNavArea *spawnArea, int team )
+void CTFNavMesh::ComputeIncursionDistances( CNavSearchContext &context, CTFNavArea *spawnArea, int team )
 {
 	if ( spawnArea == NULL || team < 0 || team >= TF_TEAM_COUNT )
 	{
 		return;
 	}
 
-	CNavArea::ClearSearchLists();
+	context.Reset();
 
 	spawnArea->m_distanceFromSpawnRoom[ team ] = 0.0f;
-	spawnArea->AddToOpenList();
-	spawnArea->Mark();
-	spawnArea->SetParent( NULL );
+	context.AddToOpenList( spawnArea );
+	context.Mark( spawnArea );
+	context.SetParent( spawnArea, NULL );
 
 	CUtlVectorFixedGrowable< const NavConnect *, 64 > adjAreaVector;
 	//TFNavAttributeType teamSpawnRoom = ( team == TF_TEAM_RED ) ? TF_NAV_SPAWN_ROOM_RED : TF_NAV_SPAWN_ROOM_BLUE;
 
-	while( !CNavArea::IsOpenListEmpty() )
+	while( !context.IsOpenListEmpty() )
 	{
 		// get next area to check
-		CTFNavArea *area = static_cast< CTFNavArea * >( CNavArea::PopOpenList() );
+		CTFNavArea *area = static_cast< CTFNavArea * >( context.PopOpenList() );
 		
 		bool bIgnoreBlockedAreas = false;
 
@@ -1630,14 +1632,14 @@ void CTFNavMesh::ComputeIncursionDistances( CTFNavArea *spawnArea, int team )
 			if ( adjacentTravelDistance < 0.0f || adjacentTravelDistance > newTravelDistance )
 			{
 				adjArea->m_distanceFromSpawnRoom[ team ] = newTravelDistance;
-				adjArea->Mark();
-				adjArea->SetParent( area );
+				context.Mark( adjArea );
+				context.SetParent( adjArea, area );
 
-				if ( !adjArea->IsOpen() )
+				if ( !context.IsOpen( adjArea ) )
 				{
 					// Since we're doing a breadth-first search, this area will end up at the end of the list.
 					// Adding it to the tail explicitly saves us a bunch of list traversals.
-					adjArea->AddToOpenListTail();
+					context.AddToOpenListTail( adjArea );
 				}
 			}
 		}
@@ -116,11 +116,11 @@ protected:
 	virtual void EndCustomAnalysis();
 
 private:
-	void ComputeIncursionDistances( void );					// recompute travel distance from each team's spawn room for each nav area
-	void ComputeIncursionDistances( CTFNavArea *spawnArea, int team );
+	void ComputeIncursionDistances( CNavSearchContext &context );	// recompute travel distance from each team's spawn room for each nav area
+	void ComputeIncursionDistances( CNavSearchContext &context, CTFNavArea *spawnArea, int team );
 	void ComputeInvasionAreas( void );
-	void ComputeLegalBombDropAreas( void );
-	void ComputeBombTargetDistance();
+	void ComputeLegalBombDropAreas( CNavSearchContext &context );
+	void ComputeBombTargetDistance( CNavSearchContext &context );
 
 	void UpdateDebugDisplay( void ) const;
 
@@ -2012,9 +2012,9 @@ bool CPopulationManager::IsValidPopfile( CUtlString fullPath )
 		return false;
 	}
 
-	KeyValues *values = new KeyValues( "Population" );
-
-	if ( !values->LoadFromFile( filesystem, pszFullPath, "GAME" ) )
+	// only read, so parse it into an arena
+	KeyValues *values = KeyValues::LoadFromFileArena( filesystem, pszFullPath, "GAME" );
+	if ( !values )
 		return false;
 
 	for ( KeyValues *data = values->GetFirstSubKey(); data != NULL; data = data->GetNextKey() )
@@ -2050,11 +2050,12 @@ bool CPopulationManager::Parse( void )
 	//if ( m_bIsInitialized )
 //		return true;
 
-	KeyValues *values = new KeyValues( "Population" );
-	if ( !values->LoadFromFile( filesystem, m_popfileFull, "GAME" ) )
+	// The populators copy what they need out of the file, so it's parsed into an arena
+	// that goes away in one piece at the end
+	KeyValues *values = KeyValues::LoadFromFileArena( filesystem, m_popfileFull, "GAME", KeyValues::ARENA_INDEX_CHILDREN );
+	if ( !values )
 	{
 		Warning( "Can't open %s.\n", m_popfileFull );
-		values->deleteThis();
 		return false;
 	}
 
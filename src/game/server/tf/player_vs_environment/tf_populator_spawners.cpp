@@ -12,6 +12,7 @@
 #include "tf_weapon_medigun.h"
 #include "tf_tank_boss.h"
 #include "bot/behavior/engineer/mvm_engineer/tf_bot_mvm_engineer_idle.h"
+#include "econ_item_system.h"
 
 #include "etwprof.h"
 
@@ -450,6 +451,13 @@ CTFBotSpawner::CTFBotSpawner( IPopulator *populator ) : IPopulationSpawner( popu
 	m_flAutoJumpMin = m_flAutoJumpMax = 0.f; // default AutoJumpMin/Max
 
 	m_defaultAttributes.Reset();
+
+	m_sentryBusterItemDef = INVALID_ITEM_DEF_INDEX;
+	m_romePromoHatItemDef = INVALID_ITEM_DEF_INDEX;
+	m_romePromoMiscItemDef = INVALID_ITEM_DEF_INDEX;
+	m_zombieItemDef = INVALID_ITEM_DEF_INDEX;
+	m_bHasBotModel = false;
+	m_bHasBotBossModel = false;
 }
 
 static void ParseCharacterAttributes( CTFBot::EventChangeAttributes_t& event, KeyValues *data )
@@ -570,7 +578,10 @@ static void ParseItemAttributes( CTFBot::EventChangeAttributes_t& event, KeyValu
 				}
 
 				// couldn't find? add new attribute entry
-				botItemAttrs.m_attributes.AddToTail( newStaticAttrib );
+				if ( iExistingAttribute == botItemAttrs.m_attributes.Count() )
+				{
+					botItemAttrs.m_attributes.AddToTail( newStaticAttrib );
+				}
 			}
 
 			// only one entry expected -- done here, before we add a new one
@@ -891,10 +902,46 @@ bool CTFBotSpawner::Parse( KeyValues *values )
 		}
 	}
 
+	PrebakeLoadout();
+
 	return true;
 }
 
 
+//-----------------------------------------------------------------------
+void CTFBotSpawner::PrebakeLoadout()
+{
+	m_defaultAttributes.ResolveItemDefinitions();
+	FOR_EACH_VEC( m_eventChangeAttributes, i )
+	{
+		m_eventChangeAttributes[i].ResolveItemDefinitions();
+	}
+
+	const GameItemSchema_t *pSchema = ItemSystem()->GetItemSchema();
+	const CEconItemDefinition *pItemDef;
+
+	pItemDef = pSchema->GetItemDefinitionByName( "tw_sentrybuster" );
+	m_sentryBusterItemDef = pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX;
+
+	pItemDef = pSchema->GetItemDefinitionByName( g_szRomePromoItems_Hat[m_class] );
+	m_romePromoHatItemDef = pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX;
+
+	pItemDef = pSchema->GetItemDefinitionByName( g_szRomePromoItems_Misc[m_class] );
+	m_romePromoMiscItemDef = pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX;
+
+	pItemDef = pSchema->GetItemDefinitionByName( CFmtStr( "Zombie %s", g_aRawPlayerClassNamesShort[m_class] ) );
+	m_zombieItemDef = pItemDef ? pItemDef->GetDefinitionIndex() : INVALID_ITEM_DEF_INDEX;
+
+	m_bHasBotModel = false;
+	m_bHasBotBossModel = false;
+	if ( m_class >= TF_CLASS_SCOUT && m_class <= TF_CLASS_ENGINEER )
+	{
+		m_bHasBotModel = g_pFullFileSystem->FileExists( g_szBotModels[ m_class ] );
+		m_bHasBotBossModel = g_pFullFileSystem->FileExists( g_szBotBossModels[ m_class ] );
+	}
+}
+
+
 //-----------------------------------------------------------------------
 bool CTFBotSpawner::ParseEventChangeAttributes( KeyValues *data )
 {
@@ -1214,12 +1261,12 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 			CMissionPopulator *pMission = dynamic_cast< CMissionPopulator* >( GetPopulator() );
 			if ( pMission && ( pMission->GetMissionType() == CTFBot::MISSION_DESTROY_SENTRIES ) )
 			{
-				newBot->AddItem( "tw_sentrybuster" );
+				newBot->AddItem( "tw_sentrybuster", m_sentryBusterItemDef );
 			}
 			else
 			{
-				newBot->AddItem( g_szRomePromoItems_Hat[m_class] );
-				newBot->AddItem( g_szRomePromoItems_Misc[m_class] );
+				newBot->AddItem( g_szRomePromoItems_Hat[m_class], m_romePromoHatItemDef );
+				newBot->AddItem( g_szRomePromoItems_Misc[m_class], m_romePromoMiscItemDef );
 			}
 		}
 
@@ -1260,20 +1307,21 @@ bool CTFBotSpawner::Spawn( const Vector &rawHere, EntityHandleVector_t *result )
 
 			const char *name = g_aRawPlayerClassNamesShort[ nClassIndex ];
 
-			newBot->AddItem( CFmtStr( "Zombie %s", name ) );
+			newBot->AddItem( CFmtStr( "Zombie %s", name ), ( nClassIndex == m_class ) ? m_zombieItemDef : INVALID_ITEM_DEF_INDEX );
 		}
 		else
 		{
 			// use the nifty new robot model
 			if ( nClassIndex >= TF_CLASS_SCOUT && nClassIndex <= TF_CLASS_ENGINEER )
 			{
-				if ( ( m_scale >= tf_mvm_miniboss_scale.GetFloat() || newBot->IsMiniBoss() ) && g_pFullFileSystem->FileExists( g_szBotBossModels[ nClassIndex ] ) )
+				bool bPrebaked = ( nClassIndex == m_class );
+				if ( ( m_scale >= tf_mvm_miniboss_scale.GetFloat() || newBot->IsMiniBoss() ) && ( bPrebaked ? m_bHasBotBossModel : g_pFullFileSystem->FileExists( g_szBotBossModels[ nClassIndex ] ) ) )
 				{
 					newBot->GetPlayerClass()->SetCustomModel( g_szBotBossModels[ nClassIndex ], USE_CLASS_ANIMATIONS );
 					newBot->UpdateModel();
 					newBot->SetBloodColor( DONT_BLEED );
 				}
-				else if ( g_pFullFileSystem->FileExists( g_szBotModels[ nClassIndex ] ) )
+				else if ( bPrebaked ? m_bHasBotModel : g_pFullFileSystem->FileExists( g_szBotModels[ nClassIndex ] ) )
 				{
 					newBot->GetPlayerClass()->SetCustomModel( g_szBotModels[ nClassIndex ], USE_CLASS_ANIMATIONS );
 					newBot->UpdateModel();
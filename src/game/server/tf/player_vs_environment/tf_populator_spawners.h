@@ -187,6 +187,18 @@ public:
 
 	CTFBot::EventChangeAttributes_t m_defaultAttributes;
 	CUtlVector< CTFBot::EventChangeAttributes_t > m_eventChangeAttributes;
+
+private:
+	// Resolve everything Spawn needs from the item schema and the filesystem once,
+	// when the popfile is parsed, instead of for every robot
+	void PrebakeLoadout();
+
+	item_definition_index_t m_sentryBusterItemDef;
+	item_definition_index_t m_romePromoHatItemDef;
+	item_definition_index_t m_romePromoMiscItemDef;
+	item_definition_index_t m_zombieItemDef;
+	bool m_bHasBotModel;
+	bool m_bHasBotBossModel;
 };
 
 //-----------------------------------------------------------------------
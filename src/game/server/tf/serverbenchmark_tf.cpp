@@ -10,9 +10,14 @@
 #include "tf_bot_temp.h"
 #include "entity_tfstart.h"
 #include "tf_player.h"
+#include "tf_gamerules.h"
+#include "utlstring.h"
+#include "fmtstr.h"
 
 
 static ConVar sv_benchmark_freeroam( "sv_benchmark_freeroam", "0", 0, "Allow the local player to move freely in the benchmark. Only used for debugging. Don't use for real benchmarks because it will make the timing inconsistent." );
+static ConVar sv_benchmark_classes( "sv_benchmark_classes", "", 0, "Comma separated list of classes the benchmark bots cycle through (e.g. \"engineer,soldier,pyro\"). Empty picks random classes, engineers first." );
+static ConVar sv_benchmark_popfile( "sv_benchmark_popfile", "", 0, "Mann vs. Machine population file to load when the benchmark starts on an MvM map. Empty uses the map's default." );
 
 
 class CTFServerBenchmark : public CServerBenchmarkHook
@@ -31,6 +36,46 @@ public:
 
 		m_nBotsCreated = 0;
 		m_bSetupLocalPlayer = false;
+
+		m_BotClasses.RemoveAll();
+		CUtlStringList classNames;
+		V_SplitString( sv_benchmark_classes.GetString(), ",", classNames );
+		FOR_EACH_VEC( classNames, i )
+		{
+			CUtlString strClass( classNames[i] );
+			strClass.Trim();
+
+			int iClass = GetClassIndexFromString( strClass.Get() );
+			if ( iClass == TF_CLASS_UNDEFINED )
+			{
+				Warning( "sv_benchmark_classes: unknown class '%s'\n", strClass.Get() );
+				continue;
+			}
+			m_BotClasses.AddToTail( iClass );
+		}
+
+		if ( IsMannVsMachine() && sv_benchmark_popfile.GetString()[0] )
+		{
+			engine->ServerCommand( CFmtStr( "tf_mvm_popfile \"%s\";", sv_benchmark_popfile.GetString() ) );
+			engine->ServerExecute();
+		}
+	}
+
+	virtual const char *GetGameModeName()
+	{
+		if ( !TFGameRules() )
+			return "";
+
+		if ( TFGameRules()->IsMannVsMachineMode() )
+			return "mvm";
+
+		const char *pszGameType = TFGameRules()->GetGameTypeName();
+		return pszGameType ? pszGameType : "";
+	}
+
+	bool IsMannVsMachine() const
+	{
+		return TFGameRules() && TFGameRules()->IsMannVsMachineMode();
 	}
 
 	virtual void GetPhysicsModelNames( CUtlVector<char*> &modelNames )
@@ -134,10 +179,33 @@ public:
 		}
 
 		RespawnDeadPlayers();
+
+		// In MvM the robots come to the defenders, so just keep the waves coming.
+		if ( IsMannVsMachine() )
+		{
+			ReadyUpDefenders();
+			return;
+		}
+
 		MoveRedPlayersToBlueArea();
 		AddSentries();
 	}
 
+	void ReadyUpDefenders()
+	{
+		if ( TFGameRules()->State_Get() != GR_STATE_BETWEEN_RNDS )
+			return;
+
+		for ( int i = 1; i <= gpGlobals->maxClients; i++ )
+		{
+			CTFPlayer *pPlayer = ToTFPlayer( UTIL_PlayerByIndex( i ) );
+			if ( pPlayer && pPlayer->GetTeamNumber() == TF_TEAM_PVE_DEFENDERS && !g_pServerBenchmark->IsLocalBenchmarkPlayer( pPlayer ) )
+			{
+				TFGameRules()->PlayerReadyStatus_UpdatePlayerState( pPlayer, true );
+			}
+		}
+	}
+
 	void RespawnDeadPlayers()
 	{
 		for ( int i = 1; i <= gpGlobals->maxClients; i++ )
@@ -212,9 +280,21 @@ public:
 		if ( m_nBotsCreated == 0 )
 			iTeam = TF_TEAM_BLUE;
 
-		int iClass = g_pServerBenchmark->RandomInt( TF_FIRST_NORMAL_CLASS, ( TF_LAST_NORMAL_CLASS - 1 ) ); //( TF_LAST_NORMAL_CLASS - 1 ) to exclude the new civilian class
-		if ( m_nBotsCreated < 4 )
-			iClass = TF_CLASS_ENGINEER; // Make engineers first so they'll build sentries.
+		// The invaders are spawned by the population manager.
+		if ( IsMannVsMachine() )
+			iTeam = TF_TEAM_PVE_DEFENDERS;
+
+		int iClass;
+		if ( m_BotClasses.Count() )
+		{
+			iClass = m_BotClasses[ m_nBotsCreated % m_BotClasses.Count() ];
+		}
+		else
+		{
+			iClass = g_pServerBenchmark->RandomInt( TF_FIRST_NORMAL_CLASS, ( TF_LAST_NORMAL_CLASS - 1 ) ); //( TF_LAST_NORMAL_CLASS - 1 ) to exclude the new civilian class
+			if ( m_nBotsCreated < 4 )
+				iClass = TF_CLASS_ENGINEER; // Make engineers first so they'll build sentries.
+		}
 
 		CBasePlayer *pPlayer = BotPutInServer( false, false, iTeam, iClass, NULL );
 		if ( !pPlayer )
@@ -227,6 +307,7 @@ public:
 private:
 	int m_nBotsCreated;
 	bool m_bSetupLocalPlayer;
+	CUtlVector<int> m_BotClasses;
 	
 	Vector m_vLocalPlayerOrigin;
 	QAngle m_vLocalPlayerEyeAngles;
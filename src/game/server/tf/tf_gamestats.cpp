@@ -33,6 +33,7 @@
 #include "tf_gcmessages.h"
 #include "rtime.h"
 #include "team_train_watcher.h"
+#include "tf_structuredlog.h"
 
 extern ConVar tf_mm_trusted;
 
@@ -726,6 +727,7 @@ void CTFGameStats::Event_PlayerHealedOther( CTFPlayer *pPlayer, float amount )
 		return;
 	}
 	IncrementStat( pPlayer, TFSTAT_HEALING, (int) amount );
+	g_TFStructuredLog.LogHeal( pPlayer, iAmount );
 
 	TF_Gamestats_RoundStats_t* round = GetRoundStatsForTeam( pPlayer->GetTeamNumber() );
 	if ( round )
@@ -831,6 +833,7 @@ void CTFGameStats::Event_PlayerCreatedBuilding( CTFPlayer *pPlayer, CBaseObject
 		return;
 
 	IncrementStat( pPlayer, TFSTAT_BUILDINGSBUILT, 1 );
+	g_TFStructuredLog.LogBuildingBuilt( pPlayer, pBuilding );
 
 	TF_Gamestats_RoundStats_t* round = GetRoundStatsForTeam( pPlayer->GetTeamNumber() );
 	if ( round )
@@ -850,6 +853,7 @@ void CTFGameStats::Event_PlayerDestroyedBuilding( CTFPlayer *pPlayer, CBaseObjec
 		return;
 
 	IncrementStat( pPlayer, TFSTAT_BUILDINGSDESTROYED, 1 );
+	g_TFStructuredLog.LogBuildingDestroyed( pPlayer, pBuilding );
 
 	TF_Gamestats_RoundStats_t* round = GetRoundStatsForTeam( pPlayer->GetTeamNumber() );
 	if ( round )
@@ -1035,6 +1039,9 @@ void CTFGameStats::Event_PlayerDamage( CBasePlayer *pBasePlayer, const CTakeDama
 	// defensive guard against insanely huge damage values that apparently get into the stats system once in a while -- ignore insane values
 	const int INSANE_PLAYER_DAMAGE = TFGameRules()->IsMannVsMachineMode() ? 5000 : 1500;
 
+	// the structured log wants every event, so it goes ahead of the stats filters
+	g_TFStructuredLog.LogDamage( ToTFPlayer( pBasePlayer ), info, iDamageTaken );
+
 	if ( sv_cheats && !sv_cheats->GetBool() )
 	{
 		Assert( iDamageTaken >= 0 );
@@ -1459,6 +1466,7 @@ void CTFGameStats::Event_PlayerCapturedPoint( CTFPlayer *pPlayer )
 {
 	// increment player stats
 	IncrementStat( pPlayer, TFSTAT_CAPTURES, 1 );
+	g_TFStructuredLog.LogPointEvent( TF_LOGRECORD_CAPTURE, pPlayer );
 	// increment reported stats
 	int iClass = pPlayer->GetPlayerClass()->GetClassIndex();
 	if ( m_reportedStats.m_pCurrentGame != NULL )
@@ -1500,6 +1508,7 @@ void CTFGameStats::Event_PlayerScoresEscortPoints( CTFPlayer *pPlayer, int iPoin
 void CTFGameStats::Event_PlayerDefendedPoint( CTFPlayer *pPlayer )
 {
 	IncrementStat( pPlayer, TFSTAT_DEFENSES, 1 );
+	g_TFStructuredLog.LogPointEvent( TF_LOGRECORD_DEFEND, pPlayer );
 
 	ConVarRef tf_gamemode_cp( "tf_gamemode_cp" );
 	ConVarRef tf_gamemode_payload( "tf_gamemode_payload" );
@@ -1549,6 +1558,9 @@ void CTFGameStats::Event_PlayerKilled( CBasePlayer *pPlayer, const CTakeDamageIn
 	Assert( pPlayer );
 	CTFPlayer *pTFPlayer = ToTFPlayer( pPlayer );
 
+	// every death, including world kills, suicides and kills by buildings
+	g_TFStructuredLog.LogKill( pTFPlayer, info );
+
 	IncrementStat( pTFPlayer, TFSTAT_DEATHS, 1 );
 	SendStatsToPlayer( pTFPlayer, false );
 
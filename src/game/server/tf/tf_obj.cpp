@@ -44,6 +44,7 @@
 #include "tf_weapon_wrench.h"
 #include "tf_weapon_grenade_pipebomb.h"
 #include "tf_weapon_builder.h"
+#include "ilagcompensationmanager.h"
 
 #include "player_vs_environment/tf_population_manager.h"
 
@@ -270,6 +271,8 @@ void CBaseObject::UpdateOnRemove( void )
 {
 	m_bDying = true;
 
+	lagcompensation->RemoveAdditionalEntity( this );
+
 	// check for sapper crits
 	CObjectSapper *pSapper = GetSapper();
 	if ( pSapper )
@@ -399,6 +402,9 @@ void CBaseObject::Spawn( void )
 	AddFlag( FL_OBJECT ); // So NPCs will notice it
 	SetViewOffset( WorldSpaceCenter() - GetAbsOrigin() );
 
+	// hitscan against buildings is lag compensated like it is against players
+	lagcompensation->AddAdditionalEntity( this );
+
 	m_iDesiredBuildRotations = 0;
 	m_flCurrentBuildRotation = 0;
 
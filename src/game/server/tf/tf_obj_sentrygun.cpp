@@ -833,10 +833,13 @@ bool CObjectSentrygun::FindTarget()
 		}
 		else
 		{
-			// Search through all dummies and find one in range
-			for ( int i = 0; i < ITFTargetDummy::AutoList().Count(); ++i )
+			// Search through all dummies and find one in range. The last visible one in
+			// list order wins, so walk them backwards and stop at the first.
+			CUtlVector< CBaseEntity * > dummyVector;
+			TFTargetGrid().CollectTargets( CTFTargetGrid::TARGET_DUMMY, TEAM_ANY, vecSentryOrigin, m_flSentryRange, &dummyVector );
+			for ( int i = dummyVector.Count() - 1; i >= 0; --i )
 			{
-				pDummy = static_cast<CTFTargetDummy*>( ITFTargetDummy::AutoList()[i] );
+				pDummy = static_cast<CTFTargetDummy*>( dummyVector[i] );
 				if ( InSameTeam( pDummy ) )
 					continue;
 
@@ -854,6 +857,7 @@ bool CObjectSentrygun::FindTarget()
 				{
 					pTargetCurrent = pDummy;
 					bDummyTarget = true;
+					break;
 				}
 			}
 		}
@@ -931,10 +935,14 @@ bool CObjectSentrygun::FindTarget()
 	{
 		// Sentries will try to target players first, then objects.  However, if the enemy held was an object it will continue
 		// to try and attack it first.
-		int nTeamCount = pTeam->GetNumPlayers();
-		for ( int iPlayer = 0; iPlayer < nTeamCount; ++iPlayer )
+		CUtlVector< CBaseEntity * > playerVector;
+		TFTargetGrid().CollectTargets( CTFTargetGrid::TARGET_PLAYER, iEnemyTeam, vecSentryOrigin, m_flSentryRange, &playerVector );
+
+		CUtlVector< SentryTarget_t > playerTargets;
+		int iOldTarget = -1;
+		for ( int iPlayer = 0; iPlayer < playerVector.Count(); ++iPlayer )
 		{
-			CTFPlayer *pTargetPlayer = static_cast<CTFPlayer*>( pTeam->GetPlayer( iPlayer ) );
+			CTFPlayer *pTargetPlayer = static_cast<CTFPlayer*>( playerVector[iPlayer] );
 			if ( pTargetPlayer == NULL )
 				continue;
 
@@ -950,22 +958,57 @@ bool CObjectSentrygun::FindTarget()
 			VectorSubtract( vecTargetCenter, vecSentryOrigin, vecSegment );
 			float flDist2 = vecSegment.LengthSqr();
 
-			// Check to see if the target is closer than the already validated target.
+			// Out of range.
 			if ( flDist2 > flMinDist2 )
 				continue;
 
-			// It is closer, check to see if the target is valid.
-			if ( ValidTargetPlayer( pTargetPlayer, vecSentryOrigin, vecTargetCenter ) )
+			SentryTarget_t &target = playerTargets[ playerTargets.AddToTail() ];
+			target.m_pEntity = pTargetPlayer;
+			target.m_vecTarget = vecTargetCenter;
+			target.m_flDist2 = flDist2;
+			target.m_nOrder = iPlayer;
+			target.m_nTieRank = -iPlayer;
+			target.m_nValid = -1;
+		}
+
+		// The closest valid player wins.
+		int iTarget = FindNearestValidTarget( playerTargets, CTFTargetGrid::TARGET_PLAYER, vecSentryOrigin );
+		if ( iTarget != -1 )
+		{
+			flMinDist2 = playerTargets[iTarget].m_flDist2;
+			pTargetCurrent = playerTargets[iTarget].m_pEntity;
+
+			for ( int i = 0; i < playerTargets.Count(); ++i )
 			{
-				flMinDist2 = flDist2;
-				pTargetCurrent = pTargetPlayer;
+				if ( playerTargets[i].m_pEntity == pTargetOld )
+				{
+					iOldTarget = i;
+					break;
+				}
+			}
+		}
+
+		// The old target's distance only holds back a switch that is less than 25% closer.
+		// It counts if the old target is valid and no valid player ahead of it in the
+		// team list is closer, which is when the old list walk used to record it.
+		if ( iOldTarget != -1 && pTargetCurrent != pTargetOld && flMinDist2 >= playerTargets[iOldTarget].m_flDist2 * 0.75f )
+		{
+			SentryTarget_t &oldTarget = playerTargets[iOldTarget];
 
-				// Store the current target distance if we come across it
-				if ( pTargetPlayer == pTargetOld )
+			bool bCloserAhead = false;
+			for ( int i = iTarget; i < playerTargets.Count() && playerTargets[i].m_flDist2 < oldTarget.m_flDist2; ++i )
+			{
+				if ( playerTargets[i].m_nOrder < oldTarget.m_nOrder && ValidTarget( playerTargets[i], CTFTargetGrid::TARGET_PLAYER, vecSentryOrigin ) )
 				{
-					flOldTargetDist2 = flDist2;
+					bCloserAhead = true;
+					break;
 				}
 			}
+
+			if ( !bCloserAhead && ValidTarget( oldTarget, CTFTargetGrid::TARGET_PLAYER, vecSentryOrigin ) )
+			{
+				flOldTargetDist2 = oldTarget.m_flDist2;
+			}
 		}
 	}
 
@@ -973,59 +1016,81 @@ bool CObjectSentrygun::FindTarget()
 	if ( pTargetCurrent == NULL )
 	{
 		// target non-player bots
-		CUtlVector< INextBot * > botVector;
-		TheNextBots().CollectAllBots( &botVector );
+		CUtlVector< CBaseEntity * > botVector;
+		TFTargetGrid().CollectTargets( CTFTargetGrid::TARGET_BOT, TEAM_ANY, vecSentryOrigin, m_flSentryRange, &botVector );
 
 		float closeBotRangeSq = m_flSentryRange * m_flSentryRange;
 
+		CUtlVector< SentryTarget_t > botTargets;
 		for( int b=0; b<botVector.Count(); ++b )
 		{
-			CBaseCombatCharacter *bot = botVector[b]->GetEntity();
+			CBaseCombatCharacter *bot = static_cast< CBaseCombatCharacter* >( botVector[b] );
 
 			Vector vecBotTarget = GetEnemyAimPosition( bot );
 			float rangeSq = ( vecBotTarget - vecSentryOrigin ).LengthSqr();
 
 			if ( rangeSq < closeBotRangeSq )
 			{
-				if ( ValidTargetBot( bot, vecSentryOrigin, vecBotTarget ) )
-				{
-					closeBotRangeSq = rangeSq;
-					pTargetCurrent = bot;
-				}
+				SentryTarget_t &target = botTargets[ botTargets.AddToTail() ];
+				target.m_pEntity = bot;
+				target.m_vecTarget = vecBotTarget;
+				target.m_flDist2 = rangeSq;
+				target.m_nOrder = b;
+				target.m_nTieRank = b;
+				target.m_nValid = -1;
 			}
 		}
 
+		int iBot = FindNearestValidTarget( botTargets, CTFTargetGrid::TARGET_BOT, vecSentryOrigin );
+		if ( iBot != -1 )
+		{
+			pTargetCurrent = botTargets[iBot].m_pEntity;
+		}
+
 		if ( ( pTargetCurrent == NULL ) && !bTruceActive )
 		{
+			// The old target's distance counts for hysteresis even when it's out of range,
+			// so look it up directly rather than relying on the grid to return it
+			if ( pTargetOld && pTargetOld->IsBaseObject() && pTeam->IsObjectOnTeam( static_cast< CBaseObject* >( pTargetOld ) ) )
+			{
+				vecTargetCenter = pTargetOld->GetAbsOrigin();
+				vecTargetCenter += pTargetOld->GetViewOffset();
+				flOldTargetDist2 = ( vecTargetCenter - vecSentryOrigin ).LengthSqr();
+			}
+
 			// target objects
-			int nTeamObjectCount = pTeam->GetNumObjects();
-			for ( int iObject = 0; iObject < nTeamObjectCount; ++iObject )
+			CUtlVector< CBaseEntity * > objectVector;
+			TFTargetGrid().CollectTargets( CTFTargetGrid::TARGET_OBJECT, iEnemyTeam, vecSentryOrigin, m_flSentryRange, &objectVector );
+
+			CUtlVector< SentryTarget_t > objectTargets;
+			for ( int iObject = 0; iObject < objectVector.Count(); ++iObject )
 			{
-				CBaseObject *pTargetObject = pTeam->GetObject( iObject );
-				if ( !pTargetObject )
-					continue;
+				CBaseObject *pTargetObject = static_cast< CBaseObject* >( objectVector[iObject] );
 
 				vecTargetCenter = pTargetObject->GetAbsOrigin();
 				vecTargetCenter += pTargetObject->GetViewOffset();
 				VectorSubtract( vecTargetCenter, vecSentryOrigin, vecSegment );
 				float flDist2 = vecSegment.LengthSqr();
 
-				// Store the current target distance if we come across it
-				if ( pTargetObject == pTargetOld )
-				{
-					flOldTargetDist2 = flDist2;
-				}
-
-				// Check to see if the target is closer than the already validated target.
+				// Out of range.
 				if ( flDist2 > flMinDist2 )
 					continue;
 
-				// It is closer, check to see if the target is valid.
-				if ( ValidTargetObject( pTargetObject, vecSentryOrigin, vecTargetCenter ) )
-				{
-					flMinDist2 = flDist2;
-					pTargetCurrent = pTargetObject;
-				}
+				SentryTarget_t &target = objectTargets[ objectTargets.AddToTail() ];
+				target.m_pEntity = pTargetObject;
+				target.m_vecTarget = vecTargetCenter;
+				target.m_flDist2 = flDist2;
+				target.m_nOrder = iObject;
+				target.m_nTieRank = -iObject;
+				target.m_nValid = -1;
+			}
+
+			// The closest valid object wins.
+			int iObjectTarget = FindNearestValidTarget( objectTargets, CTFTargetGrid::TARGET_OBJECT, vecSentryOrigin );
+			if ( iObjectTarget != -1 )
+			{
+				flMinDist2 = objectTargets[iObjectTarget].m_flDist2;
+				pTargetCurrent = objectTargets[iObjectTarget].m_pEntity;
 			}
 		}
 	}
@@ -1146,6 +1211,65 @@ bool CObjectSentrygun::ValidTargetBot( CBaseCombatCharacter *pBot, const Vector
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Nearest first; equally near candidates in the order the old list walk
+//			would have kept them
+//-----------------------------------------------------------------------------
+int __cdecl CObjectSentrygun::SentryTargetCompare( const SentryTarget_t *pLeft, const SentryTarget_t *pRight )
+{
+	if ( pLeft->m_flDist2 != pRight->m_flDist2 )
+		return ( pLeft->m_flDist2 < pRight->m_flDist2 ) ? -1 : 1;
+
+	return pLeft->m_nTieRank - pRight->m_nTieRank;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Ask the ValidTarget*() check for the candidate's type, at most once
+//-----------------------------------------------------------------------------
+bool CObjectSentrygun::ValidTarget( SentryTarget_t &target, CTFTargetGrid::TargetType_t type, const Vector &vecSentryOrigin )
+{
+	if ( target.m_nValid == -1 )
+	{
+		bool bValid = false;
+		switch ( type )
+		{
+		case CTFTargetGrid::TARGET_PLAYER:
+			bValid = ValidTargetPlayer( static_cast< CTFPlayer* >( target.m_pEntity ), vecSentryOrigin, target.m_vecTarget );
+			break;
+		case CTFTargetGrid::TARGET_OBJECT:
+			bValid = ValidTargetObject( static_cast< CBaseObject* >( target.m_pEntity ), vecSentryOrigin, target.m_vecTarget );
+			break;
+		case CTFTargetGrid::TARGET_BOT:
+			bValid = ValidTargetBot( static_cast< CBaseCombatCharacter* >( target.m_pEntity ), vecSentryOrigin, target.m_vecTarget );
+			break;
+		default:
+			Assert( 0 );
+			break;
+		}
+
+		target.m_nValid = bValid ? 1 : 0;
+	}
+
+	return ( target.m_nValid == 1 );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Sort the candidates nearest first and return the index of the first
+//			valid one, or -1. Candidates behind it are never ray traced.
+//-----------------------------------------------------------------------------
+int CObjectSentrygun::FindNearestValidTarget( CUtlVector< SentryTarget_t > &targets, CTFTargetGrid::TargetType_t type, const Vector &vecSentryOrigin )
+{
+	targets.Sort( &SentryTargetCompare );
+
+	for ( int i = 0; i < targets.Count(); ++i )
+	{
+		if ( ValidTarget( targets[i], type, vecSentryOrigin ) )
+			return i;
+	}
+
+	return -1;
+}
+
 //-----------------------------------------------------------------------------
 // Found a Target
 //-----------------------------------------------------------------------------
@@ -13,6 +13,7 @@
 
 #include "tf_obj.h"
 #include "tf_projectile_rocket.h"
+#include "tf_target_grid.h"
 
 class CTFPlayer;
 
@@ -135,6 +136,21 @@ private:
 	bool ValidTargetObject( CBaseObject *pObject, const Vector &vecStart, const Vector &vecEnd );
 	bool ValidTargetBot( CBaseCombatCharacter *pBot, const Vector &vecStart, const Vector &vecEnd );
 
+	// An in-range target candidate for one FindTarget() call. Candidates are sorted
+	// nearest first and validated lazily, so the ray trace stops at the first valid one.
+	struct SentryTarget_t
+	{
+		CBaseEntity *m_pEntity;
+		Vector m_vecTarget;
+		float m_flDist2;
+		int m_nOrder;				// position in the source list
+		int m_nTieRank;				// lower wins between equally near candidates, as the old list walk did
+		int m_nValid;				// -1 until ValidTarget() has been asked
+	};
+	static int __cdecl SentryTargetCompare( const SentryTarget_t *pLeft, const SentryTarget_t *pRight );
+	bool ValidTarget( SentryTarget_t &target, CTFTargetGrid::TargetType_t type, const Vector &vecSentryOrigin );
+	int FindNearestValidTarget( CUtlVector< SentryTarget_t > &targets, CTFTargetGrid::TargetType_t type, const Vector &vecSentryOrigin );
+
 	void FoundTarget( CBaseEntity *pTarget, const Vector &vecSoundCenter, bool bNoSound=false );
 	bool FInViewCone ( CBaseEntity *pEntity );
 	int Range( CBaseEntity *pTarget );
@@ -668,6 +668,7 @@ public:
 
 	CNetworkVarEmbedded( CTFPlayerShared, m_Shared );
 	friend class CTFPlayerShared;
+	friend class CMovementRecorder;
 
 	int m_flNextTimeCheck;		// Next time the player can execute a "timeleft" command
 
@@ -0,0 +1,754 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Opt-in structured log of gameplay events
+//
+//=============================================================================//
+
+#include "cbase.h"
+#include "tf_structuredlog.h"
+#include "tf_player.h"
+#include "tf_obj.h"
+#include "tf_weaponbase.h"
+#include "filesystem.h"
+#include <time.h>
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+ConVar tf_structuredlog( "tf_structuredlog", "0", FCVAR_NONE, "Write kills, damage, healing, objectives, buildings and MvM events to a structured log under logs/." );
+ConVar tf_structuredlog_format( "tf_structuredlog_format", "binary", FCVAR_NONE, "Structured log file format: binary, json or text. Applies to the next file." );
+ConVar tf_structuredlog_maxsize( "tf_structuredlog_maxsize", "64", FCVAR_NONE, "Start a new structured log file once the current one reaches this many megabytes.", true, 1, true, 1024 );
+
+#define TF_STRUCTUREDLOG_VERSION		2
+#define TF_STRUCTUREDLOG_FLUSH_SIZE		( 64 * 1024 )
+
+enum ETFLogFormat
+{
+	TF_LOGFORMAT_BINARY = 0,
+	TF_LOGFORMAT_JSON,
+	TF_LOGFORMAT_TEXT,
+};
+
+static const char *s_pszLogFormatExtension[] = { "bin", "json", "log" };
+
+//-----------------------------------------------------------------------------
+// Names for each record type and its value fields, NULL where a field is unused
+//-----------------------------------------------------------------------------
+struct TFLogRecordInfo_t
+{
+	const char *m_pszName;
+	const char *m_pszValue;
+	const char *m_pszParam;
+	const char *m_pszParam2;
+};
+
+static const TFLogRecordInfo_t s_LogRecordInfo[] =
+{
+	{ "kill",				"customkill",	"damagebits",	NULL },
+	{ "damage",				"damage",		"customkill",	"damagebits" },
+	{ "healed",				"healing",		NULL,			NULL },
+	{ "pointcaptured",		NULL,			NULL,			NULL },
+	{ "captureblocked",		NULL,			NULL,			NULL },
+	{ "builtobject",		"object",		"mode",			NULL },
+	{ "killedobject",		"object",		"mode",			NULL },
+	{ "mvm_wave_start",		"wave",			NULL,			NULL },
+	{ "mvm_wave_end",		"wave",			"success",		NULL },
+	{ "mvm_upgrade",		"cost",			"attribute",	"bottle" },
+};
+COMPILE_TIME_ASSERT( ARRAYSIZE( s_LogRecordInfo ) == TF_LOGRECORD_COUNT );
+
+// Binary files start with this, followed by a uint16 size and the record for each record
+struct TFLogFileHeader_t
+{
+	char	m_szMagic[4];			// "TFSL"
+	uint32	m_nVersion;
+	uint32	m_nRecordSize;
+	float	m_flTickInterval;
+	char	m_szMap[64];
+};
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Drains the ring buffer to disk on its own thread
+//-----------------------------------------------------------------------------
+class CTFStructuredLogWriter : public CThread
+{
+public:
+	CTFStructuredLogWriter( const char *pszBaseName, const char *pszMap, ETFLogFormat eFormat, int nMaxBytes )
+		: m_strBaseName( pszBaseName )
+		, m_strMap( pszMap )
+		, m_eFormat( eFormat )
+		, m_nMaxBytes( nMaxBytes )
+		, m_flTickInterval( gpGlobals->interval_per_tick )
+		, m_hFile( FILESYSTEM_INVALID_HANDLE )
+		, m_nFileIndex( 0 )
+		, m_nFileBytes( 0 )
+		, m_bStop( false )
+		, m_Buffer( 0, TF_STRUCTUREDLOG_FLUSH_SIZE, m_eFormat == TF_LOGFORMAT_BINARY ? 0 : CUtlBuffer::TEXT_BUFFER )
+	{
+		SetName( "TFStructuredLog" );
+	}
+
+	void Wake() { m_Wake.Set(); }
+
+	void RequestStop()
+	{
+		m_bStop = true;
+		m_Wake.Set();
+	}
+
+	virtual int Run()
+	{
+		OpenFile();
+
+		for ( ;; )
+		{
+			m_Wake.Wait( 250 );
+
+			// anything logged before the stop request is in the ring by now
+			bool bStop = m_bStop;
+			Drain();
+			if ( bStop )
+				break;
+		}
+
+		CloseFile();
+		return 0;
+	}
+
+private:
+	void OpenFile();
+	void CloseFile();
+	void Drain();
+	void Flush();
+
+	void FormatBinary( const TFLogRecord_t &record );
+	void FormatJSON( const TFLogRecord_t &record );
+	void FormatText( const TFLogRecord_t &record );
+	void FormatTextPlayer( const char *pszPrefix, int nUserID, uint32 unAccountID, int nTeam );
+
+	CUtlString		m_strBaseName;
+	CUtlString		m_strMap;
+	ETFLogFormat	m_eFormat;
+	int				m_nMaxBytes;
+	float			m_flTickInterval;
+
+	FileHandle_t	m_hFile;
+	int				m_nFileIndex;
+	int				m_nFileBytes;
+
+	volatile bool	m_bStop;
+	CThreadEvent	m_Wake;
+	CUtlBuffer		m_Buffer;
+};
+
+void CTFStructuredLogWriter::OpenFile()
+{
+	char szFileName[MAX_PATH];
+	V_snprintf( szFileName, sizeof( szFileName ), "%s_%03d.%s", m_strBaseName.Get(), m_nFileIndex, s_pszLogFormatExtension[m_eFormat] );
+
+	m_hFile = filesystem->Open( szFileName, m_eFormat == TF_LOGFORMAT_BINARY ? "wb" : "wt", "DEFAULT_WRITE_PATH" );
+	m_nFileBytes = 0;
+	if ( m_hFile == FILESYSTEM_INVALID_HANDLE )
+	{
+		// Keep draining so the game thread doesn't fill the ring and start dropping
+		Warning( "tf_structuredlog: couldn't open %s\n", szFileName );
+		return;
+	}
+
+	switch ( m_eFormat )
+	{
+	case TF_LOGFORMAT_BINARY:
+		{
+			TFLogFileHeader_t header;
+			V_memset( &header, 0, sizeof( header ) );
+			V_memcpy( header.m_szMagic, "TFSL", sizeof( header.m_szMagic ) );
+			header.m_nVersion = TF_STRUCTUREDLOG_VERSION;
+			header.m_nRecordSize = sizeof( TFLogRecord_t );
+			header.m_flTickInterval = m_flTickInterval;
+			V_strncpy( header.m_szMap, m_strMap.Get(), sizeof( header.m_szMap ) );
+			m_Buffer.Put( &header, sizeof( header ) );
+		}
+		break;
+
+	case TF_LOGFORMAT_JSON:
+		m_Buffer.Printf( "{\"type\":\"header\",\"version\":%d,\"map\":\"%s\",\"tick_interval\":%g}\n", TF_STRUCTUREDLOG_VERSION, m_strMap.Get(), m_flTickInterval );
+		break;
+
+	case TF_LOGFORMAT_TEXT:
+		m_Buffer.Printf( "Log file started (map \"%s\") (tick_interval \"%g\")\n", m_strMap.Get(), m_flTickInterval );
+		break;
+	}
+}
+
+void CTFStructuredLogWriter::CloseFile()
+{
+	Flush();
+
+	if ( m_hFile != FILESYSTEM_INVALID_HANDLE )
+	{
+		filesystem->Close( m_hFile );
+		m_hFile = FILESYSTEM_INVALID_HANDLE;
+	}
+}
+
+void CTFStructuredLogWriter::Flush()
+{
+	if ( m_hFile != FILESYSTEM_INVALID_HANDLE && m_Buffer.TellPut() > 0 )
+	{
+		filesystem->Write( m_Buffer.Base(), m_Buffer.TellPut(), m_hFile );
+		m_nFileBytes += m_Buffer.TellPut();
+	}
+
+	m_Buffer.Clear();
+}
+
+void CTFStructuredLogWriter::Drain()
+{
+	TFLogRecord_t record;
+	while ( g_TFStructuredLog.PopRecord( record ) )
+	{
+		switch ( m_eFormat )
+		{
+		case TF_LOGFORMAT_BINARY:	FormatBinary( record );	break;
+		case TF_LOGFORMAT_JSON:		FormatJSON( record );	break;
+		case TF_LOGFORMAT_TEXT:		FormatText( record );	break;
+		}
+
+		if ( m_Buffer.TellPut() >= TF_STRUCTUREDLOG_FLUSH_SIZE )
+		{
+			Flush();
+		}
+	}
+
+	Flush();
+
+	if ( m_hFile != FILESYSTEM_INVALID_HANDLE && m_nFileBytes >= m_nMaxBytes )
+	{
+		CloseFile();
+		m_nFileIndex++;
+		OpenFile();
+	}
+}
+
+void CTFStructuredLogWriter::FormatBinary( const TFLogRecord_t &record )
+{
+	// length prefixed so readers can skip records from newer versions
+	m_Buffer.PutUnsignedShort( sizeof( record ) );
+	m_Buffer.Put( &record, sizeof( record ) );
+}
+
+void CTFStructuredLogWriter::FormatJSON( const TFLogRecord_t &record )
+{
+	const TFLogRecordInfo_t &info = s_LogRecordInfo[record.m_nType];
+
+	m_Buffer.Printf( "{\"type\":\"%s\",\"tick\":%d,\"time\":%.3f", info.m_pszName, record.m_nTick, record.m_nTick * m_flTickInterval );
+
+	if ( record.m_nActorUserID )
+	{
+		m_Buffer.Printf( ",\"actor\":{\"userid\":%d,\"account\":%u,\"team\":%d,\"class\":%d,\"bot\":%s,\"pos\":[%d,%d,%d]}",
+			record.m_nActorUserID, record.m_unActorAccountID, record.m_nActorTeam, record.m_nActorClass,
+			( record.m_nFlags & TF_LOGRECORD_FLAG_ACTOR_BOT ) ? "true" : "false",
+			record.m_vecActorPos[0], record.m_vecActorPos[1], record.m_vecActorPos[2] );
+	}
+
+	if ( record.m_nTargetUserID )
+	{
+		m_Buffer.Printf( ",\"target\":{\"userid\":%d,\"account\":%u,\"team\":%d,\"class\":%d,\"bot\":%s,\"pos\":[%d,%d,%d]}",
+			record.m_nTargetUserID, record.m_unTargetAccountID, record.m_nTargetTeam, record.m_nTargetClass,
+			( record.m_nFlags & TF_LOGRECORD_FLAG_TARGET_BOT ) ? "true" : "false",
+			record.m_vecTargetPos[0], record.m_vecTargetPos[1], record.m_vecTargetPos[2] );
+	}
+	else if ( record.m_nType == TF_LOGRECORD_BUILDING_BUILT )
+	{
+		m_Buffer.Printf( ",\"pos\":[%d,%d,%d]", record.m_vecTargetPos[0], record.m_vecTargetPos[1], record.m_vecTargetPos[2] );
+	}
+
+	if ( record.m_nItemDef != INVALID_ITEM_DEF_INDEX )
+	{
+		m_Buffer.Printf( ",\"item\":%d", record.m_nItemDef );
+	}
+
+	if ( info.m_pszValue )
+	{
+		m_Buffer.Printf( ",\"%s\":%d", info.m_pszValue, record.m_nValue );
+	}
+	if ( info.m_pszParam )
+	{
+		m_Buffer.Printf( ",\"%s\":%d", info.m_pszParam, record.m_nParam );
+	}
+	if ( info.m_pszParam2 )
+	{
+		m_Buffer.Printf( ",\"%s\":%d", info.m_pszParam2, record.m_nParam2 );
+	}
+
+	if ( record.m_nFlags & TF_LOGRECORD_FLAG_CRIT )
+	{
+		m_Buffer.PutString( ",\"crit\":true" );
+	}
+	else if ( record.m_nFlags & TF_LOGRECORD_FLAG_MINICRIT )
+	{
+		m_Buffer.PutString( ",\"minicrit\":true" );
+	}
+
+	if ( record.m_nFlags & TF_LOGRECORD_FLAG_BY_BUILDING )
+	{
+		m_Buffer.PutString( ",\"by_building\":true" );
+	}
+
+	m_Buffer.PutString( "}\n" );
+}
+
+void CTFStructuredLogWriter::FormatTextPlayer( const char *pszPrefix, int nUserID, uint32 unAccountID, int nTeam )
+{
+	// No names, they'd need the player on the game thread. The userid ties these to
+	// the "entered the game" lines in the regular log.
+	const char *pszTeam = ( nTeam == TF_TEAM_RED ) ? "Red" : ( ( nTeam == TF_TEAM_BLUE ) ? "Blue" : "Unassigned" );
+	if ( unAccountID )
+	{
+		m_Buffer.Printf( "%s\"<%d><[U:1:%u]><%s>\"", pszPrefix, nUserID, unAccountID, pszTeam );
+	}
+	else
+	{
+		m_Buffer.Printf( "%s\"<%d><BOT><%s>\"", pszPrefix, nUserID, pszTeam );
+	}
+}
+
+void CTFStructuredLogWriter::FormatText( const TFLogRecord_t &record )
+{
+	const TFLogRecordInfo_t &info = s_LogRecordInfo[record.m_nType];
+
+	m_Buffer.Printf( "T %d: ", record.m_nTick );
+
+	if ( record.m_nActorUserID )
+	{
+		FormatTextPlayer( "", record.m_nActorUserID, record.m_unActorAccountID, record.m_nActorTeam );
+		m_Buffer.Printf( " triggered \"%s\"", info.m_pszName );
+	}
+	else
+	{
+		m_Buffer.Printf( "World triggered \"%s\"", info.m_pszName );
+	}
+
+	if ( record.m_nTargetUserID )
+	{
+		FormatTextPlayer( " against ", record.m_nTargetUserID, record.m_unTargetAccountID, record.m_nTargetTeam );
+	}
+
+	if ( record.m_nItemDef != INVALID_ITEM_DEF_INDEX )
+	{
+		m_Buffer.Printf( " (item \"%d\")", record.m_nItemDef );
+	}
+
+	if ( info.m_pszValue )
+	{
+		m_Buffer.Printf( " (%s \"%d\")", info.m_pszValue, record.m_nValue );
+	}
+	if ( info.m_pszParam )
+	{
+		m_Buffer.Printf( " (%s \"%d\")", info.m_pszParam, record.m_nParam );
+	}
+	if ( info.m_pszParam2 )
+	{
+		m_Buffer.Printf( " (%s \"%d\")", info.m_pszParam2, record.m_nParam2 );
+	}
+
+	if ( record.m_nFlags & TF_LOGRECORD_FLAG_CRIT )
+	{
+		m_Buffer.PutString( " (crit \"crit\")" );
+	}
+	else if ( record.m_nFlags & TF_LOGRECORD_FLAG_MINICRIT )
+	{
+		m_Buffer.PutString( " (crit \"mini\")" );
+	}
+
+	if ( record.m_nFlags & TF_LOGRECORD_FLAG_BY_BUILDING )
+	{
+		m_Buffer.PutString( " (by_building \"1\")" );
+	}
+
+	if ( record.m_nActorUserID )
+	{
+		m_Buffer.Printf( " (attacker_position \"%d %d %d\")", record.m_vecActorPos[0], record.m_vecActorPos[1], record.m_vecActorPos[2] );
+	}
+	if ( record.m_nTargetUserID )
+	{
+		m_Buffer.Printf( " (victim_position \"%d %d %d\")", record.m_vecTargetPos[0], record.m_vecTargetPos[1], record.m_vecTargetPos[2] );
+	}
+	else if ( record.m_nType == TF_LOGRECORD_BUILDING_BUILT )
+	{
+		m_Buffer.Printf( " (position \"%d %d %d\")", record.m_vecTargetPos[0], record.m_vecTargetPos[1], record.m_vecTargetPos[2] );
+	}
+
+	m_Buffer.PutString( "\n" );
+}
+
+
+//-----------------------------------------------------------------------------
+// CTFStructuredLog
+//-----------------------------------------------------------------------------
+CTFStructuredLog g_TFStructuredLog;
+
+CTFStructuredLog::CTFStructuredLog() : CAutoGameSystemPerFrame( "CTFStructuredLog" )
+{
+	m_nDropped = 0;
+	m_flNextDropWarningTime = 0.0f;
+	m_pWriter = NULL;
+}
+
+static void SetRecordPosition( int16 vecPos[3], const Vector &vecOrigin )
+{
+	for ( int i = 0; i < 3; i++ )
+	{
+		vecPos[i] = (int16)clamp( vecOrigin[i], -32768.0f, 32767.0f );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Returns the next free slot, or NULL if the writer has fallen a whole
+//			ring behind. Records are dropped rather than stalling the game.
+//-----------------------------------------------------------------------------
+TFLogRecord_t *CTFStructuredLog::BeginRecord( ETFLogRecordType eType )
+{
+	Assert( ThreadInMainThread() );
+
+	unsigned nWrite = m_nWriteIndex;
+	if ( nWrite - m_nReadIndex >= TF_STRUCTUREDLOG_RING_SIZE )
+	{
+		m_nDropped++;
+		return NULL;
+	}
+
+	TFLogRecord_t *pRecord = &m_Ring[nWrite & ( TF_STRUCTUREDLOG_RING_SIZE - 1 )];
+	V_memset( pRecord, 0, sizeof( *pRecord ) );
+	pRecord->m_nType = eType;
+	pRecord->m_nTick = gpGlobals->tickcount;
+	pRecord->m_nItemDef = INVALID_ITEM_DEF_INDEX;
+	return pRecord;
+}
+
+void CTFStructuredLog::CommitRecord()
+{
+	// the record has to be complete before the writer can see it
+	ThreadMemoryBarrier();
+	++m_nWriteIndex;
+}
+
+bool CTFStructuredLog::PopRecord( TFLogRecord_t &record )
+{
+	unsigned nRead = m_nReadIndex;
+	if ( nRead == m_nWriteIndex )
+		return false;
+
+	ThreadMemoryBarrier();
+	record = m_Ring[nRead & ( TF_STRUCTUREDLOG_RING_SIZE - 1 )];
+	ThreadMemoryBarrier();
+	++m_nReadIndex;
+	return true;
+}
+
+void CTFStructuredLog::SetActor( TFLogRecord_t *pRecord, CTFPlayer *pPlayer )
+{
+	CSteamID steamID;
+	pRecord->m_nActorUserID = pPlayer->GetUserID();
+	pRecord->m_unActorAccountID = pPlayer->GetSteamID( &steamID ) ? steamID.GetAccountID() : 0;
+	pRecord->m_nActorTeam = pPlayer->GetTeamNumber();
+	pRecord->m_nActorClass = pPlayer->GetPlayerClass()->GetClassIndex();
+	SetRecordPosition( pRecord->m_vecActorPos, pPlayer->GetAbsOrigin() );
+	if ( pPlayer->IsBot() )
+	{
+		pRecord->m_nFlags |= TF_LOGRECORD_FLAG_ACTOR_BOT;
+	}
+}
+
+void CTFStructuredLog::SetTarget( TFLogRecord_t *pRecord, CTFPlayer *pPlayer )
+{
+	CSteamID steamID;
+	pRecord->m_nTargetUserID = pPlayer->GetUserID();
+	pRecord->m_unTargetAccountID = pPlayer->GetSteamID( &steamID ) ? steamID.GetAccountID() : 0;
+	pRecord->m_nTargetTeam = pPlayer->GetTeamNumber();
+	pRecord->m_nTargetClass = pPlayer->GetPlayerClass()->GetClassIndex();
+	SetRecordPosition( pRecord->m_vecTargetPos, pPlayer->GetAbsOrigin() );
+	if ( pPlayer->IsBot() )
+	{
+		pRecord->m_nFlags |= TF_LOGRECORD_FLAG_TARGET_BOT;
+	}
+}
+
+static void SetRecordDamage( TFLogRecord_t *pRecord, const CTakeDamageInfo &info )
+{
+	CTFWeaponBase *pWeapon = dynamic_cast< CTFWeaponBase * >( info.GetWeapon() );
+	if ( pWeapon && pWeapon->GetAttributeContainer()->GetItem() )
+	{
+		pRecord->m_nItemDef = pWeapon->GetAttributeContainer()->GetItem()->GetItemDefIndex();
+	}
+
+	if ( info.GetCritType() == CTakeDamageInfo::CRIT_FULL )
+	{
+		pRecord->m_nFlags |= TF_LOGRECORD_FLAG_CRIT;
+	}
+	else if ( info.GetCritType() == CTakeDamageInfo::CRIT_MINI )
+	{
+		pRecord->m_nFlags |= TF_LOGRECORD_FLAG_MINICRIT;
+	}
+}
+
+void CTFStructuredLog::SetAttacker( TFLogRecord_t *pRecord, const CTakeDamageInfo &info )
+{
+	CBaseEntity *pAttacker = info.GetAttacker();
+	CTFPlayer *pPlayer = ToTFPlayer( pAttacker );
+	if ( !pPlayer && pAttacker && pAttacker->IsBaseObject() )
+	{
+		pPlayer = static_cast< CBaseObject * >( pAttacker )->GetOwner();
+		pRecord->m_nFlags |= TF_LOGRECORD_FLAG_BY_BUILDING;
+	}
+
+	if ( pPlayer )
+	{
+		SetActor( pRecord, pPlayer );
+	}
+}
+
+void CTFStructuredLog::LogKill( CTFPlayer *pVictim, const CTakeDamageInfo &info )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_KILL );
+	if ( !pRecord )
+		return;
+
+	SetAttacker( pRecord, info );
+	if ( pVictim )
+	{
+		SetTarget( pRecord, pVictim );
+	}
+	SetRecordDamage( pRecord, info );
+	pRecord->m_nValue = info.GetDamageCustom();
+	pRecord->m_nParam = info.GetDamageType();
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogDamage( CTFPlayer *pVictim, const CTakeDamageInfo &info, int iDamageTaken )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_DAMAGE );
+	if ( !pRecord )
+		return;
+
+	SetAttacker( pRecord, info );
+	if ( pVictim )
+	{
+		SetTarget( pRecord, pVictim );
+	}
+	SetRecordDamage( pRecord, info );
+	pRecord->m_nValue = iDamageTaken;
+	pRecord->m_nParam = info.GetDamageCustom();
+	pRecord->m_nParam2 = info.GetDamageType();
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogHeal( CTFPlayer *pHealer, int iAmount )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_HEAL );
+	if ( !pRecord )
+		return;
+
+	SetActor( pRecord, pHealer );
+	pRecord->m_nValue = iAmount;
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogPointEvent( ETFLogRecordType eType, CTFPlayer *pPlayer )
+{
+	Assert( eType == TF_LOGRECORD_CAPTURE || eType == TF_LOGRECORD_DEFEND );
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( eType );
+	if ( !pRecord )
+		return;
+
+	SetActor( pRecord, pPlayer );
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogBuildingBuilt( CTFPlayer *pBuilder, CBaseObject *pObject )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_BUILDING_BUILT );
+	if ( !pRecord )
+		return;
+
+	SetActor( pRecord, pBuilder );
+	SetRecordPosition( pRecord->m_vecTargetPos, pObject->GetAbsOrigin() );
+	pRecord->m_nValue = pObject->GetType();
+	pRecord->m_nParam = pObject->GetObjectMode();
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogBuildingDestroyed( CTFPlayer *pAttacker, CBaseObject *pObject )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_BUILDING_DESTROYED );
+	if ( !pRecord )
+		return;
+
+	SetActor( pRecord, pAttacker );
+	if ( pObject->GetOwner() )
+	{
+		SetTarget( pRecord, pObject->GetOwner() );
+	}
+	SetRecordPosition( pRecord->m_vecTargetPos, pObject->GetAbsOrigin() );
+	pRecord->m_nValue = pObject->GetType();
+	pRecord->m_nParam = pObject->GetObjectMode();
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogWaveStart( int iWave )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_MVM_WAVE_START );
+	if ( !pRecord )
+		return;
+
+	pRecord->m_nValue = iWave;
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogWaveEnd( int iWave, bool bSuccess )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_MVM_WAVE_END );
+	if ( !pRecord )
+		return;
+
+	pRecord->m_nValue = iWave;
+	pRecord->m_nParam = bSuccess ? 1 : 0;
+	CommitRecord();
+}
+
+void CTFStructuredLog::LogUpgrade( CTFPlayer *pPlayer, int iItemDef, int iAttributeDef, int iCost, bool bIsBottle )
+{
+	if ( !IsActive() )
+		return;
+
+	TFLogRecord_t *pRecord = BeginRecord( TF_LOGRECORD_MVM_UPGRADE );
+	if ( !pRecord )
+		return;
+
+	SetActor( pRecord, pPlayer );
+	pRecord->m_nItemDef = iItemDef;
+	pRecord->m_nValue = iCost;
+	pRecord->m_nParam = iAttributeDef;
+	pRecord->m_nParam2 = bIsBottle ? 1 : 0;
+	CommitRecord();
+}
+
+void CTFStructuredLog::Start()
+{
+	Assert( !m_pWriter );
+
+	ETFLogFormat eFormat = TF_LOGFORMAT_BINARY;
+	if ( FStrEq( tf_structuredlog_format.GetString(), "json" ) )
+	{
+		eFormat = TF_LOGFORMAT_JSON;
+	}
+	else if ( FStrEq( tf_structuredlog_format.GetString(), "text" ) )
+	{
+		eFormat = TF_LOGFORMAT_TEXT;
+	}
+	else if ( !FStrEq( tf_structuredlog_format.GetString(), "binary" ) )
+	{
+		Warning( "tf_structuredlog_format: unknown format \"%s\", writing binary\n", tf_structuredlog_format.GetString() );
+	}
+
+	time_t now = time( NULL );
+	struct tm tmNow;
+	Plat_localtime( &now, &tmNow );
+
+	char szBaseName[MAX_PATH];
+	V_snprintf( szBaseName, sizeof( szBaseName ), "logs/tf_events_%04d%02d%02d_%02d%02d%02d_%s",
+		tmNow.tm_year + 1900, tmNow.tm_mon + 1, tmNow.tm_mday, tmNow.tm_hour, tmNow.tm_min, tmNow.tm_sec, STRING( gpGlobals->mapname ) );
+	filesystem->CreateDirHierarchy( "logs", "DEFAULT_WRITE_PATH" );
+
+	CTFStructuredLogWriter *pWriter = new CTFStructuredLogWriter( szBaseName, STRING( gpGlobals->mapname ), eFormat, tf_structuredlog_maxsize.GetInt() * 1024 * 1024 );
+	if ( !pWriter->Start() )
+	{
+		Warning( "tf_structuredlog: couldn't start the writer thread\n" );
+		delete pWriter;
+		tf_structuredlog.SetValue( 0 );
+		return;
+	}
+
+	m_pWriter = pWriter;
+}
+
+void CTFStructuredLog::Stop()
+{
+	if ( !m_pWriter )
+		return;
+
+	// Stop logging before asking the writer to finish, so it sees everything
+	CTFStructuredLogWriter *pWriter = m_pWriter;
+	m_pWriter = NULL;
+
+	pWriter->RequestStop();
+	pWriter->Join();
+	delete pWriter;
+}
+
+void CTFStructuredLog::LevelShutdownPreEntity()
+{
+	// One set of files per map. FrameUpdatePostEntityThink starts the next one.
+	Stop();
+}
+
+void CTFStructuredLog::Shutdown()
+{
+	Stop();
+}
+
+void CTFStructuredLog::FrameUpdatePostEntityThink()
+{
+	if ( tf_structuredlog.GetBool() != IsActive() )
+	{
+		if ( IsActive() )
+		{
+			Stop();
+		}
+		else
+		{
+			Start();
+		}
+	}
+
+	if ( !IsActive() )
+		return;
+
+	// hand the writer a tick's worth of records at a time
+	if ( m_nWriteIndex != m_nReadIndex )
+	{
+		m_pWriter->Wake();
+	}
+
+	if ( m_nDropped && gpGlobals->curtime >= m_flNextDropWarningTime )
+	{
+		Warning( "tf_structuredlog: dropped %d records, the writer can't keep up\n", m_nDropped );
+		m_nDropped = 0;
+		m_flNextDropWarningTime = gpGlobals->curtime + 5.0f;
+	}
+}
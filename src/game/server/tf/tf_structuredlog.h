@@ -0,0 +1,136 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Opt-in structured log of gameplay events. The game thread fills fixed size
+//			records into a ring buffer and a background thread writes them out as
+//			length-prefixed binary, newline-delimited JSON or log style text, so
+//			stats pipelines don't have to parse the text log and the game thread
+//			never formats anything.
+//
+//			tf_structuredlog 1				- start logging at the next level or right away
+//			tf_structuredlog_format <fmt>	- binary, json or text
+//			tf_structuredlog_maxsize <mb>	- start a new file once this one is this large
+//
+//=============================================================================//
+
+#ifndef TF_STRUCTUREDLOG_H
+#define TF_STRUCTUREDLOG_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+#include "tier0/threadtools.h"
+
+class CTFPlayer;
+class CBaseObject;
+class CTakeDamageInfo;
+class CTFStructuredLogWriter;
+
+// Record types. Don't reorder, the binary files store these.
+enum ETFLogRecordType
+{
+	TF_LOGRECORD_KILL = 0,			// actor killed target
+	TF_LOGRECORD_DAMAGE,			// actor damaged target
+	TF_LOGRECORD_HEAL,				// actor healed someone
+	TF_LOGRECORD_CAPTURE,			// actor captured a point
+	TF_LOGRECORD_DEFEND,			// actor defended a point
+	TF_LOGRECORD_BUILDING_BUILT,	// actor built an object, target position is the object
+	TF_LOGRECORD_BUILDING_DESTROYED,// actor destroyed an object owned by target
+	TF_LOGRECORD_MVM_WAVE_START,
+	TF_LOGRECORD_MVM_WAVE_END,
+	TF_LOGRECORD_MVM_UPGRADE,		// actor bought an upgrade for an item
+
+	TF_LOGRECORD_COUNT
+};
+
+#define TF_LOGRECORD_FLAG_CRIT			( 1 << 0 )
+#define TF_LOGRECORD_FLAG_MINICRIT		( 1 << 1 )
+#define TF_LOGRECORD_FLAG_ACTOR_BOT		( 1 << 2 )
+#define TF_LOGRECORD_FLAG_TARGET_BOT	( 1 << 3 )
+#define TF_LOGRECORD_FLAG_BY_BUILDING	( 1 << 4 )		// the actor's building did the damage
+
+//-----------------------------------------------------------------------------
+// One logged event. What m_nValue and the two params hold depends on the type,
+// see s_LogRecordInfo in tf_structuredlog.cpp. Written to binary files as is.
+//-----------------------------------------------------------------------------
+struct TFLogRecord_t
+{
+	uint8	m_nType;				// ETFLogRecordType
+	uint8	m_nFlags;				// TF_LOGRECORD_FLAG_*
+	uint8	m_nActorTeam;
+	uint8	m_nActorClass;
+	uint8	m_nTargetTeam;
+	uint8	m_nTargetClass;
+	uint16	m_nItemDef;				// weapon or upgraded item, INVALID_ITEM_DEF_INDEX if none
+	int32	m_nTick;
+	uint32	m_unActorAccountID;		// 0 for bots
+	uint32	m_unTargetAccountID;
+	int16	m_nActorUserID;			// 0 if there is no actor
+	int16	m_nTargetUserID;
+	int32	m_nValue;
+	int32	m_nParam;
+	int32	m_nParam2;
+	int16	m_vecActorPos[3];
+	int16	m_vecTargetPos[3];
+};
+COMPILE_TIME_ASSERT( sizeof( TFLogRecord_t ) == 48 );
+
+// Must be a power of two
+#define TF_STRUCTUREDLOG_RING_SIZE		8192
+
+
+//-----------------------------------------------------------------------------
+// Purpose: Collects records on the game thread and owns the writer thread
+//-----------------------------------------------------------------------------
+class CTFStructuredLog : public CAutoGameSystemPerFrame
+{
+public:
+	CTFStructuredLog();
+
+	bool IsActive() const { return m_pWriter != NULL; }
+
+	// Game thread only
+	// Every death and every damage event, before the stats code filters any out.
+	// The actor is the attacking player, or the builder if a building did it, or none for the world.
+	void LogKill( CTFPlayer *pVictim, const CTakeDamageInfo &info );
+	void LogDamage( CTFPlayer *pVictim, const CTakeDamageInfo &info, int iDamageTaken );
+	void LogHeal( CTFPlayer *pHealer, int iAmount );
+	void LogPointEvent( ETFLogRecordType eType, CTFPlayer *pPlayer );
+	void LogBuildingBuilt( CTFPlayer *pBuilder, CBaseObject *pObject );
+	void LogBuildingDestroyed( CTFPlayer *pAttacker, CBaseObject *pObject );
+	void LogWaveStart( int iWave );
+	void LogWaveEnd( int iWave, bool bSuccess );
+	void LogUpgrade( CTFPlayer *pPlayer, int iItemDef, int iAttributeDef, int iCost, bool bIsBottle );
+
+	// Writer thread only. Copies out the oldest record, returns false if there is none.
+	bool PopRecord( TFLogRecord_t &record );
+
+	// CAutoGameSystemPerFrame
+	virtual void LevelShutdownPreEntity();
+	virtual void Shutdown();
+	virtual void FrameUpdatePostEntityThink();
+
+private:
+	void Start();
+	void Stop();
+
+	TFLogRecord_t *BeginRecord( ETFLogRecordType eType );
+	void CommitRecord();
+	void SetActor( TFLogRecord_t *pRecord, CTFPlayer *pPlayer );
+	void SetTarget( TFLogRecord_t *pRecord, CTFPlayer *pPlayer );
+	void SetAttacker( TFLogRecord_t *pRecord, const CTakeDamageInfo &info );
+
+	// Single producer, single consumer. Both counters only ever increase.
+	TFLogRecord_t				m_Ring[TF_STRUCTUREDLOG_RING_SIZE];
+	CInterlockedUInt			m_nWriteIndex;
+	CInterlockedUInt			m_nReadIndex;
+	int							m_nDropped;
+	float						m_flNextDropWarningTime;
+
+	CTFStructuredLogWriter		*m_pWriter;
+};
+
+extern CTFStructuredLog g_TFStructuredLog;
+
+
+#endif // TF_STRUCTUREDLOG_H
@@ -0,0 +1,229 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick spatial index of entities that buildings can target
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include "cbase.h"
+#include "tf_target_grid.h"
+#include "tf_team.h"
+#include "tf_obj.h"
+#include "tf_target_dummy.h"
+#include "NextBotManager.h"
+
+// memdbgon must be the last include file in a .cpp file!!!
+#include "tier0/memdbgon.h"
+
+#define TARGET_GRID_CELL_SIZE	512.0f
+#define TARGET_GRID_MARGIN		32.0f		// covers aim bones that poke outside the collision bounds
+
+static CTFTargetGrid s_TFTargetGrid;
+
+CTFTargetGrid &TFTargetGrid()
+{
+	return s_TFTargetGrid;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+CTFTargetGrid::CTFTargetGrid() : CAutoGameSystem( "CTFTargetGrid" )
+{
+	m_nBuildTick = -1;
+
+	for ( int i = 0; i < TARGET_TYPE_COUNT; ++i )
+	{
+		m_flMaxSlack[i] = 0.0f;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Drop the snapshot so no entity pointers survive into the next map
+//-----------------------------------------------------------------------------
+void CTFTargetGrid::LevelShutdownPostEntity()
+{
+	m_nBuildTick = -1;
+
+	for ( int i = 0; i < TARGET_TYPE_COUNT; ++i )
+	{
+		m_Targets[i].Purge();
+		m_Cells[i].Purge();
+		m_flMaxSlack[i] = 0.0f;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+unsigned int CTFTargetGrid::CellForPoint( float x, float y )
+{
+	int cx = (int)floorf( x * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+	int cy = (int)floorf( y * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+	return ( (unsigned int)cx & 0xFFFF ) | ( ( (unsigned int)cy & 0xFFFF ) << 16 );
+}
+
+int __cdecl CTFTargetGrid::TargetCellCompare( const Target_t *pLeft, const Target_t *pRight )
+{
+	if ( pLeft->m_nCell != pRight->m_nCell )
+		return ( pLeft->m_nCell < pRight->m_nCell ) ? -1 : 1;
+
+	return pLeft->m_nOrder - pRight->m_nOrder;
+}
+
+int __cdecl CTFTargetGrid::TargetOrderCompare( Target_t * const *ppLeft, Target_t * const *ppRight )
+{
+	return (*ppLeft)->m_nOrder - (*ppRight)->m_nOrder;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:
+//-----------------------------------------------------------------------------
+void CTFTargetGrid::AddTarget( TargetType_t type, CBaseEntity *pEntity, int iTeam, int nOrder )
+{
+	if ( !pEntity )
+		return;
+
+	Target_t &target = m_Targets[type][ m_Targets[type].AddToTail() ];
+	target.m_pEntity = pEntity;
+	target.m_vecCenter = pEntity->WorldSpaceCenter();
+	target.m_iTeam = iTeam;
+	target.m_nOrder = nOrder;
+	target.m_nCell = CellForPoint( target.m_vecCenter.x, target.m_vecCenter.y );
+
+	// Eye and aim points are within the bounding sphere plus the view offset;
+	// also allow for one tick of movement since entities keep thinking after the build
+	target.m_flSlack = pEntity->CollisionProp()->BoundingRadius() + pEntity->GetViewOffset().Length() +
+		pEntity->GetAbsVelocity().Length() * gpGlobals->interval_per_tick + TARGET_GRID_MARGIN;
+
+	m_flMaxSlack[type] = MAX( m_flMaxSlack[type], target.m_flSlack );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Rebuild the snapshot once per tick
+//-----------------------------------------------------------------------------
+void CTFTargetGrid::Update( void )
+{
+	if ( m_nBuildTick == gpGlobals->tickcount )
+		return;
+
+	VPROF_BUDGET( "CTFTargetGrid::Update", VPROF_BUDGETGROUP_GAME );
+
+	m_nBuildTick = gpGlobals->tickcount;
+
+	for ( int i = 0; i < TARGET_TYPE_COUNT; ++i )
+	{
+		m_Targets[i].RemoveAll();
+		m_Cells[i].RemoveAll();
+		m_flMaxSlack[i] = 0.0f;
+	}
+
+	for ( int i = 0; i < ITFTargetDummy::AutoList().Count(); ++i )
+	{
+		CTFTargetDummy *pDummy = static_cast< CTFTargetDummy* >( ITFTargetDummy::AutoList()[i] );
+		AddTarget( TARGET_DUMMY, pDummy, pDummy->GetTeamNumber(), i );
+	}
+
+	for ( int iTeam = FIRST_GAME_TEAM; iTeam < TF_TEAM_COUNT; ++iTeam )
+	{
+		CTFTeam *pTeam = TFTeamMgr()->GetTeam( iTeam );
+		if ( !pTeam )
+			continue;
+
+		// Players and objects are filed under the team list they came from
+		for ( int i = 0; i < pTeam->GetNumPlayers(); ++i )
+		{
+			AddTarget( TARGET_PLAYER, pTeam->GetPlayer( i ), iTeam, i );
+		}
+
+		for ( int i = 0; i < pTeam->GetNumObjects(); ++i )
+		{
+			AddTarget( TARGET_OBJECT, pTeam->GetObject( i ), iTeam, i );
+		}
+	}
+
+	CUtlVector< INextBot * > botVector;
+	TheNextBots().CollectAllBots( &botVector );
+	for ( int i = 0; i < botVector.Count(); ++i )
+	{
+		CBaseCombatCharacter *pBot = botVector[i]->GetEntity();
+		AddTarget( TARGET_BOT, pBot, pBot ? pBot->GetTeamNumber() : TEAM_INVALID, i );
+	}
+
+	// Sort each type by cell so a cell is one contiguous run
+	for ( int type = 0; type < TARGET_TYPE_COUNT; ++type )
+	{
+		CUtlVector< Target_t > &targets = m_Targets[type];
+		targets.Sort( &TargetCellCompare );
+
+		for ( int i = 0; i < targets.Count(); )
+		{
+			CellRange_t range;
+			range.m_iFirst = i;
+			range.m_nCount = 0;
+			unsigned int nCell = targets[i].m_nCell;
+			while ( i < targets.Count() && targets[i].m_nCell == nCell )
+			{
+				++range.m_nCount;
+				++i;
+			}
+			m_Cells[type].Insert( nCell, range );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Collect targets whose snapshot could be within flRadius of vecCenter
+//-----------------------------------------------------------------------------
+void CTFTargetGrid::CollectTargets( TargetType_t type, int iTeam, const Vector &vecCenter, float flRadius, CUtlVector< CBaseEntity * > *pTargets )
+{
+	VPROF_BUDGET( "CTFTargetGrid::CollectTargets", VPROF_BUDGETGROUP_GAME );
+
+	Update();
+
+	if ( m_Targets[type].Count() == 0 )
+		return;
+
+	float flSearch = flRadius + m_flMaxSlack[type];
+	int nMinX = (int)floorf( ( vecCenter.x - flSearch ) * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+	int nMaxX = (int)floorf( ( vecCenter.x + flSearch ) * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+	int nMinY = (int)floorf( ( vecCenter.y - flSearch ) * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+	int nMaxY = (int)floorf( ( vecCenter.y + flSearch ) * ( 1.0f / TARGET_GRID_CELL_SIZE ) );
+
+	CUtlVector< Target_t * > found;
+	for ( int y = nMinY; y <= nMaxY; ++y )
+	{
+		for ( int x = nMinX; x <= nMaxX; ++x )
+		{
+			unsigned int nCell = ( (unsigned int)x & 0xFFFF ) | ( ( (unsigned int)y & 0xFFFF ) << 16 );
+			UtlHashHandle_t h = m_Cells[type].Find( nCell );
+			if ( h == m_Cells[type].InvalidHandle() )
+				continue;
+
+			const CellRange_t &range = m_Cells[type][h];
+			for ( int i = range.m_iFirst; i < range.m_iFirst + range.m_nCount; ++i )
+			{
+				Target_t &target = m_Targets[type][i];
+				if ( iTeam != TEAM_ANY && target.m_iTeam != iTeam )
+					continue;
+
+				// Removed since the build, it has already left its team/bot list
+				if ( target.m_pEntity->IsMarkedForDeletion() )
+					continue;
+
+				float flReach = flRadius + target.m_flSlack;
+				if ( ( target.m_vecCenter - vecCenter ).LengthSqr() > flReach * flReach )
+					continue;
+
+				found.AddToTail( &target );
+			}
+		}
+	}
+
+	found.Sort( &TargetOrderCompare );
+
+	for ( int i = 0; i < found.Count(); ++i )
+	{
+		pTargets->AddToTail( found[i]->m_pEntity );
+	}
+}
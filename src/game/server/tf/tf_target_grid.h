@@ -0,0 +1,84 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Per-tick spatial index of entities that buildings can target
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#ifndef TF_TARGET_GRID_H
+#define TF_TARGET_GRID_H
+#ifdef _WIN32
+#pragma once
+#endif
+
+#include "igamesystem.h"
+#include "utlhashtable.h"
+
+//-----------------------------------------------------------------------------
+// Purpose: Snapshot of targetable entities, bucketed by type, team and a
+//			coarse XY grid. It is rebuilt on the first query of each tick, so
+//			every building that thinks in the same tick shares one build.
+//
+//			Queries are conservative: each target carries a slack radius that
+//			covers its eye/aim points and a tick's worth of movement, and the
+//			caller still does its own exact distance test. Results come back in
+//			the same order as the source lists (team player/object lists, the
+//			NextBot manager, the target dummy autolist), so a caller that used
+//			to walk those lists picks the same target.
+//-----------------------------------------------------------------------------
+class CTFTargetGrid : public CAutoGameSystem
+{
+public:
+	CTFTargetGrid();
+
+	enum TargetType_t
+	{
+		TARGET_DUMMY = 0,
+		TARGET_PLAYER,
+		TARGET_BOT,
+		TARGET_OBJECT,
+
+		TARGET_TYPE_COUNT
+	};
+
+	virtual char const *Name() { return "CTFTargetGrid"; }
+	virtual void LevelShutdownPostEntity();
+
+	// Adds targets of the given type whose snapshot is within flRadius of vecCenter.
+	// iTeam of TEAM_ANY collects every team; the output is in source list order.
+	void CollectTargets( TargetType_t type, int iTeam, const Vector &vecCenter, float flRadius, CUtlVector< CBaseEntity * > *pTargets );
+
+private:
+	struct Target_t
+	{
+		CBaseEntity *m_pEntity;
+		Vector m_vecCenter;
+		float m_flSlack;
+		int m_iTeam;
+		int m_nOrder;
+		unsigned int m_nCell;
+	};
+
+	struct CellRange_t
+	{
+		int m_iFirst;
+		int m_nCount;
+	};
+
+	typedef CUtlHashtable< unsigned int, CellRange_t > CellTable_t;
+
+	void Update( void );
+	void AddTarget( TargetType_t type, CBaseEntity *pEntity, int iTeam, int nOrder );
+	static unsigned int CellForPoint( float x, float y );
+	static int __cdecl TargetCellCompare( const Target_t *pLeft, const Target_t *pRight );
+	static int __cdecl TargetOrderCompare( Target_t * const *ppLeft, Target_t * const *ppRight );
+
+	int m_nBuildTick;
+	CUtlVector< Target_t > m_Targets[TARGET_TYPE_COUNT];	// sorted by cell after Update()
+	CellTable_t m_Cells[TARGET_TYPE_COUNT];
+	float m_flMaxSlack[TARGET_TYPE_COUNT];
+};
+
+CTFTargetGrid &TFTargetGrid();
+
+#endif // TF_TARGET_GRID_H
@@ -12,6 +12,12 @@
 #include "fmtstr.h"
 #include "KeyValues.h"
 #include "econ_item_system.h"
+#include "utlhashtable.h"
+
+#ifdef GAME_DLL
+#include "econ_entity.h"
+#include "serverbenchmark_base.h"
+#endif
 
 #if defined( TF_DLL ) || defined( TF_CLIENT_DLL )
 	#include "tf_gamerules.h"								// attribute cache flushing; can be generalized if/when Dota needs similar functionality
@@ -129,6 +135,7 @@ CAttributeManager::CAttributeManager()
 {
 	m_nCalls = 0;
 	m_nCurrentTick = 0;
+	m_nCacheGeneration = 1;
 }
 
 #ifdef CLIENT_DLL
@@ -256,7 +263,13 @@ void CAttributeManager::ClearCache( void )
 	if ( m_bPreventLoopback )
 		return;
 
-	m_CachedResults.Purge();
+	// Slots stamped with an older generation are ignored from here on. If the counter
+	// ever wraps, really throw them away so a stale stamp can't come back into play.
+	if ( ++m_nCacheGeneration == 0 )
+	{
+		m_CachedResults.Purge();
+		m_nCacheGeneration = 1;
+	}
 
 	m_bPreventLoopback = true;
 
@@ -325,12 +338,46 @@ bool CAttributeManager::IsBeingProvidedToBy( CBaseEntity *pEntity ) const
 // ATTRIBUTE HOOKS
 //=====================================================================================================
 
+//-----------------------------------------------------------------------------
+// Purpose: Map a hook name onto its attribute hook index
+//-----------------------------------------------------------------------------
+attrib_hook_index_t CAttributeManager::GetHookIndex( const char *pszAttribHook, bool bIsGlobalConstString )
+{
+	// Neither table is locked, attributes are only evaluated on the main thread
+	Assert( ThreadInMainThread() );
+
+	if ( !bIsGlobalConstString )
+		return GetAttribHookIndex( pszAttribHook );
+
+	// Literals never move, so their addresses can key the lookup for the life of the DLL
+	static CUtlHashtable< const void*, attrib_hook_index_t > s_StaticHookIndices;
+
+	UtlHashHandle_t h = s_StaticHookIndices.Find( pszAttribHook );
+	if ( h != s_StaticHookIndices.InvalidHandle() )
+		return s_StaticHookIndices[h];
+
+	attrib_hook_index_t iHook = GetAttribHookIndex( pszAttribHook );
+	s_StaticHookIndices.Insert( pszAttribHook, iHook );
+	return iHook;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: The pooled form of a hook name, for when we have to do the work
+//-----------------------------------------------------------------------------
+string_t CAttributeManager::PoolHookName( const char *pszAttribHook, bool bIsGlobalConstString )
+{
+	return bIsGlobalConstString ? AllocPooledString_StaticConstantStringPointer( pszAttribHook ) : AllocPooledString( pszAttribHook );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Wrapper that checks to see if we've already got the result in our cache
 //-----------------------------------------------------------------------------
-float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList )
+float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity *pInitiator, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, CUtlVector<CBaseEntity*> *pItemList )
 {
 	VPROF_BUDGET( "CAttributeManager::ApplyAttributeFloatWrapper", VPROF_BUDGETGROUP_ATTRIBUTES );
+#ifdef GAME_DLL
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_ATTRIBUTE_HOOKS );
+#endif
 
 #ifdef DEBUG
 	AssertMsg1( m_nCalls != 5000, "%d calls for attributes in a single tick.  This is slow and bad.", m_nCalls );
@@ -353,35 +400,26 @@ float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity
 	}
 
 	// We can't cache off item references so if we asked for them we need to execute the whole slow path.
-	if ( !pItemList )
+	// A cached result for a different flIn value (i.e. crit chance) just gets overwritten below.
+	if ( !pItemList && iHook < m_CachedResults.Count() )
 	{
-		int iCount = m_CachedResults.Count();
-		for ( int i = iCount-1; i >= 0; i-- )
-		{
-			if ( m_CachedResults[i].iAttribHook == iszAttribHook )
-			{
-				if ( m_CachedResults[i].in.fl == flValue )
-					return m_CachedResults[i].out.fl;
-
-				// We've got a cached result for a different flIn value. Remove the cached result to
-				// prevent stacking up entries for different requests (i.e. crit chance)
-				m_CachedResults.Remove(i);
-				break;
-			}
-		}
+		const cached_attribute_t &cached = m_CachedResults[iHook];
+		if ( cached.nGeneration == m_nCacheGeneration && cached.in.fl == flValue )
+			return cached.out.fl;
 	}
 
 	// Wasn't in cache, or we need item references. Do the work.
-	float flResult = ApplyAttributeFloat( flValue, pInitiator, iszAttribHook, pItemList );
+	float flResult = ApplyAttributeFloat( flValue, pInitiator, PoolHookName( pszAttribHook, bIsGlobalConstString ), pItemList );
 
-	// Add it to our cache if we didn't ask for item references. We could add the result value here
-	// even if we did but we'd need to walk the cache to search for an old entry to overwrite first.
+	// Add it to our cache if we didn't ask for item references.
 	if ( !pItemList )
 	{
-		int iIndex = m_CachedResults.AddToTail();
-		m_CachedResults[iIndex].in.fl = flValue;
-		m_CachedResults[iIndex].out.fl = flResult;
-		m_CachedResults[iIndex].iAttribHook = iszAttribHook;
+		m_CachedResults.EnsureCount( iHook + 1 );
+
+		cached_attribute_t &cached = m_CachedResults[iHook];
+		cached.nGeneration = m_nCacheGeneration;
+		cached.in.fl = flValue;
+		cached.out.fl = flResult;
 	}
 
 	return flResult;
@@ -390,8 +428,12 @@ float CAttributeManager::ApplyAttributeFloatWrapper( float flValue, CBaseEntity
 //-----------------------------------------------------------------------------
 // Purpose: Wrapper that checks to see if we've already got the result in our cache
 //-----------------------------------------------------------------------------
-string_t CAttributeManager::ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList /*= NULL*/ )
+string_t CAttributeManager::ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, CUtlVector<CBaseEntity*> *pItemList /*= NULL*/ )
 {
+#ifdef GAME_DLL
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_ATTRIBUTE_HOOKS );
+#endif
+
 	// Have we requested a global attribute cache flush?
 	const int iGlobalCacheVersion = GetGlobalCacheVersion();
 	if ( m_iCacheVersion != iGlobalCacheVersion )
@@ -401,37 +443,25 @@ string_t CAttributeManager::ApplyAttributeStringWrapper( string_t iszValue, CBas
 	}
 
 	// We can't cache off item references so if we asked for them we need to execute the whole slow path.
-	if ( !pItemList )
+	if ( !pItemList && iHook < m_CachedResults.Count() )
 	{
-		int iCount = m_CachedResults.Count();
-		for ( int i = iCount-1; i >= 0; i-- )
-		{
-			if ( m_CachedResults[i].iAttribHook == iszAttribHook )
-			{
-				if ( m_CachedResults[i].in.isz == iszValue )
-				{
-					return m_CachedResults[i].out.isz;
-				}
-
-				// We've got a cached result for a different flIn value. Remove the cached result to
-				// prevent stacking up entries for different requests (i.e. crit chance)
-				m_CachedResults.Remove(i);
-				break;
-			}
-		}
+		const cached_attribute_t &cached = m_CachedResults[iHook];
+		if ( cached.nGeneration == m_nCacheGeneration && cached.in.isz == iszValue )
+			return cached.out.isz;
 	}
 
 	// Wasn't in cache, or we need item references. Do the work.
-	string_t iszOut = ApplyAttributeString( iszValue, pInitiator, iszAttribHook, pItemList );
+	string_t iszOut = ApplyAttributeString( iszValue, pInitiator, PoolHookName( pszAttribHook, bIsGlobalConstString ), pItemList );
 
-	// Add it to our cache if we didn't ask for item references. We could add the result value here
-	// even if we did but we'd need to walk the cache to search for an old entry to overwrite first.
+	// Add it to our cache if we didn't ask for item references.
 	if ( !pItemList )
 	{
-		int iIndex = m_CachedResults.AddToTail();
-		m_CachedResults[iIndex].in.isz = iszValue;
-		m_CachedResults[iIndex].out.isz = iszOut;
-		m_CachedResults[iIndex].iAttribHook = iszAttribHook;
+		m_CachedResults.EnsureCount( iHook + 1 );
+
+		cached_attribute_t &cached = m_CachedResults[iHook];
+		cached.nGeneration = m_nCacheGeneration;
+		cached.in.isz = iszValue;
+		cached.out.isz = iszOut;
 	}
 
 	return iszOut;
@@ -879,3 +909,115 @@ string_t CAttributeContainerPlayer::ApplyAttributeString( string_t iszValue, CBa
 
 	return BaseClass::ApplyAttributeString( it.GetResultValue(), pInitiator, iszAttribHook, pItemList );
 }
+
+#ifdef GAME_DLL
+//-----------------------------------------------------------------------------
+// Purpose: Time attribute hook evaluation on the calling player with a
+//			synthetic loadout of 6 items carrying 20 attributes each.
+//-----------------------------------------------------------------------------
+CON_COMMAND_F( attrib_hook_benchmark, "Times attribute hooks against a 6 item, 20 attribute loadout. Format: attrib_hook_benchmark [passes]", FCVAR_CHEAT )
+{
+	CBasePlayer *pPlayer = UTIL_GetCommandClient();
+	if ( !pPlayer || !GetAttribInterface( pPlayer ) )
+		return;
+
+	// The same literals a CALL_ATTRIB_HOOK site would pass
+	static const char *s_pszBenchmarkHooks[] =
+	{
+		"mult_dmg",
+		"fast_reload",
+		"mult_projectile_range",
+		"mult_crit_chance",
+		"mult_airblast_cost",
+		"mult_postfiredelay",
+		"mult_reload_time",
+		"mult_reload_time_hidden",
+		"projectile_spread_angle",
+		"powerup_duration",
+		"airblast_pushback_scale",
+		"airblast_vertical_pushback_scale",
+		"minicrit_boost_when_charged",
+		"kill_combo_fire_rate_boost",
+		"firing_forward_pull",
+		"sniper_full_charge_damage_bonus",
+		"stickybomb_charge_rate",
+		"speed_boost_on_hit_enemy",
+		"throwable_recharge_time",
+		"mult_player_movespeed",
+	};
+	const int nHooks = ARRAYSIZE( s_pszBenchmarkHooks );
+	const int nItems = 6;
+
+	// One hookable attribute definition per hook, where the schema has one
+	CUtlVector< const CEconItemAttributeDefinition * > vecAttrDefs;
+	const CUtlMap<int, CEconItemAttributeDefinition, int> &mapAttrDefs = GetItemSchema()->GetAttributeDefinitionMap();
+	for ( int i = 0; i < nHooks; ++i )
+	{
+		FOR_EACH_MAP_FAST( mapAttrDefs, j )
+		{
+			const CEconItemAttributeDefinition &attrDef = mapAttrDefs[j];
+			if ( attrDef.GetAttributeClass() && !Q_stricmp( attrDef.GetAttributeClass(), s_pszBenchmarkHooks[i] ) &&
+				 attrDef.GetAttributeType() && attrDef.GetAttributeType()->BSupportsGameplayModificationAndNetworking() )
+			{
+				vecAttrDefs.AddToTail( &attrDef );
+				break;
+			}
+		}
+	}
+
+	CUtlVector< CEconEntity * > vecItems;
+	for ( int i = 0; i < nItems; ++i )
+	{
+		CEconEntity *pItem = dynamic_cast< CEconEntity * >( CreateEntityByName( "wearable_item" ) );
+		if ( !pItem )
+			continue;
+
+		pItem->InitializeAttributes();
+		FOR_EACH_VEC( vecAttrDefs, j )
+		{
+			pItem->GetAttributeList()->SetRuntimeAttributeValue( vecAttrDefs[j], 1.0f );
+		}
+		pItem->GetAttributeManager()->OnAttributeValuesChanged();
+		pItem->GetAttributeManager()->ProvideTo( pPlayer );
+		vecItems.AddToTail( pItem );
+	}
+
+	const int nPasses = MAX( 1, ( args.ArgC() > 1 ) ? atoi( args[1] ) : 10000 );
+	CAttributeManager *pManager = GetAttribInterface( pPlayer )->GetAttributeManager();
+	float flSum = 0.0f;
+
+	// Cold: every pass starts from an invalidated cache, as after an item change
+	double flStart = Plat_FloatTime();
+	for ( int iPass = 0; iPass < nPasses; ++iPass )
+	{
+		pManager->OnAttributeValuesChanged();
+		for ( int i = 0; i < nHooks; ++i )
+		{
+			flSum += CAttributeManager::AttribHookValue<float>( 1.0f, s_pszBenchmarkHooks[i], pPlayer, NULL, true );
+		}
+	}
+	double flCold = Plat_FloatTime() - flStart;
+
+	// Warm: repeated evaluation, as within a tick
+	flStart = Plat_FloatTime();
+	for ( int iPass = 0; iPass < nPasses; ++iPass )
+	{
+		for ( int i = 0; i < nHooks; ++i )
+		{
+			flSum += CAttributeManager::AttribHookValue<float>( 1.0f, s_pszBenchmarkHooks[i], pPlayer, NULL, true );
+		}
+	}
+	double flWarm = Plat_FloatTime() - flStart;
+
+	FOR_EACH_VEC( vecItems, i )
+	{
+		vecItems[i]->GetAttributeManager()->StopProvidingTo( pPlayer );
+		UTIL_Remove( vecItems[i] );
+	}
+
+	const double flCalls = (double)nPasses * nHooks;
+	Msg( "attrib_hook_benchmark: %d items x %d attributes, %d hooks, %d passes (checksum %f)\n", vecItems.Count(), vecAttrDefs.Count(), nHooks, nPasses, flSum );
+	Msg( "  cold: %.1f ns/hook\n", flCold * 1e9 / flCalls );
+	Msg( "  warm: %.1f ns/hook\n", flWarm * 1e9 / flCalls );
+}
+#endif // GAME_DLL
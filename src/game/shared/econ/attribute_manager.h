@@ -127,17 +127,17 @@ public:
 	}
 
 private:
-	template <class T> static void TypedAttribHookValueInternal( T& out, T TValue, string_t iszAttribHook, const CBaseEntity *pEntity, IHasAttributes *pAttribInterface, CUtlVector<CBaseEntity*> *pItemList )
+	template <class T> static void TypedAttribHookValueInternal( T& out, T TValue, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, const CBaseEntity *pEntity, IHasAttributes *pAttribInterface, CUtlVector<CBaseEntity*> *pItemList )
 	{
-		float flValue = pAttribInterface->GetAttributeManager()->ApplyAttributeFloatWrapper( static_cast<float>( TValue ), const_cast<CBaseEntity *>( pEntity ), iszAttribHook, pItemList );
+		float flValue = pAttribInterface->GetAttributeManager()->ApplyAttributeFloatWrapper( static_cast<float>( TValue ), const_cast<CBaseEntity *>( pEntity ), iHook, pszAttribHook, bIsGlobalConstString, pItemList );
 
 		out = AttributeConvertFromFloat<T>( flValue );
 	}
 
-	static void TypedAttribHookValueInternal( CAttribute_String& out, const CAttribute_String& TValue, string_t iszAttribHook, const CBaseEntity *pEntity, IHasAttributes *pAttribInterface, CUtlVector<CBaseEntity*> *pItemList )
+	static void TypedAttribHookValueInternal( CAttribute_String& out, const CAttribute_String& TValue, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, const CBaseEntity *pEntity, IHasAttributes *pAttribInterface, CUtlVector<CBaseEntity*> *pItemList )
 	{
 		string_t iszIn = AllocPooledString( TValue.value().c_str() );
-		string_t iszOut = pAttribInterface->GetAttributeManager()->ApplyAttributeStringWrapper( iszIn, const_cast<CBaseEntity *>( pEntity ), iszAttribHook, pItemList );
+		string_t iszOut = pAttribInterface->GetAttributeManager()->ApplyAttributeStringWrapper( iszIn, const_cast<CBaseEntity *>( pEntity ), iHook, pszAttribHook, bIsGlobalConstString, pItemList );
 		const char* pszOut = STRING( iszOut );
 		// STRING() returns different value for server and client
 		// server will return "" for NULL_STRING
@@ -161,9 +161,14 @@ private:
 		Assert( GetAttribInterface( (CBaseEntity*) pEntity ) == pAttribInterface );
 		Assert( pAttribInterface->GetAttributeManager() );
 		
-		string_t iszAttribHook = bIsGlobalConstString ? AllocPooledString_StaticConstantStringPointer( pszAttribHook ) : AllocPooledString( pszAttribHook );
-		return TypedAttribHookValueInternal( out, TValue, iszAttribHook, pEntity, pAttribInterface, pItemList );
+		attrib_hook_index_t iHook = GetHookIndex( pszAttribHook, bIsGlobalConstString );
+		return TypedAttribHookValueInternal( out, TValue, iHook, pszAttribHook, bIsGlobalConstString, pEntity, pAttribInterface, pItemList );
 	}
+
+	// Hook names from the CALL_ATTRIB_HOOK macros are string literals, so those are looked up by address
+	static attrib_hook_index_t GetHookIndex( const char *pszAttribHook, bool bIsGlobalConstString );
+	static string_t PoolHookName( const char *pszAttribHook, bool bIsGlobalConstString );
+
 	int m_nCurrentTick;
 	int m_nCalls;
 
@@ -202,11 +207,13 @@ private:
 	void	ClearCache();
 	int		GetGlobalCacheVersion() const;
 
-	virtual float	ApplyAttributeFloatWrapper( float flValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList = NULL );
-	virtual string_t ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, string_t iszAttribHook, CUtlVector<CBaseEntity*> *pItemList = NULL );
+	virtual float	ApplyAttributeFloatWrapper( float flValue, CBaseEntity *pInitiator, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, CUtlVector<CBaseEntity*> *pItemList = NULL );
+	virtual string_t ApplyAttributeStringWrapper( string_t iszValue, CBaseEntity *pInitiator, attrib_hook_index_t iHook, const char *pszAttribHook, bool bIsGlobalConstString, CUtlVector<CBaseEntity*> *pItemList = NULL );
 
 	// Cached attribute results
-	// We cache off requests for data, and wipe the cache whenever our providers change.
+	// We cache off requests for data, one slot per attribute hook index. Slots are only valid
+	// while their generation matches m_nCacheGeneration, so wiping the cache whenever our
+	// providers change is a single increment.
 	union cached_attribute_types
 	{
 		float fl;
@@ -215,11 +222,14 @@ private:
 
 	struct cached_attribute_t
 	{
-		string_t	iAttribHook;
+		cached_attribute_t() : nGeneration( 0 ) {}
+
+		unsigned int				nGeneration;
 		cached_attribute_types		in;
 		cached_attribute_types		out;
 	};
-	CUtlVector<cached_attribute_t>	m_CachedResults;
+	CUtlVector<cached_attribute_t>	m_CachedResults;					// indexed by attrib_hook_index_t
+	unsigned int					m_nCacheGeneration;				// never 0, which marks a slot as unused
 
 #ifdef CLIENT_DLL
 public:
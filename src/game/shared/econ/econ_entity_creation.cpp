@@ -56,6 +56,20 @@ CBaseEntity *CItemGeneration::GenerateItemFromDefIndex( int iDefIndex, const Vec
 	return SpawnItem( iDefIndex, vecOrigin, vecAngles, 1, AE_UNIQUE, NULL );
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Generate an item of the specified definition index, with the quality
+//			and level the criteria asks for
+//-----------------------------------------------------------------------------
+CBaseEntity *CItemGeneration::GenerateItemFromDefIndex( int iDefIndex, CItemSelectionCriteria *pCriteria, const Vector &vecOrigin, const QAngle &vecAngles, const char* pszOverrideClassName )
+{
+	entityquality_t iQuality;
+	int iChosenItem = ItemSystem()->GenerateItem( iDefIndex, pCriteria, &iQuality );
+	if ( iChosenItem == INVALID_ITEM_DEF_INDEX )
+		return NULL;
+
+	return SpawnItem( iChosenItem, vecOrigin, vecAngles, pCriteria->GetItemLevel(), iQuality, pszOverrideClassName );
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Generate an item from the specified item data
 //-----------------------------------------------------------------------------
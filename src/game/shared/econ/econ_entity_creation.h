@@ -32,6 +32,9 @@ public:
 	// Generate a random item matching the specified definition index
 	CBaseEntity *GenerateItemFromDefIndex( int iDefIndex, const Vector &vecOrigin, const QAngle &vecAngles );
 
+	// Generate an item of the specified definition, taking quality and level from the criteria
+	CBaseEntity *GenerateItemFromDefIndex( int iDefIndex, CItemSelectionCriteria *pCriteria, const Vector &vecOrigin, const QAngle &vecAngles, const char* pszOverrideClassName = NULL );
+
 	// Generate an item from the specified item data
 	CBaseEntity *GenerateItemFromScriptData( const CEconItemView *pData, const Vector &vecOrigin, const QAngle &vecAngles, const char *pszOverrideClassName );
 
@@ -2067,6 +2067,28 @@ public:
 private:
 };
 
+// Case-insensitive to match the game string pool the hook names used to be compared through
+static CUtlDict< attrib_hook_index_t, int > s_AttribHookIndices;
+
+//-----------------------------------------------------------------------------
+// Purpose: Intern an attribute class name, returning its hook index
+//-----------------------------------------------------------------------------
+attrib_hook_index_t GetAttribHookIndex( const char *pszAttributeClass )
+{
+	Assert( pszAttributeClass && pszAttributeClass[0] );
+
+	// Not locked, hooks are only ever looked up from the main thread
+	Assert( ThreadInMainThread() );
+
+	int iIndex = s_AttribHookIndices.Find( pszAttributeClass );
+	if ( iIndex != s_AttribHookIndices.InvalidIndex() )
+		return s_AttribHookIndices[iIndex];
+
+	attrib_hook_index_t iHook = s_AttribHookIndices.Count();
+	s_AttribHookIndices.Insert( pszAttributeClass, iHook );
+	return iHook;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Constructor
 //-----------------------------------------------------------------------------
@@ -2190,6 +2212,11 @@ bool CEconItemAttributeDefinition::BInitFromKV( KeyValues *pKVAttribute, CUtlVec
 	m_pszDescriptionString = m_pKVAttribute->GetString( "description_string", NULL );
 	m_pszArmoryDesc = m_pKVAttribute->GetString( "armory_desc", NULL );
 	m_pszAttributeClass = m_pKVAttribute->GetString( "attribute_class", NULL );
+	if ( m_pszAttributeClass && m_pszAttributeClass[0] )
+	{
+		// Intern it now so the schema's hooks get the low, densely packed indices
+		GetAttribHookIndex( m_pszAttributeClass );
+	}
 	m_bInstanceData = pKVAttribute->GetBool( "instance_data", false );
 
 	const char *pszTag = m_pKVAttribute->GetString( "apply_tag_to_item_definition", NULL );
@@ -3806,6 +3833,7 @@ CEconItemSchema::CEconItemSchema( )
 ,	m_mapPaintKitTools( DefLessFunc(uint32) )
 ,	m_mapBaseItems( DefLessFunc(int) )
 ,	m_unVersion( 0 )
+,	m_unCachedVersion( 0 )
 #if defined(CLIENT_DLL) || defined(GAME_DLL)
 ,	m_pDefaultItemDefinition( NULL )
 #endif
@@ -4293,6 +4321,9 @@ void CEconItemSchema::Reset( void )
 	m_vecAttributeTypes.Purge();
 	m_mapItems.PurgeAndDeleteElements();
 	m_mapItems.Purge();
+	InvalidateItemIndexes();
+	m_dictItemNameIndexes.Purge();
+	m_vecItemNameIndexes.Purge();
 	m_mapRarities.Purge();
 	m_mapQualities.Purge();
 	m_mapItemsSorted.Purge();
@@ -4352,11 +4383,240 @@ CEconItemSchema &CEconItemSchema::operator=( CEconItemSchema &rhs )
 	return *this;
 }
 
+unsigned char g_sha1ItemSchemaText[ k_cubHash ];
+
+//-----------------------------------------------------------------------------
+// Schema parse cache
+//
+// After a successful text load we save the raw definition next to items_game.txt as
+// binary KeyValues, with item prefabs already merged into the item definitions. Loading
+// it skips the text tokenizer, the version CRC and the prefab merges. It does not skip
+// anything else: BInitSchema still walks the full KeyValues tree to build every
+// definition, and m_pKVRawDefinition stays resident because the definitions point into
+// it. The cache is keyed on the SHA of the text it was built from and gets rebuilt
+// whenever the text changes. Run with -noschemacache to always parse the text.
+//-----------------------------------------------------------------------------
+#define ITEM_SCHEMA_CACHE_ID		MAKEID( 'I', 'S', 'C', 'H' )
+#define ITEM_SCHEMA_CACHE_VERSION	1
+
+struct ItemSchemaCacheHeader_t
+{
+	uint32		m_nId;
+	uint32		m_nVersion;
+	SHADigest_t	m_sourceSHA;			// SHA of the items_game.txt this was built from
+	uint32		m_unSchemaVersion;		// CalculateKeyValuesVersion() of the text
+	uint32		m_nDataSize;
+	CRC32_t		m_nDataCRC;
+};
+
+static void GetItemSchemaCacheFileName( const char *fileName, char *pszOut, int nOutSize )
+{
+	V_StripExtension( fileName, pszOut, nOutSize );
+	V_strncat( pszOut, ".cache", nOutSize );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:	Loads the raw definition from the cache if it was built from the text
+//			with the given SHA
+//-----------------------------------------------------------------------------
+bool CEconItemSchema::BReadSchemaCache( const char *pszCacheFile, const CSHA &sourceSHA )
+{
+	CUtlBuffer bufCache;
+	if ( !g_pFullFileSystem->ReadFile( pszCacheFile, "MOD", bufCache ) )
+		return false;
+
+	if ( bufCache.TellPut() < (int)sizeof( ItemSchemaCacheHeader_t ) )
+		return false;
+
+	const ItemSchemaCacheHeader_t *pHeader = (const ItemSchemaCacheHeader_t *)bufCache.Base();
+	if ( pHeader->m_nId != ITEM_SCHEMA_CACHE_ID || pHeader->m_nVersion != ITEM_SCHEMA_CACHE_VERSION )
+		return false;
+
+	// Stale, the text has changed since this was built
+	if ( V_memcmp( pHeader->m_sourceSHA, sourceSHA.m_shaDigest, k_cubHash ) != 0 )
+		return false;
+
+	const byte *pData = (const byte *)bufCache.Base() + sizeof( ItemSchemaCacheHeader_t );
+	if ( pHeader->m_nDataSize != (uint32)( bufCache.TellPut() - sizeof( ItemSchemaCacheHeader_t ) ) ||
+		 CRC32_ProcessSingleBuffer( pData, pHeader->m_nDataSize ) != pHeader->m_nDataCRC )
+	{
+		Warning( "Item schema cache '%s' is corrupt, ignoring it.\n", pszCacheFile );
+		return false;
+	}
+
+	// Parse straight out of the file buffer
+	CUtlBuffer bufKV( pData, pHeader->m_nDataSize, CUtlBuffer::READ_ONLY );
+
+	Reset();
+	m_pKVRawDefinition = new KeyValues( "CEconItemSchema" );
+	if ( !m_pKVRawDefinition->ReadAsBinary( bufKV ) )
+	{
+		Reset();
+		return false;
+	}
+
+	m_unCachedVersion = pHeader->m_unSchemaVersion;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:	Saves the cache for the schema we just initialized from text.
+//			bufRawBinary is the raw definition as parsed, before BInitSchema.
+//-----------------------------------------------------------------------------
+void CEconItemSchema::WriteSchemaCache( const char *pszCacheFile, CUtlBuffer &bufRawBinary )
+{
+	// The prefabs are looked up through the global schema
+	if ( GetItemSchema() != this )
+		return;
+
+	KeyValuesAD pKVCompiled( "CEconItemSchema" );
+	if ( !pKVCompiled->ReadAsBinary( bufRawBinary ) )
+		return;
+
+	// Do the prefab merge from CEconItemDefinition::BInitFromKV now. Without a "prefab" key
+	// the merge at load time is a straight copy, and gives the same result.
+	KeyValues *pKVItems = pKVCompiled->FindKey( "items" );
+	if ( pKVItems )
+	{
+		FOR_EACH_TRUE_SUBKEY( pKVItems, pKVItem )
+		{
+			if ( !pKVItem->FindKey( "prefab" ) )
+				continue;
+
+			KeyValuesAD pKVMerged( pKVItem->GetName() );
+			MergeDefinitionPrefab( pKVMerged, pKVItem );
+
+			KeyValues *pKVPrefab = pKVMerged->FindKey( "prefab" );
+			if ( pKVPrefab )
+			{
+				pKVMerged->RemoveSubKey( pKVPrefab );
+				pKVPrefab->deleteThis();
+			}
+
+			pKVItem->Clear();
+			RecursiveInheritKeyValues( pKVItem, pKVMerged );
+		}
+	}
+
+	CUtlBuffer bufData;
+	if ( !pKVCompiled->WriteAsBinary( bufData ) )
+		return;
+
+	ItemSchemaCacheHeader_t header;
+	V_memset( &header, 0, sizeof( header ) );
+	header.m_nId = ITEM_SCHEMA_CACHE_ID;
+	header.m_nVersion = ITEM_SCHEMA_CACHE_VERSION;
+	V_memcpy( header.m_sourceSHA, m_schemaSHA.m_shaDigest, k_cubHash );
+	header.m_unSchemaVersion = m_unVersion;
+	header.m_nDataSize = bufData.TellPut();
+	header.m_nDataCRC = CRC32_ProcessSingleBuffer( bufData.Base(), bufData.TellPut() );
+
+	CUtlBuffer bufCache;
+	bufCache.EnsureCapacity( sizeof( header ) + bufData.TellPut() );
+	bufCache.Put( &header, sizeof( header ) );
+	bufCache.Put( bufData.Base(), bufData.TellPut() );
+
+	if ( !g_pFullFileSystem->WriteFile( pszCacheFile, "MOD", bufCache ) )
+	{
+		DevMsg( "Couldn't write item schema cache '%s'.\n", pszCacheFile );
+	}
+}
+
+#ifdef GAME_DLL
+//-----------------------------------------------------------------------------
+// Times whole BInit calls, text against cache. This reinitializes the live schema,
+// so it only runs before the first map has loaded, like the schema updates from the GC.
+//-----------------------------------------------------------------------------
+CON_COMMAND( item_schema_load_benchmark, "Compare initializing the item schema from items_game.txt and from its parse cache. Only runs before a map is loaded. Usage: item_schema_load_benchmark [iterations]" )
+{
+	if ( !UTIL_IsCommandIssuedByServerAdmin() )
+		return;
+
+	if ( gpGlobals->mapname != NULL_STRING )
+	{
+		Warning( "item_schema_load_benchmark reinitializes the item schema and can only run before a map is loaded.\n" );
+		return;
+	}
+
+	const char *pszFile = "scripts/items/items_game.txt";
+	int nIterations = ( args.ArgC() > 1 ) ? MAX( V_atoi( args[1] ), 1 ) : 5;
+
+	CEconItemSchema *pSchema = GetItemSchema();
+	CUtlVector<CUtlString> vecErrors;
+
+	// Make sure the cache is current, and warm the file system
+	bool bFromCache = false;
+	if ( !pSchema->BInitFromFile( pszFile, "GAME", &vecErrors, true, &bFromCache ) )
+	{
+		FOR_EACH_VEC( vecErrors, i )
+		{
+			Warning( "%s\n", vecErrors[i].Get() );
+		}
+		return;
+	}
+
+	double flTextTotal = 0, flTextBest = FLT_MAX;
+	double flCacheTotal = 0, flCacheBest = FLT_MAX;
+
+	for ( int i = 0; i < nIterations; i++ )
+	{
+		double flStart = Plat_FloatTime();
+		pSchema->BInitFromFile( pszFile, "GAME", NULL, false );
+		double flText = Plat_FloatTime() - flStart;
+
+		flStart = Plat_FloatTime();
+		pSchema->BInitFromFile( pszFile, "GAME", NULL, true, &bFromCache );
+		double flCache = Plat_FloatTime() - flStart;
+
+		if ( !bFromCache )
+		{
+			Warning( "The item schema cache couldn't be read or written, nothing to compare.\n" );
+			break;
+		}
+
+		flTextTotal += flText;
+		flTextBest = MIN( flTextBest, flText );
+		flCacheTotal += flCache;
+		flCacheBest = MIN( flCacheBest, flCache );
+	}
+
+	// Anyone holding on to the old definitions needs to hear about the new ones
+	ItemSystem()->PostInit();
+
+	if ( !bFromCache )
+		return;
+
+	Msg( "Item schema BInit, %d iterations:\n", nIterations );
+	Msg( "  text:  mean %.1f ms, best %.1f ms\n", flTextTotal * 1000.0 / nIterations, flTextBest * 1000.0 );
+	Msg( "  cache: mean %.1f ms, best %.1f ms\n", flCacheTotal * 1000.0 / nIterations, flCacheBest * 1000.0 );
+	if ( flCacheTotal > 0 )
+	{
+		Msg( "  speedup: %.2fx\n", flTextTotal / flCacheTotal );
+	}
+}
+#endif // GAME_DLL
+
 //-----------------------------------------------------------------------------
 // Initializes the schema, given KV filename
 //-----------------------------------------------------------------------------
 bool CEconItemSchema::BInit( const char *fileName, const char *pathID, CUtlVector<CUtlString> *pVecErrors /* = NULL */)
 {
+	return BInitFromFile( fileName, pathID, pVecErrors, !CommandLine()->FindParm( "-noschemacache" ) );
+}
+
+//-----------------------------------------------------------------------------
+// Initializes the schema from a KV file, using and refreshing its parse cache
+// if bUseCache is set
+//-----------------------------------------------------------------------------
+bool CEconItemSchema::BInitFromFile( const char *fileName, const char *pathID, CUtlVector<CUtlString> *pVecErrors, bool bUseCache, bool *pbFromCache /* = NULL */ )
+{
+	if ( pbFromCache )
+	{
+		*pbFromCache = false;
+	}
+
+	double flStartTime = Plat_FloatTime();
+
 	Reset();
 
 	// Read the raw data
@@ -4379,11 +4639,39 @@ bool CEconItemSchema::BInit( const char *fileName, const char *pathID, CUtlVecto
 	sha1.Final();
 	sha1.GetHash( m_schemaSHA.m_shaDigest );
 
+	char szCacheFile[MAX_PATH];
+	GetItemSchemaCacheFileName( fileName, szCacheFile, sizeof( szCacheFile ) );
+
+	if ( bUseCache && BReadSchemaCache( szCacheFile, m_schemaSHA ) )
+	{
+		// BInitTextBuffer would have saved off the same hash
+		V_memcpy( g_sha1ItemSchemaText, m_schemaSHA.m_shaDigest, k_cubHash );
+
+		bool bSuccess = BInitSchema( m_pKVRawDefinition, pVecErrors ) && BPostSchemaInit( pVecErrors );
+		if ( pbFromCache )
+		{
+			*pbFromCache = bSuccess;
+		}
+		DevMsg( "Item schema loaded from '%s' in %.1f ms\n", szCacheFile, ( Plat_FloatTime() - flStartTime ) * 1000.0 );
+		return bSuccess;
+	}
+
 	// Wrap it with a text buffer reader
 	CUtlBuffer bufText( bufRawData.Base(), bufRawData.TellPut(), CUtlBuffer::READ_ONLY | CUtlBuffer::TEXT_BUFFER );
 
 	// Use the standard init path
-	return BInitTextBuffer( bufText, pVecErrors );
+	CUtlBuffer bufRawBinary;
+	if ( !BInitTextBuffer( bufText, pVecErrors, bUseCache ? &bufRawBinary : NULL ) )
+		return false;
+
+	DevMsg( "Item schema loaded from '%s' in %.1f ms\n", fileName, ( Plat_FloatTime() - flStartTime ) * 1000.0 );
+
+	if ( bUseCache )
+	{
+		WriteSchemaCache( szCacheFile, bufRawBinary );
+	}
+
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -4405,12 +4693,10 @@ bool CEconItemSchema::BInitBinaryBuffer( CUtlBuffer &buffer, CUtlVector<CUtlStri
 	return false;
 }
 
-unsigned char g_sha1ItemSchemaText[ k_cubHash ];
-
 //-----------------------------------------------------------------------------
 // Initializes the schema, given KV in text form
 //-----------------------------------------------------------------------------
-bool CEconItemSchema::BInitTextBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString> *pVecErrors /* = NULL */ )
+bool CEconItemSchema::BInitTextBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString> *pVecErrors /* = NULL */, CUtlBuffer *pBufRawBinary /* = NULL */ )
 {
 	// Save off the hash into a global variable, so VAC can check it
 	// later
@@ -4420,6 +4706,12 @@ bool CEconItemSchema::BInitTextBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString
 	m_pKVRawDefinition = new KeyValues( "CEconItemSchema" );
 	if ( m_pKVRawDefinition->LoadFromBuffer( NULL, buffer ) )
 	{
+		// Snapshot for the schema cache before init has a chance to touch it
+		if ( pBufRawBinary )
+		{
+			m_pKVRawDefinition->WriteAsBinary( *pBufRawBinary );
+		}
+
 		return BInitSchema( m_pKVRawDefinition, pVecErrors )
 			&& BPostSchemaInit( pVecErrors );
 	}
@@ -4629,7 +4921,9 @@ bool CEconItemSchema::BInitSchema( KeyValues *pKVRawDefinition, CUtlVector<CUtlS
 	m_unMinLevel = pKVRawDefinition->GetInt( "item_level_min", 0 );
 	m_unMaxLevel = pKVRawDefinition->GetInt( "item_level_max", 0 );
 
-	m_unVersion = CalculateKeyValuesVersion( pKVRawDefinition );
+	// The schema cache already knows the version of the text it came from
+	m_unVersion = m_unCachedVersion ? m_unCachedVersion : CalculateKeyValuesVersion( pKVRawDefinition );
+	m_unCachedVersion = 0;
 
 
 
@@ -5269,6 +5563,8 @@ bool CEconItemSchema::BInitAttributes( KeyValues *pKVAttributes, CUtlVector<CUtl
 bool CEconItemSchema::BInitItems( KeyValues *pKVItems, CUtlVector<CUtlString> *pVecErrors )
 {
 	m_mapItems.PurgeAndDeleteElements();
+	ClearItemIndexes();
+	m_bItemIndexesValid = true;
 	m_mapItemsSorted.Purge();
 	m_mapToolsItems.Purge();
 	m_mapPaintKitTools.Purge();
@@ -5318,7 +5614,13 @@ bool CEconItemSchema::BInitItems( KeyValues *pKVItems, CUtlVector<CUtlString> *p
 				CEconItemDefinition *pItemDef = CreateEconItemDefinition();
 				nMapIndex = m_mapItems.Insert( nItemIndex, pItemDef );
 				m_mapItemsSorted.Insert( nItemIndex, pItemDef );
+
+				// Bundles and set remaps look other items up by name from inside BInitFromKV,
+				// so the indexes have to cover everything loaded so far. The map was emptied
+				// above and items only ever go on the end, so adding each one once it has
+				// its name keeps them in the same order a full rebuild would.
 				SCHEMA_INIT_SUBSTEP( m_mapItems[nMapIndex]->BInitFromKV( pKVItem, pVecErrors ) );
+				AddItemToIndexes( nItemIndex, pItemDef );
 
 				// Cache off Tools references
 				if ( pItemDef->IsTool() )
@@ -6408,6 +6710,8 @@ econ_tag_handle_t CEconItemSchema::GetHandleForTag( const char *pszTagName )
 //-----------------------------------------------------------------------------
 void CEconItemSchema::ItemTesting_CreateTestDefinition( int iCloneFromItemDef, int iNewDef, KeyValues *pNewKV )
 {
+	InvalidateItemIndexes();
+
 	int nMapIndex = m_mapItems.Find( iNewDef );
 	if ( !m_mapItems.IsValidIndex( nMapIndex ) )
 	{
@@ -6423,6 +6727,9 @@ void CEconItemSchema::ItemTesting_CreateTestDefinition( int iCloneFromItemDef, i
 
 	// Then stomp it with the KV test contents
 	m_mapItems[nMapIndex]->BInitFromTestItemKVs( iNewDef, pNewKV );
+
+	// The copy and the test KVs change the new definition's name
+	InvalidateItemIndexes();
 }
 
 //-----------------------------------------------------------------------------
@@ -6432,6 +6739,7 @@ void CEconItemSchema::ItemTesting_DiscardTestDefinition( int iDef )
 {
 	m_mapItems.Remove( iDef );
 	m_mapItemsSorted.Remove( iDef );
+	InvalidateItemIndexes();
 }
 
 //-----------------------------------------------------------------------------
@@ -6723,17 +7031,82 @@ CEconItemDefinition *CEconItemSchema::GetItemDefinitionByName( const char *pszDe
 	if ( pszDefName == NULL )
 		return NULL;
 
+	const CUtlVector< item_definition_index_t > *pIndexes = GetItemDefinitionIndexesByName( pszDefName );
+	if ( !pIndexes )
+		return NULL;
+
+	return GetItemDefinition( pIndexes->Head() );
+}
+
+const CEconItemDefinition *CEconItemSchema::GetItemDefinitionByName( const char *pszDefName ) const
+{
+	return const_cast<CEconItemSchema *>(this)->GetItemDefinitionByName( pszDefName );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:	Returns every definition with the given name, in the order a walk of
+//			m_mapItems would find them
+//-----------------------------------------------------------------------------
+const CUtlVector< item_definition_index_t > *CEconItemSchema::GetItemDefinitionIndexesByName( const char *pszDefName ) const
+{
+	if ( pszDefName == NULL )
+		return NULL;
+
+	const_cast<CEconItemSchema *>(this)->EnsureItemIndexes();
+
+	int index = m_dictItemNameIndexes.Find( pszDefName );
+	if ( index == m_dictItemNameIndexes.InvalidIndex() )
+		return NULL;
+
+	return &m_vecItemNameIndexes[ m_dictItemNameIndexes[index] ];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:	Rebuilds the item lookup tables if the item map changed since they
+//			were last built
+//-----------------------------------------------------------------------------
+void CEconItemSchema::EnsureItemIndexes( void )
+{
+	if ( m_bItemIndexesValid )
+		return;
+
+	BuildItemIndexes();
+	m_bItemIndexesValid = true;
+}
+
+void CEconItemSchema::BuildItemIndexes( void )
+{
+	ClearItemIndexes();
+
 	FOR_EACH_MAP_FAST( m_mapItems, i )
 	{
-		if ( V_stricmp( pszDefName, m_mapItems[i]->GetDefinitionName()) == 0 )
-			return m_mapItems[i]; 
+		AddItemToIndexes( m_mapItems.Key( i ), m_mapItems[i] );
 	}
-	return NULL;
 }
 
-const CEconItemDefinition *CEconItemSchema::GetItemDefinitionByName( const char *pszDefName ) const
+void CEconItemSchema::ClearItemIndexes( void )
 {
-	return const_cast<CEconItemSchema *>(this)->GetItemDefinitionByName( pszDefName );
+	m_dictItemNameIndexes.Purge();
+	m_vecItemNameIndexes.Purge();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose:	Adds one definition to the lookup tables. Definitions have to be
+//			added in the order a walk of m_mapItems would find them.
+//-----------------------------------------------------------------------------
+void CEconItemSchema::AddItemToIndexes( item_definition_index_t unDefIndex, const CEconItemDefinition *pItemDef )
+{
+	const char *pszName = pItemDef->GetDefinitionName();
+	if ( !pszName )
+		return;
+
+	int index = m_dictItemNameIndexes.Find( pszName );
+	if ( index == m_dictItemNameIndexes.InvalidIndex() )
+	{
+		index = m_dictItemNameIndexes.Insert( pszName, m_vecItemNameIndexes.AddToTail() );
+	}
+
+	m_vecItemNameIndexes[ m_dictItemNameIndexes[index] ].AddToTail( unDefIndex );
 }
 
 
@@ -6892,6 +7265,7 @@ bool CEconItemSchema::SetupPreviewItemDefinition( KeyValues *pKV )
 	}
 
 	CEconItemDefinition *pItemDef = m_mapItems[ nMapIndex ];
+	InvalidateItemIndexes();
 	return pItemDef->BInitFromKV( pKV );
 }
 #endif // defined(CLIENT_DLL) || defined(GAME_DLL)
@@ -710,6 +710,17 @@ enum EAssetClassAttrExportRule_t
 	k_EAssetClassAttrExportRule_GCOnly = ( 1 << 2 ),	// attribute only lives on GC and not exported to any external request
 };
 
+//-----------------------------------------------------------------------------
+// Attribute hook indices
+// Every distinct "attribute_class" is interned into a small integer when the
+// schema loads, so attribute managers can key their result caches by index
+// instead of by string. Indices are never recycled; hook names that no schema
+// attribute uses yet are added the first time they're looked up. Main thread only.
+//-----------------------------------------------------------------------------
+typedef int attrib_hook_index_t;
+
+attrib_hook_index_t	GetAttribHookIndex( const char *pszAttributeClass );
+
 //-----------------------------------------------------------------------------
 // CEconItemAttributeDefinition
 // Template definition of a randomly created attribute
@@ -2555,7 +2566,8 @@ public:
 	// Setup & parse in the item data files.
 	virtual bool BInit( const char *fileName, const char *pathID, CUtlVector<CUtlString> *pVecErrors = NULL );
 	bool		BInitBinaryBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString> *pVecErrors = NULL );
-	bool		BInitTextBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString> *pVecErrors = NULL );
+	bool		BInitTextBuffer( CUtlBuffer &buffer, CUtlVector<CUtlString> *pVecErrors = NULL, CUtlBuffer *pBufRawBinary = NULL );
+	bool		BInitFromFile( const char *fileName, const char *pathID, CUtlVector<CUtlString> *pVecErrors, bool bUseCache, bool *pbFromCache = NULL );
 
 	uint32		GetVersion() const { return m_unVersion; }
 	CSHA		GetSchemaSHA() const { return m_schemaSHA; }
@@ -2737,6 +2749,9 @@ public:
 	CEconItemDefinition *GetItemDefinitionByName( const char *pszDefName );
 	const CEconItemDefinition *GetItemDefinitionByName( const char *pszDefName ) const;
 
+	// All the definitions with this name, in item map order. NULL if there aren't any.
+	const CUtlVector< item_definition_index_t > *GetItemDefinitionIndexesByName( const char *pszDefName ) const;
+
 	random_attrib_t *GetRandomAttributeTemplateByName( const char *pszAttrTemplateName ) const;
 	CLootlistJob *GetLootlistJobTemplateByName( const char *pszLootlistJobTemplateName ) const;
 
@@ -2812,11 +2827,24 @@ protected:
 
 	virtual bool BInitSchema( KeyValues *pKVRawDefinition, CUtlVector<CUtlString> *pVecErrors = NULL );
 	virtual bool BPostSchemaInit( CUtlVector<CUtlString> *pVecErrors );
+
+	// Lookup tables over m_mapItems. They're thrown away whenever the map changes and
+	// rebuilt the next time someone asks for one. BInitItems keeps them valid while
+	// loading by adding each definition as it's parsed.
+	void InvalidateItemIndexes( void ) { m_bItemIndexesValid = false; }
+	void EnsureItemIndexes( void );
+	void BuildItemIndexes( void );
+	virtual void ClearItemIndexes( void );
+	virtual void AddItemToIndexes( item_definition_index_t unDefIndex, const CEconItemDefinition *pItemDef );
 #ifdef TF_CLIENT_DLL
 	virtual int CalculateNumberOfConcreteItems( const CEconItemDefinition *pItemDef );	// Let derived classes handle custom item types
 #endif // TF_CLIENT_DLL
 
 private:
+	// Schema parse cache. See BInitFromFile.
+	bool BReadSchemaCache( const char *pszCacheFile, const CSHA &sourceSHA );
+	void WriteSchemaCache( const char *pszCacheFile, CUtlBuffer &bufRawBinary );
+
 	bool BInitGameInfo( KeyValues *pKVGameInfo, CUtlVector<CUtlString> *pVecErrors );
 	bool BInitAttributeTypes( CUtlVector<CUtlString> *pVecErrors );
 	bool BInitDefinitionPrefabs( KeyValues *pKVPrefabs, CUtlVector<CUtlString> *pVecErrors );
@@ -2873,6 +2901,7 @@ private:
 
 	KeyValues		*m_pKVRawDefinition;
 	uint32			m_unVersion;
+	uint32			m_unCachedVersion;	// version stored in the schema cache, so BInitSchema needn't recompute it
 	CSHA			m_schemaSHA;
 
 	// Class range
@@ -2916,6 +2945,11 @@ private:
 	// A sorted version of the same map, for instances where we really want sorted data
 	SortedItemDefinitionMap_t							m_mapItemsSorted;
 
+	// Item definitions by name, see EnsureItemIndexes
+	bool												m_bItemIndexesValid;
+	CUtlDict< int >										m_dictItemNameIndexes;
+	CUtlVector< CUtlVector< item_definition_index_t > >	m_vecItemNameIndexes;
+
 	// List of all the tool items, is a sublist of mapItems
 	ToolsItemDefinitionMap_t							m_mapToolsItems;
 
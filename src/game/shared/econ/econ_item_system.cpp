@@ -301,7 +301,7 @@ void CEconItemSystem::ParseItemSchemaFile( const char *pFilename )
 //-----------------------------------------------------------------------------
 // Purpose: Generate a random item matching the specified criteria
 //-----------------------------------------------------------------------------
-item_definition_index_t CEconItemSystem::GenerateRandomItem( CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality )
+item_definition_index_t CEconItemSystem::GenerateRandomItem( CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality, const CUtlVector<item_definition_index_t> *pCandidates )
 {
 	// First, pick a random item quality (use the one passed in first)
 	if ( !pCriteria->BQualitySet() )
@@ -311,16 +311,42 @@ item_definition_index_t CEconItemSystem::GenerateRandomItem( CItemSelectionCrite
 
 	pCriteria->SetIgnoreEnabledFlag( true );
 
-	// Determine which item templates match the criteria
+	// Determine which item templates match the criteria. If the caller didn't narrow it
+	// down already and the criteria asks for an item by name, only the definitions with
+	// that name can match.
 	CUtlVector<item_definition_index_t> vecMatches;
 	const CEconItemSchema::ItemDefinitionMap_t &mapDefs = m_itemSchema.GetItemDefinitionMap();
+	if ( !pCandidates )
+	{
+		const char *pszName = pCriteria->GetRequiredStringEQValue( "name" );
+		if ( pszName )
+		{
+			pCandidates = m_itemSchema.GetItemDefinitionIndexesByName( pszName );
+			if ( !pCandidates )
+				return INVALID_ITEM_DEF_INDEX;
+		}
+	}
 
 HackMakeValidList:
-	FOR_EACH_MAP_FAST( mapDefs, i )
+	if ( pCandidates )
 	{
-		if ( pCriteria->BEvaluate( mapDefs[i] ) )
+		FOR_EACH_VEC( *pCandidates, i )
 		{
-			vecMatches.AddToTail( mapDefs.Key( i ) );
+			const CEconItemDefinition *pItemDef = m_itemSchema.GetItemDefinition( (*pCandidates)[i] );
+			if ( pItemDef && pCriteria->BEvaluate( pItemDef ) )
+			{
+				vecMatches.AddToTail( (*pCandidates)[i] );
+			}
+		}
+	}
+	else
+	{
+		FOR_EACH_MAP_FAST( mapDefs, i )
+		{
+			if ( pCriteria->BEvaluate( mapDefs[i] ) )
+			{
+				vecMatches.AddToTail( mapDefs.Key( i ) );
+			}
 		}
 	}
 
@@ -339,7 +365,19 @@ HackMakeValidList:
 
 	// Choose a random match
 	int iChosenIdx = RandomInt( 0, (iValidItems-1) );
-	item_definition_index_t iChosenItem = vecMatches[iChosenIdx];
+	return GenerateItem( vecMatches[iChosenIdx], pCriteria, outEntityQuality );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Fill in the quality and level for an item the caller already chose,
+//			the same way GenerateRandomItem does for the item it picks
+//-----------------------------------------------------------------------------
+item_definition_index_t CEconItemSystem::GenerateItem( item_definition_index_t iChosenItem, CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality )
+{
+	if ( !pCriteria->BQualitySet() )
+	{
+		pCriteria->SetQuality( GetRandomQualityForItem() );
+	}
 
 	const CEconItemDefinition *pItemDef = m_itemSchema.GetItemDefinition( iChosenItem );
 	if ( !pItemDef )
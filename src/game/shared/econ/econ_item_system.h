@@ -51,8 +51,12 @@ public:
 		return m_itemSchema.GetAttributeDefinitionByName( pszDefName );
 	}
 
-	// Select and return a random item's definition index matching the specified criteria
-	item_definition_index_t	GenerateRandomItem( CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality );
+	// Select and return a random item's definition index matching the specified criteria. If pCandidates
+	// is passed in, only those definitions are tested instead of the whole schema.
+	item_definition_index_t	GenerateRandomItem( CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality, const CUtlVector<item_definition_index_t> *pCandidates = NULL );
+
+	// Resolve the quality and level of an item the caller already picked, the same way GenerateRandomItem does
+	item_definition_index_t	GenerateItem( item_definition_index_t iItemDef, CItemSelectionCriteria *pCriteria, entityquality_t *outEntityQuality );
 
 	// Select and return the base item definition index for a class's load-out slot 
 	// Note: baseitemcriteria_t is game-specific and/or may not exist!
@@ -106,6 +106,22 @@ const char *CItemSelectionCriteria::GetFieldForFirstConditionOfType( EItemCriter
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Find a required string equality condition on the given field, and
+//			return the value it's looking for.
+//-----------------------------------------------------------------------------
+const char *CItemSelectionCriteria::GetRequiredStringEQValue( const char *pszField ) const
+{
+	FOR_EACH_VEC( m_vecConditions, i )
+	{
+		const ICondition *pCondition = m_vecConditions[i];
+		if ( pCondition->GetEOp() == k_EOperator_String_EQ && pCondition->BRequired() && !V_stricmp( pCondition->GetField(), pszField ) )
+			return pCondition->GetValue();
+	}
+
+	return NULL;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Initialize from a KV structure
 //-----------------------------------------------------------------------------
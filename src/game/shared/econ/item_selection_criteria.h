@@ -107,6 +107,7 @@ public:
 			virtual EItemCriteriaOperator GetEOp() const { return k_EItemCriteriaOperator_Count; }
 			virtual const char *GetField() const { return ""; }
 			virtual const char *GetValue() const { return ""; }
+			virtual bool BRequired() const { return false; }
 
 			virtual bool BSerializeToMsg( CSOItemCriteriaCondition & msg ) const { Assert( !"BSerializeToMsg() called on for unimplementing ICondition!" ); return false; }
 	  };
@@ -118,6 +119,10 @@ public:
 	  const char	*GetValueForFirstConditionOfType( EItemCriteriaOperator eType ) const;
 	  const char	*GetFieldForFirstConditionOfType( EItemCriteriaOperator eType ) const;
 
+	  // Value of a required string equality condition on pszField, or NULL if there
+	  // isn't one. Only definitions with that value can pass the criteria.
+	  const char	*GetRequiredStringEQValue( const char *pszField ) const;
+
 	  // Alternate ways of initializing
 	  bool			BInitFromKV( KeyValues *pKVCriteria );
 
@@ -161,6 +166,7 @@ private:
 		EItemCriteriaOperator	GetEOp( void ) const OVERRIDE { return m_EOp; }
 		virtual	const char		*GetField( void ) const OVERRIDE  { return m_sField.Get(); }
 		virtual	const char		*GetValue( void ) const OVERRIDE  { Assert(0); return NULL; }
+		virtual bool			BRequired( void ) const OVERRIDE { return m_bRequired; }
 
 	private:
 		// Returns if the given KeyValues block passes this condition 
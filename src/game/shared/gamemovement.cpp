@@ -16,6 +16,8 @@
 #include "rumble_shared.h"
 #ifdef CLIENT_DLL
 #include "prediction.h"
+#else
+#include "serverbenchmark_base.h"
 #endif
 
 #if defined(HL2_DLL) || defined(HL2_CLIENT_DLL)
@@ -1131,6 +1133,10 @@ void CGameMovement::ProcessMovement( CBasePlayer *pPlayer, CMoveData *pMove )
 {
 	Assert( pMove && pPlayer );
 
+#ifdef GAME_DLL
+	SV_BENCHMARK_SCOPE( SV_BENCHMARK_GAME_MOVEMENT );
+#endif
+
 	float flStoreFrametime = gpGlobals->frametime;
 
 	//!!HACK HACK: Adrian - slow down all player movement by this factor.
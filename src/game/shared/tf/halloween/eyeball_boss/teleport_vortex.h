@@ -49,6 +49,7 @@ public:
 	virtual void	OnDataChanged(DataUpdateType_t updateType);
 	virtual void	ClientThink();
 	virtual void	BuildTransformations( CStudioHdr *pStudioHdr, Vector *pos, Quaternion q[], const matrix3x4_t& cameraTransform, int boneMask, CBoneBitList &boneComputed );
+	virtual bool	IsBoneSetupThreadSafe( void ) { return false; }		// BuildTransformations reads the local player's origin
 
 	void			DestroyParticleEffect();
 #else
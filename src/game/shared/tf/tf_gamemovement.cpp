@@ -36,6 +36,7 @@
 	#include "team.h"
 	#include "bot/tf_bot.h"
 	#include "tf_fx.h"
+	#include "movement_recorder.h"
 #endif
 
 
@@ -93,6 +94,20 @@ extern ConVar mp_tournament_readymode_countdown;
 
 #define	NUM_CROUCH_HINTS	3
 
+//-----------------------------------------------------------------------------
+// Purpose: True while sv_movement_replay reruns recorded moves on a player.
+//			Sounds, speech, anim events and anything that damages or kills are
+//			skipped then, they'd reach outside the player being replayed.
+//-----------------------------------------------------------------------------
+static inline bool IsReplayingMovement()
+{
+#ifdef GAME_DLL
+	return g_MovementRecorder.IsReplaying();
+#else
+	return false;
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -230,7 +245,7 @@ void CTFGameMovement::PlayerMove()
 				}
 			}
 
-			if ( bPlaySplash )
+			if ( bPlaySplash && !IsReplayingMovement() )
 			{
 				m_pTFPlayer->EmitSound( "Physics.WaterSplash" );
 			}
@@ -864,7 +879,10 @@ void CTFGameMovement::VehicleMove( void )
 	m_pTFPlayer->SetCurrentTauntMoveSpeed( flTargetMoveSpeed );
 	float flLeanAccel = flTargetSpeed > flSmoothMoveSpeed ? flAcceleration : flTargetSpeed < flSmoothMoveSpeed ? -flAcceleration : 0.f;
 	flLeanAccel = Sign( m_pTFPlayer->GetCurrentTauntMoveSpeed() ) != Sign( flTargetSpeed ) ? -flLeanAccel : flLeanAccel;
-	m_pTFPlayer->m_PlayerAnimState->Vehicle_LeanAccel( flLeanAccel );
+	if ( !IsReplayingMovement() )
+	{
+		m_pTFPlayer->m_PlayerAnimState->Vehicle_LeanAccel( flLeanAccel );
+	}
 
 #ifdef DEBUG
 	engine->Con_NPrintf( 0, "Speed:  %3.2f", m_pTFPlayer->GetCurrentTauntMoveSpeed() );
@@ -1044,6 +1062,11 @@ void CTFGameMovement::AirDash( void )
 	mv->m_vecVelocity.z += flDashZ;
 
 	int iAirDash = m_pTFPlayer->m_Shared.GetAirDash();
+	m_pTFPlayer->m_Shared.SetAirDash( iAirDash+1 );
+
+	if ( IsReplayingMovement() )
+		return;
+
 	if ( iAirDash == 0 )
 	{
 #if defined(GAME_DLL)
@@ -1059,8 +1082,6 @@ void CTFGameMovement::AirDash( void )
 #endif
 	}
 
-	m_pTFPlayer->m_Shared.SetAirDash( iAirDash+1 );
-
 	// Play the gesture.
  	m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_DOUBLEJUMP );
 #ifdef GAME_DLL
@@ -1262,11 +1283,14 @@ bool CTFGameMovement::CheckJumpButton()
 	PreventBunnyJumping();
 
 	// Start jump animation and player sound (specific TF animation and flags).
-	m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_JUMP );
-	player->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, 1.0, true );
+	if ( !IsReplayingMovement() )
+	{
+		m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_JUMP );
+		player->PlayStepSound( (Vector &)mv->GetAbsOrigin(), player->m_pSurfaceData, 1.0, true );
+	}
 	m_pTFPlayer->m_Shared.SetJumping( true );
 
-	if ( m_pTFPlayer->m_Shared.InCond( TF_COND_HALLOWEEN_KART ) )
+	if ( m_pTFPlayer->m_Shared.InCond( TF_COND_HALLOWEEN_KART ) && !IsReplayingMovement() )
 	{
 		m_pTFPlayer->EmitSound( "BumperCar.Jump" );
 	}
@@ -1362,7 +1386,7 @@ int CTFGameMovement::CheckStuck( void )
 		TracePlayerBBox( originalPos, originalPos, PlayerSolidMask(), COLLISION_GROUP_PLAYER_MOVEMENT, traceresult );
 
 #ifdef GAME_DLL
-		if ( TFGameRules() && TFGameRules()->IsMannVsMachineMode() && m_pTFPlayer && m_pTFPlayer->GetTeamNumber() == TF_TEAM_PVE_INVADERS )
+		if ( TFGameRules() && TFGameRules()->IsMannVsMachineMode() && m_pTFPlayer && m_pTFPlayer->GetTeamNumber() == TF_TEAM_PVE_INVADERS && !IsReplayingMovement() )
 		{
 			if ( traceresult.startsolid )
 			{
@@ -1981,7 +2005,10 @@ void CTFGameMovement::CheckKartWallBumping()
 	{
 		// Play a flinch to show we impacted something
 		bool bDashing = m_pTFPlayer->m_Shared.InCond( TF_COND_HALLOWEEN_KART_DASH );
-		m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_CUSTOM_GESTURE, bDashing ? ACT_KART_IMPACT_BIG : ACT_KART_IMPACT );
+		if ( !IsReplayingMovement() )
+		{
+			m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_CUSTOM_GESTURE, bDashing ? ACT_KART_IMPACT_BIG : ACT_KART_IMPACT );
+		}
 
 		Vector vAim = m_pTFPlayer->GetLocalVelocity();
 		vAim.z = 0;
@@ -1999,7 +2026,10 @@ void CTFGameMovement::CheckKartWallBumping()
 			Vector vOld = m_pTFPlayer->GetLocalVelocity();
 			Vector vNew = ( -2.0f * pWallTrace.plane.normal.Dot( vOld ) * pWallTrace.plane.normal + vOld );
 			vNew.NormalizeInPlace();
-			m_pTFPlayer->AddHalloweenKartPushEvent( m_pTFPlayer, NULL, NULL, vNew * vOld.Length() / 2.0f, 0 );
+			if ( !IsReplayingMovement() )
+			{
+				m_pTFPlayer->AddHalloweenKartPushEvent( m_pTFPlayer, NULL, NULL, vNew * vOld.Length() / 2.0f, 0 );
+			}
 			if ( bDashing )
 			{
 				// Stop moving
@@ -2938,7 +2968,7 @@ bool CTFGameMovement::GameHasLadders() const
 //-----------------------------------------------------------------------------
 void CTFGameMovement::SetGroundEntity( trace_t *pm )
 {
-	if ( m_pTFPlayer->m_Shared.InCond( TF_COND_HALLOWEEN_KART ) && !m_pTFPlayer->GetGroundEntity() && pm && pm->m_pEnt )
+	if ( m_pTFPlayer->m_Shared.InCond( TF_COND_HALLOWEEN_KART ) && !m_pTFPlayer->GetGroundEntity() && pm && pm->m_pEnt && !IsReplayingMovement() )
 	{
 		m_pTFPlayer->EmitSound( "BumperCar.JumpLand" );
 	}
@@ -2948,7 +2978,7 @@ void CTFGameMovement::SetGroundEntity( trace_t *pm )
 	{
 #ifdef GAME_DLL
 		int iAirDash = m_pTFPlayer->m_Shared.GetAirDash();
-		if ( iAirDash > 0 )
+		if ( iAirDash > 0 && !IsReplayingMovement() )
 		{
 			m_pTFPlayer->SpeakConceptIfAllowed( MP_CONCEPT_DOUBLE_JUMP, "started_jumping:0" );
 		}
@@ -3042,7 +3072,7 @@ void CTFGameMovement::HandleDuck( int nButtonsPressed )
 			player->m_Local.m_flDucktime = TIME_TO_DUCK_MS * ( 1.0f - flPercentage );
 		}
 
-		if ( m_pTFPlayer->m_Shared.GetAirDash() > 0 )
+		if ( m_pTFPlayer->m_Shared.GetAirDash() > 0 && !IsReplayingMovement() )
 		{
 			m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_DOUBLEJUMP_CROUCH );
 		}
@@ -3251,7 +3281,7 @@ void CTFGameMovement::OnDuck( int nButtonsPressed )
 		player->m_Local.m_flDucktime = GAMEMOVEMENT_DUCK_TIME;
 		player->m_Local.m_bDucking = true;
 
-		if ( m_pTFPlayer->m_Shared.GetAirDash() > 0 )
+		if ( m_pTFPlayer->m_Shared.GetAirDash() > 0 && !IsReplayingMovement() )
 		{
 			m_pTFPlayer->DoAnimationEvent( PLAYERANIMEVENT_DOUBLEJUMP_CROUCH );
 		}
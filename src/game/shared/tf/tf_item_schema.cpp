@@ -1626,6 +1626,49 @@ void CTFItemSchema::Reset()
 	CEconItemSchema::Reset();
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Adds the class and loadout slot lookup to the base item indexes
+//-----------------------------------------------------------------------------
+void CTFItemSchema::ClearItemIndexes( void )
+{
+	CEconItemSchema::ClearItemIndexes();
+
+	for ( int iClass = 0; iClass < LOADOUT_COUNT; iClass++ )
+	{
+		for ( int iSlot = 0; iSlot < CLASS_LOADOUT_POSITION_COUNT; iSlot++ )
+		{
+			m_vecItemsByClassSlot[iClass][iSlot].RemoveAll();
+		}
+	}
+}
+
+void CTFItemSchema::AddItemToIndexes( item_definition_index_t unDefIndex, const CEconItemDefinition *pItemDef )
+{
+	CEconItemSchema::AddItemToIndexes( unDefIndex, pItemDef );
+
+	const CTFItemDefinition *pTFItemDef = (const CTFItemDefinition *)pItemDef;
+	for ( int iClass = 0; iClass < LOADOUT_COUNT; iClass++ )
+	{
+		int iSlot = pTFItemDef->GetLoadoutSlot( iClass );
+		if ( iSlot >= 0 && iSlot < CLASS_LOADOUT_POSITION_COUNT )
+		{
+			m_vecItemsByClassSlot[iClass][iSlot].AddToTail( unDefIndex );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: 
+//-----------------------------------------------------------------------------
+const CUtlVector< item_definition_index_t > &CTFItemSchema::GetItemDefinitionIndexesByClassSlot( int iClass, int iSlot )
+{
+	Assert( iClass >= 0 && iClass < LOADOUT_COUNT );
+	Assert( iSlot >= 0 && iSlot < CLASS_LOADOUT_POSITION_COUNT );
+
+	EnsureItemIndexes();
+	return m_vecItemsByClassSlot[iClass][iSlot];
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -743,6 +743,9 @@ public:
 	const MMGroupMap_t& GetMMGroupMap() const { return m_mapMMGroups; }
 	const SchemaMMGroup_t* GetMMGroup( EMatchmakingGroupType eCat ) const;
 
+	// Definitions that go in this loadout slot for this class, in item map order
+	const CUtlVector< item_definition_index_t > &GetItemDefinitionIndexesByClassSlot( int iClass, int iSlot );
+
 
 public:
 	// CEconItemSchema interface.
@@ -763,6 +766,9 @@ protected:
 	virtual int CalculateNumberOfConcreteItems( const CEconItemDefinition *pItemDef );
 #endif // TF_CLIENT_DLL
 
+	virtual void ClearItemIndexes( void ) OVERRIDE;
+	virtual void AddItemToIndexes( item_definition_index_t unDefIndex, const CEconItemDefinition *pItemDef ) OVERRIDE;
+
 private:
 	void InitializeStringTable( const char **ppStringTable, unsigned int unStringCount, CUtlVector<const char *> *out_pvecStringTable );
 
@@ -795,6 +801,8 @@ private:
 	MMGroupMap_t m_mapMMGroups;
 	WarDefinitionMap_t m_mapWars;
 
+	CUtlVector< item_definition_index_t > m_vecItemsByClassSlot[ LOADOUT_COUNT ][ CLASS_LOADOUT_POSITION_COUNT ];
+
 };
 
 #endif // TFITEMSCHEMA_H
@@ -26,7 +26,11 @@ item_definition_index_t CTFItemSystem::GenerateBaseItem( baseitemcriteria_t *pCr
 	criteria.SetItemLevel( 1 );
 	criteria.BAddCondition( "baseitem", k_EOperator_String_EQ, "1", true );
 	InventoryManager()->AddBaseItemCriteria( pCriteria, &criteria );
-	int iChosenItem = GenerateRandomItem( &criteria, NULL );
+
+	// Only items that equip into this class's slot can be its base item, so there's no
+	// need to test the rest of the schema.
+	const CUtlVector< item_definition_index_t > &vecSlotItems = GetItemSchema()->GetItemDefinitionIndexesByClassSlot( pCriteria->iClass, pCriteria->iSlot );
+	int iChosenItem = GenerateRandomItem( &criteria, NULL, &vecSlotItems );
 	return iChosenItem;
 }
 
@@ -20,6 +20,7 @@
 	#include "tf_gamerules.h"
 	#include "tf_player.h"
 	#include "tf_gc_server.h"
+	#include "tf_structuredlog.h"
 #else
 	#include "dt_utlvector_recv.h"
 	#include "c_tf_player.h"
@@ -513,6 +514,8 @@ void CMannVsMachineStats::RoundEvent_WaveStart()
 		SW_ReportWaveSummary( m_iCurrentWaveIdx - 1, true );
 	}
 
+	g_TFStructuredLog.LogWaveStart( m_iCurrentWaveIdx );
+
 	// reset stats
 	ResetWaveStats();
 }
@@ -522,6 +525,8 @@ void CMannVsMachineStats::RoundEvent_WaveStart()
 //-----------------------------------------------------------------------------
 void CMannVsMachineStats::RoundEvent_WaveEnd( bool bSuccess )
 {
+	g_TFStructuredLog.LogWaveEnd( m_iCurrentWaveIdx, bSuccess );
+
 	// if failed, report immediately, 
 	// report successes on starting the next wave because of currency picked up late
 	ConVar *sv_cheats = g_pCVar->FindVar( "sv_cheats" );
@@ -656,6 +661,8 @@ void CMannVsMachineStats::PlayerEvent_Upgraded( CTFPlayer *pTFPlayer, uint16 nIt
 	if ( pTFPlayer->IsBot() || !TFGameRules() || !TFGameRules()->IsPVEModeActive() )
 		return;
 
+	g_TFStructuredLog.LogUpgrade( pTFPlayer, nItemDef, nAttributeDef, nCost, bIsBottle );
+
 	OnStatsChanged();
 
 	CBroadcastRecipientFilter filter;
@@ -78,6 +78,7 @@
 #include "tf_weapon_builder.h"
 #include "nav_mesh/tf_nav_area.h"
 #include "nav_pathfind.h"
+#include "movement_recorder.h"
 #include "tf_obj_dispenser.h"
 #include "dt_utlvector_send.h"
 #include "tf_item_wearable.h"
@@ -348,11 +349,9 @@ BEGIN_RECV_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerSharedLocal )
 	RecvPropDataTable( RECVINFO_DT(m_RoundScoreData),0, &REFERENCE_RECV_TABLE(DT_TFPlayerScoringDataExclusive) ),
 END_RECV_TABLE()
 
-BEGIN_RECV_TABLE_NOBASE( condition_source_t, DT_TFPlayerConditionSource )
-	//RecvPropInt( RECVINFO( m_nPreventedDamageFromCondition ) ),
-	//RecvPropFloat( RECVINFO( m_flExpireTime ) ),
+BEGIN_RECV_TABLE_NOBASE( condition_provider_t, DT_TFPlayerConditionProvider )
+	RecvPropInt( RECVINFO( m_nCond ) ),
 	RecvPropEHandle( RECVINFO( m_pProvider ) ),
-	//RecvPropBool( RECVINFO( m_bPrevActive ) ),
 END_RECV_TABLE()
 
 BEGIN_RECV_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerShared )
@@ -433,7 +432,7 @@ BEGIN_RECV_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerShared )
 	RecvPropFloat( RECVINFO( m_askForBallTime ) ),
 	RecvPropBool( RECVINFO( m_bKingRuneBuffActive ) ),
 
-	RecvPropUtlVectorDataTable( m_ConditionData, TF_COND_LAST, DT_TFPlayerConditionSource ),
+	RecvPropUtlVectorDataTable( m_ConditionProviders, TF_MAX_CONDITION_PROVIDERS, DT_TFPlayerConditionProvider ),
 
 	RecvPropInt( RECVINFO( m_nPlayerCondEx4 ) ),
 
@@ -523,11 +522,9 @@ BEGIN_SEND_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerSharedLocal )
 	SendPropDataTable( SENDINFO_DT(m_RoundScoreData), &REFERENCE_SEND_TABLE(DT_TFPlayerScoringDataExclusive) ),
 END_SEND_TABLE()
 
-BEGIN_SEND_TABLE_NOBASE( condition_source_t, DT_TFPlayerConditionSource )
-	//SendPropInt( SENDINFO( m_nPreventedDamageFromCondition ) ),
-	//SendPropFloat( SENDINFO( m_flExpireTime ) ),
+BEGIN_SEND_TABLE_NOBASE( condition_provider_t, DT_TFPlayerConditionProvider )
+	SendPropInt( SENDINFO( m_nCond ), 8, SPROP_UNSIGNED ),
 	SendPropEHandle( SENDINFO( m_pProvider ) ),
-	//SendPropBool( SENDINFO( m_bPrevActive ) ),
 END_SEND_TABLE()
 
 BEGIN_SEND_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerShared )
@@ -609,7 +606,7 @@ BEGIN_SEND_TABLE_NOBASE( CTFPlayerShared, DT_TFPlayerShared )
 	SendPropFloat( SENDINFO( m_askForBallTime ) ),
 	SendPropBool( SENDINFO( m_bKingRuneBuffActive ) ),
 
-	SendPropUtlVectorDataTable( m_ConditionData, TF_COND_LAST, DT_TFPlayerConditionSource ),
+	SendPropUtlVectorDataTable( m_ConditionProviders, TF_MAX_CONDITION_PROVIDERS, DT_TFPlayerConditionProvider ),
 
 	SendPropInt( SENDINFO( m_nPlayerCondEx4 ), -1, SPROP_VARINT | SPROP_UNSIGNED ),
 	
@@ -777,6 +774,9 @@ CTFPlayerShared::CTFPlayerShared()
 	// Don't forget to add an m_nOldCond* and m_nForceCond*
 	COMPILE_TIME_ASSERT( TF_COND_LAST < (32 + 32 + 32 + 32 + 32) );
 
+	// condition_provider_t::m_nCond is sent in 8 bits
+	COMPILE_TIME_ASSERT( TF_COND_LAST <= 256 );
+
 	m_nPlayerState.Set( TF_STATE_WELCOME );
 	m_bJumping = false;
 	m_iAirDash = 0;
@@ -1134,8 +1134,8 @@ void CTFPlayerShared::AddCond( ETFCond eCond, float flDuration /* = PERMANENT_CO
 		}
 
 		m_ConditionData[eCond].m_flExpireTime = flDuration;
-		m_ConditionData[eCond].m_pProvider = pProvider;
 		m_ConditionData[eCond].m_nPreventedDamageFromCondition = 0;
+		SetConditionProvider( eCond, pProvider );
 
 		OnConditionAdded( eCond );
 	}
@@ -1179,9 +1179,8 @@ void CTFPlayerShared::RemoveCond( ETFCond eCond, bool ignore_duration )
 	}
 
 	m_ConditionData[eCond].m_flExpireTime = 0;
-	m_ConditionData[eCond].m_pProvider = NULL;
 	m_ConditionData[eCond].m_bPrevActive = false;
-
+	SetConditionProvider( eCond, NULL );
 }
 
 //-----------------------------------------------------------------------------
@@ -1191,12 +1190,12 @@ bool CTFPlayerShared::InCond( ETFCond eCond ) const
 {
 	Assert( eCond >= 0 && eCond < TF_COND_LAST );
 
-	// Old condition system, only used for the first 32 conditions
-	if ( eCond < 32 && m_ConditionList.InCond( eCond ) )
+	CConditionVars<const int> cPlayerCond( m_nPlayerCond.m_Value, m_nPlayerCondEx.m_Value, m_nPlayerCondEx2.m_Value, m_nPlayerCondEx3.m_Value, m_nPlayerCondEx4.m_Value, eCond );
+	if ( (cPlayerCond.CondVar() & cPlayerCond.CondBit()) != 0 )
 		return true;
 
-	CConditionVars<const int> cPlayerCond( m_nPlayerCond.m_Value, m_nPlayerCondEx.m_Value, m_nPlayerCondEx2.m_Value, m_nPlayerCondEx3.m_Value, m_nPlayerCondEx4.m_Value, eCond );
-	return (cPlayerCond.CondVar() & cPlayerCond.CondBit()) != 0;
+	// Old condition system, only used for the first 32 conditions
+	return eCond < 32 && m_ConditionList.InCond( eCond );
 }
 
 //-----------------------------------------------------------------------------
@@ -1266,6 +1265,68 @@ CBaseEntity *CTFPlayerShared::GetConditionProvider( ETFCond eCond ) const
 	return pProvider;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Sets the provider of a condition, and on the server keeps the
+//			networked provider list in step with it
+//-----------------------------------------------------------------------------
+void CTFPlayerShared::SetConditionProvider( ETFCond eCond, CBaseEntity *pProvider )
+{
+	m_ConditionData[eCond].m_pProvider = pProvider;
+
+#ifdef GAME_DLL
+	FOR_EACH_VEC( m_ConditionProviders, i )
+	{
+		if ( m_ConditionProviders[i].m_nCond != eCond )
+			continue;
+
+		if ( pProvider )
+		{
+			m_ConditionProviders[i].m_pProvider = pProvider;
+		}
+		else
+		{
+			// Fill the gap from the end, so only two entries change on the wire
+			m_ConditionProviders.FastRemove( i );
+		}
+
+		NetworkStateChanged();
+		return;
+	}
+
+	if ( !pProvider )
+		return;
+
+	if ( m_ConditionProviders.Count() >= TF_MAX_CONDITION_PROVIDERS )
+	{
+		AssertMsg( false, "Too many conditions with providers, raise TF_MAX_CONDITION_PROVIDERS" );
+		return;
+	}
+
+	int iProvider = m_ConditionProviders.AddToTail();
+	m_ConditionProviders[iProvider].m_nCond = eCond;
+	m_ConditionProviders[iProvider].m_pProvider = pProvider;
+	NetworkStateChanged();
+#endif
+}
+
+#ifdef CLIENT_DLL
+//-----------------------------------------------------------------------------
+// Purpose: Copies the networked providers into the condition data, or clears
+//			the ones we took from the last update
+//-----------------------------------------------------------------------------
+void CTFPlayerShared::ApplyConditionProviders( bool bClear )
+{
+	FOR_EACH_VEC( m_ConditionProviders, i )
+	{
+		int nCond = m_ConditionProviders[i].m_nCond;
+		if ( nCond < 0 || nCond >= m_ConditionData.Count() )
+			continue;
+
+		m_ConditionData[nCond].m_pProvider = bClear ? NULL : m_ConditionProviders[i].m_pProvider.Get();
+	}
+}
+#endif // CLIENT_DLL
+
 //-----------------------------------------------------------------------------
 // Purpose: Returns the entity that applied this condition to us - for granting an assist when we die
 //-----------------------------------------------------------------------------
@@ -1394,6 +1455,7 @@ void CTFPlayerShared::InstantlySniperUnzoom( void )
 void CTFPlayerShared::OnPreDataChanged( void )
 {
 	m_ConditionList.OnPreDataChanged();
+	ApplyConditionProviders( true );
 
 	m_nOldConditions = m_nPlayerCond;
 	m_nOldConditionsEx = m_nPlayerCondEx;
@@ -1426,6 +1488,9 @@ void CTFPlayerShared::OnDataChanged( void )
 		UpdateLegacyStunSystem();
 	}
 
+	// Providers first, so OnConditionAdded can see who gave us the condition
+	ApplyConditionProviders( false );
+
 	// Update conditions from last network change
 	SyncConditions( m_nOldConditions, m_nPlayerCond, m_nForceConditions, 0 );
 	SyncConditions( m_nOldConditionsEx, m_nPlayerCondEx, m_nForceConditionsEx, 32 );
@@ -1518,13 +1583,15 @@ void CTFPlayerShared::RemoveAllCond()
 {
 	m_ConditionList.RemoveAll();
 
-	int i;
-	for ( i=0;i<TF_COND_LAST;i++ )
+	// Only walk the conditions that are set
+	CBitVec< TF_COND_LAST > vbConditions;
+	GetConditionsBits( vbConditions );
+	for ( int i = vbConditions.FindNextSetBit( 0 ); i != -1; i = vbConditions.FindNextSetBit( i + 1 ) )
 	{
-		if ( InCond( (ETFCond)i ) )
-		{
-			RemoveCond( (ETFCond)i );
-		}
+		RemoveCond( (ETFCond)i );
+
+		// Removing a condition can add or remove others, so go by the live bits
+		GetConditionsBits( vbConditions );
 	}
 
 	// Now remove all the rest
@@ -2315,49 +2382,52 @@ void CTFPlayerShared::ConditionGameRulesThink( void )
 		m_flNextCritUpdate = gpGlobals->curtime + 0.5;
 	}
 
-	for ( int i=0; i < TF_COND_LAST; ++i )
+	// Conditions handled by the condition list never set their bit, so walking
+	// the set bits visits exactly the conditions we have to expire here.
+	CBitVec< TF_COND_LAST > vbConditions;
+	GetConditionsBits( vbConditions );
+	for ( int i = vbConditions.FindNextSetBit( 0 ); i != -1; i = vbConditions.FindNextSetBit( i + 1 ) )
 	{
-		// if we're in this condition and it's not already being handled by the condition list
-		if ( InCond( (ETFCond)i ) && ((i >= 32) || !m_ConditionList.InCond( (ETFCond)i )) )
+		// Ignore permanent conditions
+		if ( m_ConditionData[i].m_flExpireTime != PERMANENT_CONDITION )
 		{
-			// Ignore permanent conditions
-			if ( m_ConditionData[i].m_flExpireTime != PERMANENT_CONDITION )
-			{
-				float flReduction = gpGlobals->frametime;
+			float flReduction = gpGlobals->frametime;
 
-				// If we're being healed, we reduce bad conditions faster
-				if ( ConditionExpiresFast( (ETFCond)i) && m_aHealers.Count() > 0 )
+			// If we're being healed, we reduce bad conditions faster
+			if ( ConditionExpiresFast( (ETFCond)i) && m_aHealers.Count() > 0 )
+			{
+				if ( i == TF_COND_URINE )
 				{
-					if ( i == TF_COND_URINE )
-					{
-						flReduction += (m_aHealers.Count() * flReduction);
-					}
-					else
-					{
-						flReduction += (m_aHealers.Count() * flReduction * 4);
-					}
+					flReduction += (m_aHealers.Count() * flReduction);
 				}
-
-				m_ConditionData[i].m_flExpireTime = MAX( m_ConditionData[i].m_flExpireTime - flReduction, 0 );
-
-				if ( m_ConditionData[i].m_flExpireTime == 0 )
+				else
 				{
-					RemoveCond( (ETFCond)i );
+					flReduction += (m_aHealers.Count() * flReduction * 4);
 				}
 			}
-			else
+
+			m_ConditionData[i].m_flExpireTime = MAX( m_ConditionData[i].m_flExpireTime - flReduction, 0 );
+
+			if ( m_ConditionData[i].m_flExpireTime == 0 )
 			{
+				RemoveCond( (ETFCond)i );
+
+				// Removing a condition can add or remove others
+				GetConditionsBits( vbConditions );
+			}
+		}
+		else
+		{
 #if !defined( DEBUG )
-				// Prevent hacked usercommand exploits
-				if ( m_pOuter->GetTimeSinceLastUserCommand() > 5.f || m_pOuter->GetTimeSinceLastThink() > 5.f )
+			// Prevent hacked usercommand exploits
+			if ( m_pOuter->GetTimeSinceLastUserCommand() > 5.f || m_pOuter->GetTimeSinceLastThink() > 5.f )
+			{
+				if ( GetCarryingRuneType() != RUNE_NONE )
 				{
-					if ( GetCarryingRuneType() != RUNE_NONE )
-					{
-						m_pOuter->DropRune();
-					}
+					m_pOuter->DropRune();
 				}
-#endif
 			}
+#endif
 		}
 	}
 
@@ -5353,6 +5423,12 @@ void CTFPlayerShared::OnAddHalloweenKartDash()
 //-----------------------------------------------------------------------------
 void CTFPlayerShared::OnRemoveHalloweenKartDash()
 {
+#ifdef GAME_DLL
+	// Movement replays end dashes when the kart hits a wall, keep that to the player
+	if ( g_MovementRecorder.IsReplaying() )
+		return;
+#endif
+
 	m_pOuter->SetFOV( m_pOuter, 0.f, 1.f, 0.f );
 #ifdef CLIENT_DLL
 	if ( m_pOuter->m_pSpeedBoostEffect )
@@ -6047,16 +6123,21 @@ void CTFPlayerShared::EndCharge()
 #ifdef GAME_DLL
 	if ( GetDemomanChargeMeter() < 90 )
 	{
-		// Impacts drain the charge meter completely.
-		float flMeterAtImpact = m_flChargeMeter;
-
-		CTFWearableDemoShield *pWearableShield = GetEquippedDemoShield( m_pOuter );
-		if ( pWearableShield )
+		// The bash hurts whoever we hit and the crit lasts past the move, so a
+		// movement replay only takes the condition change
+		if ( !g_MovementRecorder.IsReplaying() )
 		{
-			pWearableShield->ShieldBash( m_pOuter, flMeterAtImpact );
-		}
+			// Impacts drain the charge meter completely.
+			float flMeterAtImpact = m_flChargeMeter;
 
-		CalcChargeCrit();
+			CTFWearableDemoShield *pWearableShield = GetEquippedDemoShield( m_pOuter );
+			if ( pWearableShield )
+			{
+				pWearableShield->ShieldBash( m_pOuter, flMeterAtImpact );
+			}
+
+			CalcChargeCrit();
+		}
 
 		// Removing the condition here would cause issues with prediction, so we set the
 		// duration to zero so that it will be removed during the next condition think.
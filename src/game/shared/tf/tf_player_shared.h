@@ -171,7 +171,6 @@ struct localplayerscoring_t
 // Condition Provider
 struct condition_source_t
 {
-	DECLARE_EMBEDDED_NETWORKVAR();
 	DECLARE_CLASS_NOBASE( condition_source_t );
 
 	condition_source_t()
@@ -184,10 +183,29 @@ struct condition_source_t
 
 	int	m_nPreventedDamageFromCondition;
 	float	m_flExpireTime;
-	CNetworkHandle( CBaseEntity, m_pProvider );
+	CHandle< CBaseEntity > m_pProvider;
 	bool	m_bPrevActive;
 };
 
+// Most conditions don't have a provider, so rather than networking a slot for every
+// condition we only send the ones that do. The condition bits say what's active.
+#define TF_MAX_CONDITION_PROVIDERS	32
+
+struct condition_provider_t
+{
+	DECLARE_EMBEDDED_NETWORKVAR();
+	DECLARE_CLASS_NOBASE( condition_provider_t );
+
+	condition_provider_t()
+	{
+		m_nCond = TF_COND_INVALID;
+		m_pProvider = NULL;
+	}
+
+	CNetworkVar( int, m_nCond );
+	CNetworkHandle( CBaseEntity, m_pProvider );
+};
+
 
 //=============================================================================
 // For checkpointing upgrades Players have purchased in Mann Vs Machine
@@ -235,6 +253,7 @@ public:
 #else
 
 	friend class CTFPlayer;
+	friend class CMovementRecorder;
 	typedef CTFPlayer OuterClass;
 
 #endif
@@ -254,6 +273,9 @@ private:
 	// Condition Provider tracking
 	CUtlVector< condition_source_t > m_ConditionData;
 
+	// Networked providers of the active conditions, see condition_provider_t
+	CUtlVector< condition_provider_t > m_ConditionProviders;
+
 public:
 	enum ERageBuffSlot
 	{
@@ -738,6 +760,11 @@ private:
 
 	void ImpactWaterTrace( trace_t &trace, const Vector &vecStart );
 
+	void SetConditionProvider( ETFCond eCond, CBaseEntity *pProvider );
+#ifdef CLIENT_DLL
+	void ApplyConditionProviders( bool bClear );
+#endif
+
 	void OnAddZoomed( void );
 	void OnAddStealthed( void );
 	void OnAddInvulnerable( void );
@@ -10,9 +10,9 @@
 #pragma once
 #endif
 
-#include "HelperInfo.h"
-#include "GameData.h"
-#include "GDClass.h"
-#include "InputOutput.h"
+#include "helperinfo.h"
+#include "gamedata.h"
+#include "gdclass.h"
+#include "inputoutput.h"
 
 #endif // FGDLIB_H
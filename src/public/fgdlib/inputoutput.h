@@ -10,7 +10,7 @@
 
 
 #include <utlvector.h>
-#include "fgdlib/EntityDefs.h"
+#include "fgdlib/entitydefs.h"
 
 
 enum InputOutputType_t
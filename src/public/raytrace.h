@@ -41,6 +41,23 @@ public:
 
 };
 
+/// Eight rays traced as one packet: two FourRays sharing a single walk through the acceleration
+/// structure. As with FourRays, all eight must have the same direction signs to share a kd-tree
+/// walk; the BVH has no such restriction.
+class EightRays
+{
+public:
+	FourRays m_Rays[2];										// rays 0-3 and 4-7
+
+	inline void Check(void) const
+	{
+		m_Rays[0].Check();
+		m_Rays[1].Check();
+	}
+	// returns direction sign mask for 8 rays, or -1 if they can not be traced as a bundle.
+	int CalculateDirectionSignMask(void) const;
+};
+
 /// The format a triangle is stored in for intersections. size of this structure is important.
 /// This structure can be in one of two forms. Before the ray tracing environment is set up, the
 /// ProjectedEdgeEquations hold the coordinates of the 3 vertices, for facilitating bounding box
@@ -192,6 +209,47 @@ protected:
 
 };
 
+/// Node of the optional bounding volume hierarchy (RTE_FLAGS_USE_BVH). 32 bytes, two to a cache
+/// line. The children of an interior node are stored next to each other, left first.
+struct CacheOptimizedBVHNode
+{
+	float m_flMins[3];
+	int32 m_nChildOrFirstTri;								// left child, or first entry in
+															// TriangleIndexList for leaves
+	float m_flMaxs[3];
+	int32 m_nTriCountOrAxis;								// leaves: # of triangles (>=0).
+															// interior: -1-split axis
+
+	inline bool IsLeaf(void) const
+	{
+		return m_nTriCountOrAxis >= 0;
+	}
+
+	inline int LeftChild(void) const
+	{
+		assert(!IsLeaf());
+		return m_nChildOrFirstTri;
+	}
+
+	inline int SplitAxis(void) const
+	{
+		assert(!IsLeaf());
+		return -1-m_nTriCountOrAxis;
+	}
+
+	inline int32 TriangleIndexStart(void) const
+	{
+		assert(IsLeaf());
+		return m_nChildOrFirstTri;
+	}
+
+	inline int NumberOfTrianglesInLeaf(void) const
+	{
+		assert(IsLeaf());
+		return m_nTriCountOrAxis;
+	}
+};
+
 
 struct RayTracingSingleResult
 {
@@ -220,6 +278,10 @@ public:
 #define RTE_FLAGS_FAST_TREE_GENERATION 1
 #define RTE_FLAGS_DONT_STORE_TRIANGLE_COLORS 2				// saves memory if not needed
 #define RTE_FLAGS_DONT_STORE_TRIANGLE_MATERIALS 4
+#define RTE_FLAGS_USE_BVH 8									// build a SAH-binned BVH instead of
+															// the kd-tree. Builds faster, and
+															// packets don't need matching signs
+#define RTE_FLAGS_DISABLE_AVX 16							// keep Trace8Rays on the SSE path
 
 enum RayTraceLightingMode_t {
 	DIRECT_LIGHTING,										// just dot product lighting
@@ -262,6 +324,7 @@ public:
 
 	FourVectors BackgroundColor;							//< color where no intersection
 	CUtlVector<CacheOptimizedKDNode> OptimizedKDTree;		//< the packed kdtree. root is 0
+	CUtlVector<CacheOptimizedBVHNode> OptimizedBVH;			//< the packed bvh, if RTE_FLAGS_USE_BVH
 	CUtlBlockVector<CacheOptimizedTriangle> OptimizedTriangleList; //< the packed triangles
 	CUtlVector<int32> TriangleIndexList;					//< the list of triangle indices.
 	CUtlVector<LightDesc_t> LightList;						//< the list of lights
@@ -273,6 +336,7 @@ public:
 	{
 		BackgroundColor.DuplicateVector(Vector(1,0,0));		// red
 		Flags=0;
+		m_bTrace8AVX=false;
 	}
 
 
@@ -310,6 +374,17 @@ public:
 					RayTracingResult *rslt_out,
 					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
 
+	// eight ray versions of the above. Each half of the packet has its own t extents and gets
+	// its own result; rslt_out must point at two results. The AVX implementation is used when
+	// the cpu supports it.
+	void Trace8Rays(const EightRays &rays, const fltx4 TMin[2], const fltx4 TMax[2],
+					int DirectionSignMask, RayTracingResult *rslt_out,
+					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
+
+	void Trace8Rays(const EightRays &rays, const fltx4 TMin[2], const fltx4 TMax[2],
+					RayTracingResult *rslt_out,
+					int32 skip_id=-1, ITransparentTriangleCallback *pCallback = NULL);
+
 	// compute virtual light sources to model inter-reflection
 	void ComputeVirtualLightSources(void);
 
@@ -356,6 +431,17 @@ public:
 	void CalculateTriangleListBounds(int32 const *tris,int ntris,
 									 Vector &minout, Vector &maxout);
 
+	// bvh construction. Uses the same cost model as the kd-tree, evaluated over a fixed number
+	// of bins per axis rather than at triangle vertices.
+	void BuildBVH(void);
+	void RefineBVHNode(int node_number,int32 *tri_list,int ntris,
+					   Vector const *tri_mins, Vector const *tri_maxs, Vector const *tri_centers,
+					   int depth);
+
+	void Trace4RaysBVH(const FourRays &rays, fltx4 TMin, fltx4 TMax,int DirectionSignMask,
+					   RayTracingResult *rslt_out,
+					   int32 skip_id, ITransparentTriangleCallback *pCallback);
+
 	void AddInfinitePointLight(Vector position,				// light center
 							   Vector intensity);			// rgb amount
 
@@ -383,6 +469,8 @@ public:
 		return TriangleColors[triID];
 	}
 
+private:
+	bool m_bTrace8AVX;										// set up by SetupAccelerationStructure
 };
 
 
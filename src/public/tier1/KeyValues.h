@@ -129,6 +129,22 @@ public:
 	// Read from a utlbuffer...
 	bool LoadFromBuffer( char const *resourceName, CUtlBuffer &buf, IBaseFileSystem* pFileSystem = NULL, const char *pPathID = NULL );
 
+	// Arena parse mode, for large files that are loaded and then only read (popfiles, items_game, ...).
+	// Every node and string of the result lives in one arena owned by the returned root, value strings
+	// point into the loaded text instead of being copied, and the whole tree goes away with one
+	// deleteThis() on the root. Reading works as usual and light edits are fine, but the nodes belong
+	// to the arena: never delete a subkey on its own and keep using it, never move a subkey into a tree
+	// that outlives the root, and never pass the tree to another module (it has its own KeyValues code).
+	// Returns NULL if the file can't be read.
+	enum
+	{
+		ARENA_USES_ESCAPE_SEQUENCES	= 0x01,	// same as UsesEscapeSequences( true )
+		ARENA_IGNORE_CONDITIONALS	= 0x02,	// same as UsesConditionals( false )
+		ARENA_INDEX_CHILDREN		= 0x04,	// hash the children of wide blocks so FindKey on them doesn't walk the list
+	};
+	static KeyValues *LoadFromFileArena( IBaseFileSystem *filesystem, const char *resourceName, const char *pathID = NULL, int nArenaFlags = 0 );
+	static KeyValues *LoadFromBufferArena( char const *resourceName, const char *pBuffer, IBaseFileSystem* pFileSystem = NULL, const char *pPathID = NULL, int nArenaFlags = 0 );
+
 	// Find a keyValue, create it if it is not found.
 	// Set bCreate to true to create the key if it doesn't already exist (which ensures a valid pointer will be returned)
 	KeyValues *FindKey(const char *keyName, bool bCreate = false);
@@ -282,6 +298,7 @@ private:
 	void CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char* tmpBuffer );
 
 	void RemoveEverything();
+	friend class CKeyValuesArenaParser;
 //	void RecursiveSaveToFile( IBaseFileSystem *filesystem, CUtlBuffer &buffer, int indentLevel );
 //	void WriteConvertedString( CUtlBuffer &buffer, const char *pszString );
 	
@@ -312,6 +329,9 @@ private:
 	void FreeAllocatedValue();
 	void AllocateValueBlock(int size);
 
+	KeyValues *FindKeyInChildIndex( int keySymbol ) const;
+	void InvalidateParentChildIndex();
+
 	int m_iKeyName;	// keyname is a symbol defined in KeyValuesSystem
 
 	// These are needed out of the union because the API returns string pointers
@@ -330,7 +350,7 @@ private:
 	char	   m_iDataType;
 	char	   m_bHasEscapeSequences; // true, if while parsing this KeyValue, Escape Sequences are used (default false)
 	char	   m_bEvaluateConditionals; // true, if while parsing this KeyValue, conditionals blocks are evaluated (default true)
-	char	   unused[1];
+	char	   m_nArenaFlags; // KEYVALUES_ARENA_* bits, 0 for normal heap nodes. Was padding, so the layout is unchanged
 
 	KeyValues *m_pPeer;	// pointer to next key in list
 	KeyValues *m_pSub;	// pointer to Start of a new sub key list
@@ -106,12 +106,61 @@ protected:
 
 
 //-----------------------------------------------------------------------------
-// 
+// Thread safe pool. Freed blocks go to a per-thread cache, and whole
+// magazines of blocks move between the caches and a shared lock-free depot,
+// so the mutex is only taken to carve new blocks out of the blobs.
+//
+// Blocks are aligned to TSLIST_NODE_ALIGNMENT so they can sit on a CTSList.
+// Count() is exact, PeakCount() is the peak number of blocks taken out of
+// the blobs, including the ones sitting in the caches.
 //-----------------------------------------------------------------------------
+#define MEMPOOL_MT_CACHES		32		// threads beyond this share caches
+#define MEMPOOL_MT_MAGAZINE		32		// blocks moved to or from the depot at a time
+
 class CMemoryPoolMT : public CUtlMemoryPool
 {
 public:
-	CMemoryPoolMT(int blockSize, int numElements, int growMode = UTLMEMORYPOOL_GROW_FAST, const char *pszAllocOwner = NULL) : CUtlMemoryPool( blockSize, numElements, growMode, pszAllocOwner) {}
+				CMemoryPoolMT( int blockSize, int numElements, int growMode = UTLMEMORYPOOL_GROW_FAST, const char *pszAllocOwner = NULL, int nAlignment = 0 );
+				~CMemoryPoolMT();
+
+	void*		Alloc();
+	void*		Alloc( size_t amount );
+	void*		AllocZero();
+	void*		AllocZero( size_t amount );
+	void		Free( void *pMem );
+
+	// Frees everything. No other thread may be using the pool.
+	void		Clear();
+
+	int			Count() const;
+
+private:
+	struct ThreadCache_t
+	{
+		CTSListBase		m_Blocks;
+		CInterlockedInt	m_nAllocated;	// allocs minus frees made through this cache
+		char			m_Pad[64 - sizeof( CTSListBase ) - sizeof( CInterlockedInt )];
+	};
+
+	ThreadCache_t *GetThreadCache();
+	TSLNodeBase_t *Refill( ThreadCache_t *pCache );
+	void		ReturnMagazine( ThreadCache_t *pCache );
+	void		DrainCaches( bool bFreeBlocks );
+
+	ThreadCache_t		*m_pCaches;
+	CTSListBase			*m_pDepot;		// full magazines, chained through each block's second word
+	CThreadFastMutex	m_mutex;
+};
+
+
+//-----------------------------------------------------------------------------
+// The original thread safe pool, one mutex around every call. Kept for
+// comparison with CMemoryPoolMT.
+//-----------------------------------------------------------------------------
+class CMemoryPoolMutexMT : public CUtlMemoryPool
+{
+public:
+	CMemoryPoolMutexMT(int blockSize, int numElements, int growMode = UTLMEMORYPOOL_GROW_FAST, const char *pszAllocOwner = NULL, int nAlignment = 0) : CUtlMemoryPool( blockSize, numElements, growMode, pszAllocOwner, nAlignment ) {}
 
 
 	void*		Alloc()	{ AUTO_LOCK( m_mutex ); return CUtlMemoryPool::Alloc(); }
@@ -123,7 +172,7 @@ public:
 	// Frees everything
 	void		Clear() { AUTO_LOCK( m_mutex ); return CUtlMemoryPool::Clear(); }
 private:
-	CThreadFastMutex m_mutex; // @TODO: Rework to use tslist (toml 7/6/2007)
+	CThreadFastMutex m_mutex;
 };
 
 
@@ -2,6 +2,7 @@
 // $Id$
 
 #include "raytrace.h"
+#include "trace8.h"
 #include <filesystem_tools.h>
 #include <cmdlib.h>
 #include <stdio.h>
@@ -13,6 +14,13 @@ static bool SameSign(float a, float b)
 	return ((aa^bb)&0x80000000)==0;
 }
 
+int FirstRayDirectionSignMask(FourRays const &rays)
+{
+	return ((rays.direction.X(0)<0) ? 1 : 0)+
+		((rays.direction.Y(0)<0) ? 2 : 0)+
+		((rays.direction.Z(0)<0) ? 4 : 0);
+}
+
 int FourRays::CalculateDirectionSignMask(void) const
 {
 	// this code treats the floats as integers since all it cares about is the sign bit and
@@ -253,10 +261,6 @@ int CacheOptimizedTriangle::ClassifyAgainstAxisSplit(int split_plane, float spli
 	return PLANECHECK_STRADDLING;
 }
 
-#define MAILBOX_HASH_SIZE 256
-#define MAX_TREE_DEPTH 21
-#define MAX_NODE_STACK_LEN (40*MAX_TREE_DEPTH)
-
 struct NodeToVisit {
 	CacheOptimizedKDNode const *node;
 	fltx4 TMin;
@@ -265,7 +269,7 @@ struct NodeToVisit {
 
 
 static fltx4 FourEpsilons={1.0e-10,1.0e-10,1.0e-10,1.0e-10};
-static fltx4 FourZeros={1.0e-10,1.0e-10,1.0e-10,1.0e-10};
+static fltx4 FourZeros={1.0e-10,1.0e-10,1.0e-10,1.0e-10};	// not really zero, IntersectTriangle8 matches it
 static fltx4 FourNegativeEpsilons={-1.0e-10,-1.0e-10,-1.0e-10,-1.0e-10};
 
 static float BoxSurfaceArea(Vector const &boxmin, Vector const &boxmax)
@@ -274,12 +278,119 @@ static float BoxSurfaceArea(Vector const &boxmin, Vector const &boxmax)
 	return 2.0*((boxdim[0]*boxdim[2])+(boxdim[0]*boxdim[1])+(boxdim[1]*boxdim[2]));
 }
 
+// intersect four rays with one triangle, keeping the closest hit of each ray in rslt_out
+static FORCEINLINE void IntersectTriangle4( TriIntersectData_t const *tri, int32 tnum, const FourRays &rays,
+										   RayTracingResult *rslt_out, ITransparentTriangleCallback *pCallback )
+{
+	// compute plane intersection
+
+
+	FourVectors N;
+	N.x = ReplicateX4( tri->m_flNx );
+	N.y = ReplicateX4( tri->m_flNy );
+	N.z = ReplicateX4( tri->m_flNz );
+
+	fltx4 DDotN = rays.direction * N;
+	// mask off zero or near zero (ray parallel to surface)
+	fltx4 did_hit = OrSIMD( CmpGtSIMD( DDotN,FourEpsilons ),
+							CmpLtSIMD( DDotN, FourNegativeEpsilons ) );
+
+	fltx4 numerator=SubSIMD( ReplicateX4( tri->m_flD ), rays.origin * N );
+
+	fltx4 isect_t=DivSIMD( numerator,DDotN );
+	// now, we have the distance to the plane. lets update our mask
+	did_hit = AndSIMD( did_hit, CmpGtSIMD( isect_t, FourZeros ) );
+	//did_hit=AndSIMD(did_hit,CmpLtSIMD(isect_t,TMax));
+	did_hit = AndSIMD( did_hit, CmpLtSIMD( isect_t, rslt_out->HitDistance ) );
+
+	if ( ! IsAnyNegative( did_hit ) )
+		return;
+
+	// now, check 3 edges
+	fltx4 hitc1 = AddSIMD( rays.origin[tri->m_nCoordSelect0],
+						MulSIMD( isect_t, rays.direction[ tri->m_nCoordSelect0] ) );
+	fltx4 hitc2 = AddSIMD( rays.origin[tri->m_nCoordSelect1],
+						   MulSIMD( isect_t, rays.direction[tri->m_nCoordSelect1] ) );
+	
+	// do barycentric coordinate check
+	fltx4 B0 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[0] ), hitc1 );
+
+	B0 = AddSIMD(
+		B0,
+		MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[1] ), hitc2 ) );
+	B0 = AddSIMD(
+		B0, ReplicateX4( tri->m_ProjectedEdgeEquations[2] ) );
+
+	did_hit = AndSIMD( did_hit, CmpGeSIMD( B0, FourZeros ) );
+
+	fltx4 B1 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[3] ), hitc1 );
+	B1 = AddSIMD(
+		B1,
+		MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[4]), hitc2 ) );
+
+	B1 = AddSIMD(
+		B1, ReplicateX4( tri->m_ProjectedEdgeEquations[5] ) );
+	
+	did_hit = AndSIMD( did_hit, CmpGeSIMD( B1, FourZeros ) );
+
+	fltx4 B2 = AddSIMD( B1, B0 );
+	did_hit = AndSIMD( did_hit, CmpLeSIMD( B2, Four_Ones ) );
+
+	if ( ! IsAnyNegative( did_hit ) )
+		return;
+
+	// if the triangle is transparent
+	if ( tri->m_nFlags & FCACHETRI_TRANSPARENT )
+	{
+		if ( pCallback )
+		{
+			// assuming a triangle indexed as v0, v1, v2
+			// the projected edge equations are set up such that the vert opposite the first
+			// equation is v2, and the vert opposite the second equation is v0
+			// Therefore we pass them back in 1, 2, 0 order
+			// Also B2 is currently B1 + B0 and needs to be 1 - (B1+B0) in order to be a real
+			// barycentric coordinate.  Compute that now and pass it to the callback
+			fltx4 b2 = SubSIMD( Four_Ones, B2 );
+			if ( pCallback->VisitTriangle_ShouldContinue( *tri, rays, &did_hit, &B1, &b2, &B0, tnum ) )
+			{
+				did_hit = Four_Zeros;
+			}
+		}
+	}
+	// now, set the hit_id and closest_hit fields for any enabled rays
+	fltx4 replicated_n = ReplicateIX4(tnum);
+	StoreAlignedSIMD((float *) rslt_out->HitIds,
+				 OrSIMD(AndSIMD(replicated_n,did_hit),
+						   AndNotSIMD(did_hit,LoadAlignedSIMD(
+											 (float *) rslt_out->HitIds))));
+	rslt_out->HitDistance=OrSIMD(AndSIMD(isect_t,did_hit),
+					 AndNotSIMD(did_hit,rslt_out->HitDistance));
+
+	rslt_out->surface_normal.x=OrSIMD(
+		AndSIMD(N.x,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.x));
+	rslt_out->surface_normal.y=OrSIMD(
+		AndSIMD(N.y,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.y));
+	rslt_out->surface_normal.z=OrSIMD(
+		AndSIMD(N.z,did_hit),
+		AndNotSIMD(did_hit,rslt_out->surface_normal.z));
+}
+
 void RayTracingEnvironment::Trace4Rays(const FourRays &rays, fltx4 TMin, fltx4 TMax,
 									   RayTracingResult *rslt_out,
 									   int32 skip_id, ITransparentTriangleCallback *pCallback)
 {
 	int msk=rays.CalculateDirectionSignMask();
-	if (msk!=-1)
+	if (Flags & RTE_FLAGS_USE_BVH)
+	{
+		// the bvh can trace mixed direction signs as one packet. the mask only orders the
+		// children, so fall back on the first ray's signs.
+		if (msk==-1)
+			msk=FirstRayDirectionSignMask(rays);
+		Trace4RaysBVH(rays,TMin,TMax,msk,rslt_out,skip_id, pCallback);
+	}
+	else if (msk!=-1)
 		Trace4Rays(rays,TMin,TMax,msk,rslt_out,skip_id, pCallback);
 	else
 	{
@@ -346,6 +457,12 @@ void RayTracingEnvironment::Trace4Rays(const FourRays &rays, fltx4 TMin, fltx4 T
 									   int DirectionSignMask, RayTracingResult *rslt_out,
 									   int32 skip_id, ITransparentTriangleCallback *pCallback)
 {
+	if (Flags & RTE_FLAGS_USE_BVH)
+	{
+		Trace4RaysBVH(rays,TMin,TMax,DirectionSignMask,rslt_out,skip_id,pCallback);
+		return;
+	}
+
 	rays.Check();
 
 	memset(rslt_out->HitIds,0xff,sizeof(rslt_out->HitIds));
@@ -475,100 +592,7 @@ void RayTracingEnvironment::Trace4Rays(const FourRays &rays, fltx4 TMin, fltx4 T
 				if ( ( mailboxids[mbox_slot] != tnum ) && ( tri->m_nTriangleID != skip_id ) )
 				{
 					mailboxids[mbox_slot] = tnum;
-					// compute plane intersection
-
-
-					FourVectors N;
-					N.x = ReplicateX4( tri->m_flNx );
-					N.y = ReplicateX4( tri->m_flNy );
-					N.z = ReplicateX4( tri->m_flNz );
-
-					fltx4 DDotN = rays.direction * N;
-					// mask off zero or near zero (ray parallel to surface)
-					fltx4 did_hit = OrSIMD( CmpGtSIMD( DDotN,FourEpsilons ),
-											CmpLtSIMD( DDotN, FourNegativeEpsilons ) );
-
-					fltx4 numerator=SubSIMD( ReplicateX4( tri->m_flD ), rays.origin * N );
-
-					fltx4 isect_t=DivSIMD( numerator,DDotN );
-					// now, we have the distance to the plane. lets update our mask
-					did_hit = AndSIMD( did_hit, CmpGtSIMD( isect_t, FourZeros ) );
-					//did_hit=AndSIMD(did_hit,CmpLtSIMD(isect_t,TMax));
-					did_hit = AndSIMD( did_hit, CmpLtSIMD( isect_t, rslt_out->HitDistance ) );
-
-					if ( ! IsAnyNegative( did_hit ) )
-						continue;
-
-					// now, check 3 edges
-					fltx4 hitc1 = AddSIMD( rays.origin[tri->m_nCoordSelect0],
-										MulSIMD( isect_t, rays.direction[ tri->m_nCoordSelect0] ) );
-					fltx4 hitc2 = AddSIMD( rays.origin[tri->m_nCoordSelect1],
-										   MulSIMD( isect_t, rays.direction[tri->m_nCoordSelect1] ) );
-					
-					// do barycentric coordinate check
-					fltx4 B0 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[0] ), hitc1 );
-
-					B0 = AddSIMD(
-						B0,
-						MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[1] ), hitc2 ) );
-					B0 = AddSIMD(
-						B0, ReplicateX4( tri->m_ProjectedEdgeEquations[2] ) );
-
-					did_hit = AndSIMD( did_hit, CmpGeSIMD( B0, FourZeros ) );
-
-					fltx4 B1 = MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[3] ), hitc1 );
-					B1 = AddSIMD(
-						B1,
-						MulSIMD( ReplicateX4( tri->m_ProjectedEdgeEquations[4]), hitc2 ) );
-
-					B1 = AddSIMD(
-						B1, ReplicateX4( tri->m_ProjectedEdgeEquations[5] ) );
-					
-					did_hit = AndSIMD( did_hit, CmpGeSIMD( B1, FourZeros ) );
-
-					fltx4 B2 = AddSIMD( B1, B0 );
-					did_hit = AndSIMD( did_hit, CmpLeSIMD( B2, Four_Ones ) );
-
-					if ( ! IsAnyNegative( did_hit ) )
-						continue;
-
-					// if the triangle is transparent
-					if ( tri->m_nFlags & FCACHETRI_TRANSPARENT )
-					{
-						if ( pCallback )
-						{
-							// assuming a triangle indexed as v0, v1, v2
-							// the projected edge equations are set up such that the vert opposite the first
-							// equation is v2, and the vert opposite the second equation is v0
-							// Therefore we pass them back in 1, 2, 0 order
-							// Also B2 is currently B1 + B0 and needs to be 1 - (B1+B0) in order to be a real
-							// barycentric coordinate.  Compute that now and pass it to the callback
-							fltx4 b2 = SubSIMD( Four_Ones, B2 );
-							if ( pCallback->VisitTriangle_ShouldContinue( *tri, rays, &did_hit, &B1, &b2, &B0, tnum ) )
-							{
-								did_hit = Four_Zeros;
-							}
-						}
-					}
-					// now, set the hit_id and closest_hit fields for any enabled rays
-					fltx4 replicated_n = ReplicateIX4(tnum);
-					StoreAlignedSIMD((float *) rslt_out->HitIds,
-								 OrSIMD(AndSIMD(replicated_n,did_hit),
-										   AndNotSIMD(did_hit,LoadAlignedSIMD(
-															 (float *) rslt_out->HitIds))));
-					rslt_out->HitDistance=OrSIMD(AndSIMD(isect_t,did_hit),
-									 AndNotSIMD(did_hit,rslt_out->HitDistance));
-
-					rslt_out->surface_normal.x=OrSIMD(
-						AndSIMD(N.x,did_hit),
-						AndNotSIMD(did_hit,rslt_out->surface_normal.x));
-					rslt_out->surface_normal.y=OrSIMD(
-						AndSIMD(N.y,did_hit),
-						AndNotSIMD(did_hit,rslt_out->surface_normal.y));
-					rslt_out->surface_normal.z=OrSIMD(
-						AndSIMD(N.z,did_hit),
-						AndNotSIMD(did_hit,rslt_out->surface_normal.z));
-					
+					IntersectTriangle4( tri, tnum, rays, rslt_out, pCallback );
 				}
 			} while (--ntris);
 			// now, check if all rays have terminated
@@ -592,6 +616,72 @@ void RayTracingEnvironment::Trace4Rays(const FourRays &rays, fltx4 TMin, fltx4 T
 }
 
 
+void RayTracingEnvironment::Trace4RaysBVH(const FourRays &rays, fltx4 TMin, fltx4 TMax,
+										  int DirectionSignMask, RayTracingResult *rslt_out,
+										  int32 skip_id, ITransparentTriangleCallback *pCallback)
+{
+	memset(rslt_out->HitIds,0xff,sizeof(rslt_out->HitIds));
+
+	rslt_out->HitDistance=ReplicateX4(1.0e23);
+
+	rslt_out->surface_normal.DuplicateVector(Vector(0.,0.,0.));
+	FourVectors OneOverRayDir=rays.direction;
+	OneOverRayDir.MakeReciprocalSaturate();
+
+	if (! OptimizedBVH.Count())
+		return;
+
+	// children are visited nearest first along the split axis, so no per node sort is needed.
+	// the builder limits the depth, and each level pushes at most one node.
+	int NodeStack[BVH_MAX_DEPTH+1];
+	int stack_len=0;
+	int node_number=0;
+	while(1)
+	{
+		CacheOptimizedBVHNode const &node=OptimizedBVH[node_number];
+
+		// slab test against the node's box. rays stop at the closest hit found so far, so
+		// boxes entirely behind it are skipped
+		fltx4 tnear=TMin;
+		fltx4 tfar=MinSIMD(TMax,rslt_out->HitDistance);
+		for(int c=0;c<3;c++)
+		{
+			fltx4 isect_min_t=
+				MulSIMD(SubSIMD(ReplicateX4(node.m_flMins[c]),rays.origin[c]),OneOverRayDir[c]);
+			fltx4 isect_max_t=
+				MulSIMD(SubSIMD(ReplicateX4(node.m_flMaxs[c]),rays.origin[c]),OneOverRayDir[c]);
+			tnear=MaxSIMD(tnear,MinSIMD(isect_min_t,isect_max_t));
+			tfar=MinSIMD(tfar,MaxSIMD(isect_min_t,isect_max_t));
+		}
+		if (IsAnyNegative(CmpLeSIMD(tnear,tfar)))
+		{
+			if (! node.IsLeaf())
+			{
+				int near_side=(DirectionSignMask>>node.SplitAxis()) & 1;
+				assert(stack_len<=BVH_MAX_DEPTH);
+				NodeStack[stack_len++]=node.LeftChild()+(near_side ^ 1);
+				node_number=node.LeftChild()+near_side;
+				continue;
+			}
+
+			// leaf. triangles are only ever in one leaf, so no mailboxing
+			int32 const *tlist=TriangleIndexList.Base()+node.TriangleIndexStart();
+			for(int ntris=node.NumberOfTrianglesInLeaf();ntris;ntris--)
+			{
+				int tnum=*(tlist++);
+				TriIntersectData_t const *tri = &( OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+				if ( tri->m_nTriangleID != skip_id )
+					IntersectTriangle4( tri, tnum, rays, rslt_out, pCallback );
+			}
+		}
+
+		if (! stack_len)
+			return;
+		node_number=NodeStack[--stack_len];
+	}
+}
+
+
 int RayTracingEnvironment::MakeLeafNode(int first_tri, int last_tri)
 {
 	CacheOptimizedKDNode ret;
@@ -869,17 +959,223 @@ void RayTracingEnvironment::RefineNode(int node_number,int32 const *tri_list,int
 }
 
 
-void RayTracingEnvironment::SetupAccelerationStructure(void)
+// The bvh uses the same surface area heuristic, but partitions triangles instead of space: each
+// triangle goes to exactly one side, by its bounding box center, and the two children are
+// bounded by what they hold. Candidate splits are the boundaries between BVH_NUM_BINS equal
+// slices of the range of centers on each axis, which makes building roughly linear per level.
+
+#define BVH_NUM_BINS 16
+#define BVH_MAX_LEAF_TRIS 16								// split past this even if the sah
+															// says not to
+
+struct BVHBin_t
+{
+	Vector m_Mins;
+	Vector m_Maxs;
+	int m_nTris;
+};
+
+static void ClearBVHBin(BVHBin_t &bin)
+{
+	bin.m_Mins=Vector( 1.0e23, 1.0e23, 1.0e23);
+	bin.m_Maxs=Vector( -1.0e23, -1.0e23, -1.0e23);
+	bin.m_nTris=0;
+}
+
+static void AddToBVHBin(BVHBin_t &bin, Vector const &mins, Vector const &maxs, int ntris)
+{
+	VectorMin(bin.m_Mins,mins,bin.m_Mins);
+	VectorMax(bin.m_Maxs,maxs,bin.m_Maxs);
+	bin.m_nTris+=ntris;
+}
+
+static int BVHBinForCenter(float center, float min_center, float bin_scale)
+{
+	int bin=(int) ((center-min_center)*bin_scale);
+	return clamp(bin,0,BVH_NUM_BINS-1);
+}
+
+void RayTracingEnvironment::RefineBVHNode(int node_number,int32 *tri_list,int ntris,
+										  Vector const *tri_mins, Vector const *tri_maxs,
+										  Vector const *tri_centers, int depth)
+{
+	BVHBin_t bounds, center_bounds;
+	ClearBVHBin(bounds);
+	ClearBVHBin(center_bounds);
+	for(int t=0;t<ntris;t++)
+	{
+		AddToBVHBin(bounds,tri_mins[tri_list[t]],tri_maxs[tri_list[t]],1);
+		AddToBVHBin(center_bounds,tri_centers[tri_list[t]],tri_centers[tri_list[t]],1);
+	}
+
+	for(int c=0;c<3;c++)
+	{
+		OptimizedBVH[node_number].m_flMins[c]=bounds.m_Mins[c];
+		OptimizedBVH[node_number].m_flMaxs[c]=bounds.m_Maxs[c];
+	}
+
+	// find the cheapest bin boundary over all 3 axes
+	float best_cost=1.0e23;
+	int best_axis=-1;
+	int best_bin=0;
+	if ( (ntris>2) && (depth<BVH_MAX_DEPTH) )
+	{
+		float ISA=1.0/MAX(BoxSurfaceArea(bounds.m_Mins,bounds.m_Maxs),1.0e-10);
+		for(int axis=0;axis<3;axis++)
+		{
+			float extent=center_bounds.m_Maxs[axis]-center_bounds.m_Mins[axis];
+			if (extent<=0)
+				continue;							// all centers on one plane
+			float bin_scale=BVH_NUM_BINS*(1.0-1.0e-5)/extent;
+
+			BVHBin_t bins[BVH_NUM_BINS];
+			for(int b=0;b<BVH_NUM_BINS;b++)
+				ClearBVHBin(bins[b]);
+			for(int t=0;t<ntris;t++)
+			{
+				int tnum=tri_list[t];
+				int b=BVHBinForCenter(tri_centers[tnum][axis],center_bounds.m_Mins[axis],bin_scale);
+				AddToBVHBin(bins[b],tri_mins[tnum],tri_maxs[tnum],1);
+			}
+
+			// sweep from the right to get the cost of everything above each boundary, then
+			// from the left to finish the sum
+			float right_cost[BVH_NUM_BINS];
+			BVHBin_t right;
+			ClearBVHBin(right);
+			for(int b=BVH_NUM_BINS-1;b>0;b--)
+			{
+				AddToBVHBin(right,bins[b].m_Mins,bins[b].m_Maxs,bins[b].m_nTris);
+				right_cost[b]=right.m_nTris ? BoxSurfaceArea(right.m_Mins,right.m_Maxs)*right.m_nTris : 0;
+			}
+			BVHBin_t left;
+			ClearBVHBin(left);
+			for(int b=1;b<BVH_NUM_BINS;b++)
+			{
+				AddToBVHBin(left,bins[b-1].m_Mins,bins[b-1].m_Maxs,bins[b-1].m_nTris);
+				if ( (left.m_nTris==0) || (left.m_nTris==ntris) )
+					continue;
+				float trial_cost=COST_OF_TRAVERSAL+COST_OF_INTERSECTION*ISA*
+					(BoxSurfaceArea(left.m_Mins,left.m_Maxs)*left.m_nTris+right_cost[b]);
+				if (trial_cost<best_cost)
+				{
+					best_cost=trial_cost;
+					best_axis=axis;
+					best_bin=b;
+				}
+			}
+		}
+	}
+
+	float cost_of_no_split=COST_OF_INTERSECTION*ntris;
+	bool must_split=(ntris>BVH_MAX_LEAF_TRIS) && (depth<BVH_MAX_DEPTH);
+	if ( (!must_split) && ( (best_axis==-1) || (cost_of_no_split<=best_cost) ) )
+	{
+		OptimizedBVH[node_number].m_nChildOrFirstTri=TriangleIndexList.Count();
+		OptimizedBVH[node_number].m_nTriCountOrAxis=ntris;
+		for(int t=0;t<ntris;t++)
+			TriangleIndexList.AddToTail(tri_list[t]);
+		return;
+	}
+
+	// partition the list in place. when the centers are too close together to bin, just cut
+	// the list in half.
+	int nleft;
+	if (best_axis==-1)
+	{
+		best_axis=0;
+		nleft=ntris/2;
+	}
+	else
+	{
+		float bin_scale=BVH_NUM_BINS*(1.0-1.0e-5)/
+			(center_bounds.m_Maxs[best_axis]-center_bounds.m_Mins[best_axis]);
+		nleft=0;
+		int nright=ntris;
+		while(nleft<nright)
+		{
+			int tnum=tri_list[nleft];
+			if (BVHBinForCenter(tri_centers[tnum][best_axis],center_bounds.m_Mins[best_axis],
+								bin_scale) < best_bin)
+				nleft++;
+			else
+			{
+				tri_list[nleft]=tri_list[--nright];
+				tri_list[nright]=tnum;
+			}
+		}
+	}
+
+	int left_child=OptimizedBVH.Count();
+	OptimizedBVH[node_number].m_nChildOrFirstTri=left_child;
+	OptimizedBVH[node_number].m_nTriCountOrAxis=-1-best_axis;
+	CacheOptimizedBVHNode newnode;
+	OptimizedBVH.AddToTail(newnode);
+	OptimizedBVH.AddToTail(newnode);
+	RefineBVHNode(left_child,tri_list,nleft,tri_mins,tri_maxs,tri_centers,depth+1);
+	RefineBVHNode(left_child+1,tri_list+nleft,ntris-nleft,tri_mins,tri_maxs,tri_centers,depth+1);
+}
+
+void RayTracingEnvironment::BuildBVH(void)
 {
-	CacheOptimizedKDNode root{};
-	OptimizedKDTree.AddToTail(root);
-	int32 *root_triangle_list=new int32[OptimizedTriangleList.Count()];
-	for(int t=0;t<OptimizedTriangleList.Count();t++)
+	int ntris=OptimizedTriangleList.Count();
+	Vector *tri_mins=new Vector[ntris];
+	Vector *tri_maxs=new Vector[ntris];
+	Vector *tri_centers=new Vector[ntris];
+	int32 *root_triangle_list=new int32[ntris];
+	for(int t=0;t<ntris;t++)
+	{
+		CacheOptimizedTriangle const &tri=OptimizedTriangleList[t];
+		tri_mins[t]=tri.Vertex(0);
+		tri_maxs[t]=tri.Vertex(0);
+		for(int v=1;v<3;v++)
+		{
+			VectorMin(tri_mins[t],tri.Vertex(v),tri_mins[t]);
+			VectorMax(tri_maxs[t],tri.Vertex(v),tri_maxs[t]);
+		}
+		tri_centers[t]=0.5*(tri_mins[t]+tri_maxs[t]);
 		root_triangle_list[t]=t;
-	CalculateTriangleListBounds(root_triangle_list,OptimizedTriangleList.Count(),m_MinBound,
-								m_MaxBound);
-	RefineNode(0,root_triangle_list,OptimizedTriangleList.Count(),m_MinBound,m_MaxBound,0);
+	}
+
+	OptimizedBVH.EnsureCapacity(2*(1+ntris/2));
+	TriangleIndexList.EnsureCapacity(ntris);
+	CacheOptimizedBVHNode root;
+	OptimizedBVH.AddToTail(root);
+	RefineBVHNode(0,root_triangle_list,ntris,tri_mins,tri_maxs,tri_centers,0);
+
+	for(int c=0;c<3;c++)
+	{
+		m_MinBound[c]=OptimizedBVH[0].m_flMins[c];
+		m_MaxBound[c]=OptimizedBVH[0].m_flMaxs[c];
+	}
+
 	delete[] root_triangle_list;
+	delete[] tri_centers;
+	delete[] tri_maxs;
+	delete[] tri_mins;
+}
+
+
+void RayTracingEnvironment::SetupAccelerationStructure(void)
+{
+	m_bTrace8AVX=(! (Flags & RTE_FLAGS_DISABLE_AVX)) && Trace8RaysAVXAvailable();
+
+	if (Flags & RTE_FLAGS_USE_BVH)
+	{
+		BuildBVH();
+	}
+	else
+	{
+		CacheOptimizedKDNode root{};
+		OptimizedKDTree.AddToTail(root);
+		int32 *root_triangle_list=new int32[OptimizedTriangleList.Count()];
+		for(int t=0;t<OptimizedTriangleList.Count();t++)
+			root_triangle_list[t]=t;
+		CalculateTriangleListBounds(root_triangle_list,OptimizedTriangleList.Count(),m_MinBound,
+									m_MaxBound);
+		RefineNode(0,root_triangle_list,OptimizedTriangleList.Count(),m_MinBound,m_MaxBound,0);
+		delete[] root_triangle_list;
+	}
 
 	// now, convert all triangles to "intersection format"
 	for(int i=0;i<OptimizedTriangleList.Count();i++)
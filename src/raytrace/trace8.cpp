@@ -0,0 +1,113 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id$
+//
+// Eight ray packets. The SSE path keeps the packet as two fltx4 halves; trace8_avx.cpp builds the
+// same traversal with 256 bit registers.
+
+#include "raytrace.h"
+#include "trace8.h"
+#include "trace8_packet.h"
+
+// two fltx4s acting as one eight wide register
+struct Packet8SSE
+{
+	struct V
+	{
+		fltx4 m_Lo;
+		fltx4 m_Hi;
+	};
+
+	static FORCEINLINE V Combine( fltx4 lo, fltx4 hi )
+	{
+		V ret;
+		ret.m_Lo = lo;
+		ret.m_Hi = hi;
+		return ret;
+	}
+	static FORCEINLINE fltx4 Half( const V &a, int half )
+	{
+		return half ? a.m_Hi : a.m_Lo;
+	}
+	static FORCEINLINE V Replicate( float f )
+	{
+		fltx4 r = ReplicateX4( f );
+		return Combine( r, r );
+	}
+	static FORCEINLINE V ReplicateI( int32 i )
+	{
+		fltx4 r = ReplicateIX4( i );
+		return Combine( r, r );
+	}
+
+#define PACKET8SSE_OP( name, simd )												\
+	static FORCEINLINE V name( const V &a, const V &b )							\
+	{																			\
+		return Combine( simd( a.m_Lo, b.m_Lo ), simd( a.m_Hi, b.m_Hi ) );		\
+	}
+
+	PACKET8SSE_OP( Add, AddSIMD )
+	PACKET8SSE_OP( Sub, SubSIMD )
+	PACKET8SSE_OP( Mul, MulSIMD )
+	PACKET8SSE_OP( Div, DivSIMD )
+	PACKET8SSE_OP( Min, MinSIMD )
+	PACKET8SSE_OP( Max, MaxSIMD )
+	PACKET8SSE_OP( And, AndSIMD )
+	PACKET8SSE_OP( AndNot, AndNotSIMD )
+	PACKET8SSE_OP( Or, OrSIMD )
+	PACKET8SSE_OP( CmpLe, CmpLeSIMD )
+	PACKET8SSE_OP( CmpLt, CmpLtSIMD )
+	PACKET8SSE_OP( CmpGe, CmpGeSIMD )
+	PACKET8SSE_OP( CmpGt, CmpGtSIMD )
+
+#undef PACKET8SSE_OP
+
+	static FORCEINLINE bool IsAnyNegative( const V &a )
+	{
+		return ::IsAnyNegative( OrSIMD( a.m_Lo, a.m_Hi ) );
+	}
+};
+
+void Trace8RaysSSE( RayTracingEnvironment &env, const EightRays &rays,
+				    const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+				    RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	Trace8RaysPacket<Packet8SSE>( env, rays, TMin, TMax, DirectionSignMask, rslt_out, skip_id, pCallback );
+}
+
+int EightRays::CalculateDirectionSignMask(void) const
+{
+	int msk=m_Rays[0].CalculateDirectionSignMask();
+	if ( (msk == -1) || (m_Rays[1].CalculateDirectionSignMask() != msk) )
+		return -1;
+	return msk;
+}
+
+void RayTracingEnvironment::Trace8Rays(const EightRays &rays, const fltx4 TMin[2], const fltx4 TMax[2],
+									   int DirectionSignMask, RayTracingResult *rslt_out,
+									   int32 skip_id, ITransparentTriangleCallback *pCallback)
+{
+	if (m_bTrace8AVX)
+		Trace8RaysAVX(*this,rays,TMin,TMax,DirectionSignMask,rslt_out,skip_id,pCallback);
+	else
+		Trace8RaysSSE(*this,rays,TMin,TMax,DirectionSignMask,rslt_out,skip_id,pCallback);
+}
+
+void RayTracingEnvironment::Trace8Rays(const EightRays &rays, const fltx4 TMin[2], const fltx4 TMax[2],
+									   RayTracingResult *rslt_out,
+									   int32 skip_id, ITransparentTriangleCallback *pCallback)
+{
+	int msk=rays.CalculateDirectionSignMask();
+	if (msk!=-1)
+		Trace8Rays(rays,TMin,TMax,msk,rslt_out,skip_id,pCallback);
+	else if (Flags & RTE_FLAGS_USE_BVH)
+	{
+		// the bvh only uses the mask to order children
+		Trace8Rays(rays,TMin,TMax,FirstRayDirectionSignMask(rays.m_Rays[0]),rslt_out,skip_id,pCallback);
+	}
+	else
+	{
+		// the halves disagree, so the kd-tree has to walk them separately
+		Trace4Rays(rays.m_Rays[0],TMin[0],TMax[0],rslt_out,skip_id,pCallback);
+		Trace4Rays(rays.m_Rays[1],TMin[1],TMax[1],rslt_out+1,skip_id,pCallback);
+	}
+}
@@ -0,0 +1,36 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id$
+//
+// Internal to the raytrace library: limits shared by the traversal loops, and the per
+// instruction set entry points behind RayTracingEnvironment::Trace8Rays.
+
+#ifndef TRACE8_H
+#define TRACE8_H
+
+#include "raytrace.h"
+
+#define MAILBOX_HASH_SIZE 256
+#define MAX_TREE_DEPTH 21
+#define MAX_NODE_STACK_LEN (40*MAX_TREE_DEPTH)
+
+#define BVH_MAX_DEPTH 64
+
+// the AVX path is compiled with a per function target, so it only needs an x86 compiler
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#define RAYTRACE_AVX 1
+#endif
+
+// sign mask of ray 0, used to order children when a packet's signs differ
+int FirstRayDirectionSignMask(FourRays const &rays);
+
+bool Trace8RaysAVXAvailable(void);
+
+void Trace8RaysSSE(RayTracingEnvironment &env, const EightRays &rays,
+				   const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+				   RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback);
+
+void Trace8RaysAVX(RayTracingEnvironment &env, const EightRays &rays,
+				   const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+				   RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback);
+
+#endif
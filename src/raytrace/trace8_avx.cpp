@@ -0,0 +1,92 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id$
+//
+// AVX build of the eight ray packet traversal. Only the functions in this file are compiled for
+// AVX, so the rest of the library still runs on any SSE2 cpu; RayTracingEnvironment only calls
+// in here when the cpu reports AVX support.
+
+#include "raytrace.h"
+#include "trace8.h"
+#include "tier0/platform.h"
+
+#ifdef RAYTRACE_AVX
+
+#include <immintrin.h>
+
+#if defined( __clang__ )
+#pragma clang attribute push( __attribute__(( target( "avx" ) )), apply_to = function )
+#elif defined( __GNUC__ )
+#pragma GCC push_options
+#pragma GCC target( "avx" )
+#endif
+
+struct Packet8AVX
+{
+	typedef __m256 V;
+
+	static FORCEINLINE V Combine( fltx4 lo, fltx4 hi )
+	{
+		return _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+	}
+	static FORCEINLINE fltx4 Half( V a, int half )
+	{
+		return half ? _mm256_extractf128_ps( a, 1 ) : _mm256_castps256_ps128( a );
+	}
+	static FORCEINLINE V Replicate( float f )		{ return _mm256_set1_ps( f ); }
+	static FORCEINLINE V ReplicateI( int32 i )		{ return _mm256_castsi256_ps( _mm256_set1_epi32( i ) ); }
+
+	static FORCEINLINE V Add( V a, V b )			{ return _mm256_add_ps( a, b ); }
+	static FORCEINLINE V Sub( V a, V b )			{ return _mm256_sub_ps( a, b ); }
+	static FORCEINLINE V Mul( V a, V b )			{ return _mm256_mul_ps( a, b ); }
+	static FORCEINLINE V Div( V a, V b )			{ return _mm256_div_ps( a, b ); }
+	static FORCEINLINE V Min( V a, V b )			{ return _mm256_min_ps( a, b ); }
+	static FORCEINLINE V Max( V a, V b )			{ return _mm256_max_ps( a, b ); }
+	static FORCEINLINE V And( V a, V b )			{ return _mm256_and_ps( a, b ); }
+	static FORCEINLINE V AndNot( V a, V b )			{ return _mm256_andnot_ps( a, b ); }	// ~a & b
+	static FORCEINLINE V Or( V a, V b )				{ return _mm256_or_ps( a, b ); }
+	static FORCEINLINE V CmpLe( V a, V b )			{ return _mm256_cmp_ps( a, b, _CMP_LE_OQ ); }
+	static FORCEINLINE V CmpLt( V a, V b )			{ return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+	static FORCEINLINE V CmpGe( V a, V b )			{ return _mm256_cmp_ps( a, b, _CMP_GE_OQ ); }
+	static FORCEINLINE V CmpGt( V a, V b )			{ return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+
+	static FORCEINLINE bool IsAnyNegative( V a )	{ return _mm256_movemask_ps( a ) != 0; }
+};
+
+#include "trace8_packet.h"
+
+void Trace8RaysAVX( RayTracingEnvironment &env, const EightRays &rays,
+				    const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+				    RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	Trace8RaysPacket<Packet8AVX>( env, rays, TMin, TMax, DirectionSignMask, rslt_out, skip_id, pCallback );
+
+	// avoid the sse/avx transition penalty in whatever sse code runs next
+	_mm256_zeroupper();
+}
+
+#if defined( __clang__ )
+#pragma clang attribute pop
+#elif defined( __GNUC__ )
+#pragma GCC pop_options
+#endif
+
+bool Trace8RaysAVXAvailable(void)
+{
+	return GetCPUInformation()->m_bAVX;
+}
+
+#else // RAYTRACE_AVX
+
+void Trace8RaysAVX( RayTracingEnvironment &env, const EightRays &rays,
+				    const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+				    RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	Trace8RaysSSE( env, rays, TMin, TMax, DirectionSignMask, rslt_out, skip_id, pCallback );
+}
+
+bool Trace8RaysAVXAvailable(void)
+{
+	return false;
+}
+
+#endif // RAYTRACE_AVX
@@ -0,0 +1,350 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+// $Id$
+//
+// Eight ray packet traversal, written once against a packet type P and included by both the
+// SSE and AVX builds of Trace8Rays. P provides:
+//
+//   typedef ... V;								8 floats
+//   V Combine(fltx4 lo, fltx4 hi), fltx4 Half(V, int half)
+//   V Replicate(float), V ReplicateI(int32)
+//   Add, Sub, Mul, Div, Min, Max, And, AndNot, Or, CmpLe, CmpLt, CmpGe, CmpGt
+//   bool IsAnyNegative(V)
+//
+// Everything here is static or a template over P, so the AVX translation unit never shares an
+// out of line copy of a function with the SSE one.
+//
+// The loops mirror Trace4Rays and Trace4RaysBVH; the only difference is that the decisions
+// about which nodes to visit are made for all eight rays at once.
+
+#ifndef TRACE8_PACKET_H
+#define TRACE8_PACKET_H
+
+template<class P> struct Rays8_t
+{
+	typename P::V m_Origin[3];
+	typename P::V m_Direction[3];
+	typename P::V m_OneOverDirection[3];
+};
+
+template<class P> struct Hits8_t
+{
+	typename P::V m_HitIds;									// triangle indices, as float bits
+	typename P::V m_HitDistance;
+	typename P::V m_Normal[3];
+};
+
+template<class P> struct NodeToVisit8_t
+{
+	CacheOptimizedKDNode const *node;
+	typename P::V TMin;
+	typename P::V TMax;
+};
+
+template<class P> static FORCEINLINE void SetupRays8( const EightRays &rays, Rays8_t<P> &out )
+{
+	FourVectors OneOverRayDir[2];
+	for ( int h = 0; h < 2; h++ )
+	{
+		OneOverRayDir[h] = rays.m_Rays[h].direction;
+		OneOverRayDir[h].MakeReciprocalSaturate();
+	}
+	for ( int c = 0; c < 3; c++ )
+	{
+		out.m_Origin[c] = P::Combine( rays.m_Rays[0].origin[c], rays.m_Rays[1].origin[c] );
+		out.m_Direction[c] = P::Combine( rays.m_Rays[0].direction[c], rays.m_Rays[1].direction[c] );
+		out.m_OneOverDirection[c] = P::Combine( OneOverRayDir[0][c], OneOverRayDir[1][c] );
+	}
+}
+
+template<class P> static FORCEINLINE void InitHits8( Hits8_t<P> &hits )
+{
+	hits.m_HitIds = P::ReplicateI( -1 );
+	hits.m_HitDistance = P::Replicate( 1.0e23 );
+	for ( int c = 0; c < 3; c++ )
+		hits.m_Normal[c] = P::Replicate( 0.0 );
+}
+
+template<class P> static FORCEINLINE void StoreHits8( const Hits8_t<P> &hits, RayTracingResult *rslt_out )
+{
+	for ( int h = 0; h < 2; h++ )
+	{
+		StoreAlignedSIMD( (float *) rslt_out[h].HitIds, P::Half( hits.m_HitIds, h ) );
+		rslt_out[h].HitDistance = P::Half( hits.m_HitDistance, h );
+		rslt_out[h].surface_normal.x = P::Half( hits.m_Normal[0], h );
+		rslt_out[h].surface_normal.y = P::Half( hits.m_Normal[1], h );
+		rslt_out[h].surface_normal.z = P::Half( hits.m_Normal[2], h );
+	}
+}
+
+// intersect eight rays with one triangle, keeping the closest hit of each ray. Same math as
+// IntersectTriangle4.
+template<class P> static FORCEINLINE void IntersectTriangle8( TriIntersectData_t const *tri, int32 tnum,
+															 const EightRays &rays, const Rays8_t<P> &r,
+															 Hits8_t<P> &hits, ITransparentTriangleCallback *pCallback )
+{
+	typedef typename P::V V;
+
+	const V Epsilons = P::Replicate( 1.0e-10 );
+	const V NegativeEpsilons = P::Replicate( -1.0e-10 );
+	// The distance and edge tests compare against IntersectTriangle4's FourZeros, which is
+	// 1e-10 rather than 0. Using the same value keeps hits identical to Trace4Rays.
+	const V Zeros = P::Replicate( 1.0e-10 );
+
+	V N[3];
+	N[0] = P::Replicate( tri->m_flNx );
+	N[1] = P::Replicate( tri->m_flNy );
+	N[2] = P::Replicate( tri->m_flNz );
+
+	V DDotN = P::Add( P::Add( P::Mul( r.m_Direction[0], N[0] ), P::Mul( r.m_Direction[1], N[1] ) ),
+					  P::Mul( r.m_Direction[2], N[2] ) );
+	// mask off zero or near zero (ray parallel to surface)
+	V did_hit = P::Or( P::CmpGt( DDotN, Epsilons ), P::CmpLt( DDotN, NegativeEpsilons ) );
+
+	V ODotN = P::Add( P::Add( P::Mul( r.m_Origin[0], N[0] ), P::Mul( r.m_Origin[1], N[1] ) ),
+					  P::Mul( r.m_Origin[2], N[2] ) );
+	V isect_t = P::Div( P::Sub( P::Replicate( tri->m_flD ), ODotN ), DDotN );
+
+	did_hit = P::And( did_hit, P::CmpGt( isect_t, Zeros ) );
+	did_hit = P::And( did_hit, P::CmpLt( isect_t, hits.m_HitDistance ) );
+
+	if ( ! P::IsAnyNegative( did_hit ) )
+		return;
+
+	// now, check 3 edges
+	V hitc1 = P::Add( r.m_Origin[tri->m_nCoordSelect0], P::Mul( isect_t, r.m_Direction[tri->m_nCoordSelect0] ) );
+	V hitc2 = P::Add( r.m_Origin[tri->m_nCoordSelect1], P::Mul( isect_t, r.m_Direction[tri->m_nCoordSelect1] ) );
+
+	V B0 = P::Add( P::Add( P::Mul( P::Replicate( tri->m_ProjectedEdgeEquations[0] ), hitc1 ),
+						   P::Mul( P::Replicate( tri->m_ProjectedEdgeEquations[1] ), hitc2 ) ),
+				   P::Replicate( tri->m_ProjectedEdgeEquations[2] ) );
+	did_hit = P::And( did_hit, P::CmpGe( B0, Zeros ) );
+
+	V B1 = P::Add( P::Add( P::Mul( P::Replicate( tri->m_ProjectedEdgeEquations[3] ), hitc1 ),
+						   P::Mul( P::Replicate( tri->m_ProjectedEdgeEquations[4] ), hitc2 ) ),
+				   P::Replicate( tri->m_ProjectedEdgeEquations[5] ) );
+	did_hit = P::And( did_hit, P::CmpGe( B1, Zeros ) );
+
+	V B2 = P::Add( B1, B0 );
+	did_hit = P::And( did_hit, P::CmpLe( B2, P::Replicate( 1.0 ) ) );
+
+	if ( ! P::IsAnyNegative( did_hit ) )
+		return;
+
+	// the callback interface is four wide, so hand it each half that hit. See
+	// IntersectTriangle4 for the barycentric ordering.
+	if ( ( tri->m_nFlags & FCACHETRI_TRANSPARENT ) && pCallback )
+	{
+		fltx4 half_hit[2];
+		for ( int h = 0; h < 2; h++ )
+		{
+			half_hit[h] = P::Half( did_hit, h );
+			if ( ! IsAnyNegative( half_hit[h] ) )
+				continue;
+
+			fltx4 b0 = P::Half( B0, h );
+			fltx4 b1 = P::Half( B1, h );
+			fltx4 b2 = SubSIMD( Four_Ones, P::Half( B2, h ) );
+			if ( pCallback->VisitTriangle_ShouldContinue( *tri, rays.m_Rays[h], &half_hit[h], &b1, &b2, &b0, tnum ) )
+			{
+				half_hit[h] = Four_Zeros;
+			}
+		}
+		did_hit = P::Combine( half_hit[0], half_hit[1] );
+	}
+
+	// now, set the hit_id and closest_hit fields for any enabled rays
+	hits.m_HitIds = P::Or( P::And( P::ReplicateI( tnum ), did_hit ), P::AndNot( did_hit, hits.m_HitIds ) );
+	hits.m_HitDistance = P::Or( P::And( isect_t, did_hit ), P::AndNot( did_hit, hits.m_HitDistance ) );
+	for ( int c = 0; c < 3; c++ )
+	{
+		hits.m_Normal[c] = P::Or( P::And( N[c], did_hit ), P::AndNot( did_hit, hits.m_Normal[c] ) );
+	}
+}
+
+template<class P> static void TraceKDTree8( RayTracingEnvironment &env, const EightRays &rays, const Rays8_t<P> &r,
+										   typename P::V TMin, typename P::V TMax, int DirectionSignMask,
+										   Hits8_t<P> &hits, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	typedef typename P::V V;
+
+	// now, clip rays against bounding box
+	for ( int c = 0; c < 3; c++ )
+	{
+		V isect_min_t = P::Mul( P::Sub( P::Replicate( env.m_MinBound[c] ), r.m_Origin[c] ), r.m_OneOverDirection[c] );
+		V isect_max_t = P::Mul( P::Sub( P::Replicate( env.m_MaxBound[c] ), r.m_Origin[c] ), r.m_OneOverDirection[c] );
+		TMin = P::Max( TMin, P::Min( isect_min_t, isect_max_t ) );
+		TMax = P::Min( TMax, P::Max( isect_min_t, isect_max_t ) );
+	}
+	V active = P::CmpLe( TMin, TMax );						// mask of which rays are active
+	if ( ! P::IsAnyNegative( active ) )
+		return;												// missed bounding box
+
+	int32 mailboxids[MAILBOX_HASH_SIZE];					// used to avoid redundant triangle tests
+	memset( mailboxids, 0xff, sizeof( mailboxids ) );
+
+	// based on ray direction, whether to visit left or right node first
+	int front_idx[3], back_idx[3];
+	for ( int c = 0; c < 3; c++ )
+	{
+		front_idx[c] = ( DirectionSignMask >> c ) & 1;
+		back_idx[c] = front_idx[c] ^ 1;
+	}
+
+	NodeToVisit8_t<P> NodeQueue[MAX_NODE_STACK_LEN];
+	CacheOptimizedKDNode const *CurNode = &( env.OptimizedKDTree[0] );
+	NodeToVisit8_t<P> *stack_ptr = &NodeQueue[MAX_NODE_STACK_LEN];
+	while ( 1 )
+	{
+		while ( CurNode->NodeType() != KDNODE_STATE_LEAF )	// traverse until next leaf
+		{
+			int split_plane_number = CurNode->NodeType();
+			CacheOptimizedKDNode const *FrontChild = &( env.OptimizedKDTree[CurNode->LeftChild()] );
+
+			V dist_to_sep_plane =							// dist=(split-org)/dir
+				P::Mul( P::Sub( P::Replicate( CurNode->SplittingPlaneValue ), r.m_Origin[split_plane_number] ),
+						r.m_OneOverDirection[split_plane_number] );
+			active = P::CmpLe( TMin, TMax );
+
+			// now, decide how to traverse children. can either do front,back, or do front and push
+			// back.
+			V hits_front = P::And( active, P::CmpGe( dist_to_sep_plane, TMin ) );
+			if ( ! P::IsAnyNegative( hits_front ) )
+			{
+				// missed the front. only traverse back
+				CurNode = FrontChild + back_idx[split_plane_number];
+				TMin = P::Max( TMin, dist_to_sep_plane );
+			}
+			else
+			{
+				V hits_back = P::And( active, P::CmpLe( dist_to_sep_plane, TMax ) );
+				if ( ! P::IsAnyNegative( hits_back ) )
+				{
+					// missed the back - only need to traverse front node
+					CurNode = FrontChild + front_idx[split_plane_number];
+					TMax = P::Min( TMax, dist_to_sep_plane );
+				}
+				else
+				{
+					// at least some rays hit both nodes.
+					// must push far, traverse near
+					assert( stack_ptr > NodeQueue );
+					--stack_ptr;
+					stack_ptr->node = FrontChild + back_idx[split_plane_number];
+					stack_ptr->TMin = P::Max( TMin, dist_to_sep_plane );
+					stack_ptr->TMax = TMax;
+					CurNode = FrontChild + front_idx[split_plane_number];
+					TMax = P::Min( TMax, dist_to_sep_plane );
+				}
+			}
+		}
+		// hit a leaf! must do intersection check
+		int ntris = CurNode->NumberOfTrianglesInLeaf();
+		if ( ntris )
+		{
+			int32 const *tlist = &( env.TriangleIndexList[CurNode->TriangleIndexStart()] );
+			do
+			{
+				int tnum = *( tlist++ );
+				// check mailbox
+				int mbox_slot = tnum & ( MAILBOX_HASH_SIZE - 1 );
+				TriIntersectData_t const *tri = &( env.OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+				if ( ( mailboxids[mbox_slot] != tnum ) && ( tri->m_nTriangleID != skip_id ) )
+				{
+					mailboxids[mbox_slot] = tnum;
+					IntersectTriangle8<P>( tri, tnum, rays, r, hits, pCallback );
+				}
+			} while ( --ntris );
+			// now, check if all rays have terminated
+			V raydone = P::CmpLe( TMax, hits.m_HitDistance );
+			if ( ! P::IsAnyNegative( raydone ) )
+				return;
+		}
+
+		if ( stack_ptr == &NodeQueue[MAX_NODE_STACK_LEN] )
+			return;
+		// pop stack!
+		CurNode = stack_ptr->node;
+		TMin = stack_ptr->TMin;
+		TMax = stack_ptr->TMax;
+		stack_ptr++;
+	}
+}
+
+template<class P> static void TraceBVH8( RayTracingEnvironment &env, const EightRays &rays, const Rays8_t<P> &r,
+										typename P::V TMin, typename P::V TMax, int DirectionSignMask,
+										Hits8_t<P> &hits, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	typedef typename P::V V;
+
+	if ( ! env.OptimizedBVH.Count() )
+		return;
+
+	int NodeStack[BVH_MAX_DEPTH+1];
+	int stack_len = 0;
+	int node_number = 0;
+	while ( 1 )
+	{
+		CacheOptimizedBVHNode const &node = env.OptimizedBVH[node_number];
+
+		V tnear = TMin;
+		V tfar = P::Min( TMax, hits.m_HitDistance );
+		for ( int c = 0; c < 3; c++ )
+		{
+			V isect_min_t = P::Mul( P::Sub( P::Replicate( node.m_flMins[c] ), r.m_Origin[c] ), r.m_OneOverDirection[c] );
+			V isect_max_t = P::Mul( P::Sub( P::Replicate( node.m_flMaxs[c] ), r.m_Origin[c] ), r.m_OneOverDirection[c] );
+			tnear = P::Max( tnear, P::Min( isect_min_t, isect_max_t ) );
+			tfar = P::Min( tfar, P::Max( isect_min_t, isect_max_t ) );
+		}
+		if ( P::IsAnyNegative( P::CmpLe( tnear, tfar ) ) )
+		{
+			if ( ! node.IsLeaf() )
+			{
+				int near_side = ( DirectionSignMask >> node.SplitAxis() ) & 1;
+				assert( stack_len <= BVH_MAX_DEPTH );
+				NodeStack[stack_len++] = node.LeftChild() + ( near_side ^ 1 );
+				node_number = node.LeftChild() + near_side;
+				continue;
+			}
+
+			int32 const *tlist = env.TriangleIndexList.Base() + node.TriangleIndexStart();
+			for ( int ntris = node.NumberOfTrianglesInLeaf(); ntris; ntris-- )
+			{
+				int tnum = *( tlist++ );
+				TriIntersectData_t const *tri = &( env.OptimizedTriangleList[tnum].m_Data.m_IntersectData );
+				if ( tri->m_nTriangleID != skip_id )
+					IntersectTriangle8<P>( tri, tnum, rays, r, hits, pCallback );
+			}
+		}
+
+		if ( ! stack_len )
+			return;
+		node_number = NodeStack[--stack_len];
+	}
+}
+
+template<class P> static void Trace8RaysPacket( RayTracingEnvironment &env, const EightRays &rays,
+											   const fltx4 TMin[2], const fltx4 TMax[2], int DirectionSignMask,
+											   RayTracingResult *rslt_out, int32 skip_id, ITransparentTriangleCallback *pCallback )
+{
+	Rays8_t<P> r;
+	SetupRays8<P>( rays, r );
+
+	Hits8_t<P> hits;
+	InitHits8<P>( hits );
+
+	if ( env.Flags & RTE_FLAGS_USE_BVH )
+	{
+		TraceBVH8<P>( env, rays, r, P::Combine( TMin[0], TMin[1] ), P::Combine( TMax[0], TMax[1] ),
+					  DirectionSignMask, hits, skip_id, pCallback );
+	}
+	else
+	{
+		rays.Check();
+		TraceKDTree8<P>( env, rays, r, P::Combine( TMin[0], TMin[1] ), P::Combine( TMax[0], TMax[1] ),
+						 DirectionSignMask, hits, skip_id, pCallback );
+	}
+
+	StoreHits8<P>( hits, rslt_out );
+}
+
+#endif
@@ -159,6 +159,109 @@ private:
 	int m_stackLevel;
 };
 
+
+//-----------------------------------------------------------------------------
+// Arena parse mode (see KeyValues::LoadFromFileArena). Each arena node is
+// placed right after a KeyValuesArenaNode_t, which holds the state that
+// doesn't fit in the one spare byte of KeyValues.
+//-----------------------------------------------------------------------------
+enum
+{
+	KEYVALUES_ARENA_NODE	= 0x01,		// lives in an arena, deleteThis only runs the destructor
+	KEYVALUES_ARENA_ROOT	= 0x02,		// owns the arena, deleteThis frees it
+	KEYVALUES_ARENA_STRING	= 0x04,		// m_sValue points into the arena
+	KEYVALUES_ARENA_INDEXED	= 0x08,		// the child index covers every child
+};
+
+// wide blocks get a child index once they have this many children
+#define KEYVALUES_ARENA_INDEX_MIN_CHILDREN	16
+
+#define KEYVALUES_ARENA_BLOCK_SIZE		( 256 * 1024 )
+
+class CKeyValuesArena
+{
+public:
+	CKeyValuesArena() : m_pBlocks( NULL ), m_pCur( NULL ), m_pEnd( NULL ) {}
+	~CKeyValuesArena()
+	{
+		while ( m_pBlocks )
+		{
+			Block_t *pNext = m_pBlocks->m_pNext;
+			free( m_pBlocks );
+			m_pBlocks = pNext;
+		}
+	}
+
+	void *Alloc( int nSize )
+	{
+		nSize = AlignValue( nSize, 8 );
+		if ( m_pEnd - m_pCur < nSize )
+			return AllocBlock( nSize );
+
+		void *p = m_pCur;
+		m_pCur += nSize;
+		return p;
+	}
+
+	char *AllocString( const char *pString, int nLen )
+	{
+		char *p = (char *)Alloc( nLen + 1 );
+		memcpy( p, pString, nLen );
+		p[nLen] = 0;
+		return p;
+	}
+
+private:
+	struct Block_t
+	{
+		Block_t *m_pNext;
+		void *m_pPad;	// keeps the data after the header 8 byte aligned
+	};
+
+	void *AllocBlock( int nSize )
+	{
+		MEM_ALLOC_CREDIT();
+
+		// Large requests (the file text) get a block of their own, so what's left
+		// of the current block isn't thrown away
+		bool bDedicated = ( nSize > KEYVALUES_ARENA_BLOCK_SIZE / 4 );
+		Block_t *pBlock = (Block_t *)malloc( sizeof( Block_t ) + ( bDedicated ? nSize : KEYVALUES_ARENA_BLOCK_SIZE ) );
+		pBlock->m_pNext = m_pBlocks;
+		m_pBlocks = pBlock;
+
+		char *pData = (char *)( pBlock + 1 );
+		if ( bDedicated )
+			return pData;
+
+		m_pCur = pData + nSize;
+		m_pEnd = pData + KEYVALUES_ARENA_BLOCK_SIZE;
+		return pData;
+	}
+
+	Block_t *m_pBlocks;
+	char *m_pCur;
+	char *m_pEnd;
+};
+
+struct KeyValuesArenaNode_t
+{
+	CKeyValuesArena *m_pArena;		// root only
+	KeyValues **m_ppChildIndex;		// open addressing on the key symbol, first duplicate wins
+	int m_nChildIndexMask;
+	KeyValues *m_pIndexParent;		// the parent whose child index holds us, if any
+};
+
+static inline KeyValuesArenaNode_t *GetArenaNode( const KeyValues *pKV )
+{
+	return (KeyValuesArenaNode_t *)pKV - 1;
+}
+
+static inline unsigned int HashKeySymbol( int keySymbol )
+{
+	unsigned int h = (unsigned int)keySymbol * 2654435761u;
+	return h ^ ( h >> 16 );
+}
+
 // Uncomment this line to hit the ~CLeakTrack assert to see what's looking like it's leaking
 // #define LEAKTRACK
 
@@ -462,8 +565,7 @@ void KeyValues::Init()
 	m_bHasEscapeSequences = false;
 	m_bEvaluateConditionals = true;
 
-	// for future proof
-	memset( unused, 0, sizeof(unused) );
+	m_nArenaFlags = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -487,18 +589,34 @@ void KeyValues::RemoveEverything()
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
+	m_pSub = NULL;
+	m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
 
 	for ( dat = m_pPeer; dat && dat != this; dat = datNext )
 	{
 		datNext = dat->m_pPeer;
 		dat->m_pPeer = NULL;
-		delete dat;
+		dat->deleteThis();
 	}
 
-	delete [] m_sValue;
+	FreeAllocatedValue();
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: free the string values. Strings of arena nodes usually live in the
+//			arena and are left alone
+//-----------------------------------------------------------------------------
+void KeyValues::FreeAllocatedValue()
+{
+	if ( !( m_nArenaFlags & KEYVALUES_ARENA_STRING ) )
+	{
+		delete [] m_sValue;
+	}
 	m_sValue = NULL;
+	m_nArenaFlags &= ~KEYVALUES_ARENA_STRING;
+
 	delete [] m_wsValue;
 	m_wsValue = NULL;
 }
@@ -967,6 +1085,9 @@ void KeyValues::SaveKeyToFile( KeyValues *dat, IBaseFileSystem *filesystem, File
 //-----------------------------------------------------------------------------
 KeyValues *KeyValues::FindKey(int keySymbol) const
 {
+	if ( m_nArenaFlags & KEYVALUES_ARENA_INDEXED )
+		return FindKeyInChildIndex( keySymbol );
+
 	for (KeyValues *dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
 	{
 		if (dat->m_iKeyName == keySymbol)
@@ -976,6 +1097,37 @@ KeyValues *KeyValues::FindKey(int keySymbol) const
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: looks up a child through the index built by the arena parser
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::FindKeyInChildIndex( int keySymbol ) const
+{
+	const KeyValuesArenaNode_t *pNode = GetArenaNode( this );
+	for ( unsigned int i = HashKeySymbol( keySymbol ) & pNode->m_nChildIndexMask; ; i = ( i + 1 ) & pNode->m_nChildIndexMask )
+	{
+		KeyValues *dat = pNode->m_ppChildIndex[i];
+		if ( !dat || dat->m_iKeyName == keySymbol )
+			return dat;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Our name or peer is about to change, so the parent's child index
+//			would be stale. The parent goes back to walking its list.
+//-----------------------------------------------------------------------------
+void KeyValues::InvalidateParentChildIndex()
+{
+	if ( !( m_nArenaFlags & KEYVALUES_ARENA_NODE ) )
+		return;
+
+	KeyValuesArenaNode_t *pNode = GetArenaNode( this );
+	if ( pNode->m_pIndexParent )
+	{
+		pNode->m_pIndexParent->m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
+		pNode->m_pIndexParent = NULL;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: Find a keyValue, create it if it is not found.
 //			Set bCreate to true to create the key if it doesn't already exist 
@@ -1011,15 +1163,26 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 
 	KeyValues *lastItem = NULL;
 	KeyValues *dat;
-	// find the searchStr in the current peer list
-	for (dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
+	if ( m_nArenaFlags & KEYVALUES_ARENA_INDEXED )
 	{
-		lastItem = dat;	// record the last item looked at (for if we need to append to the end of the list)
-
-		// symbol compare
-		if (dat->m_iKeyName == iSearchStr)
+		dat = FindKeyInChildIndex( iSearchStr );
+		if ( !dat && bCreate )
 		{
-			break;
+			lastItem = FindLastSubKey();
+		}
+	}
+	else
+	{
+		// find the searchStr in the current peer list
+		for (dat = m_pSub; dat != NULL; dat = dat->m_pPeer)
+		{
+			lastItem = dat;	// record the last item looked at (for if we need to append to the end of the list)
+
+			// symbol compare
+			if (dat->m_iKeyName == iSearchStr)
+			{
+				break;
+			}
 		}
 	}
 
@@ -1050,6 +1213,7 @@ KeyValues *KeyValues::FindKey(const char *keyName, bool bCreate)
 				m_pSub = dat;
 			}
 			dat->m_pPeer = NULL;
+			m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
 
 			// a key graduates to be a submsg as soon as it's m_pSub is set
 			// this should be the only place m_pSub is set
@@ -1132,6 +1296,8 @@ void KeyValues::AddSubkeyUsingKnownLastChild( KeyValues *pSubkey, KeyValues *pLa
 	Assert( pSubkey != NULL );
 	Assert( pSubkey->m_pPeer == NULL );
 
+	m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
+
 	// Empty child list?
 	if ( pLastChild == NULL )
 	{
@@ -1167,6 +1333,8 @@ void KeyValues::AddSubKey( KeyValues *pSubkey )
 	Assert( pSubkey != NULL );
 	Assert( pSubkey->m_pPeer == NULL );
 
+	m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
+
 	// add into subkey list
 	if ( m_pSub == NULL )
 	{
@@ -1194,6 +1362,8 @@ void KeyValues::RemoveSubKey(KeyValues *subKey)
 	if (!subKey)
 		return;
 
+	m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
+
 	// check the list pointer
 	if (m_pSub == subKey)
 	{
@@ -1216,6 +1386,9 @@ void KeyValues::RemoveSubKey(KeyValues *subKey)
 	}
 
 	subKey->m_pPeer = NULL;
+
+	// It may go into another tree, so it mustn't point back at us anymore
+	subKey->InvalidateParentChildIndex();
 }
 
 
@@ -1242,6 +1415,7 @@ KeyValues *KeyValues::FindLastSubKey()
 //-----------------------------------------------------------------------------
 void KeyValues::SetNextKey( KeyValues *pDat )
 {
+	InvalidateParentChildIndex();
 	m_pPeer = pDat;
 }
 
@@ -1595,11 +1769,8 @@ void KeyValues::SetColor( const char *keyName, Color value)
 
 void KeyValues::SetStringValue( char const *strValue )
 {
-	// delete the old value
-	delete [] m_sValue;
-	// make sure we're not storing the WSTRING  - as we're converting over to STRING
-	delete [] m_wsValue;
-	m_wsValue = NULL;
+	// delete the old value, and make sure we're not storing the WSTRING - as we're converting over to STRING
+	FreeAllocatedValue();
 
 	if (!strValue)
 	{
@@ -1629,11 +1800,8 @@ void KeyValues::SetString( const char *keyName, const char *value )
 			return;
 		}
 
-		// delete the old value
-		delete [] dat->m_sValue;
-		// make sure we're not storing the WSTRING  - as we're converting over to STRING
-		delete [] dat->m_wsValue;
-		dat->m_wsValue = NULL;
+		// delete the old value, and make sure we're not storing the WSTRING - as we're converting over to STRING
+		dat->FreeAllocatedValue();
 
 		if (!value)
 		{
@@ -1658,11 +1826,8 @@ void KeyValues::SetWString( const char *keyName, const wchar_t *value )
 	KeyValues *dat = FindKey( keyName, true );
 	if ( dat )
 	{
-		// delete the old value
-		delete [] dat->m_wsValue;
-		// make sure we're not storing the STRING  - as we're converting over to WSTRING
-		delete [] dat->m_sValue;
-		dat->m_sValue = NULL;
+		// delete the old value, and make sure we're not storing the STRING - as we're converting over to WSTRING
+		dat->FreeAllocatedValue();
 
 		if (!value)
 		{
@@ -1702,11 +1867,8 @@ void KeyValues::SetUint64( const char *keyName, uint64 value )
 
 	if ( dat )
 	{
-		// delete the old value
-		delete [] dat->m_sValue;
-		// make sure we're not storing the WSTRING  - as we're converting over to STRING
-		delete [] dat->m_wsValue;
-		dat->m_wsValue = NULL;
+		// delete the old value, and make sure we're not storing the WSTRING - as we're converting over to STRING
+		dat->FreeAllocatedValue();
 
 		dat->m_sValue = new char[sizeof(uint64)];
 		*((uint64 *)dat->m_sValue) = value;
@@ -1730,6 +1892,7 @@ void KeyValues::SetFloat( const char *keyName, float value )
 
 void KeyValues::SetName( const char * setName )
 {
+	InvalidateParentChildIndex();
 	m_iKeyName = s_pfGetSymbolForString( setName, true );
 }
 
@@ -1808,6 +1971,7 @@ void KeyValues::CopyKeyValuesFromRecursive( const KeyValues& rootSrc )
 //-----------------------------------------------------------------------------
 void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char* tmpBuffer )
 {
+	InvalidateParentChildIndex();
 	m_iKeyName = src.GetNameSymbol();
 
 	if ( src.m_pSub )
@@ -1876,8 +2040,14 @@ void KeyValues::CopyKeyValue( const KeyValues& src, size_t tmpBufferSizeB, char*
 
 KeyValues& KeyValues::operator=( const KeyValues& src )
 {
+	InvalidateParentChildIndex();
 	RemoveEverything();
-	Init();	// reset all values
+
+	// reset all values, but an arena node stays where it is
+	char nArenaFlags = m_nArenaFlags & ( KEYVALUES_ARENA_NODE | KEYVALUES_ARENA_ROOT );
+	Init();
+	m_nArenaFlags = nArenaFlags;
+
 	CopyKeyValuesFromRecursive( src );
 	return *this;
 }
@@ -1890,6 +2060,7 @@ void KeyValues::CopySubkeys( KeyValues *pParent ) const
 {
 	// recursively copy subkeys
 	// Also maintain ordering....
+	pParent->m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
 	KeyValues *pPrev = NULL;
 	for ( KeyValues *sub = m_pSub; sub != NULL; sub = sub->m_pPeer )
 	{
@@ -2017,9 +2188,13 @@ bool KeyValues::IsEmpty(const char *keyName)
 //-----------------------------------------------------------------------------
 void KeyValues::Clear( void )
 {
-	delete m_pSub;
+	if ( m_pSub )
+	{
+		m_pSub->deleteThis();
+	}
 	m_pSub = NULL;
 	m_iDataType = TYPE_NONE;
+	m_nArenaFlags &= ~KEYVALUES_ARENA_INDEXED;
 }
 
 //-----------------------------------------------------------------------------
@@ -2039,6 +2214,15 @@ KeyValues::types_t KeyValues::GetDataType(const char *keyName)
 //-----------------------------------------------------------------------------
 void KeyValues::deleteThis()
 {
+	if ( m_nArenaFlags & KEYVALUES_ARENA_NODE )
+	{
+		// the memory of arena nodes goes back when the root frees the arena
+		CKeyValuesArena *pArena = ( m_nArenaFlags & KEYVALUES_ARENA_ROOT ) ? GetArenaNode( this )->m_pArena : NULL;
+		this->~KeyValues();
+		delete pArena;
+		return;
+	}
+
 	delete this;
 }
 
@@ -2419,6 +2603,63 @@ bool KeyValues::LoadFromBuffer( char const *resourceName, const char *pBuffer, I
 	return retVal;
 }
 
+//-----------------------------------------------------------------------------
+// Purpose: Works out whether a value token is an int, float, uint64 or string.
+//			Shared by both text parsers so they type values the same way
+//-----------------------------------------------------------------------------
+static KeyValues::types_t ParseValueToken( const char *value, int len, int &ival, float &fval, uint64 &ulval )
+{
+	// Here, let's determine if we got a float or an int....
+	char* pIEnd;	// pos where int scan ended
+	char* pFEnd;	// pos where float scan ended
+	const char* pSEnd = value + len ; // pos where token ends
+
+	ival = strtol( value, &pIEnd, 10 );
+	fval = (float)strtod( value, &pFEnd );
+	bool bOverflow = ( ival == LONG_MAX || ival == LONG_MIN ) && errno == ERANGE;
+#ifdef POSIX
+	// strtod supports hex representation in strings under posix but we DON'T
+	// want that support in keyvalues, so undo it here if needed
+	if ( len > 1 &&  tolower(value[1]) == 'x' )
+	{
+		fval = 0.0f;
+		pFEnd = (char *)value;
+	}
+#endif
+
+	if ( *value == 0 )
+	{
+		return KeyValues::TYPE_STRING;
+	}
+	else if ( ( 18 == len ) && ( value[0] == '0' ) && ( value[1] == 'x' ) )
+	{
+		// an 18-byte value prefixed with "0x" (followed by 16 hex digits) is an int64 value
+		int64 retVal = 0;
+		for( int i=2; i < 2 + 16; i++ )
+		{
+			char digit = value[i];
+			if ( digit >= 'a' ) 
+				digit -= 'a' - ( '9' + 1 );
+			else
+				if ( digit >= 'A' )
+					digit -= 'A' - ( '9' + 1 );
+			retVal = ( retVal * 16 ) + ( digit - '0' );
+		}
+		ulval = retVal;
+		return KeyValues::TYPE_UINT64;
+	}
+	else if ( (pFEnd > pIEnd) && (pFEnd == pSEnd) )
+	{
+		return KeyValues::TYPE_FLOAT;
+	}
+	else if (pIEnd == pSEnd && !bOverflow)
+	{
+		return KeyValues::TYPE_INT;
+	}
+
+	return KeyValues::TYPE_STRING;
+}
+
 //-----------------------------------------------------------------------------
 // Purpose: 
 //-----------------------------------------------------------------------------
@@ -2515,63 +2756,25 @@ void KeyValues::RecursiveLoadFromBuffer( char const *resourceName, CUtlBuffer &b
 			}
 
 			int len = Q_strlen( value );
+			int ival;
+			float fval;
+			uint64 ulval;
+			dat->m_iDataType = ParseValueToken( value, len, ival, fval, ulval );
 
-			// Here, let's determine if we got a float or an int....
-			char* pIEnd;	// pos where int scan ended
-			char* pFEnd;	// pos where float scan ended
-			const char* pSEnd = value + len ; // pos where token ends
-
-			int ival = strtol( value, &pIEnd, 10 );
-			float fval = (float)strtod( value, &pFEnd );
-			bool bOverflow = ( ival == LONG_MAX || ival == LONG_MIN ) && errno == ERANGE;
-#ifdef POSIX
-			// strtod supports hex representation in strings under posix but we DON'T
-			// want that support in keyvalues, so undo it here if needed
-			if ( len > 1 &&  tolower(value[1]) == 'x' )
-			{
-				fval = 0.0f;
-				pFEnd = (char *)value;
-			}
-#endif
-				
-			if ( *value == 0 )
+			if ( dat->m_iDataType == TYPE_UINT64 )
 			{
-				dat->m_iDataType = TYPE_STRING;	
-			}
-			else if ( ( 18 == len ) && ( value[0] == '0' ) && ( value[1] == 'x' ) )
-			{
-				// an 18-byte value prefixed with "0x" (followed by 16 hex digits) is an int64 value
-				int64 retVal = 0;
-				for( int i=2; i < 2 + 16; i++ )
-				{
-					char digit = value[i];
-					if ( digit >= 'a' ) 
-						digit -= 'a' - ( '9' + 1 );
-					else
-						if ( digit >= 'A' )
-							digit -= 'A' - ( '9' + 1 );
-					retVal = ( retVal * 16 ) + ( digit - '0' );
-				}
 				dat->m_sValue = new char[sizeof(uint64)];
-				*((uint64 *)dat->m_sValue) = retVal;
-				dat->m_iDataType = TYPE_UINT64;
+				*((uint64 *)dat->m_sValue) = ulval;
 			}
-			else if ( (pFEnd > pIEnd) && (pFEnd == pSEnd) )
+			else if ( dat->m_iDataType == TYPE_FLOAT )
 			{
-				dat->m_flValue = fval; 
-				dat->m_iDataType = TYPE_FLOAT;
+				dat->m_flValue = fval;
 			}
-			else if (pIEnd == pSEnd && !bOverflow)
+			else if ( dat->m_iDataType == TYPE_INT )
 			{
-				dat->m_iValue = ival; 
-				dat->m_iDataType = TYPE_INT;
+				dat->m_iValue = ival;
 			}
 			else
-			{
-				dat->m_iDataType = TYPE_STRING;
-			}
-
-			if (dat->m_iDataType == TYPE_STRING)
 			{
 				// copy in the string information
 				dat->m_sValue = new char[len+1];
@@ -2727,7 +2930,11 @@ bool KeyValues::ReadAsBinary( CUtlBuffer &buffer, int nStackDepth )
 		return false;
 
 	RemoveEverything(); // remove current content
-	Init();	// reset
+
+	// reset, but an arena node stays where it is
+	char nArenaFlags = m_nArenaFlags & ( KEYVALUES_ARENA_NODE | KEYVALUES_ARENA_ROOT );
+	Init();
+	m_nArenaFlags = nArenaFlags;
 	
 	if ( nStackDepth > 100 )
 	{
@@ -3263,3 +3470,611 @@ bool CKeyValuesDumpContextAsDevMsg::KvWriteText( char const *szText )
 	}
 	return true;
 }
+
+
+//-----------------------------------------------------------------------------
+// Arena parser. Works on a writable copy of the text that the arena owns.
+// Tokens are terminated in place wherever the character after them can be
+// overwritten, so most names and values are never copied anywhere, and one
+// token of pushback means the text is never scanned twice.
+//-----------------------------------------------------------------------------
+class CKeyValuesArenaParser
+{
+public:
+	CKeyValuesArenaParser( CKeyValuesArena *pArena, char *pText, int nLen, int nArenaFlags ) :
+		m_pArena( pArena ),
+		m_pCur( pText ),
+		m_pEnd( pText + nLen ),
+		m_bHasEscapeSequences( ( nArenaFlags & KeyValues::ARENA_USES_ESCAPE_SEQUENCES ) != 0 ),
+		m_bEvaluateConditionals( ( nArenaFlags & KeyValues::ARENA_IGNORE_CONDITIONALS ) == 0 ),
+		m_bIndexChildren( ( nArenaFlags & KeyValues::ARENA_INDEX_CHILDREN ) != 0 ),
+		m_pUnreadToken( NULL ),
+		m_bUnreadQuoted( false ),
+		m_bUnreadConditional( false )
+	{
+		m_pConv = m_bHasEscapeSequences ? GetCStringCharConversion() : GetNoEscCharConversion();
+	}
+
+	KeyValues *Parse( char const *resourceName, IBaseFileSystem *pFileSystem, const char *pPathID );
+
+private:
+	const char *ReadToken( bool &wasQuoted, bool &wasConditional );
+	void UnreadToken( const char *pToken, bool wasQuoted, bool wasConditional );
+
+	KeyValues *CreateNode( const char *pName );
+	void RecursiveParse( KeyValues *pParent );
+	void SetValue( KeyValues *dat, const char *value );
+	void BuildChildIndex( KeyValues *pParent, int nChildren );
+
+	CKeyValuesArena *m_pArena;
+	char *m_pCur;
+	char *m_pEnd;
+	CUtlCharConversion *m_pConv;
+	bool m_bHasEscapeSequences;
+	bool m_bEvaluateConditionals;
+	bool m_bIndexChildren;
+
+	const char *m_pUnreadToken;
+	bool m_bUnreadQuoted;
+	bool m_bUnreadConditional;
+};
+
+//-----------------------------------------------------------------------------
+// Purpose: Same tokens as KeyValues::ReadToken, but they stay valid for as
+//			long as the arena does
+//-----------------------------------------------------------------------------
+const char *CKeyValuesArenaParser::ReadToken( bool &wasQuoted, bool &wasConditional )
+{
+	if ( m_pUnreadToken )
+	{
+		const char *pToken = m_pUnreadToken;
+		wasQuoted = m_bUnreadQuoted;
+		wasConditional = m_bUnreadConditional;
+		m_pUnreadToken = NULL;
+		return pToken;
+	}
+
+	wasQuoted = false;
+	wasConditional = false;
+
+	// eating white spaces and remarks loop
+	while ( true )
+	{
+		while ( m_pCur < m_pEnd && isspace( *(unsigned char *)m_pCur ) )
+		{
+			m_pCur++;
+		}
+
+		if ( m_pCur >= m_pEnd )
+			return NULL;	// file ends after reading whitespaces
+
+		// stop if it's not a comment; a new token starts here
+		if ( m_pCur[0] != '/' || m_pCur[1] != '/' )
+			break;
+
+		// read complete line
+		m_pCur += 2;
+		while ( m_pCur < m_pEnd && *m_pCur++ != '\n' )
+			;
+	}
+
+	// read quoted strings specially
+	if ( *m_pCur == '\"' )
+	{
+		wasQuoted = true;
+
+		// escape sequences only ever make the token shorter, so they are converted in place
+		char *pToken = ++m_pCur;
+		int nRead = 0;
+		while ( m_pCur < m_pEnd && *m_pCur != '\"' )
+		{
+			char c = *m_pCur++;
+			if ( c == m_pConv->GetEscapeChar() )
+			{
+				int nLength = MIN( m_pConv->MaxConversionLength(), (int)( m_pEnd - m_pCur ) );
+				if ( nLength > 0 )
+				{
+					c = m_pConv->FindConversion( m_pCur, &nLength );
+					m_pCur += nLength;
+				}
+				else
+				{
+					c = '\0';
+				}
+			}
+
+			if ( nRead < KEYVALUES_TOKEN_SIZE - 1 )
+			{
+				pToken[nRead++] = c;
+			}
+		}
+
+		// skip the closing quote, which is where the terminator goes at the latest
+		if ( m_pCur < m_pEnd )
+		{
+			m_pCur++;
+		}
+		pToken[nRead] = 0;
+		return pToken;
+	}
+
+	if ( *m_pCur == '{' || *m_pCur == '}' )
+	{
+		// it's a control char, just return this one char
+		return ( *m_pCur++ == '{' ) ? "{" : "}";
+	}
+
+	// read in the token until we hit a whitespace or a control character
+	char *pToken = m_pCur;
+	bool bConditionalStart = false;
+	while ( m_pCur < m_pEnd )
+	{
+		char c = *m_pCur;
+
+		// break if any control character appears in non quoted tokens
+		if ( c == '\"' || c == '{' || c == '}' )
+			break;
+
+		if ( c == '[' )
+			bConditionalStart = true;
+
+		if ( c == ']' && bConditionalStart )
+		{
+			wasConditional = true;
+		}
+
+		// break on whitespace
+		if ( isspace( (unsigned char)c ) )
+			break;
+
+		m_pCur++;
+	}
+
+	int nLen = m_pCur - pToken;
+	if ( nLen > KEYVALUES_TOKEN_SIZE - 1 )
+	{
+		g_KeyValuesErrorStack.ReportError(" ReadToken overflow" );
+		nLen = KEYVALUES_TOKEN_SIZE - 1;
+	}
+
+	// the control character after the token still has to be read, so copy the token out
+	if ( m_pCur < m_pEnd && !isspace( *(unsigned char *)m_pCur ) )
+		return m_pArena->AllocString( pToken, nLen );
+
+	// otherwise the whitespace (or the end of the text) becomes the terminator
+	if ( m_pCur < m_pEnd )
+	{
+		m_pCur++;
+	}
+	pToken[nLen] = 0;
+	return pToken;
+}
+
+void CKeyValuesArenaParser::UnreadToken( const char *pToken, bool wasQuoted, bool wasConditional )
+{
+	Assert( !m_pUnreadToken );
+	m_pUnreadToken = pToken;
+	m_bUnreadQuoted = wasQuoted;
+	m_bUnreadConditional = wasConditional;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Constructs a node in the arena
+//-----------------------------------------------------------------------------
+KeyValues *CKeyValuesArenaParser::CreateNode( const char *pName )
+{
+	KeyValuesArenaNode_t *pNode = (KeyValuesArenaNode_t *)m_pArena->Alloc( sizeof( KeyValuesArenaNode_t ) + sizeof( KeyValues ) );
+	pNode->m_pArena = NULL;
+	pNode->m_ppChildIndex = NULL;
+	pNode->m_nChildIndexMask = 0;
+	pNode->m_pIndexParent = NULL;
+
+	KeyValues *dat = ::new( pNode + 1 ) KeyValues( pName );
+	dat->UsesEscapeSequences( m_bHasEscapeSequences );
+	dat->UsesConditionals( m_bEvaluateConditionals );
+	dat->m_nArenaFlags = KEYVALUES_ARENA_NODE;
+	Assert( GetArenaNode( dat ) == pNode );
+	return dat;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Types the value like the heap parser does. Strings aren't copied,
+//			the token already lives in the text or the arena
+//-----------------------------------------------------------------------------
+void CKeyValuesArenaParser::SetValue( KeyValues *dat, const char *value )
+{
+	int ival;
+	float fval;
+	uint64 ulval;
+	dat->m_iDataType = ParseValueToken( value, Q_strlen( value ), ival, fval, ulval );
+
+	if ( dat->m_iDataType == KeyValues::TYPE_UINT64 )
+	{
+		dat->m_sValue = (char *)m_pArena->Alloc( sizeof( uint64 ) );
+		*((uint64 *)dat->m_sValue) = ulval;
+		dat->m_nArenaFlags |= KEYVALUES_ARENA_STRING;
+	}
+	else if ( dat->m_iDataType == KeyValues::TYPE_FLOAT )
+	{
+		dat->m_flValue = fval;
+	}
+	else if ( dat->m_iDataType == KeyValues::TYPE_INT )
+	{
+		dat->m_iValue = ival;
+	}
+	else
+	{
+		dat->m_sValue = const_cast< char * >( value );
+		dat->m_nArenaFlags |= KEYVALUES_ARENA_STRING;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Hashes the children of a wide block on their key symbol
+//-----------------------------------------------------------------------------
+void CKeyValuesArenaParser::BuildChildIndex( KeyValues *pParent, int nChildren )
+{
+	// at most half full, so probe chains stay short
+	int nSize = 1;
+	while ( nSize < nChildren * 2 )
+	{
+		nSize <<= 1;
+	}
+
+	KeyValues **ppIndex = (KeyValues **)m_pArena->Alloc( nSize * sizeof( KeyValues * ) );
+	memset( ppIndex, 0, nSize * sizeof( KeyValues * ) );
+
+	int nMask = nSize - 1;
+	for ( KeyValues *dat = pParent->m_pSub; dat != NULL; dat = dat->m_pPeer )
+	{
+		// Renaming or relinking a child has to find us to drop the index
+		Assert( dat->m_nArenaFlags & KEYVALUES_ARENA_NODE );
+		GetArenaNode( dat )->m_pIndexParent = pParent;
+
+		// FindKey returns the first of duplicate names, so the first one keeps the slot
+		unsigned int i = HashKeySymbol( dat->m_iKeyName ) & nMask;
+		while ( ppIndex[i] && ppIndex[i]->m_iKeyName != dat->m_iKeyName )
+		{
+			i = ( i + 1 ) & nMask;
+		}
+
+		if ( !ppIndex[i] )
+		{
+			ppIndex[i] = dat;
+		}
+	}
+
+	KeyValuesArenaNode_t *pNode = GetArenaNode( pParent );
+	pNode->m_ppChildIndex = ppIndex;
+	pNode->m_nChildIndexMask = nMask;
+	pParent->m_nArenaFlags |= KEYVALUES_ARENA_INDEXED;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same grammar and error handling as KeyValues::RecursiveLoadFromBuffer
+//-----------------------------------------------------------------------------
+void CKeyValuesArenaParser::RecursiveParse( KeyValues *pParent )
+{
+	CKeyErrorContext errorReport( pParent );
+	bool wasQuoted;
+	bool wasConditional;
+	if ( errorReport.GetStackLevel() > 100 )
+	{
+		g_KeyValuesErrorStack.ReportError( "RecursiveLoadFromBuffer:  recursion overflow" );
+		return;
+	}
+
+	// keep this out of the stack until a key is parsed
+	CKeyErrorContext errorKey( INVALID_KEY_SYMBOL );
+
+	Assert( !pParent->m_pSub );
+	KeyValues *pLastChild = NULL;
+	int nChildren = 0;
+
+	// Keep parsing until we hit the closing brace which terminates this block, or a parse error
+	while ( 1 )
+	{
+		bool bAccepted = true;
+
+		// get the key name
+		const char * name = ReadToken( wasQuoted, wasConditional );
+
+		if ( !name )	// EOF stop reading
+		{
+			g_KeyValuesErrorStack.ReportError("RecursiveLoadFromBuffer:  got EOF instead of keyname" );
+			break;
+		}
+
+		if ( !*name ) // empty token, maybe "" or EOF
+		{
+			g_KeyValuesErrorStack.ReportError("RecursiveLoadFromBuffer:  got empty keyname" );
+			break;
+		}
+
+		if ( *name == '}' && !wasQuoted )	// top level closed, stop reading
+			break;
+
+		KeyValues *dat = CreateNode( name );
+		if ( pLastChild )
+		{
+			pLastChild->m_pPeer = dat;
+		}
+		else
+		{
+			pParent->m_pSub = dat;
+		}
+
+		errorKey.Reset( dat->GetNameSymbol() );
+
+		// get the value
+		const char * value = ReadToken( wasQuoted, wasConditional );
+
+		if ( wasConditional && value )
+		{
+			bAccepted = !m_bEvaluateConditionals || EvaluateConditional( value );
+
+			// get the real value
+			value = ReadToken( wasQuoted, wasConditional );
+		}
+
+		if ( !value )
+		{
+			g_KeyValuesErrorStack.ReportError("RecursiveLoadFromBuffer:  got NULL key" );
+			break;
+		}
+
+		if ( *value == '}' && !wasQuoted )
+		{
+			g_KeyValuesErrorStack.ReportError("RecursiveLoadFromBuffer:  got } in key" );
+			break;
+		}
+
+		if ( *value == '{' && !wasQuoted )
+		{
+			// this isn't a key, it's a section
+			errorKey.Reset( INVALID_KEY_SYMBOL );
+			// sub value list
+			RecursiveParse( dat );
+		}
+		else
+		{
+			if ( wasConditional )
+			{
+				g_KeyValuesErrorStack.ReportError("RecursiveLoadFromBuffer:  got conditional between key and value" );
+				break;
+			}
+
+			SetValue( dat, value );
+
+			// Look ahead one token for a conditional tag
+			const char *peek = ReadToken( wasQuoted, wasConditional );
+			if ( wasConditional )
+			{
+				bAccepted = !m_bEvaluateConditionals || EvaluateConditional( peek );
+			}
+			else if ( peek )
+			{
+				UnreadToken( peek, wasQuoted, wasConditional );
+			}
+		}
+
+		if ( bAccepted )
+		{
+			pLastChild = dat;
+			nChildren++;
+		}
+		else
+		{
+			if ( pLastChild == NULL )
+			{
+				pParent->m_pSub = NULL;
+			}
+			else
+			{
+				pLastChild->m_pPeer = NULL;
+			}
+
+			dat->deleteThis();
+		}
+	}
+
+	if ( m_bIndexChildren && nChildren >= KEYVALUES_ARENA_INDEX_MIN_CHILDREN )
+	{
+		BuildChildIndex( pParent, nChildren );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Same top level handling as KeyValues::LoadFromBuffer. Returns the
+//			root, which owns the arena
+//-----------------------------------------------------------------------------
+KeyValues *CKeyValuesArenaParser::Parse( char const *resourceName, IBaseFileSystem *pFileSystem, const char *pPathID )
+{
+	AUTO_LOCK( g_KVMutex );
+
+	KeyValues *pRoot = CreateNode( "" );
+	pRoot->m_nArenaFlags |= KEYVALUES_ARENA_ROOT;
+	GetArenaNode( pRoot )->m_pArena = m_pArena;
+
+	KeyValues *pPreviousKey = NULL;
+	KeyValues *pCurrentKey = pRoot;
+	CUtlVector< KeyValues * > includedKeys;
+	CUtlVector< KeyValues * > baseKeys;
+	bool wasQuoted;
+	bool wasConditional;
+	g_KeyValuesErrorStack.SetFilename( resourceName );
+	while ( 1 )
+	{
+		bool bAccepted = true;
+
+		// the first thing must be a key
+		const char *s = ReadToken( wasQuoted, wasConditional );
+		if ( !s || *s == 0 )
+			break;
+
+		if ( !Q_stricmp( s, "#include" ) )	// special include macro (not a key name)
+		{
+			s = ReadToken( wasQuoted, wasConditional );
+			// Name of subfile to load is now in s
+
+			if ( !s || *s == 0 )
+			{
+				g_KeyValuesErrorStack.ReportError("#include is NULL " );
+			}
+			else
+			{
+				pRoot->ParseIncludedKeys( resourceName, s, pFileSystem, pPathID, includedKeys );
+			}
+
+			continue;
+		}
+		else if ( !Q_stricmp( s, "#base" ) )
+		{
+			s = ReadToken( wasQuoted, wasConditional );
+			// Name of subfile to load is now in s
+
+			if ( !s || *s == 0 )
+			{
+				g_KeyValuesErrorStack.ReportError("#base is NULL " );
+			}
+			else
+			{
+				pRoot->ParseIncludedKeys( resourceName, s, pFileSystem, pPathID, baseKeys );
+			}
+
+			continue;
+		}
+
+		if ( !pCurrentKey )
+		{
+			pCurrentKey = CreateNode( s );
+			pPreviousKey->m_pPeer = pCurrentKey;
+		}
+		else
+		{
+			pCurrentKey->SetName( s );
+		}
+
+		// get the '{'
+		s = ReadToken( wasQuoted, wasConditional );
+
+		if ( wasConditional )
+		{
+			bAccepted = !m_bEvaluateConditionals || EvaluateConditional( s );
+
+			// Now get the '{'
+			s = ReadToken( wasQuoted, wasConditional );
+		}
+
+		if ( s && *s == '{' && !wasQuoted )
+		{
+			// header is valid so load the file
+			RecursiveParse( pCurrentKey );
+		}
+		else
+		{
+			g_KeyValuesErrorStack.ReportError("LoadFromBuffer: missing {" );
+		}
+
+		if ( !bAccepted )
+		{
+			// the root is reused for the next key, anything else is dropped
+			if ( pPreviousKey )
+			{
+				pPreviousKey->m_pPeer = NULL;
+				pCurrentKey->deleteThis();
+				pCurrentKey = NULL;
+			}
+			else
+			{
+				pCurrentKey->Clear();
+			}
+		}
+		else
+		{
+			pPreviousKey = pCurrentKey;
+			pCurrentKey = NULL;
+		}
+	}
+
+	// Included and base files are parsed into the heap. Included keys are
+	// linked in after the root and get freed with it
+	pRoot->AppendIncludedKeys( includedKeys );
+	pRoot->MergeBaseKeys( baseKeys );
+	for ( int i = baseKeys.Count() - 1; i >= 0; i-- )
+	{
+		baseKeys[i]->deleteThis();
+	}
+
+	g_KeyValuesErrorStack.SetFilename( "" );
+
+	return pRoot;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Parses text that already lives in the arena
+//-----------------------------------------------------------------------------
+static KeyValues *ParseArenaText( CKeyValuesArena *pArena, char *pText, char const *resourceName, IBaseFileSystem *pFileSystem, const char *pPathID, int nArenaFlags )
+{
+	int nLen = Q_strlen( pText );
+
+	// Translate Unicode files into UTF-8 before proceeding
+	if ( nLen > 2 && (uint8)pText[0] == 0xFF && (uint8)pText[1] == 0xFE )
+	{
+		int nUTF8Len = V_UnicodeToUTF8( (wchar_t*)(pText+2), NULL, 0 );
+		char *pUTF8Buf = (char *)pArena->Alloc( nUTF8Len );
+		V_UnicodeToUTF8( (wchar_t*)(pText+2), pUTF8Buf, nUTF8Len );
+		pText = pUTF8Buf;
+		nLen = Q_strlen( pText );
+	}
+
+	CKeyValuesArenaParser parser( pArena, pText, nLen, nArenaFlags );
+	return parser.Parse( resourceName, pFileSystem, pPathID );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Read from a buffer in arena mode. The text is copied into the arena
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::LoadFromBufferArena( char const *resourceName, const char *pBuffer, IBaseFileSystem* pFileSystem, const char *pPathID, int nArenaFlags )
+{
+	if ( !pBuffer )
+		return NULL;
+
+	CKeyValuesArena *pArena = new CKeyValuesArena;
+	char *pText = pArena->AllocString( pBuffer, Q_strlen( pBuffer ) + 1 );	// double NULL in case this is a unicode file
+	return ParseArenaText( pArena, pText, resourceName, pFileSystem, pPathID, nArenaFlags );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Load from disk in arena mode. The file is read straight into the arena
+//-----------------------------------------------------------------------------
+KeyValues *KeyValues::LoadFromFileArena( IBaseFileSystem *filesystem, const char *resourceName, const char *pathID, int nArenaFlags )
+{
+	TM_ZONE_DEFAULT( TELEMETRY_LEVEL0 );
+	TM_ZONE_DEFAULT_PARAM( TELEMETRY_LEVEL0, resourceName );
+
+	Assert( filesystem );
+
+	FileHandle_t f = filesystem->Open( resourceName, "rb", pathID );
+	if ( !f )
+		return NULL;
+
+	s_LastFileLoadingFrom = (char*)resourceName;
+
+	CKeyValuesArena *pArena = new CKeyValuesArena;
+	int fileSize = filesystem->Size( f );
+	char *pText = (char *)pArena->Alloc( fileSize + 2 );
+	bool bRetOK = ( filesystem->Read( pText, fileSize, f ) == fileSize );
+
+	filesystem->Close( f );	// close file after reading
+
+	if ( !bRetOK )
+	{
+		delete pArena;
+		return NULL;
+	}
+
+	pText[fileSize] = 0; // null terminate file as EOF
+	pText[fileSize+1] = 0; // double NULL terminating in case this is a unicode file
+	return ParseArenaText( pArena, pText, resourceName, filesystem, pathID, nArenaFlags );
+}
@@ -310,3 +310,243 @@ void CUtlMemoryPool::Free( void *memBlock )
 }
 
 
+
+//-----------------------------------------------------------------------------
+// CMemoryPoolMT
+//
+// Each thread pushes and pops blocks on its own cache, which costs an
+// uncontended compare and swap. When a cache holds more than two magazines'
+// worth of blocks, one magazine goes to the shared depot; when it runs dry it
+// takes a magazine back, and only when the depot is empty does it lock the
+// pool and carve a magazine out of the blobs. Magazines are chained through
+// the second word of each block, the first word is the CTSList link.
+//-----------------------------------------------------------------------------
+
+static THREAD_LOCAL int s_iMemoryPoolThreadCache = -1;
+static int32 s_nMemoryPoolThreads = 0;
+
+static inline TSLNodeBase_t *&NextInMagazine( TSLNodeBase_t *pBlock )
+{
+	return ((TSLNodeBase_t **)pBlock)[1];
+}
+
+CMemoryPoolMT::CMemoryPoolMT( int blockSize, int numElements, int growMode, const char *pszAllocOwner, int nAlignment ) :
+	CUtlMemoryPool( Max<int>( blockSize, 2 * sizeof( void * ) ), numElements, growMode, pszAllocOwner, Max<int>( nAlignment, TSLIST_NODE_ALIGNMENT ) )
+{
+	COMPILE_TIME_ASSERT( sizeof( ThreadCache_t ) == 64 );
+
+	m_pCaches = (ThreadCache_t *)MemAlloc_AllocAligned( MEMPOOL_MT_CACHES * sizeof( ThreadCache_t ), 64 );
+	for ( int i = 0; i < MEMPOOL_MT_CACHES; i++ )
+	{
+		Construct( &m_pCaches[i] );
+	}
+	m_pDepot = new CTSListBase;
+}
+
+CMemoryPoolMT::~CMemoryPoolMT()
+{
+	// give the cached blocks back so the leak report only sees real leaks
+	DrainCaches( true );
+
+	for ( int i = 0; i < MEMPOOL_MT_CACHES; i++ )
+	{
+		Destruct( &m_pCaches[i] );
+	}
+	MemAlloc_FreeAligned( m_pCaches );
+	delete m_pDepot;
+}
+
+//-----------------------------------------------------------------------------
+// Threads are dealt caches round robin the first time they touch any pool
+//-----------------------------------------------------------------------------
+CMemoryPoolMT::ThreadCache_t *CMemoryPoolMT::GetThreadCache()
+{
+	int iCache = s_iMemoryPoolThreadCache;
+	if ( iCache < 0 )
+	{
+		iCache = s_iMemoryPoolThreadCache = ( ThreadInterlockedIncrement( &s_nMemoryPoolThreads ) - 1 ) % MEMPOOL_MT_CACHES;
+	}
+	return &m_pCaches[iCache];
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Restocks an empty cache and returns one block for the caller
+//-----------------------------------------------------------------------------
+TSLNodeBase_t *CMemoryPoolMT::Refill( ThreadCache_t *pCache )
+{
+	TSLNodeBase_t *pMagazine = m_pDepot->Pop();
+	if ( pMagazine )
+	{
+		TSLNodeBase_t *pNext = NextInMagazine( pMagazine );
+		while ( pNext )
+		{
+			TSLNodeBase_t *pBlock = pNext;
+			pNext = NextInMagazine( pBlock );
+			pCache->m_Blocks.Push( pBlock );
+		}
+		return pMagazine;
+	}
+
+	{
+		AUTO_LOCK( m_mutex );
+		TSLNodeBase_t *pFirst = (TSLNodeBase_t *)CUtlMemoryPool::Alloc();
+		if ( pFirst )
+		{
+			for ( int i = 1; i < MEMPOOL_MT_MAGAZINE; i++ )
+			{
+				TSLNodeBase_t *pBlock = (TSLNodeBase_t *)CUtlMemoryPool::Alloc();
+				if ( !pBlock )
+					break;
+				pCache->m_Blocks.Push( pBlock );
+			}
+			return pFirst;
+		}
+	}
+
+	// The blobs can't grow, but other threads may still be sitting on free blocks
+	for ( int i = 0; i < MEMPOOL_MT_CACHES; i++ )
+	{
+		TSLNodeBase_t *pBlock = m_pCaches[i].m_Blocks.Pop();
+		if ( pBlock )
+			return pBlock;
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Moves a magazine of blocks from an overfull cache to the depot
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::ReturnMagazine( ThreadCache_t *pCache )
+{
+	TSLNodeBase_t *pMagazine = pCache->m_Blocks.Pop();
+	if ( !pMagazine )
+		return;
+
+	TSLNodeBase_t *pTail = pMagazine;
+	for ( int i = 1; i < MEMPOOL_MT_MAGAZINE; i++ )
+	{
+		TSLNodeBase_t *pBlock = pCache->m_Blocks.Pop();
+		if ( !pBlock )
+			break;
+		NextInMagazine( pTail ) = pBlock;
+		pTail = pBlock;
+	}
+	NextInMagazine( pTail ) = NULL;
+
+	m_pDepot->Push( pMagazine );
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Empties the caches and the depot, optionally handing the blocks
+//			back to the blobs. No other thread may be using the pool.
+//-----------------------------------------------------------------------------
+void CMemoryPoolMT::DrainCaches( bool bFreeBlocks )
+{
+	for ( int i = 0; i < MEMPOOL_MT_CACHES; i++ )
+	{
+		TSLNodeBase_t *pBlock = m_pCaches[i].m_Blocks.Detach();
+		while ( pBlock )
+		{
+			TSLNodeBase_t *pNext = pBlock->Next;
+			if ( bFreeBlocks )
+			{
+				CUtlMemoryPool::Free( pBlock );
+			}
+			pBlock = pNext;
+		}
+		m_pCaches[i].m_nAllocated = 0;
+	}
+
+	TSLNodeBase_t *pMagazine = m_pDepot->Detach();
+	while ( pMagazine )
+	{
+		TSLNodeBase_t *pNextMagazine = pMagazine->Next;
+		TSLNodeBase_t *pBlock = pMagazine;
+		while ( pBlock )
+		{
+			TSLNodeBase_t *pNext = NextInMagazine( pBlock );
+			if ( bFreeBlocks )
+			{
+				CUtlMemoryPool::Free( pBlock );
+			}
+			pBlock = pNext;
+		}
+		pMagazine = pNextMagazine;
+	}
+}
+
+void* CMemoryPoolMT::Alloc()
+{
+	return Alloc( m_BlockSize );
+}
+
+void* CMemoryPoolMT::AllocZero()
+{
+	return AllocZero( m_BlockSize );
+}
+
+void *CMemoryPoolMT::Alloc( size_t amount )
+{
+	if ( amount > (unsigned int)m_BlockSize )
+		return NULL;
+
+	ThreadCache_t *pCache = GetThreadCache();
+	TSLNodeBase_t *pBlock = pCache->m_Blocks.Pop();
+	if ( !pBlock )
+	{
+		pBlock = Refill( pCache );
+		if ( !pBlock )
+			return NULL;
+	}
+
+	++pCache->m_nAllocated;
+	return pBlock;
+}
+
+void *CMemoryPoolMT::AllocZero( size_t amount )
+{
+	void *mem = Alloc( amount );
+	if ( mem )
+	{
+		memset( mem, 0x00, amount );
+	}
+	return mem;
+}
+
+void CMemoryPoolMT::Free( void *memBlock )
+{
+	if ( !memBlock )
+		return;
+
+#ifdef _DEBUG
+	// invalidate the memory
+	memset( memBlock, 0xDD, m_BlockSize );
+#endif
+
+	ThreadCache_t *pCache = GetThreadCache();
+	--pCache->m_nAllocated;
+	pCache->m_Blocks.Push( (TSLNodeBase_t *)memBlock );
+
+	if ( pCache->m_Blocks.Count() > 2 * MEMPOOL_MT_MAGAZINE )
+	{
+		ReturnMagazine( pCache );
+	}
+}
+
+void CMemoryPoolMT::Clear()
+{
+	DrainCaches( false );
+
+	AUTO_LOCK( m_mutex );
+	CUtlMemoryPool::Clear();
+}
+
+int CMemoryPoolMT::Count() const
+{
+	int nCount = 0;
+	for ( int i = 0; i < MEMPOOL_MT_CACHES; i++ )
+	{
+		nCount += m_pCaches[i].m_nAllocated;
+	}
+	return nCount;
+}
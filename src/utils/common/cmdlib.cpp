@@ -23,6 +23,7 @@
 #include "filesystem_helpers.h"
 #include "utllinkedlist.h"
 #include "tier0/icommandline.h"
+#include "tier0/threadtools.h"
 #include "KeyValues.h"
 #include "filesystem_tools.h"
 
@@ -61,8 +62,6 @@ CUtlLinkedList<SpewHookFn, unsigned short> g_ExtraSpewHooks;
 bool g_bStopOnExit = false;
 void (*g_ExtraSpewHook)(const char*) = NULL;
 
-#if defined( _WIN32 ) || defined( WIN32 )
-
 void CmdLib_FPrintf( FileHandle_t hFile, const char *pFormat, ... )
 {
 	static CUtlVector<char> buf;
@@ -128,7 +127,7 @@ char* CmdLib_FGets( char *pOut, int outSize, FileHandle_t hFile )
 	return pOut;
 }
 
-#if !defined( _X360 )
+#ifdef IS_WINDOWS_PC
 #include <wincon.h>
 #endif
 
@@ -141,7 +140,11 @@ public:
 		if ( g_bStopOnExit )
 		{
 			Warning( "\nPress any key to quit.\n" );
+#ifdef _WIN32
 			getch();
+#else
+			getchar();
+#endif
 		}
 	}
 } g_ExitStopper;
@@ -153,7 +156,7 @@ static unsigned short g_BadColor = 0xFFFF;
 static WORD g_BackgroundFlags = 0xFFFF;
 static void GetInitialColors( )
 {
-#if !defined( _X360 )
+#ifdef IS_WINDOWS_PC
 	// Get the old background attributes.
 	CONSOLE_SCREEN_BUFFER_INFO oldInfo;
 	GetConsoleScreenBufferInfo( GetStdHandle( STD_OUTPUT_HANDLE ), &oldInfo );
@@ -175,7 +178,7 @@ static void GetInitialColors( )
 WORD SetConsoleTextColor( int red, int green, int blue, int intensity )
 {
 	WORD ret = g_LastColor;
-#if !defined( _X360 )
+#ifdef IS_WINDOWS_PC
 	
 	g_LastColor = 0;
 	if( red )	g_LastColor |= FOREGROUND_RED;
@@ -194,10 +197,10 @@ WORD SetConsoleTextColor( int red, int green, int blue, int intensity )
 
 void RestoreConsoleTextColor( WORD color )
 {
-#if !defined( _X360 )
+#ifdef IS_WINDOWS_PC
 	SetConsoleTextAttribute( GetStdHandle( STD_OUTPUT_HANDLE ), color | g_BackgroundFlags );
-	g_LastColor = color;
 #endif
+	g_LastColor = color;
 }
 
 
@@ -216,23 +219,16 @@ void Error( char const *pMsg, ... )
 
 #else
 
-CRITICAL_SECTION g_SpewCS;
-bool g_bSpewCSInitted = false;
+// Recursive, an Error() raised while writing the log spews again on the same thread
+CThreadMutex g_SpewCS;
 bool g_bSuppressPrintfOutput = false;
 
 SpewRetval_t CmdLib_SpewOutputFunc( SpewType_t type, char const *pMsg )
 {
-	// Hopefully two threads won't call this simultaneously right at the start!
-	if ( !g_bSpewCSInitted )
-	{
-		InitializeCriticalSection( &g_SpewCS );
-		g_bSpewCSInitted = true;
-	}
-
 	WORD old;
 	SpewRetval_t retVal;
 	
-	EnterCriticalSection( &g_SpewCS );
+	g_SpewCS.Lock();
 	{
 		if (( type == SPEW_MESSAGE ) || (type == SPEW_LOG ))
 		{
@@ -297,12 +293,16 @@ SpewRetval_t CmdLib_SpewOutputFunc( SpewType_t type, char const *pMsg )
 		if ( !g_bSuppressPrintfOutput || type == SPEW_ERROR )
 			printf( "%s", pMsg );
 
+#ifdef _WIN32
 		OutputDebugString( pMsg );
+#endif
 		
 		if ( type == SPEW_ERROR )
 		{
 			printf( "\n" );
+#ifdef _WIN32
 			OutputDebugString( "\n" );
+#endif
 		}
 
 		if( g_pLogFile )
@@ -317,7 +317,7 @@ SpewRetval_t CmdLib_SpewOutputFunc( SpewType_t type, char const *pMsg )
 
 		RestoreConsoleTextColor( old );
 	}
-	LeaveCriticalSection( &g_SpewCS );
+	g_SpewCS.Unlock();
 
 	if ( type == SPEW_ERROR )
 	{
@@ -413,15 +413,17 @@ void CmdLib_Cleanup()
 
 void CmdLib_Exit( int exitCode )
 {
+#ifdef _WIN32
 	TerminateProcess( GetCurrentProcess(), 1 );
+#else
+	_exit( 1 );
+#endif
 }	
 
 
 
 #endif
 
-#endif
-
 
 
 
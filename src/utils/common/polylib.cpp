@@ -13,6 +13,7 @@
 #include "worldsize.h"
 #include "threads.h"
 #include "tier0/dbg.h"
+#include "tier0/threadtools.h"
 
 // doesn't seem to need to be here? -- in threads.h
 //extern int numthreads;
@@ -31,7 +32,11 @@ void pw(winding_t *w)
 		printf ("(%5.1f, %5.1f, %5.1f)\n",w->p[i][0], w->p[i][1],w->p[i][2]);
 }
 
-winding_t *winding_pool[MAX_POINTS_ON_WINDING+4];
+// Freed windings are kept on a free list for their size, one set of lists per tool thread,
+// so the tool threads never wait on each other here. A winding goes back on the list of
+// whichever thread frees it. Threads that RunThreads didn't start share the main lists.
+static winding_t *winding_pool[MAX_TOOL_THREADS+1][MAX_POINTS_ON_WINDING+4];
+static CThreadFastMutex s_MainWindingPoolMutex;
 
 /*
 =============
@@ -50,18 +55,30 @@ winding_t *AllocWinding (int points)
 		if (c_active_windings > c_peak_windings)
 			c_peak_windings = c_active_windings;
 	}
-	ThreadLock();
-	if (winding_pool[points])
+
+	int iThread = GetCurrentThreadIndex();
+	if ( iThread == THREADINDEX_MAIN )
+		s_MainWindingPoolMutex.Lock();
+
+	winding_t **pool = winding_pool[iThread];
+	if (pool[points])
 	{
-		w = winding_pool[points];
-		winding_pool[points] = w->next;
+		w = pool[points];
+		pool[points] = w->next;
 	}
 	else
+	{
+		w = NULL;
+	}
+
+	if ( iThread == THREADINDEX_MAIN )
+		s_MainWindingPoolMutex.Unlock();
+
+	if (!w)
 	{
 		w = (winding_t *)malloc(sizeof(*w));
 		w->p = (Vector *)calloc( points, sizeof(Vector) );
 	}
-	ThreadUnlock();
 	w->numpoints = 0; // None are occupied yet even though allocated.
 	w->maxpoints = points;
 	w->next = NULL;
@@ -73,11 +90,16 @@ void FreeWinding (winding_t *w)
 	if (w->numpoints == 0xdeaddead)
 		Error ("FreeWinding: freed a freed winding");
 	
-	ThreadLock();
+	int iThread = GetCurrentThreadIndex();
+	if ( iThread == THREADINDEX_MAIN )
+		s_MainWindingPoolMutex.Lock();
+
 	w->numpoints = 0xdeaddead; // flag as freed
-	w->next = winding_pool[w->maxpoints];
-	winding_pool[w->maxpoints] = w;
-	ThreadUnlock();
+	w->next = winding_pool[iThread][w->maxpoints];
+	winding_pool[iThread][w->maxpoints] = w;
+
+	if ( iThread == THREADINDEX_MAIN )
+		s_MainWindingPoolMutex.Unlock();
 }
 
 /*
@@ -16,8 +16,8 @@
 #include "xbox\xbox_win32stubs.h"
 #endif
 #if defined(POSIX)
-#include "../../filesystem/linux_support.h"
 #include <sys/stat.h>
+#include <glob.h>
 #endif
 /*
 =============================================================================
@@ -1219,55 +1219,35 @@ int CScriptLib::GetFileList( const char* pDirPath, const char* pPattern, CUtlVec
 
 	_findclose( h );
 #elif defined(POSIX)
-	FIND_DATA findData;
 	Q_FixSlashes( fullPath );
-	void *h = FindFirstFile( fullPath, &findData );
-	if ( (intp)h == -1 )
+	glob_t globResult;
+	if ( glob( fullPath, 0, NULL, &globResult ) != 0 )
 	{
 		return 0;
 	}
 
-	do
+	for ( size_t i = 0; i < globResult.gl_pathc; i++ )
 	{
-		// dos attribute complexities i.e. _A_NORMAL is 0
-		if ( bFindDirs )
-		{
-			// skip non dirs
-			if ( !( findData.dwFileAttributes & S_IFDIR ) )
-				continue;
-		}
-		else
-		{
-			// skip dirs
-			if ( findData.dwFileAttributes & S_IFDIR )
-				continue;
-		}
+		const char *pFileName = globResult.gl_pathv[i];
 
-		if ( !stricmp( findData.cFileName, "." ) )
+		struct stat statbuf;
+		if ( stat( pFileName, &statbuf ) != 0 )
 			continue;
 
-		if ( !stricmp( findData.cFileName, ".." ) )
+		// skip non dirs when finding dirs, and dirs otherwise
+		if ( bFindDirs != S_ISDIR( statbuf.st_mode ) )
 			continue;
 
-		char fileName[MAX_PATH];
-		strcpy( fileName, sourcePath );
-		strcat( fileName, findData.cFileName );
-
 		int j = fileList.AddToTail();
-		fileList[j].fileName.Set( fileName );
-		struct stat statbuf;
-		if ( stat( fileName, &statbuf ) )
+		fileList[j].fileName.Set( pFileName );
 #ifdef OSX
-			fileList[j].timeWrite = statbuf.st_mtimespec.tv_sec;
+		fileList[j].timeWrite = statbuf.st_mtimespec.tv_sec;
 #else
-			fileList[j].timeWrite = statbuf.st_mtime;
+		fileList[j].timeWrite = statbuf.st_mtime;
 #endif
-		else
-			fileList[j].timeWrite = 0;
 	}
-	while ( !FindNextFile( h, &findData ) );
 
-	FindClose( h );
+	globfree( &globResult );
 
 #else
 #error
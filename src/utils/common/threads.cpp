@@ -1,6 +1,6 @@
 //========= Copyright Valve Corporation, All rights reserved. ============//
 //
-// Purpose: 
+// Purpose:
 //
 // $Workfile:     $
 // $Date:         $
@@ -13,13 +13,22 @@
 
 #define	USED
 
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
 #include "cmdlib.h"
 #define NO_THREAD_NAMES
 #include "threads.h"
 #include "pacifier.h"
+#include "tier0/threadtools.h"
+#include "tier1/utlvector.h"
+
 
-#define	MAX_THREADS	16
+// How many chunks each thread's share of RunThreadsOnIndividual is cut into. More chunks
+// means finer load balancing at the end of a run, at the cost of more queue traffic.
+#define WORK_CHUNKS_PER_THREAD	16
 
 
 class CRunThreadsData
@@ -30,19 +39,36 @@ public:
 	RunThreadsFn m_Fn;
 };
 
-CRunThreadsData g_RunThreadsData[MAX_THREADS];
+CRunThreadsData g_RunThreadsData[MAX_TOOL_THREADS];
 
 
-int		dispatch;
+CInterlockedInt	dispatch;
 int		workcount;
 qboolean		pacifier;
 
 qboolean	threaded;
 bool g_bLowPriorityThreads = false;
 
-HANDLE g_ThreadHandles[MAX_THREADS];
+ThreadHandle_t g_ThreadHandles[MAX_TOOL_THREADS];
 
 
+// The pacifier isn't thread safe. Whoever finishes an item updates it, unless another
+// thread is already doing so.
+static CThreadFastMutex	g_PacifierMutex;
+static CInterlockedInt	g_nWorkDone;
+
+static void UpdateThreadPacifier( int nDone )
+{
+	if ( !pacifier || !workcount )
+		return;
+
+	if ( g_PacifierMutex.TryLock() )
+	{
+		UpdatePacifier( (float)nDone / workcount );
+		g_PacifierMutex.Unlock();
+	}
+}
+
 
 /*
 =============
@@ -52,27 +78,160 @@ GetThreadWork
 */
 int	GetThreadWork (void)
 {
-	int	r;
+	int r = dispatch++;
+	if ( r >= workcount )
+		return -1;
 
-	ThreadLock ();
+	UpdateThreadPacifier( r );
+	return r;
+}
+
+
+/*
+===================================================================
+
+WORK STEALING
+
+RunThreadsOnIndividual cuts the work into chunks of consecutive items and deals them out to
+the threads round robin, so all threads start near the front and move through the work in
+about the order it was given. Each thread takes items one at a time from its current chunk,
+then the next chunk of its own. A thread with nothing left steals the last chunk someone else
+hasn't started, or failing that, the back half of what is left of their current chunk.
+
+===================================================================
+*/
+
+class CWorkQueue
+{
+public:
+	CThreadFastMutex m_Mutex;
 
-	if (dispatch == workcount)
+	// items [m_iItem, m_iItemEnd) are left in the chunk the owner is working through
+	int m_iItem;
+	int m_iItemEnd;
+
+	// unstarted chunks. slot n is chunk ( owner + n * numthreads )
+	int m_iSlot;
+	int m_iSlotEnd;
+
+	// queues are locked by other threads, so keep them off each other's cache lines
+	char m_Pad[64];
+};
+
+static CWorkQueue g_WorkQueues[MAX_TOOL_THREADS];
+static CUtlVector<int> g_WorkChunkStart;					// first item of each chunk, plus workcount at the end
+static ThreadWorkerFn workfunction;
+
+static void BuildWorkChunks( int workcnt, const float *pflCosts )
+{
+	if ( workcnt <= 0 )
 	{
-		ThreadUnlock ();
-		return -1;
+		for ( int i = 0; i < numthreads; i++ )
+		{
+			g_WorkQueues[i].m_iItem = g_WorkQueues[i].m_iItemEnd = 0;
+			g_WorkQueues[i].m_iSlot = g_WorkQueues[i].m_iSlotEnd = 0;
+		}
+		return;
 	}
 
-	UpdatePacifier( (float)dispatch / workcount );
+	int nChunks = MIN( numthreads * WORK_CHUNKS_PER_THREAD, workcnt );
 
-	r = dispatch;
-	dispatch++;
-	ThreadUnlock ();
+	g_WorkChunkStart.RemoveAll();
+	g_WorkChunkStart.EnsureCapacity( nChunks + 1 );
+	g_WorkChunkStart.AddToTail( 0 );
 
-	return r;
+	if ( pflCosts )
+	{
+		// close a chunk whenever it reaches its share of the total cost
+		double flTotal = 0;
+		for ( int i = 0; i < workcnt; i++ )
+			flTotal += MAX( pflCosts[i], 0.0f );
+
+		double flPerChunk = flTotal / nChunks;
+		double flChunk = 0;
+		for ( int i = 0; i < workcnt - 1; i++ )
+		{
+			flChunk += MAX( pflCosts[i], 0.0f );
+			if ( flChunk >= flPerChunk )
+			{
+				g_WorkChunkStart.AddToTail( i + 1 );
+				flChunk = 0;
+			}
+		}
+	}
+	else
+	{
+		for ( int i = 1; i < nChunks; i++ )
+			g_WorkChunkStart.AddToTail( (int)( (int64)workcnt * i / nChunks ) );
+	}
+
+	g_WorkChunkStart.AddToTail( workcnt );
+	nChunks = g_WorkChunkStart.Count() - 1;
+
+	for ( int i = 0; i < numthreads; i++ )
+	{
+		CWorkQueue &queue = g_WorkQueues[i];
+		queue.m_iItem = queue.m_iItemEnd = 0;
+		queue.m_iSlot = 0;
+		queue.m_iSlotEnd = ( i < nChunks ) ? ( nChunks - i + numthreads - 1 ) / numthreads : 0;
+	}
 }
 
+static bool StealWork( int iThread, int &iFirst, int &iEnd )
+{
+	for ( int i = 1; i < numthreads; i++ )
+	{
+		int iVictim = ( iThread + i ) % numthreads;
+		CWorkQueue &victim = g_WorkQueues[iVictim];
 
-ThreadWorkerFn workfunction;
+		AUTO_LOCK( victim.m_Mutex );
+		if ( victim.m_iSlot < victim.m_iSlotEnd )
+		{
+			int iChunk = iVictim + ( --victim.m_iSlotEnd ) * numthreads;
+			iFirst = g_WorkChunkStart[iChunk];
+			iEnd = g_WorkChunkStart[iChunk + 1];
+			return true;
+		}
+
+		int nLeft = victim.m_iItemEnd - victim.m_iItem;
+		if ( nLeft > 0 )
+		{
+			iEnd = victim.m_iItemEnd;
+			iFirst = victim.m_iItemEnd = victim.m_iItemEnd - ( nLeft + 1 ) / 2;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int GetThreadWorkItem( int iThread )
+{
+	CWorkQueue &queue = g_WorkQueues[iThread];
+	{
+		AUTO_LOCK( queue.m_Mutex );
+		if ( queue.m_iItem < queue.m_iItemEnd )
+			return queue.m_iItem++;
+
+		if ( queue.m_iSlot < queue.m_iSlotEnd )
+		{
+			int iChunk = iThread + ( queue.m_iSlot++ ) * numthreads;
+			queue.m_iItem = g_WorkChunkStart[iChunk];
+			queue.m_iItemEnd = g_WorkChunkStart[iChunk + 1];
+			return queue.m_iItem++;
+		}
+	}
+
+	// Once nothing can be stolen, everything left is already running somewhere
+	int iFirst, iEnd;
+	if ( !StealWork( iThread, iFirst, iEnd ) )
+		return -1;
+
+	AUTO_LOCK( queue.m_Mutex );
+	queue.m_iItem = iFirst + 1;
+	queue.m_iItemEnd = iEnd;
+	return iFirst;
+}
 
 void ThreadWorkerFunction( int iThread, void *pUserData )
 {
@@ -80,64 +239,63 @@ void ThreadWorkerFunction( int iThread, void *pUserData )
 
 	while (1)
 	{
-		work = GetThreadWork ();
+		work = GetThreadWorkItem( iThread );
 		if (work == -1)
 			break;
-		 
+
 		workfunction( iThread, work );
+		UpdateThreadPacifier( ++g_nWorkDone );
 	}
 }
 
-void RunThreadsOnIndividual (int workcnt, qboolean showpacifier, ThreadWorkerFn func)
+void RunThreadsOnIndividualWeighted (int workcnt, qboolean showpacifier, ThreadWorkerFn func, const float *pflCosts)
 {
 	if (numthreads == -1)
 		ThreadSetDefault ();
-	
+	if ( numthreads > MAX_TOOL_THREADS )
+		numthreads = MAX_TOOL_THREADS;
+
 	workfunction = func;
+	g_nWorkDone = 0;
+	BuildWorkChunks( workcnt, pflCosts );
 	RunThreadsOn (workcnt, showpacifier, ThreadWorkerFunction);
 }
 
+void RunThreadsOnIndividual (int workcnt, qboolean showpacifier, ThreadWorkerFn func)
+{
+	RunThreadsOnIndividualWeighted( workcnt, showpacifier, func, NULL );
+}
+
 
 /*
 ===================================================================
 
-WIN32
+THREADS
 
 ===================================================================
 */
 
 int		numthreads = -1;
-CRITICAL_SECTION		crit;
+CThreadMutex		crit;
 static int enter;
 
 
-class CCritInit
-{
-public:
-	CCritInit()
-	{
-		InitializeCriticalSection (&crit);
-	}
-} g_CritInit;
-
-
-
 void SetLowPriority()
 {
+#ifdef _WIN32
 	SetPriorityClass( GetCurrentProcess(), IDLE_PRIORITY_CLASS );
+#else
+	setpriority( PRIO_PROCESS, 0, 19 );
+#endif
 }
 
 
 void ThreadSetDefault (void)
 {
-	SYSTEM_INFO info;
-
 	if (numthreads == -1)	// not set manually
 	{
-		GetSystemInfo (&info);
-		numthreads = info.dwNumberOfProcessors;
-		if (numthreads < 1 || numthreads > 32)
-			numthreads = 1;
+		numthreads = GetCPUInformation()->m_nLogicalProcessors;
+		numthreads = clamp( numthreads, 1, MAX_TOOL_THREADS );
 	}
 
 	Msg ("%i threads\n", numthreads);
@@ -148,7 +306,7 @@ void ThreadLock (void)
 {
 	if (!threaded)
 		return;
-	EnterCriticalSection (&crit);
+	crit.Lock();
 	if (enter)
 		Error ("Recursive ThreadLock\n");
 	enter = 1;
@@ -161,14 +319,23 @@ void ThreadUnlock (void)
 	if (!enter)
 		Error ("ThreadUnlock without lock\n");
 	enter = 0;
-	LeaveCriticalSection (&crit);
+	crit.Unlock();
+}
+
+
+static THREAD_LOCAL int s_iThreadIndex = THREADINDEX_MAIN;
+
+int GetCurrentThreadIndex (void)
+{
+	return s_iThreadIndex;
 }
 
 
 // This runs in the thread and dispatches a RunThreadsFn call.
-DWORD WINAPI InternalRunThreadsFn( LPVOID pParameter )
+static uintp InternalRunThreadsFn( void *pParameter )
 {
 	CRunThreadsData *pData = (CRunThreadsData*)pParameter;
+	s_iThreadIndex = pData->m_iThread;
 	pData->m_Fn( pData->m_iThread, pData->m_pUserData );
 	return 0;
 }
@@ -188,23 +355,22 @@ void RunThreads_Start( RunThreadsFn fn, void *pUserData, ERunThreadsPriority ePr
 		g_RunThreadsData[i].m_pUserData = pUserData;
 		g_RunThreadsData[i].m_Fn = fn;
 
-		DWORD dwDummy;
-		g_ThreadHandles[i] = CreateThread(
-		   NULL,	// LPSECURITY_ATTRIBUTES lpsa,
-		   0,		// DWORD cbStack,
-		   InternalRunThreadsFn,	// LPTHREAD_START_ROUTINE lpStartAddr,
-		   &g_RunThreadsData[i],	// LPVOID lpvThreadParm,
-		   0,			// DWORD fdwCreate,
-		   &dwDummy );
+		g_ThreadHandles[i] = CreateSimpleThread( InternalRunThreadsFn, &g_RunThreadsData[i] );
+		if ( !g_ThreadHandles[i] )
+			Error( "RunThreads_Start: couldn't create thread %d\n", i );
 
 		if ( ePriority == k_eRunThreadsPriority_UseGlobalState )
 		{
 			if( g_bLowPriorityThreads )
-				SetThreadPriority( g_ThreadHandles[i], THREAD_PRIORITY_LOWEST );
+				ThreadSetPriority( g_ThreadHandles[i], TP_PRIORITY_LOWEST );
 		}
 		else if ( ePriority == k_eRunThreadsPriority_Idle )
 		{
-			SetThreadPriority( g_ThreadHandles[i], THREAD_PRIORITY_IDLE );
+#ifdef _WIN32
+			ThreadSetPriority( g_ThreadHandles[i], THREAD_PRIORITY_IDLE );
+#else
+			ThreadSetPriority( g_ThreadHandles[i], TP_PRIORITY_LOWEST );
+#endif
 		}
 	}
 }
@@ -212,13 +378,15 @@ void RunThreads_Start( RunThreadsFn fn, void *pUserData, ERunThreadsPriority ePr
 
 void RunThreads_End()
 {
-	WaitForMultipleObjects( numthreads, g_ThreadHandles, TRUE, INFINITE );
 	for ( int i=0; i < numthreads; i++ )
-		CloseHandle( g_ThreadHandles[i] );
+	{
+		ThreadJoin( g_ThreadHandles[i] );
+		ReleaseThreadHandle( g_ThreadHandles[i] );
+	}
 
 	threaded = false;
 }
-	
+
 
 /*
 =============
@@ -227,7 +395,7 @@ RunThreadsOn
 */
 void RunThreadsOn( int workcnt, qboolean showpacifier, RunThreadsFn fn, void *pUserData )
 {
-	int		start, end;
+	double	start, end;
 
 	start = Plat_FloatTime();
 	dispatch = 0;
@@ -237,11 +405,13 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, RunThreadsFn fn, void *pU
 
 #ifdef _PROFILE
 	threaded = false;
-	(*func)( 0 );
+	fn( 0, pUserData );
 	return;
 #endif
 
-	
+	if (numthreads == -1)
+		ThreadSetDefault ();
+
 	RunThreads_Start( fn, pUserData );
 	RunThreads_End();
 
@@ -250,7 +420,7 @@ void RunThreadsOn( int workcnt, qboolean showpacifier, RunThreadsFn fn, void *pU
 	if (pacifier)
 	{
 		EndPacifier(false);
-		printf (" (%i)\n", end-start);
+		printf (" (%i)\n", (int)(end-start));
 	}
 }
 
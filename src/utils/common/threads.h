@@ -18,7 +18,7 @@
 
 // Arrays that are indexed by thread should always be MAX_TOOL_THREADS+1
 // large so THREADINDEX_MAIN can be used from the main thread.
-#define MAX_TOOL_THREADS	16
+#define MAX_TOOL_THREADS	64
 #define THREADINDEX_MAIN	(MAX_TOOL_THREADS)
 
 
@@ -45,8 +45,15 @@ void SetLowPriority();
 void ThreadSetDefault (void);
 int	GetThreadWork (void);
 
+// Runs fn once for every work item on all threads. Items are handed out in index order in
+// chunks; a thread that runs out of work steals from the others, so a few slow items don't
+// leave the rest of the threads idle.
 void RunThreadsOnIndividual ( int workcnt, qboolean showpacifier, ThreadWorkerFn fn );
 
+// Same, but pflCosts[i] is a rough relative cost for item i, used to size the chunks so each
+// holds about the same amount of work. Only the ratios matter.
+void RunThreadsOnIndividualWeighted ( int workcnt, qboolean showpacifier, ThreadWorkerFn fn, const float *pflCosts );
+
 void RunThreadsOn ( int workcnt, qboolean showpacifier, RunThreadsFn fn, void *pUserData=NULL );
 
 // This version doesn't track work items - it just runs your function and waits for it to finish.
@@ -56,10 +63,15 @@ void RunThreads_End();
 void ThreadLock (void);
 void ThreadUnlock (void);
 
+// The iThread passed to the RunThreads callbacks for the tool thread that's calling,
+// or THREADINDEX_MAIN on the main thread and any thread that RunThreads didn't start.
+int GetCurrentThreadIndex (void);
+
 
 #ifndef NO_THREAD_NAMES
 #define RunThreadsOn(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreadsOn(n,p,f); }
 #define RunThreadsOnIndividual(n,p,f) { if (p) printf("%-20s ", #f ":"); RunThreadsOnIndividual(n,p,f); }
+#define RunThreadsOnIndividualWeighted(n,p,f,c) { if (p) printf("%-20s ", #f ":"); RunThreadsOnIndividualWeighted(n,p,f,c); }
 #endif
 
 #endif // THREADS_H
@@ -5,8 +5,11 @@
 // $NoKeywords: $
 //=============================================================================//
 
+#include "tier0/platform.h"
+#ifdef _WIN32
 #include <windows.h>
 #include <dbghelp.h>
+#endif
 #include "tier0/minidump.h"
 #include "tools_minidump.h"
 
@@ -18,6 +21,7 @@ static ToolsExceptionHandler g_pCustomExceptionHandler = NULL;
 // Internal helpers.
 // --------------------------------------------------------------------------------- //
 
+#ifdef _WIN32
 static LONG __stdcall ToolsExceptionFilter( struct _EXCEPTION_POINTERS *ExceptionInfo )
 {
 	// Non VMPI workers write a minidump and show a crash dialog like normal.
@@ -36,6 +40,7 @@ static LONG __stdcall ToolsExceptionFilter_Custom( struct _EXCEPTION_POINTERS *E
 	g_pCustomExceptionHandler( ExceptionInfo->ExceptionRecord->ExceptionCode, ExceptionInfo );
 	return EXCEPTION_EXECUTE_HANDLER; // (never gets here anyway)
 }
+#endif
 
 
 // --------------------------------------------------------------------------------- //
@@ -50,12 +55,16 @@ void EnableFullMinidumps( bool bFull )
 
 void SetupDefaultToolsMinidumpHandler()
 {
+#ifdef _WIN32
 	SetUnhandledExceptionFilter( ToolsExceptionFilter );
+#endif
 }
 
 
 void SetupToolsMinidumpHandler( ToolsExceptionHandler fn )
 {
 	g_pCustomExceptionHandler = fn;
+#ifdef _WIN32
 	SetUnhandledExceptionFilter( ToolsExceptionFilter_Custom );
+#endif
 }
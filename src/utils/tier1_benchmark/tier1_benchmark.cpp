@@ -0,0 +1,344 @@
+//========= Copyright Valve Corporation, All rights reserved. ============//
+//
+// Purpose: Micro benchmarks for tier1 containers and parsers
+//
+// $NoKeywords: $
+//=============================================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "tier0/platform.h"
+#include "tier0/threadtools.h"
+#include "tier1/KeyValues.h"
+#include "tier1/mempool.h"
+#include "tier1/utlbuffer.h"
+#include "tier1/utlvector.h"
+#include "tier1/strtools.h"
+
+
+void Usage( void )
+{
+	printf( "Usage: tier1_benchmark kv [iterations] file ...\n" );
+	printf( "       tier1_benchmark mempool [block size] [ops per thread]\n" );
+	exit( -1 );
+}
+
+static bool LoadFileIntoBuffer( const char *pFileName, CUtlBuffer &buf )
+{
+	FILE *fp = fopen( pFileName, "rb" );
+	if ( !fp )
+		return false;
+
+	fseek( fp, 0, SEEK_END );
+	int nSize = ftell( fp );
+	fseek( fp, 0, SEEK_SET );
+
+	buf.EnsureCapacity( nSize + 1 );
+	int nBytesRead = fread( buf.Base(), 1, nSize, fp );
+	fclose( fp );
+
+	buf.SeekPut( CUtlBuffer::SEEK_HEAD, nBytesRead );
+	buf.PutChar( 0 );
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------------------------- //
+// KeyValues parse benchmark.
+// ---------------------------------------------------------------------------------------------- //
+
+static KeyValues *FindWidestKeyValuesBlock( KeyValues *pKV, int &nWidest )
+{
+	KeyValues *pWidest = NULL;
+	for ( ; pKV; pKV = pKV->GetNextKey() )
+	{
+		int nChildren = 0;
+		for ( KeyValues *pSub = pKV->GetFirstSubKey(); pSub; pSub = pSub->GetNextKey() )
+		{
+			nChildren++;
+		}
+
+		if ( nChildren > nWidest )
+		{
+			nWidest = nChildren;
+			pWidest = pKV;
+		}
+
+		KeyValues *pSubWidest = FindWidestKeyValuesBlock( pKV->GetFirstSubKey(), nWidest );
+		if ( pSubWidest )
+		{
+			pWidest = pSubWidest;
+		}
+	}
+	return pWidest;
+}
+
+static double TimeKeyValuesLookups( KeyValues *pBlock, const CUtlVector< const char * > &names )
+{
+	double flStart = Plat_FloatTime();
+	int nFound = 0;
+	FOR_EACH_VEC( names, i )
+	{
+		nFound += ( pBlock->FindKey( names[i] ) != NULL );
+	}
+	double flTime = Plat_FloatTime() - flStart;
+
+	Assert( nFound == names.Count() );
+	return flTime;
+}
+
+//-----------------------------------------------------------------------------
+// Compares the normal KeyValues parser with the arena one on the given script
+// files, with the file already in memory so only parsing and freeing count.
+// The lookup test does a FindKey for every child of the widest block.
+//-----------------------------------------------------------------------------
+static void KeyValuesParseBenchmark( int nIterations, const CUtlVector< const char * > &files )
+{
+	FOR_EACH_VEC( files, iFile )
+	{
+		const char *pszFile = files[iFile];
+
+		CUtlBuffer bufText;
+		if ( !LoadFileIntoBuffer( pszFile, bufText ) )
+		{
+			printf( "Can't read %s\n", pszFile );
+			continue;
+		}
+		const char *pszText = (const char *)bufText.Base();
+
+		double flParse[3] = { 0, 0, 0 };
+		double flFree[3] = { 0, 0, 0 };
+		double flLookup[2] = { 0, 0 };
+		int nWidest = 0;
+
+		for ( int i = 0; i < nIterations; i++ )
+		{
+			double flStart = Plat_FloatTime();
+			KeyValues *pHeap = new KeyValues( pszFile );
+			pHeap->LoadFromBuffer( pszFile, pszText );
+			flParse[0] += Plat_FloatTime() - flStart;
+
+			flStart = Plat_FloatTime();
+			KeyValues *pArena = KeyValues::LoadFromBufferArena( pszFile, pszText );
+			flParse[1] += Plat_FloatTime() - flStart;
+
+			flStart = Plat_FloatTime();
+			KeyValues *pIndexed = KeyValues::LoadFromBufferArena( pszFile, pszText, NULL, NULL, KeyValues::ARENA_INDEX_CHILDREN );
+			flParse[2] += Plat_FloatTime() - flStart;
+
+			// both trees have the same shape, so the same walk finds the same block
+			nWidest = 0;
+			KeyValues *pHeapBlock = FindWidestKeyValuesBlock( pHeap, nWidest );
+			nWidest = 0;
+			KeyValues *pIndexedBlock = FindWidestKeyValuesBlock( pIndexed, nWidest );
+			if ( pHeapBlock && pIndexedBlock )
+			{
+				CUtlVector< const char * > names;
+				for ( KeyValues *pSub = pHeapBlock->GetFirstSubKey(); pSub; pSub = pSub->GetNextKey() )
+				{
+					names.AddToTail( pSub->GetName() );
+				}
+
+				flLookup[0] += TimeKeyValuesLookups( pHeapBlock, names );
+				flLookup[1] += TimeKeyValuesLookups( pIndexedBlock, names );
+			}
+
+			KeyValues *pTrees[3] = { pHeap, pArena, pIndexed };
+			for ( int j = 0; j < 3; j++ )
+			{
+				flStart = Plat_FloatTime();
+				pTrees[j]->deleteThis();
+				flFree[j] += Plat_FloatTime() - flStart;
+			}
+		}
+
+		static const char *s_pszParserNames[3] = { "heap", "arena", "arena+index" };
+
+		printf( "%s (%d KB), %d iterations, mean ms:\n", pszFile, bufText.TellPut() / 1024, nIterations );
+		for ( int j = 0; j < 3; j++ )
+		{
+			printf( "  %-12s parse %8.2f  free %6.2f\n", s_pszParserNames[j], flParse[j] * 1000.0 / nIterations, flFree[j] * 1000.0 / nIterations );
+		}
+		printf( "  FindKey on all %d children of the widest block: heap %.3f, arena+index %.3f\n", nWidest, flLookup[0] * 1000.0 / nIterations, flLookup[1] * 1000.0 / nIterations );
+	}
+}
+
+
+// ---------------------------------------------------------------------------------------------- //
+// Thread safe memory pool benchmark.
+// ---------------------------------------------------------------------------------------------- //
+
+#define MEMPOOL_BENCHMARK_LIVE		256		// blocks each thread keeps allocated
+#define MEMPOOL_BENCHMARK_SHARED	1024	// slots threads swap blocks through
+
+template< class POOL >
+struct MemoryPoolBenchmarkThread_t
+{
+	POOL			*m_pPool;
+	int				m_nOps;
+	int				m_iThread;
+	void * volatile	*m_pShared;
+	CInterlockedInt	*m_pReady;
+	volatile bool	*m_pGo;
+};
+
+//-----------------------------------------------------------------------------
+// Each op frees one of the thread's live blocks and allocates a replacement.
+// Every eighth op instead swaps the block through a shared slot, so about one
+// free in eight lands on a block another thread allocated.
+//-----------------------------------------------------------------------------
+template< class POOL >
+static uintp MemoryPoolBenchmarkThread( void *pParam )
+{
+	MemoryPoolBenchmarkThread_t< POOL > *pData = (MemoryPoolBenchmarkThread_t< POOL > *)pParam;
+	POOL *pPool = pData->m_pPool;
+
+	void *pLive[MEMPOOL_BENCHMARK_LIVE];
+	for ( int i = 0; i < MEMPOOL_BENCHMARK_LIVE; i++ )
+	{
+		pLive[i] = pPool->Alloc();
+	}
+
+	++(*pData->m_pReady);
+	while ( !*pData->m_pGo )
+	{
+		ThreadPause();
+	}
+
+	uint32 nSeed = 0x9e3779b9 * ( pData->m_iThread + 1 );
+	for ( int i = 0; i < pData->m_nOps; i++ )
+	{
+		nSeed = nSeed * 1664525 + 1013904223;
+		int iSlot = ( nSeed >> 8 ) % MEMPOOL_BENCHMARK_LIVE;
+
+		if ( ( i & 7 ) == 7 )
+		{
+			int iShared = ( nSeed >> 20 ) % MEMPOOL_BENCHMARK_SHARED;
+			pLive[iSlot] = ThreadInterlockedExchangePointer( &pData->m_pShared[iShared], pLive[iSlot] );
+			if ( pLive[iSlot] )
+				continue;
+		}
+		else
+		{
+			pPool->Free( pLive[iSlot] );
+		}
+
+		pLive[iSlot] = pPool->Alloc();
+		*(int *)pLive[iSlot] = i;
+	}
+
+	for ( int i = 0; i < MEMPOOL_BENCHMARK_LIVE; i++ )
+	{
+		pPool->Free( pLive[i] );
+	}
+	return 0;
+}
+
+// Returns millions of ops per second across all threads
+template< class POOL >
+static double TimeMemoryPool( int nBlockSize, int nThreads, int nOpsPerThread )
+{
+	POOL pool( nBlockSize, 4096, UTLMEMORYPOOL_GROW_FAST, "mempool_mt_benchmark" );
+
+	void *pShared[MEMPOOL_BENCHMARK_SHARED];
+	memset( pShared, 0, sizeof( pShared ) );
+
+	CInterlockedInt nReady;
+	volatile bool bGo = false;
+
+	CUtlVector< MemoryPoolBenchmarkThread_t< POOL > > threadData;
+	CUtlVector< ThreadHandle_t > threads;
+	threadData.SetCount( nThreads );
+	for ( int i = 0; i < nThreads; i++ )
+	{
+		MemoryPoolBenchmarkThread_t< POOL > &data = threadData[i];
+		data.m_pPool = &pool;
+		data.m_nOps = nOpsPerThread;
+		data.m_iThread = i;
+		data.m_pShared = pShared;
+		data.m_pReady = &nReady;
+		data.m_pGo = &bGo;
+		threads.AddToTail( CreateSimpleThread( MemoryPoolBenchmarkThread< POOL >, &data ) );
+	}
+
+	while ( nReady < nThreads )
+	{
+		ThreadSleep( 0 );
+	}
+
+	double flStart = Plat_FloatTime();
+	bGo = true;
+	FOR_EACH_VEC( threads, i )
+	{
+		ThreadJoin( threads[i] );
+		ReleaseThreadHandle( threads[i] );
+	}
+	double flTime = Plat_FloatTime() - flStart;
+
+	for ( int i = 0; i < MEMPOOL_BENCHMARK_SHARED; i++ )
+	{
+		pool.Free( pShared[i] );
+	}
+	Assert( pool.Count() == 0 );
+
+	return (double)nThreads * nOpsPerThread / MAX( flTime, 1e-6 ) / 1e6;
+}
+
+//-----------------------------------------------------------------------------
+// Compares the magazine CMemoryPoolMT with the mutex pool it replaced
+//-----------------------------------------------------------------------------
+static void MemoryPoolBenchmark( int nBlockSize, int nOps )
+{
+	printf( "%d byte blocks, %d ops per thread, millions of ops/s:\n", nBlockSize, nOps );
+	printf( "  threads     mutex  magazine\n" );
+	for ( int nThreads = 1; nThreads <= 64; nThreads *= 2 )
+	{
+		double flMutex = TimeMemoryPool< CMemoryPoolMutexMT >( nBlockSize, nThreads, nOps );
+		double flMagazine = TimeMemoryPool< CMemoryPoolMT >( nBlockSize, nThreads, nOps );
+		printf( "  %7d  %8.2f  %8.2f\n", nThreads, flMutex, flMagazine );
+	}
+}
+
+
+int main( int argc, char **argv )
+{
+	if ( argc < 2 )
+	{
+		Usage();
+	}
+
+	if ( !V_stricmp( argv[1], "kv" ) )
+	{
+		int iArg = 2;
+		int nIterations = 5;
+		if ( argc > iArg && V_isdigit( argv[iArg][0] ) )
+		{
+			nIterations = MAX( V_atoi( argv[iArg++] ), 1 );
+		}
+
+		CUtlVector< const char * > files;
+		for ( ; iArg < argc; iArg++ )
+		{
+			files.AddToTail( argv[iArg] );
+		}
+		if ( !files.Count() )
+		{
+			Usage();
+		}
+
+		KeyValuesParseBenchmark( nIterations, files );
+		return 0;
+	}
+
+	if ( !V_stricmp( argv[1], "mempool" ) )
+	{
+		int nBlockSize = ( argc > 2 ) ? MAX( V_atoi( argv[2] ), 1 ) : 64;
+		int nOps = ( argc > 3 ) ? MAX( V_atoi( argv[3] ), 1 ) : 1000000;
+
+		MemoryPoolBenchmark( nBlockSize, nOps );
+		return 0;
+	}
+
+	Usage();
+	return 0;
+}
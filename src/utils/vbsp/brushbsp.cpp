@@ -303,6 +303,44 @@ tree_t *AllocTree (void)
 	return tree;
 }
 
+//-----------------------------------------------------------------------------
+// Brushes and nodes are recycled through free lists, one set per tool thread like
+// polylib's winding pools, so the block BSPs can run on all threads without fighting
+// over the heap. Threads that RunThreads didn't start share the main lists.
+//
+// Brushes are kept by the number of sides they were allocated with. That's stored in
+// front of the brush, because numsides changes as a brush is built.
+//-----------------------------------------------------------------------------
+#define MAX_POOLED_BRUSH_SIDES	64
+
+struct pooledbrush_t
+{
+	pooledbrush_t	*next;			// while on a free list
+	int				allocsides;		// -1 if too big to pool
+};
+
+static pooledbrush_t	*s_BrushPool[MAX_TOOL_THREADS+1][MAX_POOLED_BRUSH_SIDES+1];
+static node_t			*s_NodePool[MAX_TOOL_THREADS+1];
+static CThreadFastMutex	s_MainPoolMutex;
+
+class CBrushPoolAutoLock
+{
+public:
+	CBrushPoolAutoLock( int iThread ) : m_bLocked( iThread == THREADINDEX_MAIN )
+	{
+		if ( m_bLocked )
+			s_MainPoolMutex.Lock();
+	}
+	~CBrushPoolAutoLock()
+	{
+		if ( m_bLocked )
+			s_MainPoolMutex.Unlock();
+	}
+
+private:
+	bool m_bLocked;
+};
+
 /*
 ================
 AllocNode
@@ -310,20 +348,46 @@ AllocNode
 */
 node_t *AllocNode (void)
 {
-	static int s_NodeCount = 0;
+	static CInterlockedInt s_NodeCount;
+
+	node_t	*node = NULL;
 
-	node_t	*node;
+	int iThread = GetCurrentThreadIndex();
+	{
+		CBrushPoolAutoLock lock( iThread );
+		node = s_NodePool[iThread];
+		if ( node )
+		{
+			s_NodePool[iThread] = node->parent;
+		}
+	}
 
-	node = (node_t*)malloc(sizeof(*node));
+	if ( !node )
+	{
+		node = (node_t*)malloc(sizeof(*node));
+	}
 	memset (node, 0, sizeof(*node));
-	node->id = s_NodeCount;
+	node->id = s_NodeCount++;
 	node->diskId = -1;
 
-	s_NodeCount++;
-
 	return node;
 }
 
+/*
+================
+FreeNode
+================
+*/
+void FreeNode (node_t *node)
+{
+	int iThread = GetCurrentThreadIndex();
+	CBrushPoolAutoLock lock( iThread );
+
+	// the free list runs through parent
+	node->parent = s_NodePool[iThread];
+	s_NodePool[iThread] = node;
+}
+
 
 /*
 ================
@@ -332,13 +396,32 @@ AllocBrush
 */
 bspbrush_t *AllocBrush (int numsides)
 {
-	static int s_BrushId = 0;
+	static CInterlockedInt s_BrushId;
 
 	bspbrush_t	*bb;
 	int			c;
+	pooledbrush_t *block = NULL;
 
 	c = (int)&(((bspbrush_t *)0)->sides[numsides]);
-	bb = (bspbrush_t*)malloc(c);
+
+	if ( numsides <= MAX_POOLED_BRUSH_SIDES )
+	{
+		int iThread = GetCurrentThreadIndex();
+		CBrushPoolAutoLock lock( iThread );
+		block = s_BrushPool[iThread][numsides];
+		if ( block )
+		{
+			s_BrushPool[iThread][numsides] = block->next;
+		}
+	}
+
+	if ( !block )
+	{
+		block = (pooledbrush_t *)malloc( sizeof( pooledbrush_t ) + c );
+		block->allocsides = ( numsides <= MAX_POOLED_BRUSH_SIDES ) ? numsides : -1;
+	}
+
+	bb = (bspbrush_t *)( block + 1 );
 	memset (bb, 0, c);
 	bb->id = s_BrushId++;
 	if (numthreads == 1)
@@ -358,11 +441,57 @@ void FreeBrush (bspbrush_t *brushes)
 	for (i=0 ; i<brushes->numsides ; i++)
 		if (brushes->sides[i].winding)
 			FreeWinding(brushes->sides[i].winding);
-	free (brushes);
+
+	pooledbrush_t *block = (pooledbrush_t *)brushes - 1;
+	if ( block->allocsides < 0 )
+	{
+		free (block);
+	}
+	else
+	{
+		int iThread = GetCurrentThreadIndex();
+		CBrushPoolAutoLock lock( iThread );
+		block->next = s_BrushPool[iThread][block->allocsides];
+		s_BrushPool[iThread][block->allocsides] = block;
+	}
+
 	if (numthreads == 1)
 		c_active_brushes--;
 }
 
+/*
+================
+FreeBrushPools
+
+Hands everything on the brush and node free lists back to the heap.
+Don't call this while threads are running.
+================
+*/
+void FreeBrushPools (void)
+{
+	for ( int iThread = 0; iThread <= MAX_TOOL_THREADS; iThread++ )
+	{
+		for ( int nSides = 0; nSides <= MAX_POOLED_BRUSH_SIDES; nSides++ )
+		{
+			pooledbrush_t *next;
+			for ( pooledbrush_t *block = s_BrushPool[iThread][nSides]; block; block = next )
+			{
+				next = block->next;
+				free( block );
+			}
+			s_BrushPool[iThread][nSides] = NULL;
+		}
+
+		node_t *next;
+		for ( node_t *node = s_NodePool[iThread]; node; node = next )
+		{
+			next = node->parent;
+			free( node );
+		}
+		s_NodePool[iThread] = NULL;
+	}
+}
+
 
 /*
 ================
@@ -764,7 +893,7 @@ void LeafNode (node_t *node, bspbrush_t *brushes)
 	{
 		// if the brush is solid and all of its sides are on nodes,
 		// it eats everything
-		if (b->original->contents & CONTENTS_SOLID)
+		if (b->contents & CONTENTS_SOLID)
 		{
 			for (i=0 ; i<b->numsides ; i++)
 				if (b->sides[i].texinfo != TEXINFO_NODE)
@@ -775,7 +904,7 @@ void LeafNode (node_t *node, bspbrush_t *brushes)
 				break;
 			}
 		}
-		node->contents |= b->original->contents;
+		node->contents |= b->contents;
 	}
 
 	node->brushlist = brushes;
@@ -839,6 +968,198 @@ qboolean CheckPlaneAgainstVolume (int pnum, node_t *node)
 	return good;
 }
 
+/*
+================
+SplitPlaneValue
+
+Value estimate for splitting with side's plane, given how the brushes fell against it
+================
+*/
+static int SplitPlaneValue (side_t *side, int pnum, int facing, int splits, int front, int back,
+							int epsilonbrush, qboolean hintsplit)
+{
+	int value;
+
+	// give a value estimate for using this plane
+	value =  5*facing - 5*splits - abs(front-back);
+//		value =  -5*splits;
+//		value =  5*facing - 5*splits;
+	if (g_MainMap->mapplanes[pnum].type < 3)
+		value+=5;		// axial is better
+	value -= epsilonbrush*1000;	// avoid!
+
+	// trans should split last
+	if ( side->surf & SURF_TRANS )
+	{
+		value -= 500;
+	}
+
+	// never split a hint side except with another hint
+	if (hintsplit && !(side->surf & SURF_HINT) )
+		value = -9999999;
+
+	// water should split first
+	if (side->contents & (CONTENTS_WATER | CONTENTS_SLIME))
+		value = 9999999;
+
+	return value;
+}
+
+
+//-----------------------------------------------------------------------------
+// Threaded split selection for the big brush lists that get built on the main
+// thread. Scoring a plane only reads the brush list, so all the candidate planes
+// are scored on the tool threads, then the best is picked in the order the serial
+// loop would have tried them. That gives the same split, so the same tree.
+//-----------------------------------------------------------------------------
+
+// Nodes with fewer brush/side tests than this aren't worth starting threads for
+#define MIN_THREADED_SPLIT_TESTS	32768
+
+struct splitcandidate_t
+{
+	side_t		*side;
+	int			pnum;
+	bool		valid;		// passed CheckPlaneAgainstVolume
+	int			value;
+};
+
+static bspbrush_t	*s_pSplitBrushes;
+static node_t		*s_pSplitNode;
+static CUtlVector<splitcandidate_t> s_SplitCandidates;
+static CInterlockedInt s_iNextSplitCandidate;
+
+static void ScoreSplitCandidate (splitcandidate_t &cand, bspbrush_t *brushes, node_t *node)
+{
+	bspbrush_t	*test;
+	int			s, bsplits;
+	int			front = 0, back = 0, facing = 0, splits = 0, epsilonbrush = 0;
+	qboolean	hintsplit = false;
+
+	cand.valid = CheckPlaneAgainstVolume (cand.pnum, node) != 0;
+	if (!cand.valid)
+		return;
+
+	for (test = brushes ; test ; test=test->next)
+	{
+		s = TestBrushToPlanenum (test, cand.pnum, &bsplits, &hintsplit, &epsilonbrush);
+
+		splits += bsplits;
+		if (bsplits && (s&PSIDE_FACING) )
+			Error ("PSIDE_FACING with splits");
+
+		if (s & PSIDE_FACING)
+			facing++;
+		if (s & PSIDE_FRONT)
+			front++;
+		if (s & PSIDE_BACK)
+			back++;
+	}
+
+	cand.value = SplitPlaneValue (cand.side, cand.pnum, facing, splits, front, back, epsilonbrush, hintsplit);
+}
+
+static void ScoreSplitCandidatesThread (int iThread, void *pUserData)
+{
+	while (1)
+	{
+		int i = s_iNextSplitCandidate++;
+		if (i >= s_SplitCandidates.Count())
+			break;
+		ScoreSplitCandidate (s_SplitCandidates[i], s_pSplitBrushes, s_pSplitNode);
+	}
+}
+
+static side_t *SelectSplitSideThreaded (bspbrush_t *brushes, node_t *node)
+{
+	bspbrush_t	*brush;
+	side_t		*side, *bestside;
+	int			i, pass, pnum;
+	int			bestvalue;
+
+	// The serial loop flags every side on a plane as tested once the plane passes the
+	// volume check, and a plane that fails it fails again for every other side on it,
+	// so each plane only needs scoring for the first side that reaches it.
+	enum { PLANE_UNTRIED = 0, PLANE_CANDIDATE, PLANE_TESTED };
+	CUtlVector<unsigned char> planeState;
+	planeState.SetCount (g_MainMap->nummapplanes);
+	memset (planeState.Base(), PLANE_UNTRIED, planeState.Count());
+
+	bestside = NULL;
+	bestvalue = -99999;
+
+	for (pass = 0 ; pass < 2 && !bestside ; pass++)
+	{
+		s_SplitCandidates.RemoveAll();
+		for (brush = brushes ; brush ; brush=brush->next)
+		{
+			for (i=0 ; i<brush->numsides ; i++)
+			{
+				side = brush->sides + i;
+
+				if (side->bevel || !side->winding || side->texinfo == TEXINFO_NODE)
+					continue;
+				if (side->surf & SURF_SKIP)
+					continue;
+				if ( side->visible ^ (pass<1) )
+					continue;
+
+				pnum = side->planenum & ~1;
+				if (planeState[pnum] != PLANE_UNTRIED)
+					continue;
+				planeState[pnum] = PLANE_CANDIDATE;
+
+				CheckPlaneAgainstParents (pnum, node);
+
+				int iCand = s_SplitCandidates.AddToTail();
+				s_SplitCandidates[iCand].side = side;
+				s_SplitCandidates[iCand].pnum = pnum;
+			}
+		}
+
+		if (!s_SplitCandidates.Count())
+			continue;
+
+		s_pSplitBrushes = brushes;
+		s_pSplitNode = node;
+		s_iNextSplitCandidate = 0;
+		RunThreads_Start (ScoreSplitCandidatesThread, NULL);
+		RunThreads_End ();
+
+		for (i=0 ; i<s_SplitCandidates.Count() ; i++)
+		{
+			splitcandidate_t &cand = s_SplitCandidates[i];
+			if (!cand.valid)
+			{
+				planeState[cand.pnum] = PLANE_UNTRIED;
+				continue;
+			}
+
+			planeState[cand.pnum] = PLANE_TESTED;
+			if (cand.value > bestvalue)
+			{
+				bestvalue = cand.value;
+				bestside = cand.side;
+			}
+		}
+	}
+
+	// save off the side test so we don't need to recalculate it
+	// when we actually seperate the brushes
+	if (bestside)
+	{
+		int			bsplits, epsilonbrush = 0;
+		qboolean	hintsplit;
+
+		pnum = bestside->planenum & ~1;
+		for (brush = brushes ; brush ; brush=brush->next)
+			brush->side = TestBrushToPlanenum (brush, pnum, &bsplits, &hintsplit, &epsilonbrush);
+	}
+
+	return bestside;
+}
+
+
 /*
 ================
 SelectSplitSide
@@ -863,6 +1184,19 @@ side_t *SelectSplitSide (bspbrush_t *brushes, node_t *node)
 	int			epsilonbrush;
 	qboolean	hintsplit = false;
 
+	// big lists on the main thread get scored on all the threads
+	if ( numthreads > 1 && GetCurrentThreadIndex() == THREADINDEX_MAIN )
+	{
+		int nBrushes = 0, nSides = 0;
+		for (brush = brushes ; brush ; brush=brush->next)
+		{
+			nBrushes++;
+			nSides += brush->numsides;
+		}
+		if ( nBrushes * nSides >= MIN_THREADED_SPLIT_TESTS )
+			return SelectSplitSideThreaded (brushes, node);
+	}
+
 	bestside = NULL;
 	bestvalue = -99999;
 	bestsplits = 0;
@@ -935,27 +1269,7 @@ side_t *SelectSplitSide (bspbrush_t *brushes, node_t *node)
 						both++;
 				}
 
-				// give a value estimate for using this plane
-				value =  5*facing - 5*splits - abs(front-back);
-//					value =  -5*splits;
-//					value =  5*facing - 5*splits;
-				if (g_MainMap->mapplanes[pnum].type < 3)
-					value+=5;		// axial is better
-				value -= epsilonbrush*1000;	// avoid!
-
-				// trans should split last
-				if ( side->surf & SURF_TRANS )
-				{
-					value -= 500;
-				}
-
-				// never split a hint side except with another hint
-				if (hintsplit && !(side->surf & SURF_HINT) )
-					value = -9999999;
-
-				// water should split first
-				if (side->contents & (CONTENTS_WATER | CONTENTS_SLIME))
-					value = 9999999;
+				value = SplitPlaneValue (side, pnum, facing, splits, front, back, epsilonbrush, hintsplit);
 
 				// save off the side test so we don't need
 				// to recalculate it when we actually seperate
@@ -1131,6 +1445,7 @@ void SplitBrush( bspbrush_t *brush, int planenum, bspbrush_t **front, bspbrush_t
 	{
 		b[i] = AllocBrush( brush->numsides + 1 );
 		b[i]->original = brush->original;
+		b[i]->contents = brush->contents;
 	}
 
     //
@@ -1324,6 +1639,33 @@ void SplitBrushList (bspbrush_t *brushes,
 }
 
 
+/*
+================
+OriginalSplitSide
+
+The brush list is freed as soon as it's split, and freed brushes go straight back
+into use, so point the node at the map brush side the split side was copied from.
+================
+*/
+static side_t *OriginalSplitSide (bspbrush_t *brushes, side_t *side)
+{
+	for (bspbrush_t *brush = brushes ; brush ; brush=brush->next)
+	{
+		if (side < brush->sides || side >= brush->sides + brush->numsides)
+			continue;
+
+		mapbrush_t *mb = brush->original;
+		for (int i=0 ; i<mb->numsides ; i++)
+		{
+			if (mb->original_sides[i].planenum == side->planenum)
+				return &mb->original_sides[i];
+		}
+		break;
+	}
+	return NULL;
+}
+
+
 /*
 ================
 BuildTree_r
@@ -1354,7 +1696,7 @@ node_t *BuildTree_r (node_t *node, bspbrush_t *brushes)
 	}
 			 
 	// this is a splitplane node
-	node->side = bestside;
+	node->side = OriginalSplitSide (brushes, bestside);
 	node->planenum = bestside->planenum & ~1;	// always use front facing
 
 	SplitBrushList (brushes, node, &children[0], &children[1]);
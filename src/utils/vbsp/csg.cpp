@@ -231,6 +231,7 @@ static bspbrush_t *CreateClippedBrush( mapbrush_t *mb, const Vector& clipmins, c
 	// make a copy of the brush
 	bspbrush_t *newbrush = AllocBrush( nNumSides );
 	newbrush->original = mb;
+	newbrush->contents = mb->contents;
 	newbrush->numsides = nNumSides;
 	memcpy (newbrush->sides, mb->original_sides, nNumSides*sizeof(side_t));
 
@@ -632,20 +633,20 @@ qboolean BrushGE (bspbrush_t *b1, bspbrush_t *b2)
 	// Areaportals are allowed to bite water + slime
 	// NOTE: This brush combo should have been fixed up
 	// in a first pass (FixupAreaportalWaterBrushes)
-	if( (b2->original->contents & MASK_SPLITAREAPORTAL) && 
-		(b1->original->contents & CONTENTS_AREAPORTAL) )
+	if( (b2->contents & MASK_SPLITAREAPORTAL) && 
+		(b1->contents & CONTENTS_AREAPORTAL) )
 	{
 		return true;
 	}
 	
 	// detail brushes never bite structural brushes
-	if ( (b1->original->contents & CONTENTS_DETAIL) 
-		&& !(b2->original->contents & CONTENTS_DETAIL) )
+	if ( (b1->contents & CONTENTS_DETAIL) 
+		&& !(b2->contents & CONTENTS_DETAIL) )
 		return false;
-	if (b1->original->contents & CONTENTS_SOLID)
+	if (b1->contents & CONTENTS_SOLID)
 		return true;
 	// Transparent brushes are not marked as detail anymore, so let them cut each other.
-	if ( (b1->original->contents & TRANSPARENT_CONTENTS) && (b2->original->contents & TRANSPARENT_CONTENTS) )
+	if ( (b1->contents & TRANSPARENT_CONTENTS) && (b2->contents & TRANSPARENT_CONTENTS) )
 		return true;
 
 	return false;
@@ -732,8 +733,8 @@ newlist:
 			// (commening this out allows full fragmentation)
 			if (c1 > 1 && c2 > 1)
 			{
-				const int contents1 = b1->original->contents;
-				const int contents2 = b2->original->contents;
+				const int contents1 = b1->contents;
+				const int contents2 = b2->contents;
 				// if both detail, allow fragmentation
 				if ( !((contents1&contents2) & CONTENTS_DETAIL) && !((contents1|contents2) & CONTENTS_AREAPORTAL) )
 				{
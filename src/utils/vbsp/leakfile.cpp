@@ -7,7 +7,7 @@
 //=============================================================================//
 
 #include "vbsp.h"
-#include "color.h"
+#include "Color.h"
 
 /*
 ==============================================================================
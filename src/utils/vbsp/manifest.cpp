@@ -3,7 +3,9 @@
 #include "map_shared.h"
 #include "fgdlib/fgdlib.h"
 #include "manifest.h"
+#ifdef _WIN32
 #include "windows.h"
+#endif
 
 //-----------------------------------------------------------------------------
 // Purpose: default constructor
@@ -355,6 +357,8 @@ bool CManifest::LoadSubMaps( CMapFile *pMapFile, const char *pszFileName )
 bool CManifest::LoadVMFManifestUserPrefs( const char *pszFileName )
 {
 	char		UserName[ MAX_PATH ], FileName[ MAX_PATH ], UserPrefsFileName[ MAX_PATH ];
+
+#ifdef _WIN32
 	DWORD		UserNameSize;
 
 	UserNameSize = sizeof( UserName );
@@ -362,6 +366,10 @@ bool CManifest::LoadVMFManifestUserPrefs( const char *pszFileName )
 	{
 		strcpy( UserPrefsFileName, "default" );
 	}
+#else
+	const char *pszUser = getenv( "USER" );
+	V_strncpy( UserName, pszUser ? pszUser : "default", sizeof( UserName ) );
+#endif
 
 	sprintf( UserPrefsFileName, "\\%s.vmm_prefs", UserName );
 	V_StripExtension( pszFileName, FileName, sizeof( FileName ) );
@@ -147,13 +147,81 @@ node_t	*BlockTree (int xl, int yl, int xh, int yh)
 	return node;
 }
 
+int			brush_start, brush_end;
+
+// one brush list per block, clipped to the block
+static CUtlVector<bspbrush_t *> g_BlockBrushes;
+
+static void BlockBounds (int blocknum, int &xblock, int &yblock, Vector &mins, Vector &maxs)
+{
+	yblock = block_yl + blocknum / (block_xh-block_xl+1);
+	xblock = block_xl + blocknum % (block_xh-block_xl+1);
+
+	mins[0] = xblock*BLOCKS_SIZE;
+	mins[1] = yblock*BLOCKS_SIZE;
+	mins[2] = MIN_COORD_INTEGER;
+	maxs[0] = (xblock+1)*BLOCKS_SIZE;
+	maxs[1] = (yblock+1)*BLOCKS_SIZE;
+	maxs[2] = MAX_COORD_INTEGER;
+}
+
+/*
+============
+MakeBlockBrushes
+
+Clips the world brushes to every block on the main thread. That's where the
+blocks create their planes and fix up their areaportal brushes, so doing it up
+front in block order leaves ProcessBlock_Thread with nothing shared to write,
+and the planes are numbered the same however many threads build the blocks.
+============
+*/
+static void MakeBlockBrushes (int numblocks, CUtlVector<float> &costs)
+{
+	int		xblock, yblock;
+	Vector		mins, maxs;
+	bspbrush_t	*brushes;
+
+	g_BlockBrushes.SetCount (numblocks);
+	costs.SetCount (numblocks);
+
+	for (int blocknum = 0 ; blocknum < numblocks ; blocknum++)
+	{
+		BlockBounds (blocknum, xblock, yblock, mins, maxs);
+
+		// the makelist and chopbrushes could be cached between the passes...
+		brushes = MakeBspBrushList (brush_start, brush_end, mins, maxs, NO_DETAIL);
+		g_BlockBrushes[blocknum] = brushes;
+		if (!brushes)
+		{
+			costs[blocknum] = 1;
+			continue;
+		}
+
+		FixupAreaportalWaterBrushes( brushes );
+
+		// The fixup ORs water into the shared mapbrush contents, so a later block can
+		// still change them. Chopping and BrushBSP read this block's snapshot instead,
+		// which is what they saw when each block was fixed up and built in turn.
+		for ( bspbrush_t *b = brushes; b; b = b->next )
+		{
+			b->contents = b->original->contents;
+		}
+
+		// BrushBSP's volume for the block needs these planes as well
+		FreeBrush (BrushFromBounds (mins, maxs));
+
+		// chopping and split selection both test every brush against every other
+		float flBrushes = CountBrushList (brushes);
+		costs[blocknum] = flBrushes * flBrushes;
+	}
+}
+
 /*
 ============
 ProcessBlock_Thread
 
 ============
 */
-int			brush_start, brush_end;
 void ProcessBlock_Thread (int threadnum, int blocknum)
 {
 	int		xblock, yblock;
@@ -162,20 +230,12 @@ void ProcessBlock_Thread (int threadnum, int blocknum)
 	tree_t		*tree;
 	node_t		*node;
 
-	yblock = block_yl + blocknum / (block_xh-block_xl+1);
-	xblock = block_xl + blocknum % (block_xh-block_xl+1);
+	BlockBounds (blocknum, xblock, yblock, mins, maxs);
 
 	qprintf ("############### block %2i,%2i ###############\n", xblock, yblock);
 
-	mins[0] = xblock*BLOCKS_SIZE;
-	mins[1] = yblock*BLOCKS_SIZE;
-	mins[2] = MIN_COORD_INTEGER;
-	maxs[0] = (xblock+1)*BLOCKS_SIZE;
-	maxs[1] = (yblock+1)*BLOCKS_SIZE;
-	maxs[2] = MAX_COORD_INTEGER;
-
-	// the makelist and chopbrushes could be cached between the passes...
-	brushes = MakeBspBrushList (brush_start, brush_end, mins, maxs, NO_DETAIL);
+	brushes = g_BlockBrushes[blocknum];
+	g_BlockBrushes[blocknum] = NULL;
 	if (!brushes)
 	{
 		node = AllocNode ();
@@ -185,7 +245,6 @@ void ProcessBlock_Thread (int threadnum, int blocknum)
 		return;
 	}    
 
-	FixupAreaportalWaterBrushes( brushes );
 	if (!nocsg)
 		brushes = ChopBrushes (brushes);
 
@@ -260,8 +319,10 @@ void ProcessWorldModel (void)
 	{
 		qprintf ("--------------------------------------------\n");
 
-		RunThreadsOnIndividual ((block_xh-block_xl+1)*(block_yh-block_yl+1),
-			!verbose, ProcessBlock_Thread);
+		int numblocks = (block_xh-block_xl+1)*(block_yh-block_yl+1);
+		CUtlVector<float> blockCosts;
+		MakeBlockBrushes (numblocks, blockCosts);
+		RunThreadsOnIndividualWeighted (numblocks, !verbose, ProcessBlock_Thread, blockCosts.Base());
 
 		//
 		// build the division tree
@@ -319,6 +380,9 @@ void ProcessWorldModel (void)
 		}
 	}
 
+	// the finished tree holds what it needs; return the rest to the heap
+	FreeBrushPools ();
+
 	FloodAreas (tree);
 
 	RemoveAreaPortalBrushes_R( tree->headnode );
@@ -1299,7 +1363,6 @@ int RunVBSP( int argc, char **argv )
 	}
 
 	ThreadSetDefault ();
-	numthreads = 1;		// multiple threads aren't helping...
 
 	// Setup the logfile.
 	char logFile[512];
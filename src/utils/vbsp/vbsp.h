@@ -18,7 +18,7 @@
 #include "bsplib.h"
 #include "qfiles.h"
 #include "utilmatlib.h"
-#include "ChunkFile.h"
+#include "chunkfile.h"
 
 #ifdef WIN32
 #pragma warning( disable: 4706 )
@@ -181,6 +181,7 @@ struct bspbrush_t
 	Vector	            mins, maxs;
 	int		            side, testside;		// side of node during construction
 	mapbrush_t	        *original;
+	int					contents;			// original->contents as of this brush's block fixup
 	int		            numsides;
 	side_t	            sides[6];			// variably sized
 };
@@ -471,9 +472,11 @@ void SplitBrush (bspbrush_t *brush, int planenum,
 
 tree_t *AllocTree (void);
 node_t *AllocNode (void);
+void FreeNode (node_t *node);
 bspbrush_t *AllocBrush (int numsides);
 int	CountBrushList (bspbrush_t *brushes);
 void FreeBrush (bspbrush_t *brushes);
+void FreeBrushPools (void);
 vec_t BrushVolume (bspbrush_t *brush);
 node_t *NodeForPoint (node_t *node, Vector& origin);
 
@@ -481,6 +484,7 @@ void BoundBrush (bspbrush_t *brush);
 void FreeBrushList (bspbrush_t *brushes);
 node_t	*PointInLeaf (node_t *node, Vector& point);
 
+bspbrush_t *BrushFromBounds (Vector& mins, Vector& maxs);
 tree_t *BrushBSP (bspbrush_t *brushlist, Vector& mins, Vector& maxs);
 
 #define	PSIDE_FRONT			1
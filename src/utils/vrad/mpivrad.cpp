@@ -37,6 +37,7 @@ CUtlVector<char> g_LightResultsFilename;
 
 
 extern int total_transfer;
+extern int total_transferblocks;
 extern int max_transfer;
 
 extern void BuildVisLeafs(int);
@@ -297,11 +298,14 @@ void MPI_ReceiveVisLeafsResults( uint64 iWorkUnit, MessageBuffer *pBuf, int iWor
 		patch->numtransfers = numtransfers;
 		if (numtransfers) 
 		{
-			patch->transfers = new transfer_t[numtransfers];
-			pBuf->read(patch->transfers, numtransfers * sizeof(transfer_t));
+			pBuf->read( &patch->numtransferblocks, sizeof(patch->numtransferblocks) );
+			pBuf->read( &patch->transferScale, sizeof(patch->transferScale) );
+			patch->transferBlocks = (transferblock_t *)malloc( patch->numtransferblocks * sizeof(transferblock_t) );
+			pBuf->read( patch->transferBlocks, patch->numtransferblocks * sizeof(transferblock_t) );
 		}
 		
 		total_transfer += numtransfers;
+		total_transferblocks += patch->numtransferblocks;
 		if (max_transfer < numtransfers) 
 			max_transfer = numtransfers;
 	}
@@ -333,7 +337,12 @@ void MPI_AddPatchData( int iThread, int patchnum, CPatch *patch )
 		++pData->m_nPatchesInCluster;
 		pData->m_pVisLeafsMB->write(&patchnum, sizeof(patchnum));
 		pData->m_pVisLeafsMB->write(&patch->numtransfers, sizeof(patch->numtransfers));
-		pData->m_pVisLeafsMB->write( patch->transfers, patch->numtransfers * sizeof(transfer_t) );
+		if ( patch->numtransfers )
+		{
+			pData->m_pVisLeafsMB->write( &patch->numtransferblocks, sizeof(patch->numtransferblocks) );
+			pData->m_pVisLeafsMB->write( &patch->transferScale, sizeof(patch->transferScale) );
+			pData->m_pVisLeafsMB->write( patch->transferBlocks, patch->numtransferblocks * sizeof(transferblock_t) );
+		}
 	}
 }
 
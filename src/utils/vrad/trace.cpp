@@ -11,8 +11,9 @@
 
 #include "vrad.h"
 #include "trace.h"
-#include "Cmodel.h"
+#include "cmodel.h"
 #include "mathlib/vmatrix.h"
+#include "vstdlib/random.h"
 
 
 //=============================================================================
@@ -133,7 +134,7 @@ public:
 			addedCoverage[s] = 0.0f;
 			if ( ( sign >> s) & 0x1 )
 			{
-				addedCoverage[s] = ComputeCoverageFromTexture( b0->m128_f32[s], b1->m128_f32[s], b2->m128_f32[s], hitID );
+				addedCoverage[s] = ComputeCoverageFromTexture( SubFloat( *b0, s ), SubFloat( *b1, s ), SubFloat( *b2, s ), hitID );
 			}
 		}
 		m_coverage = AddSIMD( m_coverage, LoadUnalignedSIMD( addedCoverage ) );
@@ -169,7 +170,7 @@ void TestLine( const FourVectors& start, const FourVectors& stop,
 	{
 		visibility[i] = 1.0f;
 		if ( ( rt_result.HitIds[i] != -1 ) &&
-		     ( rt_result.HitDistance.m128_f32[i] < len.m128_f32[i] ) )
+		     ( SubFloat( rt_result.HitDistance, i ) < SubFloat( len, i ) ) )
 		{
 			visibility[i] = 0.0f;
 		}
@@ -373,7 +374,7 @@ void TestLine_DoesHitSky( FourVectors const& start, FourVectors const& stop,
 	{
 		aOcclusion[i] = 0.0f;
 		if ( ( rt_result.HitIds[i] != -1 ) &&
-		     ( rt_result.HitDistance.m128_f32[i] < len.m128_f32[i] ) )
+		     ( SubFloat( rt_result.HitDistance, i ) < SubFloat( len, i ) ) )
 		{
 			int id = g_RtEnv.OptimizedTriangleList[rt_result.HitIds[i]].m_Data.m_IntersectData.m_nTriangleID;
 			if ( !( id & TRACE_ID_SKY ) )
@@ -651,3 +652,108 @@ void AddBrushesForRayTrace( void )
 		}
 	}
 }
+
+
+//-----------------------------------------------------------------------------
+// -rtbench: fire random and coherent ray sets through the acceleration structure
+// that was just built, four and eight rays at a time, and report the throughput.
+//-----------------------------------------------------------------------------
+#define RTBENCH_PACKETS			( 1 << 17 )					// 8 rays each
+#define RTBENCH_MAX_DIST		16384.0f
+
+static void MakeBenchmarkRays( CUtlVector<EightRays> &rays, bool bCoherent )
+{
+	CUniformRandomStream random;
+	random.SetSeed( bCoherent ? 2 : 1 );
+
+	const Vector &mins = g_RtEnv.m_MinBound;
+	const Vector &maxs = g_RtEnv.m_MaxBound;
+
+	rays.SetCount( RTBENCH_PACKETS );
+	for ( int i = 0; i < rays.Count(); i++ )
+	{
+		// coherent packets are 8 rays from about the same point in about the same direction,
+		// like the sample rays of one luxel
+		Vector vecBaseOrigin( random.RandomFloat( mins.x, maxs.x ), random.RandomFloat( mins.y, maxs.y ), random.RandomFloat( mins.z, maxs.z ) );
+		Vector vecBaseDir( random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ) );
+		for ( int k = 0; k < 8; k++ )
+		{
+			Vector vecOrigin, vecDir;
+			if ( bCoherent )
+			{
+				vecOrigin = vecBaseOrigin + Vector( random.RandomFloat( -8, 8 ), random.RandomFloat( -8, 8 ), random.RandomFloat( -8, 8 ) );
+				vecDir = vecBaseDir + Vector( random.RandomFloat( -0.1, 0.1 ), random.RandomFloat( -0.1, 0.1 ), random.RandomFloat( -0.1, 0.1 ) );
+			}
+			else
+			{
+				vecOrigin.Init( random.RandomFloat( mins.x, maxs.x ), random.RandomFloat( mins.y, maxs.y ), random.RandomFloat( mins.z, maxs.z ) );
+				vecDir.Init( random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ), random.RandomFloat( -1, 1 ) );
+			}
+			VectorNormalize( vecDir );
+
+			FourRays &half = rays[i].m_Rays[k >> 2];
+			half.origin.X( k & 3 ) = vecOrigin.x;
+			half.origin.Y( k & 3 ) = vecOrigin.y;
+			half.origin.Z( k & 3 ) = vecOrigin.z;
+			half.direction.X( k & 3 ) = vecDir.x;
+			half.direction.Y( k & 3 ) = vecDir.y;
+			half.direction.Z( k & 3 ) = vecDir.z;
+		}
+	}
+}
+
+static void RunRayBenchmark( const char *pszName, CUtlVector<EightRays> &rays )
+{
+	fltx4 TMin[2] = { Four_Zeros, Four_Zeros };
+	fltx4 TMax[2] = { ReplicateX4( RTBENCH_MAX_DIST ), ReplicateX4( RTBENCH_MAX_DIST ) };
+
+	CUtlVector<RayTracingResult> results4, results8;
+	results4.SetCount( rays.Count() * 2 );
+	results8.SetCount( rays.Count() * 2 );
+
+	double flStart = Plat_FloatTime();
+	for ( int i = 0; i < rays.Count(); i++ )
+	{
+		g_RtEnv.Trace4Rays( rays[i].m_Rays[0], TMin[0], TMax[0], &results4[i * 2] );
+		g_RtEnv.Trace4Rays( rays[i].m_Rays[1], TMin[1], TMax[1], &results4[i * 2 + 1] );
+	}
+	double flTime4 = Plat_FloatTime() - flStart;
+
+	flStart = Plat_FloatTime();
+	for ( int i = 0; i < rays.Count(); i++ )
+	{
+		g_RtEnv.Trace8Rays( rays[i], TMin, TMax, &results8[i * 2] );
+	}
+	double flTime8 = Plat_FloatTime() - flStart;
+
+	// both widths have to agree on every hit inside the trace distance
+	int nHits = 0, nMismatches = 0;
+	for ( int i = 0; i < results4.Count(); i++ )
+	{
+		for ( int k = 0; k < 4; k++ )
+		{
+			bool bHit4 = ( results4[i].HitIds[k] != -1 ) && ( SubFloat( results4[i].HitDistance, k ) < RTBENCH_MAX_DIST );
+			bool bHit8 = ( results8[i].HitIds[k] != -1 ) && ( SubFloat( results8[i].HitDistance, k ) < RTBENCH_MAX_DIST );
+			nHits += bHit4;
+			if ( bHit4 != bHit8 || ( bHit4 && results4[i].HitIds[k] != results8[i].HitIds[k] ) )
+				nMismatches++;
+		}
+	}
+
+	int nRays = rays.Count() * 8;
+	Msg( "  %-10s: 4 wide %7.2f Mrays/s, 8 wide %7.2f Mrays/s, %5.1f%% hit, %d mismatches\n",
+		pszName, nRays / flTime4 * 1.0e-6, nRays / flTime8 * 1.0e-6, 100.0f * nHits / nRays, nMismatches );
+}
+
+void RayTraceBenchmark( void )
+{
+	Msg( "Ray tracing benchmark (%s, %d triangles, %s):\n",
+		( g_RtEnv.Flags & RTE_FLAGS_USE_BVH ) ? "bvh" : "kd-tree", g_RtEnv.OptimizedTriangleList.Count(),
+		( GetCPUInformation()->m_bAVX && !( g_RtEnv.Flags & RTE_FLAGS_DISABLE_AVX ) ) ? "avx" : "sse" );
+
+	CUtlVector<EightRays> rays;
+	MakeBenchmarkRays( rays, false );
+	RunRayBenchmark( "random", rays );
+	MakeBenchmarkRays( rays, true );
+	RunRayBenchmark( "coherent", rays );
+}
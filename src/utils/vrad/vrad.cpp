@@ -57,6 +57,8 @@ float		g_MaxDispPatchRadius = 1500.0f;			// Maximum radius allowed for displacem
 qboolean	g_bDumpPatches;
 bool	    bDumpNormals = false;
 bool		g_bDumpRtEnv = false;
+bool		g_bUseBVH = false;
+bool		g_bRayTraceBenchmark = false;
 bool		bRed2Black = true;
 bool		g_bFastAmbient = false;
 bool        g_bNoSkyRecurse = false;
@@ -94,7 +96,6 @@ bool g_bOnlyStaticProps = false;
 bool g_bShowStaticPropNormals = false;
 
 
-float		gamma = 0.5;
 float		indirect_sun = 1.0;
 float		reflectivityScale = 1.0;
 qboolean	do_extra = true;
@@ -1056,7 +1057,9 @@ MakeScales
 =============
 */
 int	total_transfer;
+int	total_transferblocks;
 int max_transfer;
+float max_transfer_error = -1;	// worst sum of quantization errors over one patch's transfers, -1 if not measured here
 
 
 //-----------------------------------------------------------------------------
@@ -1199,11 +1202,79 @@ void MakeTransfer( int ndxPatch1, int ndxPatch2, transfer_t *all_transfers )
 }
 
 
+//-----------------------------------------------------------------------------
+// Transfers are stored as a fraction of the patch's largest one, in a 16 bit float
+// with a 5 bit exponent and an 11 bit mantissa. Fractions under 2^-31 become zero.
+//-----------------------------------------------------------------------------
+#define TRANSFER_EXPONENT_BIAS	(127 - 31)
+
+static unsigned short QuantizeTransfer( float flFraction )
+{
+	// round the mantissa, a carry just moves up to the next exponent
+	unsigned int nBits = *(unsigned int *)&flFraction + ( 1 << 11 );
+	int nExponent = (int)( nBits >> 23 ) - TRANSFER_EXPONENT_BIAS;
+	if ( nExponent <= 0 )
+		return 0;
+
+	return (unsigned short)MIN( ( nBits - ( TRANSFER_EXPONENT_BIAS << 23 ) ) >> 12, 0xFFFF );
+}
+
+static FORCEINLINE float DequantizeTransfer( unsigned short nTransfer )
+{
+	unsigned int nBits = nTransfer ? ( (unsigned int)nTransfer << 12 ) + ( TRANSFER_EXPONENT_BIAS << 23 ) : 0;
+	return *(float *)&nBits;
+}
+
+static int __cdecl CompareTransferPatch( const void *p1, const void *p2 )
+{
+	return ((const transfer_t *)p1)->patch - ((const transfer_t *)p2)->patch;
+}
+
+//-----------------------------------------------------------------------------
+// Purpose: Packs a normalized transfer list, sorted by patch, into transfer blocks.
+//			A block ends early when the gap to the next patch doesn't fit in a delta.
+//			With pBlocks NULL this just counts the blocks.
+//-----------------------------------------------------------------------------
+static int CompressTransfers( const transfer_t *pTransfers, int nTransfers, float flInvMax, transferblock_t *pBlocks )
+{
+	int nBlocks = 0;
+	transferblock_t *pBlock = NULL;
+	int nInBlock = TRANSFER_BLOCK_SIZE;
+	int nPrevPatch = 0;
+
+	for ( int i = 0; i < nTransfers; i++ )
+	{
+		int nDelta = pTransfers[i].patch - nPrevPatch;
+		if ( nInBlock == TRANSFER_BLOCK_SIZE || nDelta > 0xFFFF )
+		{
+			if ( pBlocks )
+			{
+				pBlock = &pBlocks[nBlocks];
+				memset( pBlock, 0, sizeof( *pBlock ) );
+				pBlock->firstPatch = pTransfers[i].patch;
+			}
+			nBlocks++;
+			nInBlock = 0;
+			nDelta = 0;
+		}
+
+		if ( pBlock )
+		{
+			pBlock->delta[nInBlock] = nDelta;
+			pBlock->transfer[nInBlock] = QuantizeTransfer( pTransfers[i].transfer * flInvMax );
+		}
+		nInBlock++;
+		nPrevPatch = pTransfers[i].patch;
+	}
+
+	return nBlocks;
+}
+
 void MakeScales ( int ndxPatch, transfer_t *all_transfers )
 {
 	int		j;
 	float	total;
-	transfer_t	*t, *t2;
+	transfer_t	*t2;
 	total = 0;
 
 	if( ndxPatch == g_Patches.InvalidIndex() )
@@ -1218,11 +1289,6 @@ void MakeScales ( int ndxPatch, transfer_t *all_transfers )
 			max_transfer = patch->numtransfers;
 		}
 
-
-		patch->transfers = ( transfer_t* )calloc (1, patch->numtransfers * sizeof(transfer_t));
-		if (!patch->transfers)
-			Error ("Memory allocation failure");
-
 		// get total transfer energy
 		t2 = all_transfers;
 
@@ -1238,16 +1304,47 @@ void MakeScales ( int ndxPatch, transfer_t *all_transfers )
 		else	
 			total = 1.0f/M_PI;
 
-		t = patch->transfers;
+		float flMax = 0;
 		t2 = all_transfers;
-		for (j=0 ; j<patch->numtransfers ; j++, t++, t2++)
+		for (j=0 ; j<patch->numtransfers ; j++, t2++)
 		{
-			t->transfer = t2->transfer*total;
-			t->patch = t2->patch;
+			t2->transfer *= total;
+			flMax = MAX( flMax, t2->transfer );
 		}
-		if (patch->numtransfers > max_transfer)
+
+		// all_transfers is this thread's scratch space, so sort it in place
+		qsort( all_transfers, patch->numtransfers, sizeof( transfer_t ), CompareTransferPatch );
+
+		// Nothing to gather if every transfer is zero, and no scale to quantize against
+		if ( flMax > 0 )
 		{
-			max_transfer = patch->numtransfers;
+			patch->transferScale = flMax;
+			float flInvMax = 1.0f / flMax;
+
+			patch->numtransferblocks = CompressTransfers( all_transfers, patch->numtransfers, flInvMax, NULL );
+			patch->transferBlocks = ( transferblock_t* )malloc( patch->numtransferblocks * sizeof( transferblock_t ) );
+			if (!patch->transferBlocks)
+				Error ("Memory allocation failure");
+
+			CompressTransfers( all_transfers, patch->numtransfers, flInvMax, patch->transferBlocks );
+
+			// The light this patch gathers is off by at most this much per unit of shooting light
+			float flError = 0;
+			t2 = all_transfers;
+			for (j=0 ; j<patch->numtransfers ; j++, t2++)
+			{
+				flError += fabs( DequantizeTransfer( QuantizeTransfer( t2->transfer * flInvMax ) ) * flMax - t2->transfer );
+			}
+
+			ThreadLock ();
+			max_transfer_error = MAX( max_transfer_error, flError );
+			ThreadUnlock ();
+		}
+		else
+		{
+			patch->transferScale = 0;
+			patch->numtransferblocks = 0;
+			patch->transferBlocks = NULL;
 		}
 	}
 	else
@@ -1258,6 +1355,7 @@ void MakeScales ( int ndxPatch, transfer_t *all_transfers )
 
 	ThreadLock ();
 	total_transfer += patch->numtransfers;
+	total_transferblocks += patch->numtransferblocks;
 	ThreadUnlock ();
 }
 
@@ -1532,111 +1630,135 @@ void PreGetBumpNormalsForDisp( texinfo_t *pTexinfo, Vector &vecU, Vector &vecV,
 	vecV = vecTexV;
 }
 
-void GatherLight (int threadnum, void *pUserData)
+// Per patch inputs to GatherLight, padded out to fltx4s
+static CUtlVector< fltx4, CUtlMemoryAligned< fltx4, 16 > > g_PatchShootLight;	// emitlight * reflectivity, rebuilt every bounce
+static CUtlVector< fltx4, CUtlMemoryAligned< fltx4, 16 > > g_PatchOrigins;
+
+static FORCEINLINE fltx4 LoadTransfers4( const unsigned short *pTransfer )
 {
-	int			i, j, k;
-	transfer_t	*trans;
-	int			num;
+	ALIGN16 float flTransfer[4] ALIGN16_POST;
+	flTransfer[0] = DequantizeTransfer( pTransfer[0] );
+	flTransfer[1] = DequantizeTransfer( pTransfer[1] );
+	flTransfer[2] = DequantizeTransfer( pTransfer[2] );
+	flTransfer[3] = DequantizeTransfer( pTransfer[3] );
+	return LoadAlignedSIMD( flTransfer );
+}
+
+// One row of the transfer matrix times the shooting light. Each bounce runs this for
+// every patch, so it's a sparse matrix vector product over the compressed transfers.
+void GatherLight (int threadnum, int j)
+{
+	int			i, k;
 	CPatch		*patch;
-	Vector		sum, v;
 
-	while (1)
-	{
-		j = GetThreadWork ();
-		if (j == -1)
-			break;
+	patch = &g_Patches[j];
 
-		patch = &g_Patches[j];
+	const transferblock_t *pBlock = patch->transferBlocks;
+	const transferblock_t *pBlockEnd = pBlock + patch->numtransferblocks;
+	const fltx4 *pShoot = g_PatchShootLight.Base();
+	fltx4 transferScale = ReplicateX4( patch->transferScale );
 
-		trans = patch->transfers;
-		num = patch->numtransfers;
-		if ( patch->needsBumpmap )
+	if ( patch->needsBumpmap )
+	{
+		Vector normals[NUM_BUMP_VECTS+1];
+
+		// Disps
+		bool bDisp = ( g_pFaces[patch->faceNumber].dispinfo != -1 ); 
+		if ( bDisp )
 		{
-			Vector delta;
-			Vector bumpSum[NUM_BUMP_VECTS+1];
-			Vector normals[NUM_BUMP_VECTS+1];
+			normals[0] = patch->normal;
+			texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
+			Vector vecTexU, vecTexV;
+			PreGetBumpNormalsForDisp( pTexinfo, vecTexU, vecTexV, normals[0] );
 
-			// Disps
-			bool bDisp = ( g_pFaces[patch->faceNumber].dispinfo != -1 ); 
-			if ( bDisp )
-			{
-				normals[0] = patch->normal;
-				texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
-				Vector vecTexU, vecTexV;
-				PreGetBumpNormalsForDisp( pTexinfo, vecTexU, vecTexV, normals[0] );
+			// use facenormal along with the smooth normal to build the three bump map vectors
+			GetBumpNormals( vecTexU, vecTexV, normals[0], normals[0], &normals[1] ); 
+		}
+		else
+		{
+			GetPhongNormal( patch->faceNumber, patch->origin, normals[0] );
 
-				// use facenormal along with the smooth normal to build the three bump map vectors
-				GetBumpNormals( vecTexU, vecTexV, normals[0], normals[0], &normals[1] ); 
-			}
-			else
-			{
-				GetPhongNormal( patch->faceNumber, patch->origin, normals[0] );
+			texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
+			// use facenormal along with the smooth normal to build the three bump map vectors
+			GetBumpNormals( pTexinfo->textureVecsTexelsPerWorldUnits[0], 
+				pTexinfo->textureVecsTexelsPerWorldUnits[1], patch->normal, 
+				normals[0], &normals[1] );
+		}
 
-				texinfo_t *pTexinfo = &texinfo[g_pFaces[patch->faceNumber].texinfo];
-				// use facenormal along with the smooth normal to build the three bump map vectors
-				GetBumpNormals( pTexinfo->textureVecsTexelsPerWorldUnits[0], 
-					pTexinfo->textureVecsTexelsPerWorldUnits[1], patch->normal, 
-					normals[0], &normals[1] );
-			}
+		// force the base lightmap to use the flat normal instead of the phong normal
+		// FIXME: why does the patch not use the phong normal?
+		normals[0] = patch->normal;
 
-			// force the base lightmap to use the flat normal instead of the phong normal
-			// FIXME: why does the patch not use the phong normal?
-			normals[0] = patch->normal;
+		FourVectors origin;
+		origin.DuplicateVector( patch->origin );
+		FourVectors normals4[NUM_BUMP_VECTS+1];
+		fltx4 bumpSum[NUM_BUMP_VECTS+1];
+		for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
+		{
+			normals4[i].DuplicateVector( normals[i] );
+			bumpSum[i] = Four_Zeros;
+		}
 
-			for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
+		// The transfer already has the cosine to the flat normal factored in. Each bump vector
+		// swaps it for its own cosine, and since only the ratio matters the direction to the
+		// other patch doesn't need normalizing.
+		for ( ; pBlock < pBlockEnd; pBlock++ )
+		{
+			int nPatch = pBlock->firstPatch;
+			for ( k = 0; k < TRANSFER_BLOCK_SIZE; k += 4 )
 			{
-				VectorFill( bumpSum[i], 0 );
-			}
+				int nPatch0 = nPatch + pBlock->delta[k];
+				int nPatch1 = nPatch0 + pBlock->delta[k+1];
+				int nPatch2 = nPatch1 + pBlock->delta[k+2];
+				int nPatch3 = nPatch2 + pBlock->delta[k+3];
+				nPatch = nPatch3;
 
-			float dot;
-			for (k=0 ; k<num ; k++, trans++)
-			{
-				CPatch *patch2 = &g_Patches[trans->patch];
+				FourVectors delta;
+				delta.LoadAndSwizzleAligned( (const float *)&g_PatchOrigins[nPatch0], (const float *)&g_PatchOrigins[nPatch1],
+					(const float *)&g_PatchOrigins[nPatch2], (const float *)&g_PatchOrigins[nPatch3] );
+				delta -= origin;
+
+				fltx4 transfer = MulSIMD( LoadTransfers4( &pBlock->transfer[k] ), transferScale );
+				fltx4 scale = DivSIMD( transfer, delta * normals4[0] );
+
+				// empty slots can repeat a patch edge on to this one, keep their 0 * inf out of the sum
+				fltx4 used = CmpGtSIMD( transfer, Four_Zeros );
 
-				// get vector to other patch
-				VectorSubtract (patch2->origin, patch->origin, delta);
-				VectorNormalize (delta);
-				// find light emitted from other patch
-				for(i=0; i<3; i++)
-				{
-					v[i] = emitlight[trans->patch][i] * patch2->reflectivity[i];
-				}
-				// remove normal already factored into transfer steradian
-				float scale = 1.0f / DotProduct (delta, patch->normal);
-				VectorScale( v, trans->transfer * scale, v );
-				
-				Vector bumpTransfer;
 				for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
 				{
-					dot = DotProduct( delta, normals[i] );
-					if ( dot <= 0 )
-					{
-//						Assert( i > 0 ); // if this hits, then the transfer shouldn't be here.  It doesn't face the flat normal of this face!
-						continue;
-					}
-					bumpTransfer = v * dot;
-					VectorAdd( bumpSum[i], bumpTransfer, bumpSum[i] );
+					fltx4 dot = delta * normals4[i];
+					fltx4 weight = AndSIMD( AndSIMD( used, CmpGtSIMD( dot, Four_Zeros ) ), MulSIMD( scale, dot ) );
+
+					bumpSum[i] = MaddSIMD( SplatXSIMD( weight ), pShoot[nPatch0], bumpSum[i] );
+					bumpSum[i] = MaddSIMD( SplatYSIMD( weight ), pShoot[nPatch1], bumpSum[i] );
+					bumpSum[i] = MaddSIMD( SplatZSIMD( weight ), pShoot[nPatch2], bumpSum[i] );
+					bumpSum[i] = MaddSIMD( SplatWSIMD( weight ), pShoot[nPatch3], bumpSum[i] );
 				}
 			}
-			for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
-			{
-				VectorCopy( bumpSum[i], addlight[j].light[i] );
-			}
 		}
-		else
+		for ( i = 0; i < NUM_BUMP_VECTS+1; i++ )
+		{
+			addlight[j].light[i].Init( SubFloat( bumpSum[i], 0 ), SubFloat( bumpSum[i], 1 ), SubFloat( bumpSum[i], 2 ) );
+		}
+	}
+	else
+	{
+		// two sums to keep the adds from waiting on each other
+		fltx4 sum0 = Four_Zeros;
+		fltx4 sum1 = Four_Zeros;
+		for ( ; pBlock < pBlockEnd; pBlock++ )
 		{
-			VectorFill( sum, 0 );
-			for (k=0 ; k<num ; k++, trans++)
+			int nPatch = pBlock->firstPatch;
+			for ( k = 0; k < TRANSFER_BLOCK_SIZE; k += 2 )
 			{
-				for(i=0; i<3; i++)
-				{
-					v[i] = emitlight[trans->patch][i] * g_Patches[trans->patch].reflectivity[i];
-				}
-				VectorScale( v, trans->transfer, v );
-				VectorAdd( sum, v, sum );
+				nPatch += pBlock->delta[k];
+				sum0 = MaddSIMD( ReplicateX4( DequantizeTransfer( pBlock->transfer[k] ) ), pShoot[nPatch], sum0 );
+				nPatch += pBlock->delta[k+1];
+				sum1 = MaddSIMD( ReplicateX4( DequantizeTransfer( pBlock->transfer[k+1] ) ), pShoot[nPatch], sum1 );
 			}
-			VectorCopy( sum, addlight[j].light[0] );
 		}
+		fltx4 sum = MulSIMD( AddSIMD( sum0, sum1 ), transferScale );
+		addlight[j].light[0].Init( SubFloat( sum, 0 ), SubFloat( sum, 1 ), SubFloat( sum, 2 ) );
 	}
 }
 
@@ -1700,19 +1822,61 @@ void BounceLight (void)
 	}
 #endif
 
+	// the work per patch is its transfer count, and bumped patches do four gathers
+	CUtlVector<float> gatherCost;
+	gatherCost.SetCount( uiPatchCount );
+	g_PatchOrigins.SetCount( uiPatchCount );
+	g_PatchShootLight.SetCount( uiPatchCount );
+	for (i=0 ; i<uiPatchCount; i++)
+	{
+		CPatch *patch = &g_Patches[i];
+		gatherCost[i] = patch->numtransferblocks * ( patch->needsBumpmap ? NUM_BUMP_VECTS+1 : 1 );
+
+		const Vector &origin = patch->origin;
+		g_PatchOrigins[i] = Four_Zeros;
+		SubFloat( g_PatchOrigins[i], 0 ) = origin.x;
+		SubFloat( g_PatchOrigins[i], 1 ) = origin.y;
+		SubFloat( g_PatchOrigins[i], 2 ) = origin.z;
+	}
+
 	i = 0;
 	while ( bouncing )
 	{
+		double flStart = Plat_FloatTime();
+
+		float flMaxShoot = 0;
+		for (unsigned j=0 ; j<uiPatchCount; j++)
+		{
+			const Vector &reflectivity = g_Patches[j].reflectivity;
+			g_PatchShootLight[j] = Four_Zeros;
+			SubFloat( g_PatchShootLight[j], 0 ) = emitlight[j].x * reflectivity.x;
+			SubFloat( g_PatchShootLight[j], 1 ) = emitlight[j].y * reflectivity.y;
+			SubFloat( g_PatchShootLight[j], 2 ) = emitlight[j].z * reflectivity.z;
+			flMaxShoot = MAX( flMaxShoot, emitlight[j].x * reflectivity.x );
+			flMaxShoot = MAX( flMaxShoot, emitlight[j].y * reflectivity.y );
+			flMaxShoot = MAX( flMaxShoot, emitlight[j].z * reflectivity.z );
+		}
+
+		// Make sure the compressed transfers can't move a flat lightmap by more than -coring
+		if ( max_transfer_error >= 0 )
+		{
+			float flErrorBound = max_transfer_error * flMaxShoot;
+			qprintf ("	Bounce #%i transfer quantization error <= %.3f\n", i+1, flErrorBound );
+			if ( flErrorBound > coring )
+			{
+				Warning( "Bounce #%i: transfer quantization error can reach %.3f, over the -coring threshold of %.3f\n", i+1, flErrorBound, coring );
+			}
+		}
+
 		// transfer light from to the leaf patches from other patches via transfers
 		// this moves shooter->emitlight to receiver->addlight
-		unsigned int uiPatchCount = g_Patches.Size();
-		RunThreadsOn (uiPatchCount, true, GatherLight);
+		RunThreadsOnIndividualWeighted (uiPatchCount, true, GatherLight, gatherCost.Base());
 		// move newly received light (addlight) to light to be sent out (emitlight)
 		// start at children and pull light up to parents
 		// light is always received to leaf patches
 		CollectLight( added );
 
-		qprintf ("\tBounce #%i added RGB(%.0f, %.0f, %.0f)\n", i+1, added[0], added[1], added[2] );
+		qprintf ("\tBounce #%i added RGB(%.0f, %.0f, %.0f) in %.2f seconds\n", i+1, added[0], added[1], added[2], Plat_FloatTime() - flStart );
 
 		if ( i+1 == numbounce || (added[0] < 1.0 && added[1] < 1.0 && added[2] < 1.0) )
 			bouncing = false;
@@ -1724,6 +1888,9 @@ void BounceLight (void)
 			WriteWorld (name, 0);
 		}
 	}
+
+	g_PatchShootLight.Purge();
+	g_PatchOrigins.Purge();
 }
 
 
@@ -1932,7 +2099,8 @@ void MakeAllScales (void)
 
 	Msg("transfers %d, max %d\n", total_transfer, max_transfer );
 
-	qprintf ("transfer lists: %5.1f megs\n"
+	qprintf ("transfer lists: %5.1f megs (%5.1f megs uncompressed)\n"
+		, (float)total_transferblocks * sizeof(transferblock_t) / (1024*1024)
 		, (float)total_transfer * sizeof(transfer_t) / (1024*1024));
 }
 
@@ -2170,7 +2338,7 @@ void VRAD_LoadBSP( char const *pFilename )
 		// Otherwise, try looking in the BIN directory from which we were run from
 		Msg( "Could not find lights.rad in %s.\nTrying VRAD BIN directory instead...\n", 
 			    global_lights );
-		GetModuleFileName( NULL, global_lights, sizeof( global_lights ) );
+		Plat_GetModuleFilename( global_lights, sizeof( global_lights ) );
 		Q_ExtractFilePath( global_lights, global_lights, sizeof( global_lights ) );
 		strcat( global_lights, "lights.rad" );
 	}
@@ -2284,6 +2452,8 @@ void VRAD_LoadBSP( char const *pFilename )
 
 	// Build acceleration structure
 	printf ( "Setting up ray-trace acceleration structure... ");
+	if ( g_bUseBVH )
+		g_RtEnv.Flags |= RTE_FLAGS_USE_BVH;
 	float start = Plat_FloatTime();
 	g_RtEnv.SetupAccelerationStructure();
 	float end = Plat_FloatTime();
@@ -2293,6 +2463,12 @@ void VRAD_LoadBSP( char const *pFilename )
 	exit(0);
 #endif
 
+	if ( g_bRayTraceBenchmark )
+	{
+		RayTraceBenchmark();
+		exit( 0 );
+	}
+
 	RadWorld_Start();
 
 	// Setup incremental lighting.
@@ -2432,6 +2608,14 @@ int ParseCommandLine( int argc, char **argv, bool *onlydetail )
 		{
 			g_bDumpRtEnv = true;
 		}
+		else if ( !Q_stricmp( argv[i], "-bvh" ) )
+		{
+			g_bUseBVH = true;
+		}
+		else if ( !Q_stricmp( argv[i], "-rtbench" ) )
+		{
+			g_bRayTraceBenchmark = true;
+		}
 		else if ( !Q_stricmp( argv[i], "-LargeDispSampleRadius" ) )
 		{
 			g_bLargeDispSampleRadius = true;
@@ -2836,6 +3020,10 @@ void PrintUsage( int argc, char **argv )
 		"  -dump           : Write debugging .txt files.\n"
 		"  -dumpnormals    : Write normals to debug files.\n"
 		"  -dumptrace      : Write ray-tracing environment to debug files.\n"
+		"  -bvh            : Use a bounding volume hierarchy instead of a k-d tree for\n"
+		"                    ray tracing. Builds faster on large maps.\n"
+		"  -rtbench        : Build the ray tracer, report its speed on random and\n"
+		"                    coherent rays, and exit.\n"
 		"  -threads        : Control the number of threads vbsp uses (defaults to the #\n"
 		"                    or processors on your machine).\n"
 		"  -lights <file>  : Load a lights file in addition to lights.rad and the\n"
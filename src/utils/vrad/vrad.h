@@ -24,9 +24,9 @@
 #include "polylib.h"
 #include "threads.h"
 #include "builddisp.h"
-#include "VRAD_DispColl.h"
-#include "UtlMemory.h"
-#include "UtlHash.h"
+#include "vrad_dispcoll.h"
+#include "utlmemory.h"
+#include "utlhash.h"
 #include "utlvector.h"
 #include "iincremental.h"
 #include "raytrace.h"
@@ -39,12 +39,16 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#ifdef _WIN32
 #pragma warning(disable: 4142 4028)
 #include <io.h>
 #pragma warning(default: 4142 4028)
+#endif
 
 #include <fcntl.h>
+#ifdef _WIN32
 #include <direct.h>
+#endif
 #include <ctype.h>
 
 
@@ -112,6 +116,19 @@ struct transfer_t
 	float	transfer;
 };
 
+// Finished transfer lists are stored compressed, in fixed size blocks sorted by patch.
+// Each patch index is a delta from the one before it in the block, and each form factor
+// is a 16 bit float fraction of the patch's largest. Unused slots at the end of a block
+// have a zero delta and a zero transfer.
+#define TRANSFER_BLOCK_SIZE		16
+
+struct transferblock_t
+{
+	int				firstPatch;
+	unsigned short	delta[TRANSFER_BLOCK_SIZE];		// first one is always zero
+	unsigned short	transfer[TRANSFER_BLOCK_SIZE];	// fraction of CPatch::transferScale
+};
+
 
 struct LightingValue_t
 {
@@ -237,7 +254,9 @@ struct CPatch
 //	struct		patch_s		*nextclusterchild;		// next terminal child in cluster
 
 	int			numtransfers;
-	transfer_t	*transfers;
+	int			numtransferblocks;
+	float		transferScale;			// largest transfer
+	transferblock_t	*transferBlocks;
 
 	short		indices[3];				// displacement use these for subdivision
 };
@@ -337,7 +356,6 @@ extern dface_t *g_pFaces;
 extern bool g_bMPIProps;
 
 extern	byte	nodehit[MAX_MAP_NODES];
-extern  float	gamma;
 extern	float	indirect_sun;
 extern	float	smoothing_threshold;
 extern	int		dlight_map;
@@ -394,6 +412,9 @@ void TestLine_DoesHitSky( FourVectors const& start, FourVectors const& stop,
 void ExtractBrushEntityShadowCasters ( void );
 void AddBrushesForRayTrace ( void );
 
+// -rtbench: times the ray tracer on random and coherent rays
+void RayTraceBenchmark( void );
+
 void BaseLightForFace( dface_t *f, Vector& light, float *parea, Vector& reflectivity );
 void CreateDirectLights (void);
 void GetPhongNormal( int facenum, Vector const& spot, Vector& phongnormal );
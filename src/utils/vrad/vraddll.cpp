@@ -169,9 +169,18 @@ void CVRadDLL::GetBSPInfo( CBSPInfo *pInfo )
 
 bool CVRadDLL::DoIncrementalLight( char const *pVMFFile )
 {
-	char tempPath[MAX_PATH], tempFilename[MAX_PATH];
+	char tempFilename[MAX_PATH];
+#ifdef _WIN32
+	char tempPath[MAX_PATH];
 	GetTempPath( sizeof( tempPath ), tempPath );
 	GetTempFileName( tempPath, "vmf_entities_", 0, tempFilename );
+#else
+	V_strncpy( tempFilename, "/tmp/vmf_entities_XXXXXX", sizeof( tempFilename ) );
+	int fdTemp = mkstemp( tempFilename );
+	if ( fdTemp == -1 )
+		return false;
+	close( fdTemp );
+#endif
 
 	FileHandle_t fp = g_pFileSystem->Open( tempFilename, "wb" );
 	if( !fp )
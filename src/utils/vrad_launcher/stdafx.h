@@ -17,9 +17,11 @@
 #pragma once
 #endif // _MSC_VER > 1000
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN		// Exclude rarely-used stuff from Windows headers
 
 #include <windows.h>
+#endif
 #include <stdio.h>
 #include "interface.h"
 #include "ivraddll.h"
@@ -7,6 +7,7 @@
 //=============================================================================//
 #include "vis.h"
 #include "vmpi.h"
+#include "threads.h"
 
 int g_TraceClusterStart = -1;
 int g_TraceClusterStop = -1;
@@ -29,15 +30,26 @@ int g_TraceClusterStop = -1;
   void CalcMightSee (leaf_t *leaf, 
 */
 
+static inline int CountWordBits( uint64 n )
+{
+	n = n - ( ( n >> 1 ) & 0x5555555555555555ull );
+	n = ( n & 0x3333333333333333ull ) + ( ( n >> 2 ) & 0x3333333333333333ull );
+	n = ( n + ( n >> 4 ) ) & 0x0f0f0f0f0f0f0f0full;
+	return (int)( ( n * 0x0101010101010101ull ) >> 56 );
+}
+
+// bits must be padded out to a whole word
 int CountBits (byte *bits, int numbits)
 {
-	int		i;
-	int		c;
+	const uint64 *words = (const uint64 *)bits;
+	int nWords = numbits >> 6;
+	int c = 0;
 
-	c = 0;
-	for (i=0 ; i<numbits ; i++)
-		if ( CheckBit( bits, i ) )
-			c++;
+	for ( int i = 0; i < nWords; i++ )
+		c += CountWordBits( words[i] );
+
+	if ( numbits & 63 )
+		c += CountWordBits( words[nWords] & ( ( 1ull << ( numbits & 63 ) ) - 1 ) );
 
 	return c;
 }
@@ -59,12 +71,12 @@ void CheckStack (leaf_t *leaf, threaddata_t *thread)
 {
 	pstack_t	*p, *p2;
 
-	for (p=thread->pstack_head.next ; p ; p=p->next)
+	for (p=thread->pstack_head->next ; p ; p=p->next)
 	{
 //		Msg ("=");
 		if (p->leaf == leaf)
 			Error ("CheckStack: leaf recursion");
-		for (p2=thread->pstack_head.next ; p2 != p ; p2=p2->next)
+		for (p2=thread->pstack_head->next ; p2 != p ; p2=p2->next)
 			if (p2->leaf == p->leaf)
 				Error ("CheckStack: late leaf recursion");
 	}
@@ -469,6 +481,47 @@ void WritePortalTrace( const char *source )
 	Warning("Wrote %s!!!\n", filename);
 }
 
+/*
+==================
+Stack frame arena
+
+Each thread keeps the frames for every depth it has recursed to, so PortalFlow
+doesn't put a MAX_PORTALS bit string on the program stack per leaf.
+==================
+*/
+static CUtlVector<pstack_t *> g_StackFrames[MAX_TOOL_THREADS+1];
+
+static pstack_t *GetStackFrame (int iThread, int depth)
+{
+	CUtlVector<pstack_t *> &frames = g_StackFrames[iThread];
+	while ( frames.Count() <= depth )
+	{
+		pstack_t *frame = (pstack_t *)malloc( sizeof( pstack_t ) + portalbytes );
+		memset( frame, 0, sizeof( pstack_t ) );
+		frame->mightsee = (uint64 *)( frame + 1 );
+		frame->depth = frames.Count();
+		frames.AddToTail( frame );
+	}
+	return frames[depth];
+}
+
+static inline bool StackMightSee (pstack_t *stack, int pnum)
+{
+	int word = pnum >> 6;
+	if ( word < stack->mightfirst || word >= stack->mightlast )
+		return false;
+	return ( stack->mightsee[word] & ( 1ull << ( pnum & 63 ) ) ) != 0;
+}
+
+// Narrows [mightfirst, mightlast) down to the nonzero words
+static inline void TrimMightSee (pstack_t *stack)
+{
+	while ( stack->mightfirst < stack->mightlast && !stack->mightsee[stack->mightfirst] )
+		stack->mightfirst++;
+	while ( stack->mightlast > stack->mightfirst && !stack->mightsee[stack->mightlast-1] )
+		stack->mightlast--;
+}
+
 /*
 ==================
 RecursiveLeafFlow
@@ -479,12 +532,12 @@ If src_portal is NULL, this is the originating leaf
 */
 void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 {
-	pstack_t	stack;
 	portal_t	*p;
 	plane_t		backplane;
 	leaf_t 		*leaf;
 	int			i, j;
-	long		*test, *might, *vis, more;
+	uint64		*test, *might, *vis, *prevmight, more;
+	int			first, last;
 	int			pnum;
 
 #ifdef MPI
@@ -497,21 +550,26 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 
 	if ( leafnum == g_TraceClusterStop )
 	{
-		DumpPortalTrace(&thread->pstack_head);
+		DumpPortalTrace(thread->pstack_head);
 		return;
 	}
 	thread->c_chains++;
 
 	leaf = &leafs[leafnum];
 
+	pstack_t &stack = *GetStackFrame( thread->thread, prevstack->depth + 1 );
 	prevstack->next = &stack;
 
 	stack.next = NULL;
 	stack.leaf = leaf;
 	stack.portal = NULL;
 
-	might = (long *)stack.mightsee;
-	vis = (long *)thread->base->portalvis;
+	// nothing past the previous frame's might see range can be set in this one
+	first = prevstack->mightfirst;
+	last = prevstack->mightlast;
+	prevmight = prevstack->mightsee;
+	might = stack.mightsee;
+	vis = (uint64 *)thread->base->portalvis;
 	
 	// check all portals for flowing into other leafs	
 	for (i=0 ; i<leaf->portals.Count() ; i++)
@@ -520,7 +578,7 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		p = leaf->portals[i];
 		pnum = p - portals;
 
-		if ( ! (prevstack->mightsee[pnum >> 3] & (1<<(pnum&7)) ) )
+		if ( !StackMightSee( prevstack, pnum ) )
 		{
 			continue;	// can't possibly see it
 		}
@@ -528,17 +586,17 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		// if the portal can't see anything we haven't allready seen, skip it
 		if (p->status == stat_done)
 		{
-			test = (long *)p->portalvis;
+			test = (uint64 *)p->portalvis;
 		}
 		else
 		{
-			test = (long *)p->portalflood;
+			test = (uint64 *)p->portalflood;
 		}
 
 		more = 0;
-		for (j=0 ; j<portallongs ; j++)
+		for (j=first ; j<last ; j++)
 		{
-			might[j] = ((long *)prevstack->mightsee)[j] & test[j];
+			might[j] = prevmight[j] & test[j];
 			more |= (might[j] & ~vis[j]);
 		}
 		
@@ -547,6 +605,10 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 			continue;
 		}
 
+		stack.mightfirst = first;
+		stack.mightlast = last;
+		TrimMightSee( &stack );
+
 		// get plane of portal, point normal into the neighbor leaf
 		stack.portalplane = p->plane;
 		VectorSubtract (vec3_origin, p->plane.normal, backplane.normal);
@@ -558,8 +620,8 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		stack.freewindings[1] = 1;
 		stack.freewindings[2] = 1;
 		
-		float d = DotProduct (p->origin, thread->pstack_head.portalplane.normal);
-		d -= thread->pstack_head.portalplane.dist;
+		float d = DotProduct (p->origin, thread->pstack_head->portalplane.normal);
+		d -= thread->pstack_head->portalplane.dist;
 		if (d < -p->radius)
 		{
 			continue;
@@ -570,7 +632,7 @@ void RecursiveLeafFlow (int leafnum, threaddata_t *thread, pstack_t *prevstack)
 		}
 		else	
 		{
-			stack.pass = ChopWinding (p->winding, &stack, &thread->pstack_head.portalplane);
+			stack.pass = ChopWinding (p->winding, &stack, &thread->pstack_head->portalplane);
 			if (!stack.pass)
 				continue;
 		}
@@ -631,7 +693,6 @@ generates the portalvis bit vector
 void PortalFlow (int iThread, int portalnum)
 {
 	threaddata_t	data;
-	int				i;
 	portal_t		*p;
 	int				c_might, c_can;
 
@@ -642,14 +703,22 @@ void PortalFlow (int iThread, int portalnum)
 
 	memset (&data, 0, sizeof(data));
 	data.base = p;
-	
-	data.pstack_head.portal = p;
-	data.pstack_head.source = p->winding;
-	data.pstack_head.portalplane = p->plane;
-	for (i=0 ; i<portallongs ; i++)
-		((long *)data.pstack_head.mightsee)[i] = ((long *)p->portalflood)[i];
+	data.thread = iThread;
+	data.pstack_head = GetStackFrame( iThread, 0 );
+
+	pstack_t *head = data.pstack_head;
+	head->next = NULL;
+	head->leaf = NULL;
+	head->portal = p;
+	head->source = p->winding;
+	head->pass = NULL;
+	head->portalplane = p->plane;
+	memcpy (head->mightsee, p->portalflood, portalbytes);
+	head->mightfirst = 0;
+	head->mightlast = portalwords;
+	TrimMightSee( head );
 
-	RecursiveLeafFlow (p->leaf, &data, &data.pstack_head);
+	RecursiveLeafFlow (p->leaf, &data, head);
 
 
 	p->status = stat_done;
@@ -830,9 +899,9 @@ void RecursiveLeafBitFlow (int leafnum, byte *mightsee, byte *cansee)
 	portal_t	*p;
 	leaf_t 		*leaf;
 	int			i, j;
-	long		more;
+	uint64		more;
 	int			pnum;
-	byte		newmight[MAX_PORTALS/8];
+	uint64		newmight[MAX_PORTALS/64];
 
 	leaf = &leafs[leafnum];
 	
@@ -848,11 +917,11 @@ void RecursiveLeafBitFlow (int leafnum, byte *mightsee, byte *cansee)
 
 		// if this portal can see some portals we mightsee, recurse
 		more = 0;
-		for (j=0 ; j<portallongs ; j++)
+		for (j=0 ; j<portalwords ; j++)
 		{
-			((long *)newmight)[j] = ((long *)mightsee)[j] 
-				& ((long *)p->portalflood)[j];
-			more |= ((long *)newmight)[j] & ~((long *)cansee)[j];
+			newmight[j] = ((uint64 *)mightsee)[j] 
+				& ((uint64 *)p->portalflood)[j];
+			more |= newmight[j] & ~((uint64 *)cansee)[j];
 		}
 
 		if (!more)
@@ -860,7 +929,7 @@ void RecursiveLeafBitFlow (int leafnum, byte *mightsee, byte *cansee)
 
 		SetBit( cansee, pnum );
 
-		RecursiveLeafBitFlow (p->leaf, newmight, cansee);
+		RecursiveLeafBitFlow (p->leaf, (byte *)newmight, cansee);
 	}	
 }
 
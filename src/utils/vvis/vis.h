@@ -64,9 +64,14 @@ struct leaf_t
 };
 
 	
+// Stack frames live in a per thread arena that is reused from portal to portal,
+// with mightsee sized to the map instead of MAX_PORTALS.
 struct pstack_t
 {
-	byte		mightsee[MAX_PORTALS/8];		// bit string
+	uint64		*mightsee;		// [portalwords] bit string, follows the frame in the arena
+	int			mightfirst;		// mightsee is only valid in words [mightfirst, mightlast),
+	int			mightlast;		// the rest is stale data left in the arena
+	int			depth;
 	pstack_t	*next;
 	leaf_t		*leaf;
 	portal_t	*portal;	// portal exiting
@@ -83,7 +88,8 @@ struct threaddata_t
 {
 	portal_t	*base;
 	int			c_chains;
-	pstack_t	pstack_head;
+	int			thread;
+	pstack_t	*pstack_head;
 };
 
 extern	int			g_numportals;
@@ -103,8 +109,9 @@ extern	int			testlevel;
 
 extern	byte		*uncompressed;
 
-extern	int		leafbytes, leaflongs;
-extern	int		portalbytes, portallongs;
+// bit strings are padded out to whole 64 bit words
+extern	int		leafbytes, leafwords;
+extern	int		portalbytes, portalwords;
 
 
 void LeafFlow (int leafnum);
@@ -7,17 +7,21 @@
 //=============================================================================//
 // vis.c
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include "vis.h"
 #include "threads.h"
 #include "stdlib.h"
 #include "pacifier.h"
+#ifdef MPI
 #include "vmpi.h"
 #include "mpivis.h"
+#include "vmpi_tools_shared.h"
+#endif
 #include "tier1/strtools.h"
 #include "collisionutils.h"
 #include "tier0/icommandline.h"
-#include "vmpi_tools_shared.h"
 #include "ilaunchabledll.h"
 #include "tools_minidump.h"
 #include "loadcmdline.h"
@@ -40,9 +44,9 @@ byte		*vismap, *vismap_p, *vismap_end;	// past visfile
 int			originalvismapsize;
 
 int			leafbytes;				// (portalclusters+63)>>3
-int			leaflongs;
+int			leafwords;
 
-int			portalbytes, portallongs;
+int			portalbytes, portalwords;
 
 bool		fastvis;
 bool		nosort;
@@ -56,6 +60,9 @@ double		g_VisRadius = 4096.0f * 4096.0f;
 
 bool		g_bLowPriority = false;
 
+// -benchmark <pvsfile>: time CalcVis and compare the uncompressed PVS against a reference
+const char	*g_pszBenchmarkPVS = NULL;
+
 //=============================================================================
 
 void PlaneFromWinding (winding_t *w, plane_t *plane)
@@ -213,8 +220,8 @@ void ClusterMerge (int clusternum)
 		p = leaf->portals[i];
 		if (p->status != stat_done)
 			Error ("portal not done %d %p %p\n", i, p, portals);
-		for (j=0 ; j<portallongs ; j++)
-			((long *)portalvector)[j] |= ((long *)p->portalvis)[j];
+		for (j=0 ; j<portalwords ; j++)
+			((uint64 *)portalvector)[j] |= ((uint64 *)p->portalvis)[j];
 		pnum = p - portals;
 		SetBit( portalvector, pnum );
 	}
@@ -310,7 +317,16 @@ void CalcPortalVis (void)
 	else 
 #endif
 	{
-		RunThreadsOnIndividual (g_numportals*2, true, PortalFlow);
+		// the flood recurses through every portal a portal might see, so the work grows much
+		// faster than nummightsee. tell the scheduler so the expensive tail is cut up finer
+		CUtlVector<float> flowCosts;
+		flowCosts.SetCount( g_numportals*2 );
+		for (i=0 ; i<g_numportals*2 ; i++)
+		{
+			float flMightSee = sorted_portals[i]->nummightsee + 1;
+			flowCosts[i] = flMightSee * flMightSee;
+		}
+		RunThreadsOnIndividualWeighted (g_numportals*2, true, PortalFlow, flowCosts.Base());
 	}
 }
 
@@ -476,10 +492,10 @@ void LoadPortals (char *name)
 
 	// these counts should take advantage of 64 bit systems automatically
 	leafbytes = ((portalclusters+63)&~63)>>3;
-	leaflongs = leafbytes/sizeof(long);
+	leafwords = leafbytes/sizeof(uint64);
 	
 	portalbytes = ((g_numportals*2+63)&~63)>>3;
-	portallongs = portalbytes/sizeof(long);
+	portalwords = portalbytes/sizeof(uint64);
 
 // each file portal is split into two memory portals
 	portals = (portal_t*)malloc(2*g_numportals*sizeof(portal_t));
@@ -575,8 +591,8 @@ void CalcPAS (void)
 {
 	int		i, j, k, l, index;
 	int		bitbyte;
-	long	*dest, *src;
-	byte	*scan;
+	uint64	*src;
+	byte	*dest, *scan;
 	int		count;
 	byte	uncompressed[MAX_MAP_LEAFS/8];
 	byte	compressed[MAX_MAP_LEAFS/8];
@@ -601,10 +617,9 @@ void CalcPAS (void)
 				index = ((j<<3)+k);
 				if (index >= portalclusters)
 					Error ("Bad bit in PVS");	// pad bits should be 0
-				src = (long *)(uncompressedvis + index*leafbytes);
-				dest = (long *)uncompressed;
-				for (l=0 ; l<leaflongs ; l++)
-					((long *)uncompressed)[l] |= src[l];
+				src = (uint64 *)(uncompressedvis + index*leafbytes);
+				for (l=0 ; l<leafwords ; l++)
+					((uint64 *)uncompressed)[l] |= src[l];
 			}
 		}
 		for (j=0 ; j<portalclusters ; j++)
@@ -620,13 +635,13 @@ void CalcPAS (void)
 	//
 		j = CompressVis (uncompressed, compressed);
 
-		dest = (long *)vismap_p;
+		dest = vismap_p;
 		vismap_p += j;
 		
 		if (vismap_p > vismap_end)
 			Error ("Vismap expansion overflow");
 
-		dvis->bitofs[i][DVIS_PAS] = (byte *)dest-vismap;
+		dvis->bitofs[i][DVIS_PAS] = dest-vismap;
 
 		memcpy (dest, compressed, j);	
 	}
@@ -912,6 +927,47 @@ void MarkLeavesAsRadial()
 }
 
 
+//-----------------------------------------------------------------------------
+// Reports how long CalcVis took and whether the uncompressed PVS matches the
+// reference file byte for byte. The first run writes the reference.
+//-----------------------------------------------------------------------------
+static void BenchmarkCompareVis( double flVisTime )
+{
+	int nBytes = portalclusters * leafbytes;
+
+	Msg( "benchmark: %i portals, %i clusters, vis took %.3f seconds\n", g_numportals, portalclusters, flVisTime );
+
+	if ( !FileExists( g_pszBenchmarkPVS ) )
+	{
+		SaveFile( g_pszBenchmarkPVS, uncompressedvis, nBytes );
+		Msg( "benchmark: wrote reference pvs %s (%i bytes)\n", g_pszBenchmarkPVS, nBytes );
+		return;
+	}
+
+	byte *pReference;
+	int nReferenceBytes = LoadFile( g_pszBenchmarkPVS, (void **)&pReference );
+	if ( nReferenceBytes != nBytes )
+	{
+		Warning( "benchmark: pvs is %i bytes, reference %s is %i bytes\n", nBytes, g_pszBenchmarkPVS, nReferenceBytes );
+	}
+	else
+	{
+		int nDiffClusters = 0;
+		for ( int i = 0; i < portalclusters; i++ )
+		{
+			if ( memcmp( uncompressedvis + i*leafbytes, pReference + i*leafbytes, leafbytes ) )
+				nDiffClusters++;
+		}
+
+		if ( nDiffClusters )
+			Warning( "benchmark: pvs differs from %s in %i of %i clusters\n", g_pszBenchmarkPVS, nDiffClusters, portalclusters );
+		else
+			Msg( "benchmark: pvs is identical to %s\n", g_pszBenchmarkPVS );
+	}
+	free( pReference );
+}
+
+
 int ParseCommandLine( int argc, char **argv )
 {
 	int i;
@@ -953,6 +1009,19 @@ int ParseCommandLine( int argc, char **argv )
 			Msg ("nosort = true\n");
 			nosort = true;
 		}
+		else if( !Q_stricmp( argv[i], "-benchmark" ) )
+		{
+			// The last argument is always the map
+			if ( i + 1 >= argc - 1 )
+			{
+				Warning( "Error: expected a pvs file after '-benchmark'\n\n" );
+				i = 100000;	// force it to print the usage
+				break;
+			}
+
+			g_pszBenchmarkPVS = argv[i+1];
+			i++;
+		}
 		else if (!Q_stricmp (argv[i],"-tmpin"))
 			strcpy (inbase, "/tmp");
 		else if( !Q_stricmp( argv[i], "-low" ) )
@@ -1045,6 +1114,8 @@ void PrintUsage( int argc, char **argv )
 		"  -tmpin          : Make portals come from \\tmp\\<mapname>.\n"
 		"  -tmpout         : Make portals come from \\tmp\\<mapname>.\n"
 		"  -trace <start cluster> <end cluster> : Writes a linefile that traces the vis from one cluster to another for debugging map vis.\n"
+		"  -benchmark <pvsfile> : Time the vis calculation and compare the PVS with <pvsfile>\n"
+		"                    (written if it doesn't exist). The bsp isn't written.\n"
 		"  -FullMinidumps  : Write large minidumps on crash.\n"
 		"  -x360		   : Generate Xbox360 version of vsp\n"
 		"  -nox360		   : Disable generation Xbox360 version of vsp (default)\n"
@@ -1178,7 +1249,12 @@ int RunVVis( int argc, char **argv )
 	// don't write out results when simply doing a trace
 	if ( g_TraceClusterStart < 0 )
 	{
+		double visStart = Plat_FloatTime();
 		CalcVis ();
+		if ( g_pszBenchmarkPVS )
+		{
+			BenchmarkCompareVis( Plat_FloatTime() - visStart );
+		}
 		CalcPAS ();
 
 		// We need a mapping from cluster to leaves, since the PVS
@@ -1191,8 +1267,11 @@ int RunVVis( int argc, char **argv )
 		visdatasize = vismap_p - dvisdata;
 		Msg ("visdatasize:%i  compressed from %i\n", visdatasize, originalvismapsize*2);
 
-		Msg ("writing %s\n", mapFile);
-		WriteBSPFile (mapFile);
+		if ( !g_pszBenchmarkPVS )
+		{
+			Msg ("writing %s\n", mapFile);
+			WriteBSPFile (mapFile);
+		}
 	}
 	else
 	{